@@ -0,0 +1,895 @@
+/* aistarget.c -- the AIS targets around us, by MMSI and by place
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "gpsd.h"
+#include "gps_json.h"
+#include "jsonout.h"
+#include "timeutil.h"
+#include "aistarget.h"
+
+#define M_PER_DEG	111120.0	/* m per degree of latitude */
+#define GRID_ROWS	((uint32_t)(180 / AISTARGET_CELL + 0.5))
+#define GRID_COLS	((uint32_t)(360 / AISTARGET_CELL + 0.5))
+#define NONE		(-1)
+
+/* room kept for closing a reply once targets no longer fit */
+#define AISTARGET_TAIL	40
+
+static uint32_t mmsi_chain(uint32_t mmsi)
+{
+    return ((mmsi * 2654435761u) >> 16) & (AISTARGET_HASH - 1);
+}
+
+static uint32_t cell_chain(uint32_t cell)
+{
+    return ((cell * 2654435761u) >> 16) & (AISTARGET_GRID - 1);
+}
+
+static uint32_t cell_row(double lat)
+{
+    double row = floor((lat + 90.0) / AISTARGET_CELL);
+
+    if (row < 0)
+	return 0;
+    if (row >= GRID_ROWS)
+	return GRID_ROWS - 1;
+    return (uint32_t)row;
+}
+
+static uint32_t cell_col(long col)
+/* columns run round the globe */
+{
+    col %= (long)GRID_COLS;
+    if (col < 0)
+	col += GRID_COLS;
+    return (uint32_t)col;
+}
+
+static long lon_col(double lon)
+{
+    return (long)floor((lon + 180.0) / AISTARGET_CELL);
+}
+
+static double lon_diff(double lon1, double lon2)
+/* lon1 - lon2, the short way round */
+{
+    double d = lon1 - lon2;
+
+    if (d > 180.0)
+	d -= 360.0;
+    else if (d < -180.0)
+	d += 360.0;
+    return d;
+}
+
+static double distance(double lat1, double lon1, double lat2, double lon2)
+/* m, on a plane, good enough for the ranges AIS is heard over */
+{
+    double x = lon_diff(lon2, lon1) * cos((lat1 + lat2) / 2 * DEG_2_RAD);
+
+    return hypot(x, lat2 - lat1) * M_PER_DEG;
+}
+
+/*
+ * Linking and unlinking.  Every target is on three lists: the chain of
+ * its MMSI, the chain of its grid cell (when it has a position) and
+ * the age list.
+ */
+
+static void mmsi_link(struct aistarget_table_t *table, int32_t i)
+{
+    uint32_t h = mmsi_chain(table->target[i].mmsi);
+
+    table->target[i].next_mmsi = table->mmsi[h];
+    table->mmsi[h] = i;
+}
+
+static int32_t *mmsi_ref(struct aistarget_table_t *table, int32_t i)
+/* the link pointing at target i */
+{
+    int32_t *ref = &table->mmsi[mmsi_chain(table->target[i].mmsi)];
+
+    while (*ref != i)
+	ref = &table->target[*ref].next_mmsi;
+    return ref;
+}
+
+static void cell_link(struct aistarget_table_t *table, int32_t i)
+{
+    struct aistarget_t *t = &table->target[i];
+    int32_t *head = &table->grid[cell_chain(t->cell)];
+
+    t->prev_cell = NONE;
+    t->next_cell = *head;
+    if (*head != NONE)
+	table->target[*head].prev_cell = i;
+    *head = i;
+}
+
+static void cell_unlink(struct aistarget_table_t *table, int32_t i)
+{
+    struct aistarget_t *t = &table->target[i];
+
+    if (t->cell == AISTARGET_NO_CELL)
+	return;
+    if (t->prev_cell != NONE)
+	table->target[t->prev_cell].next_cell = t->next_cell;
+    else
+	table->grid[cell_chain(t->cell)] = t->next_cell;
+    if (t->next_cell != NONE)
+	table->target[t->next_cell].prev_cell = t->prev_cell;
+}
+
+static void age_link(struct aistarget_table_t *table, int32_t i)
+/* as the newest */
+{
+    struct aistarget_t *t = &table->target[i];
+
+    t->newer = NONE;
+    t->older = table->newest;
+    if (table->newest != NONE)
+	table->target[table->newest].newer = i;
+    else
+	table->oldest = i;
+    table->newest = i;
+}
+
+static void age_unlink(struct aistarget_table_t *table, int32_t i)
+{
+    struct aistarget_t *t = &table->target[i];
+
+    if (t->older != NONE)
+	table->target[t->older].newer = t->newer;
+    else
+	table->oldest = t->newer;
+    if (t->newer != NONE)
+	table->target[t->newer].older = t->older;
+    else
+	table->newest = t->older;
+}
+
+static void drop(struct aistarget_table_t *table, int32_t i)
+/* drop target i, the last one moves into its place */
+{
+    int32_t last = (int32_t)table->count - 1;
+    struct aistarget_t *t;
+
+    *mmsi_ref(table, i) = table->target[i].next_mmsi;
+    cell_unlink(table, i);
+    age_unlink(table, i);
+    table->count--;
+    if (i == last)
+	return;
+
+    /* whatever pointed at the last one now points at i */
+    *mmsi_ref(table, last) = i;
+    table->target[i] = table->target[last];
+    t = &table->target[i];
+    if (t->cell != AISTARGET_NO_CELL) {
+	if (t->prev_cell != NONE)
+	    table->target[t->prev_cell].next_cell = i;
+	else
+	    table->grid[cell_chain(t->cell)] = i;
+	if (t->next_cell != NONE)
+	    table->target[t->next_cell].prev_cell = i;
+    }
+    if (t->older != NONE)
+	table->target[t->older].newer = i;
+    else
+	table->oldest = i;
+    if (t->newer != NONE)
+	table->target[t->newer].older = i;
+    else
+	table->newest = i;
+}
+
+/*@null@*/struct aistarget_table_t *aistarget_new(void)
+{
+    struct aistarget_table_t *table;
+    int i;
+
+    table = (struct aistarget_table_t *)malloc(sizeof(*table));
+    if (table == NULL)
+	return NULL;
+    table->target = NULL;
+    table->hit = table->spare = NULL;
+    table->count = table->allocated = table->hits = 0;
+    table->oldest = table->newest = NONE;
+    (void)memset(&table->own, 0, sizeof(table->own));
+    table->own.valid = false;
+    for (i = 0; i < AISTARGET_HASH; i++)
+	table->mmsi[i] = NONE;
+    for (i = 0; i < AISTARGET_GRID; i++)
+	table->grid[i] = NONE;
+    return table;
+}
+
+void aistarget_free(/*@null@*/struct aistarget_table_t *table)
+{
+    if (table == NULL)
+	return;
+    free(table->target);
+    free(table->hit);
+    free(table->spare);
+    free(table);
+}
+
+/*@null@*/struct aistarget_t *aistarget_find(struct aistarget_table_t *table,
+					      uint32_t mmsi)
+{
+    int32_t i;
+
+    for (i = table->mmsi[mmsi_chain(mmsi)]; i != NONE;
+	 i = table->target[i].next_mmsi)
+	if (table->target[i].mmsi == mmsi)
+	    return &table->target[i];
+    return NULL;
+}
+
+void aistarget_expire(struct aistarget_table_t *table, uint32_t now)
+/* drop the targets not heard from for AISTARGET_AGE */
+{
+    while (table->oldest != NONE
+	   && now - table->target[table->oldest].seen > AISTARGET_AGE)
+	drop(table, table->oldest);
+}
+
+static int32_t add(struct aistarget_table_t *table, uint32_t mmsi)
+/* a new target, NONE when there is no memory for it */
+{
+    struct aistarget_t *t;
+    int32_t i;
+
+    if (table->count == AISTARGET_MAX)
+	drop(table, table->oldest);
+    if (table->count == table->allocated) {
+	uint32_t n = table->allocated ? table->allocated * 2 : 64;
+	struct aistarget_t *target;
+	struct aistarget_hit_t *hit;
+
+	if (n > AISTARGET_MAX)
+	    n = AISTARGET_MAX;
+	target = (struct aistarget_t *)realloc(table->target,
+					       n * sizeof(*target));
+	if (target == NULL)
+	    return NONE;
+	table->target = target;
+	hit = (struct aistarget_hit_t *)realloc(table->hit, n * sizeof(*hit));
+	if (hit == NULL)
+	    return NONE;
+	table->hit = hit;
+	hit = (struct aistarget_hit_t *)realloc(table->spare, n * sizeof(*hit));
+	if (hit == NULL)
+	    return NONE;
+	table->spare = hit;
+	table->allocated = n;
+    }
+
+    i = (int32_t)table->count++;
+    t = &table->target[i];
+    (void)memset(t, 0, sizeof(*t));
+    t->mmsi = mmsi;
+    t->lat = t->lon = t->sog = t->cog = t->heading = NAN;
+    t->status = -1;
+    t->length = t->beam = NAN;
+    t->cpa = t->tcpa = NAN;
+    t->cell = AISTARGET_NO_CELL;
+    t->prev_cell = t->next_cell = NONE;
+    mmsi_link(table, i);
+    age_link(table, i);
+    return i;
+}
+
+static void copy_text(char *to, size_t len, const char *from)
+/* without the blanks and '@' AIS pads text with */
+{
+    size_t n;
+
+    (void)strlcpy(to, from, len);
+    for (n = strlen(to); n > 0 && (to[n - 1] == ' ' || to[n - 1] == '@'); n--)
+	to[n - 1] = '\0';
+}
+
+static void set_dimensions(struct aistarget_t *t, unsigned int bow,
+			   unsigned int stern, unsigned int port,
+			   unsigned int starboard)
+{
+    if (bow + stern > 0)
+	t->length = (double)(bow + stern);
+    if (port + starboard > 0)
+	t->beam = (double)(port + starboard);
+}
+
+static void set_position(struct aistarget_table_t *table, int32_t i,
+			 double lat, double lon, uint32_t now)
+{
+    struct aistarget_t *t = &table->target[i];
+    uint32_t cell;
+
+    if (fabs(lat) > 90.0 || fabs(lon) > 180.0)
+	return;
+    t->lat = lat;
+    t->lon = lon;
+    t->moved = now;
+    cell = cell_row(lat) * GRID_COLS + cell_col(lon_col(lon));
+    if (cell != t->cell) {
+	cell_unlink(table, i);
+	t->cell = cell;
+	cell_link(table, i);
+    }
+}
+
+static void set_velocity(struct aistarget_t *t)
+/* once per report, so working out the CPA needs no trigonometry */
+{
+    if (isfinite(t->sog) && isfinite(t->cog)) {
+	t->east = t->sog * sin(t->cog * DEG_2_RAD);
+	t->north = t->sog * cos(t->cog * DEG_2_RAD);
+    } else
+	t->east = t->north = 0.0;
+}
+
+static void set_motion(struct aistarget_t *t, unsigned int speed,
+		       unsigned int course, unsigned int heading)
+/* speed in deciknots, course in tenth degrees, as class A and B send */
+{
+    t->sog = speed != AIS_SPEED_NOT_AVAILABLE
+	? speed * 0.1 * KNOTS_TO_MPS : NAN;
+    t->cog = course < AIS_COURSE_NOT_AVAILABLE ? course * 0.1 : NAN;
+    t->heading = heading < 360 ? (double)heading : NAN;
+    set_velocity(t);
+}
+
+bool aistarget_update(struct aistarget_table_t *table,
+		      const struct ais_t *ais, uint32_t now)
+/* merge a report into the target it is from, false if it says nothing */
+{
+    struct aistarget_t *t;
+    int32_t i;
+    bool moved = false;
+
+    switch (ais->type) {
+    case 1: case 2: case 3: case 4: case 5:
+    case 18: case 19: case 21: case 24: case 27:
+	break;
+    default:
+	return false;
+    }
+    if (ais->mmsi == 0)
+	return false;
+
+    aistarget_expire(table, now);
+    t = aistarget_find(table, ais->mmsi);
+    if (t != NULL) {
+	i = (int32_t)(t - table->target);
+	age_unlink(table, i);
+	age_link(table, i);
+    } else if ((i = add(table, ais->mmsi)) == NONE)
+	return false;
+    t = &table->target[i];
+    t->seen = now;
+
+    switch (ais->type) {
+    case 1: case 2: case 3:
+	t->aisclass = aistarget_class_a;
+	t->status = (int)ais->type1.status;
+	if (ais->type1.lat != AIS_LAT_NOT_AVAILABLE
+	    && ais->type1.lon != AIS_LON_NOT_AVAILABLE) {
+	    set_position(table, i, ais->type1.lat / AIS_LATLON_DIV,
+			 ais->type1.lon / AIS_LATLON_DIV, now);
+	    moved = true;
+	}
+	set_motion(t, ais->type1.speed, ais->type1.course,
+		   ais->type1.heading);
+	break;
+    case 4:
+	t->aisclass = aistarget_base;
+	if (ais->type4.lat != AIS_LAT_NOT_AVAILABLE
+	    && ais->type4.lon != AIS_LON_NOT_AVAILABLE)
+	    set_position(table, i, ais->type4.lat / AIS_LATLON_DIV,
+			 ais->type4.lon / AIS_LATLON_DIV, now);
+	break;
+    case 5:
+	t->aisclass = aistarget_class_a;
+	copy_text(t->name, sizeof(t->name), ais->type5.shipname);
+	copy_text(t->callsign, sizeof(t->callsign), ais->type5.callsign);
+	copy_text(t->destination, sizeof(t->destination),
+		  ais->type5.destination);
+	t->shiptype = ais->type5.shiptype;
+	set_dimensions(t, ais->type5.to_bow, ais->type5.to_stern,
+		       ais->type5.to_port, ais->type5.to_starboard);
+	break;
+    case 18:
+	t->aisclass = aistarget_class_b;
+	if (ais->type18.lat != AIS_LAT_NOT_AVAILABLE
+	    && ais->type18.lon != AIS_LON_NOT_AVAILABLE) {
+	    set_position(table, i, ais->type18.lat / AIS_LATLON_DIV,
+			 ais->type18.lon / AIS_LATLON_DIV, now);
+	    moved = true;
+	}
+	set_motion(t, ais->type18.speed, ais->type18.course,
+		   ais->type18.heading);
+	break;
+    case 19:
+	t->aisclass = aistarget_class_b;
+	if (ais->type19.lat != AIS_LAT_NOT_AVAILABLE
+	    && ais->type19.lon != AIS_LON_NOT_AVAILABLE) {
+	    set_position(table, i, ais->type19.lat / AIS_LATLON_DIV,
+			 ais->type19.lon / AIS_LATLON_DIV, now);
+	    moved = true;
+	}
+	set_motion(t, ais->type19.speed, ais->type19.course,
+		   ais->type19.heading);
+	copy_text(t->name, sizeof(t->name), ais->type19.shipname);
+	t->shiptype = ais->type19.shiptype;
+	set_dimensions(t, ais->type19.to_bow, ais->type19.to_stern,
+		       ais->type19.to_port, ais->type19.to_starboard);
+	break;
+    case 21:
+	t->aisclass = aistarget_aton;
+	if (ais->type21.lat != AIS_LAT_NOT_AVAILABLE
+	    && ais->type21.lon != AIS_LON_NOT_AVAILABLE)
+	    set_position(table, i, ais->type21.lat / AIS_LATLON_DIV,
+			 ais->type21.lon / AIS_LATLON_DIV, now);
+	copy_text(t->name, sizeof(t->name), ais->type21.name);
+	t->shiptype = ais->type21.aid_type;
+	break;
+    case 24:
+	t->aisclass = aistarget_class_b;
+	if (ais->type24.part != part_b)
+	    copy_text(t->name, sizeof(t->name), ais->type24.shipname);
+	if (ais->type24.part != part_a) {
+	    t->shiptype = ais->type24.shiptype;
+	    copy_text(t->callsign, sizeof(t->callsign), ais->type24.callsign);
+	    /* an auxiliary craft names its mothership instead */
+	    if (!AIS_AUXILIARY_MMSI(ais->mmsi))
+		set_dimensions(t, ais->type24.dim.to_bow,
+			       ais->type24.dim.to_stern,
+			       ais->type24.dim.to_port,
+			       ais->type24.dim.to_starboard);
+	}
+	break;
+    case 27:
+	t->status = (int)ais->type27.status;
+	if (ais->type27.lat != AIS_LONGRANGE_LAT_NOT_AVAILABLE
+	    && ais->type27.lon != AIS_LONGRANGE_LON_NOT_AVAILABLE) {
+	    set_position(table, i, ais->type27.lat / AIS_LONGRANGE_LATLON_DIV,
+			 ais->type27.lon / AIS_LONGRANGE_LATLON_DIV, now);
+	    moved = true;
+	}
+	t->sog = ais->type27.speed != AIS_LONGRANGE_SPEED_NOT_AVAILABLE
+	    ? ais->type27.speed * KNOTS_TO_MPS : NAN;
+	t->cog = ais->type27.course != AIS_LONGRANGE_COURSE_NOT_AVAILABLE
+	    ? (double)ais->type27.course : NAN;
+	set_velocity(t);
+	break;
+    }
+
+    if (moved)
+	aistarget_cpa(table, t);
+    return true;
+}
+
+void aistarget_own(struct aistarget_table_t *table, double lat, double lon,
+		   double cog, double sog, uint32_t now)
+/* own ship's fix; only a new reference fix invalidates the CPAs */
+{
+    struct aistarget_own_t *own = &table->own;
+
+    if (!isfinite(lat) || !isfinite(lon))
+	return;
+    if (!isfinite(sog))
+	sog = 0.0;
+    if (!isfinite(cog))
+	cog = 0.0;
+
+    if (own->valid) {
+	double dt = (double)(int32_t)(now - own->msec) / 1000.0;
+	double north = own->north * dt / M_PER_DEG;
+	double east = own->east * dt / M_PER_DEG / own->coslat;
+	double turn = fabs(lon_diff(cog, own->cog));
+
+	/* the course of a ship hardly moving is noise */
+	if (sog < AISTARGET_OWN_SPEED && own->sog < AISTARGET_OWN_SPEED)
+	    turn = 0.0;
+	if (distance(own->lat + north, own->lon + east, lat, lon)
+		< AISTARGET_OWN_DRIFT
+	    && turn < AISTARGET_OWN_TURN
+	    && fabs(sog - own->sog) < AISTARGET_OWN_SPEED)
+	    return;
+    }
+
+    own->valid = true;
+    own->msec = now;
+    own->lat = lat;
+    own->lon = lon;
+    own->sog = sog;
+    own->cog = cog;
+    own->east = sog * sin(cog * DEG_2_RAD);
+    own->north = sog * cos(cog * DEG_2_RAD);
+    own->coslat = cos(lat * DEG_2_RAD);
+    own->epoch++;
+}
+
+void aistarget_cpa(struct aistarget_table_t *table, struct aistarget_t *t)
+/* work out where the target and own ship come closest */
+{
+    const struct aistarget_own_t *own = &table->own;
+    double dt, rx, ry, wx, wy, w2, tcpa;
+
+    t->epoch = own->epoch;
+    if (!own->valid || !isfinite(t->lat)) {
+	t->cpa = t->tcpa = NAN;
+	return;
+    }
+
+    /* from own ship where it was when the target reported */
+    dt = (double)(int32_t)(t->moved - own->msec) / 1000.0;
+    rx = lon_diff(t->lon, own->lon) * own->coslat * M_PER_DEG
+	- own->east * dt;
+    ry = (t->lat - own->lat) * M_PER_DEG - own->north * dt;
+
+    /* their velocity relative to ours */
+    wx = t->east - own->east;
+    wy = t->north - own->north;
+    w2 = wx * wx + wy * wy;
+
+    tcpa = w2 > 1e-9 ? -(rx * wx + ry * wy) / w2 : 0.0;
+    t->tcpa = tcpa;
+    t->cpa = hypot(rx + wx * tcpa, ry + wy * tcpa);
+}
+
+double aistarget_tcpa(const struct aistarget_t *t, uint32_t now)
+/* s from now to the closest point of approach */
+{
+    return t->tcpa - (double)(int32_t)(now - t->moved) / 1000.0;
+}
+
+static bool matches(const struct aistarget_query_t *query,
+		    const struct aistarget_t *t)
+{
+    double lon;
+
+    switch (query->kind) {
+    case aistarget_all:
+	return true;
+    case aistarget_mmsi:
+	return t->mmsi == query->mmsi;
+    case aistarget_radius:
+	return isfinite(t->lat)
+	    && distance(query->lat, query->lon, t->lat, t->lon)
+		<= query->radius;
+    case aistarget_box:
+	if (!isfinite(t->lat) || t->lat < query->south || t->lat > query->north)
+	    return false;
+	lon = t->lon;
+	if (query->west > query->east)
+	    return lon >= query->west || lon <= query->east;
+	return lon >= query->west && lon <= query->east;
+    }
+    return false;
+}
+
+static void add_hit(struct aistarget_table_t *table,
+		    const struct aistarget_query_t *query, int32_t i)
+{
+    const struct aistarget_t *t = &table->target[i];
+    struct aistarget_hit_t *h;
+
+    if (!matches(query, t))
+	return;
+    h = &table->hit[table->hits++];
+    h->index = i;
+    if (!isfinite(t->lat))
+	h->range = NAN;
+    else if (table->own.valid)
+	h->range = distance(table->own.lat, table->own.lon, t->lat, t->lon);
+    else if (query->kind == aistarget_radius)
+	h->range = distance(query->lat, query->lon, t->lat, t->lon);
+    else
+	h->range = NAN;
+    /* decimetres sort as well as metres and fit any range */
+    h->key = isnan(h->range) ? UINT32_MAX : (uint32_t)(h->range * 10.0);
+}
+
+static void sort_hits(struct aistarget_table_t *table)
+/* nearest first, those without a range last, by radix on the key */
+{
+    struct aistarget_hit_t *from = table->hit, *to = table->spare, *swap;
+    uint32_t n = table->hits, i, shift;
+
+    if (n < 32) {
+	for (i = 1; i < n; i++) {
+	    struct aistarget_hit_t h = from[i];
+	    uint32_t j = i;
+
+	    for (; j > 0 && from[j - 1].key > h.key; j--)
+		from[j] = from[j - 1];
+	    from[j] = h;
+	}
+	return;
+    }
+    for (shift = 0; shift < 32; shift += 8) {
+	uint32_t count[256], sum = 0, c;
+
+	(void)memset(count, 0, sizeof(count));
+	for (i = 0; i < n; i++)
+	    count[(from[i].key >> shift) & 0xff]++;
+	/* all alike in this byte, nothing to move */
+	if (count[(from[0].key >> shift) & 0xff] == n)
+	    continue;
+	for (c = 0; c < 256; c++) {
+	    uint32_t k = count[c];
+
+	    count[c] = sum;
+	    sum += k;
+	}
+	for (i = 0; i < n; i++)
+	    to[count[(from[i].key >> shift) & 0xff]++] = from[i];
+	swap = from;
+	from = to;
+	to = swap;
+    }
+    if (from != table->hit)
+	(void)memcpy(table->hit, from, n * sizeof(*from));
+}
+
+static void select_cells(struct aistarget_table_t *table,
+			 const struct aistarget_query_t *query,
+			 uint32_t row0, uint32_t row1, long col0, long col1)
+/* the targets of the cells in rows row0..row1, columns col0..col1 */
+{
+    uint32_t row;
+    long col;
+
+    if (col1 - col0 >= (long)GRID_COLS) {
+	col0 = 0;
+	col1 = GRID_COLS - 1;
+    }
+    for (row = row0; row <= row1; row++)
+	for (col = col0; col <= col1; col++) {
+	    uint32_t cell = row * GRID_COLS + cell_col(col);
+	    int32_t i;
+
+	    for (i = table->grid[cell_chain(cell)]; i != NONE;
+		 i = table->target[i].next_cell)
+		if (table->target[i].cell == cell)
+		    add_hit(table, query, i);
+	}
+}
+
+uint32_t aistarget_select(struct aistarget_table_t *table,
+			  const struct aistarget_query_t *query, uint32_t now)
+/* the targets a query asks for in table->hit, nearest first */
+{
+    uint32_t row0 = 0, row1 = 0, i;
+    long col0 = 0, col1 = 0;
+    double cells = INFINITY;
+
+    aistarget_expire(table, now);
+    table->hits = 0;
+
+    if (query->kind == aistarget_radius) {
+	double dlat = query->radius / M_PER_DEG;
+	double maxlat = fabs(query->lat) + dlat;
+
+	row0 = cell_row(query->lat - dlat);
+	row1 = cell_row(query->lat + dlat);
+	if (maxlat < 89.0) {
+	    double dlon = dlat / cos(maxlat * DEG_2_RAD);
+
+	    col0 = lon_col(query->lon - dlon);
+	    col1 = lon_col(query->lon + dlon);
+	} else {
+	    col0 = 0;
+	    col1 = GRID_COLS - 1;
+	}
+    } else if (query->kind == aistarget_box) {
+	row0 = cell_row(query->south);
+	row1 = cell_row(query->north);
+	col0 = lon_col(query->west);
+	col1 = lon_col(query->east);
+	if (query->west > query->east)
+	    col1 += GRID_COLS;
+    }
+    if (query->kind == aistarget_radius || query->kind == aistarget_box)
+	cells = (double)(row1 + 1 - row0) * (double)(col1 + 1 - col0);
+    if (query->kind == aistarget_box && query->south > query->north)
+	cells = 0;
+
+    if (query->kind == aistarget_mmsi) {
+	struct aistarget_t *t = aistarget_find(table, query->mmsi);
+
+	if (t != NULL)
+	    add_hit(table, query, (int32_t)(t - table->target));
+    } else if (cells == 0)
+	;
+    else if (cells < (double)table->count)
+	select_cells(table, query, row0, row1, col0, col1);
+    else {
+	/* covering more cells than there are targets, look at them all */
+	for (i = 0; i < table->count; i++)
+	    add_hit(table, query, (int32_t)i);
+    }
+
+    for (i = 0; i < table->hits; i++) {
+	struct aistarget_t *t = &table->target[table->hit[i].index];
+
+	if (t->epoch != table->own.epoch)
+	    aistarget_cpa(table, t);
+    }
+    sort_hits(table);
+    return table->hits;
+}
+
+int aistarget_query_parse(const char *buf, struct aistarget_query_t *query,
+			  /*@null@*/const char **end)
+/* the query of ?AIS={...}; */
+{
+    double lat, lon, radius, south, west, north, east;
+    unsigned int mmsi, offset, limit;
+    int status;
+
+    /*@ -fullinitblock @*/
+    /* *INDENT-OFF* */
+    const struct json_attr_t json_attrs_ais[] = {
+	{"class",  t_check,    .dflt.check = "AIS"},
+	{"lat",    t_real,     .addr.real = &lat,    .dflt.real = NAN},
+	{"lon",    t_real,     .addr.real = &lon,    .dflt.real = NAN},
+	{"radius", t_real,     .addr.real = &radius, .dflt.real = NAN},
+	{"south",  t_real,     .addr.real = &south,  .dflt.real = NAN},
+	{"west",   t_real,     .addr.real = &west,   .dflt.real = NAN},
+	{"north",  t_real,     .addr.real = &north,  .dflt.real = NAN},
+	{"east",   t_real,     .addr.real = &east,   .dflt.real = NAN},
+	{"mmsi",   t_uinteger, .addr.uinteger = &mmsi, .dflt.uinteger = 0},
+	{"offset", t_uinteger, .addr.uinteger = &offset, .dflt.uinteger = 0},
+	{"limit",  t_uinteger, .addr.uinteger = &limit, .dflt.uinteger = 0},
+	{NULL},
+    };
+    /* *INDENT-ON* */
+    /*@ +fullinitblock @*/
+
+    (void)memset(query, 0, sizeof(*query));
+    query->kind = aistarget_all;
+    status = json_read_object(buf, json_attrs_ais, end);
+    if (status != 0)
+	return status;
+
+    query->offset = offset;
+    query->limit = limit;
+    if (mmsi != 0) {
+	query->kind = aistarget_mmsi;
+	query->mmsi = mmsi;
+    } else if (isfinite(lat) && isfinite(lon) && isfinite(radius)
+	       && radius > 0) {
+	query->kind = aistarget_radius;
+	query->lat = lat;
+	query->lon = lon;
+	query->radius = radius;
+    } else if (isfinite(south) && isfinite(west)
+	       && isfinite(north) && isfinite(east)) {
+	query->kind = aistarget_box;
+	query->south = south;
+	query->west = west;
+	query->north = north;
+	query->east = east;
+    }
+    return 0;
+}
+
+static void json_text(struct jsonout_t *out, const char *key, const char *s)
+{
+    char buf[JSON_VAL_MAX];
+
+    if (s[0] == '\0')
+	return;
+    jsonout_str(out, key);
+    jsonout_str(out, json_stringify(buf, sizeof(buf), s));
+    jsonout_char(out, '"');
+}
+
+static void json_real(struct jsonout_t *out, const char *key, double value,
+		      int decimals)
+{
+    if (!isfinite(value))
+	return;
+    jsonout_str(out, key);
+    jsonout_fixed(out, value, decimals);
+}
+
+static void json_target(struct jsonout_t *out, const struct aistarget_t *t,
+			double range, uint32_t now)
+{
+    static const char *classes[] = {"A", "B", "AtoN", "base"};
+
+    jsonout_lit(out, "{\"mmsi\":");
+    jsonout_uint(out, t->mmsi, 0);
+    jsonout_lit(out, ",\"type\":\"");
+    jsonout_str(out, classes[t->aisclass]);
+    jsonout_char(out, '"');
+    json_real(out, ",\"lat\":", t->lat, 6);
+    json_real(out, ",\"lon\":", t->lon, 6);
+    json_real(out, ",\"speed\":", t->sog, 2);
+    json_real(out, ",\"course\":", t->cog, 1);
+    json_real(out, ",\"heading\":", t->heading, 0);
+    if (t->status >= 0) {
+	jsonout_lit(out, ",\"status\":");
+	jsonout_uint(out, (unsigned long)t->status, 0);
+    }
+    json_text(out, ",\"name\":\"", t->name);
+    json_text(out, ",\"callsign\":\"", t->callsign);
+    if (t->shiptype != 0) {
+	jsonout_lit(out, ",\"shiptype\":");
+	jsonout_uint(out, t->shiptype, 0);
+    }
+    json_real(out, ",\"length\":", t->length, 0);
+    json_real(out, ",\"beam\":", t->beam, 0);
+    json_text(out, ",\"destination\":\"", t->destination);
+    json_real(out, ",\"range\":", range, 0);
+    json_real(out, ",\"cpa\":", t->cpa, 0);
+    json_real(out, ",\"tcpa\":", aistarget_tcpa(t, now), 0);
+    jsonout_lit(out, ",\"age\":");
+    jsonout_uint(out, (now - t->seen) / 1000, 0);
+    jsonout_char(out, '}');
+}
+
+void aistarget_json_dump(struct aistarget_table_t *table,
+			 const struct aistarget_query_t *query, uint32_t now,
+			 /*@out@*/char *reply, size_t len)
+/* the ?AIS reply, nearest first, from offset on as many as fit or the
+   limit allows; next is the offset of the rest */
+{
+    struct jsonout_t out;
+    uint32_t n, i, first, last;
+
+    n = aistarget_select(table, query, now);
+    first = query->offset < n ? query->offset : n;
+    last = n;
+    if (query->limit != 0 && query->limit < n - first)
+	last = first + query->limit;
+    jsonout_init(&out, reply, len - AISTARGET_TAIL);
+    jsonout_lit(&out, "{\"class\":\"AIS\",\"count\":");
+    jsonout_uint(&out, n, 0);
+    jsonout_lit(&out, ",\"targets\":[");
+    for (i = first; i < last; i++) {
+	char *mark = out.p;
+
+	if (i > first)
+	    jsonout_char(&out, ',');
+	json_target(&out, &table->target[table->hit[i].index],
+		    table->hit[i].range, now);
+	if (out.overflow) {
+	    /* leave out the one that did not fit */
+	    out.p = mark;
+	    *out.p = '\0';
+	    out.overflow = false;
+	    break;
+	}
+    }
+    out.end += AISTARGET_TAIL;
+    jsonout_char(&out, ']');
+    if (i < n) {
+	jsonout_lit(&out, ",\"more\":true,\"next\":");
+	jsonout_uint(&out, i, 0);
+    }
+    jsonout_lit(&out, "}\r\n");
+}
+
+void aistarget_report(struct gps_device_t *session)
+/* merge the AIS report just decoded */
+{
+    struct aistarget_table_t *table = session->context->ais_targets;
+
+    if (table == NULL || session->gpsdata.ais.own_mmsi != 0)
+	return;
+    (void)aistarget_update(table, &session->gpsdata.ais,
+			   tu_get_independend_time());
+}
+
+/* aistarget.c ends here */
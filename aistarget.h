@@ -0,0 +1,154 @@
+/* aistarget.h -- the AIS targets around us, by MMSI and by place
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _AISTARGET_H_
+#define _AISTARGET_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "gps.h"
+
+/*
+ * Every AIS report that names a vessel, an aid to navigation or a base
+ * station is merged into the target of its MMSI: position reports
+ * update where it is and where it goes, static reports its name and
+ * size.  A target not heard from for AISTARGET_AGE is dropped, when the
+ * table is full the one heard from longest ago makes room.
+ *
+ * Targets live in one dense array; deleting moves the last one into the
+ * gap.  They are found by MMSI through a chained hash and by place
+ * through a grid of AISTARGET_CELL degree cells, itself hashed into
+ * AISTARGET_GRID chains, so a radius or box query only looks at the
+ * targets of the cells it covers.  A third list orders them by the time
+ * they were last heard, which is what ageing walks.
+ *
+ * Closest point of approach is worked out against own ship on a plane
+ * tangent at own ship, both moving straight on.  Own ship is kept as a
+ * reference fix that is only replaced when the ship strays from its
+ * dead reckoning, turns or changes speed beyond the AISTARGET_OWN_*
+ * tolerances; that bumps an epoch.  A target's CPA is worked out when it
+ * reports and again only if it was for an older epoch, and holds until
+ * either changes course.  Times are msec of tu_get_independend_time().
+ */
+#ifndef GPSD_SLIM
+#define AISTARGET_MAX		16384
+#define AISTARGET_GRID		4096	/* chains of grid cells */
+#else
+#define AISTARGET_MAX		1024
+#define AISTARGET_GRID		512
+#endif /* GPSD_SLIM */
+#define AISTARGET_HASH		(AISTARGET_MAX * 2)	/* chains by MMSI */
+#define AISTARGET_AGE		(20 * 60 * 1000)	/* msec */
+#define AISTARGET_CELL		0.1	/* degrees, about 6nm north to south */
+#define AISTARGET_OWN_DRIFT	50.0	/* m off dead reckoning */
+#define AISTARGET_OWN_TURN	2.0	/* degrees of course */
+#define AISTARGET_OWN_SPEED	0.25	/* m/s */
+
+enum aistarget_class_t {
+    aistarget_class_a,
+    aistarget_class_b,
+    aistarget_aton,		/* aid to navigation */
+    aistarget_base,		/* base station */
+};
+
+struct aistarget_t {
+    /* what a query walks comes first, to share a cache line */
+    uint32_t mmsi;
+    uint32_t cell;		/* grid cell, AISTARGET_NO_CELL without position */
+    int32_t prev_cell, next_cell;	/* links, indices into the table or -1 */
+    double lat, lon;		/* degrees, NAN when not known */
+    int32_t next_mmsi;
+    int32_t older, newer;
+    uint32_t seen;		/* msec of the last report */
+    uint32_t moved;		/* msec of the last position report */
+    enum aistarget_class_t aisclass;
+    /* where it goes, NAN when not known */
+    double sog;			/* m/s */
+    double cog, heading;	/* degrees true */
+    double east, north;		/* velocity in m/s, 0 when not known */
+    int status;			/* navigation status, -1 not known */
+    /* closest point of approach to own ship */
+    uint32_t epoch;		/* of own ship the CPA is for */
+    double cpa;			/* m, NAN when it can't be worked out */
+    double tcpa;		/* s after moved, negative when it is past */
+    /* what it is, from static reports, 0 or "" when not known */
+    unsigned int shiptype;
+    double length, beam;	/* m */
+    char name[35];
+    char callsign[8];
+    char destination[21];
+};
+#define AISTARGET_NO_CELL	UINT32_MAX
+
+struct aistarget_own_t {
+    bool valid;
+    uint32_t msec;		/* of the reference fix */
+    double lat, lon;		/* degrees */
+    double sog;			/* m/s */
+    double cog;			/* degrees true */
+    double east, north;		/* velocity in m/s */
+    double coslat;		/* m east per m of a degree north */
+    uint32_t epoch;		/* bumped by every new reference fix */
+};
+
+enum aistarget_query_kind_t {
+    aistarget_all,
+    aistarget_radius,		/* lat, lon and radius */
+    aistarget_box,		/* south, west, north, east */
+    aistarget_mmsi,
+};
+
+struct aistarget_query_t {
+    enum aistarget_query_kind_t kind;
+    double lat, lon, radius;	/* degrees, m */
+    double south, west, north, east;	/* degrees, west > east crosses 180 */
+    uint32_t mmsi;
+    uint32_t offset;		/* of the first target in the reply */
+    uint32_t limit;		/* targets in the reply, 0 as many as fit */
+};
+
+/* a target a query found, with its distance from where ranges are taken */
+struct aistarget_hit_t {
+    int32_t index;
+    uint32_t key;		/* what hits are sorted by */
+    double range;		/* m, NAN when it has no position */
+};
+
+struct aistarget_table_t {
+    struct aistarget_t *target;
+    uint32_t count, allocated;
+    int32_t oldest, newest;
+    struct aistarget_own_t own;
+    struct aistarget_hit_t *hit;	/* of the last aistarget_select() */
+    struct aistarget_hit_t *spare;	/* for sorting them */
+    uint32_t hits;
+    int32_t mmsi[AISTARGET_HASH];
+    int32_t grid[AISTARGET_GRID];
+};
+
+struct gps_device_t;
+
+extern /*@null@*/struct aistarget_table_t *aistarget_new(void);
+extern void aistarget_free(/*@null@*/struct aistarget_table_t *);
+extern bool aistarget_update(struct aistarget_table_t *,
+			     const struct ais_t *, uint32_t);
+extern void aistarget_own(struct aistarget_table_t *, double, double,
+			  double, double, uint32_t);
+extern void aistarget_expire(struct aistarget_table_t *, uint32_t);
+extern /*@null@*/struct aistarget_t *aistarget_find(struct aistarget_table_t *,
+						    uint32_t);
+extern void aistarget_cpa(struct aistarget_table_t *, struct aistarget_t *);
+extern double aistarget_tcpa(const struct aistarget_t *, uint32_t);
+extern uint32_t aistarget_select(struct aistarget_table_t *,
+				 const struct aistarget_query_t *, uint32_t);
+extern int aistarget_query_parse(const char *, struct aistarget_query_t *,
+				 /*@null@*/const char **);
+extern void aistarget_json_dump(struct aistarget_table_t *,
+				const struct aistarget_query_t *, uint32_t,
+				/*@out@*/char *, size_t);
+extern void aistarget_report(struct gps_device_t *);
+
+#endif /* _AISTARGET_H_ */
@@ -0,0 +1,373 @@
+/* bench_ais.c -- cost of keeping and querying the AIS target table
+ *
+ * Fills the table with 1000 and with 10000 synthetic targets, most of
+ * them within 40nm of own ship in the western Baltic and a few on both
+ * sides of the date line, and times:
+ *
+ *   update	a class A position report merged into its target
+ *   radius	the targets within 10nm of own ship, nearest first
+ *   box	the targets in a quarter degree box
+ *   cpa	all targets after own ship turned, so every CPA is redone
+ *   json	the ?AIS reply for the targets within 10nm
+ *
+ * Before timing anything radius and box queries, some of them across
+ * the date line, are checked against a look at every target, and so
+ * is the table after a good part of it aged out.  -j prints the
+ * results as one JSON object per table size.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+#include "gps_json.h"
+#include "aistarget.h"
+
+ssize_t gpsd_write(struct gps_device_t *session,
+		   const char *buf,
+		   const size_t len)
+/* pass low-level data to devices straight through */
+{
+    return gpsd_serial_write(session, buf, len);
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char * buf UNUSED) {}
+void gpsd_report(const int debuglevel UNUSED, const int errlevel UNUSED,
+		 const char *fmt UNUSED, ...) {}
+void gpsd_external_report(const int debuglevel UNUSED,
+			  const int errlevel UNUSED,
+			  const char *fmt UNUSED, ...) {}
+
+#define OWN_LAT		54.33
+#define OWN_LON		10.15
+#define NEAR		18520.0		/* m, 10nm */
+#define START		1000000u	/* msec */
+
+static uint32_t seed = 1;
+
+static double uniform(void)
+/* [0, 1), the same sequence on every run */
+{
+    seed = seed * 1103515245u + 12345u;
+    return (double)(seed >> 8) / (double)(1u << 24);
+}
+
+static void position(struct ais_t *ais, uint32_t mmsi, double lat, double lon)
+{
+    (void)memset(ais, 0, sizeof(*ais));
+    ais->type = 1;
+    ais->mmsi = mmsi;
+    ais->type1.status = 0;
+    ais->type1.lat = (int)lrint(lat * AIS_LATLON_DIV);
+    ais->type1.lon = (int)lrint(lon * AIS_LATLON_DIV);
+    ais->type1.speed = (unsigned int)(uniform() * 200);
+    ais->type1.course = (unsigned int)(uniform() * 3600);
+    ais->type1.heading = ais->type1.course / 10;
+}
+
+static void random_place(double *lat, double *lon)
+/* mostly around own ship, one in twenty near the date line */
+{
+    if (uniform() < 0.05) {
+	*lat = -0.5 + uniform();
+	*lon = 179.5 + uniform();
+	if (*lon > 180.0)
+	    *lon -= 360.0;
+    } else {
+	*lat = OWN_LAT - 0.7 + 1.4 * uniform();
+	*lon = OWN_LON - 1.2 + 2.4 * uniform();
+    }
+}
+
+static void fill(struct aistarget_table_t *table, uint32_t n, uint32_t now)
+{
+    struct ais_t ais;
+    uint32_t i;
+
+    for (i = 0; i < n; i++) {
+	double lat, lon;
+
+	random_place(&lat, &lon);
+	position(&ais, 211000000 + i, lat, lon);
+	(void)aistarget_update(table, &ais, now);
+	(void)memset(&ais, 0, sizeof(ais));
+	ais.type = 5;
+	ais.mmsi = 211000000 + i;
+	(void)snprintf(ais.type5.shipname, sizeof(ais.type5.shipname),
+		       "VESSEL %u", (unsigned)i);
+	(void)snprintf(ais.type5.callsign, sizeof(ais.type5.callsign),
+		       "DA%04u", (unsigned)(i % 10000));
+	ais.type5.shiptype = 30 + i % 60;
+	ais.type5.to_bow = 10 + i % 90;
+	ais.type5.to_stern = 5;
+	ais.type5.to_port = 3;
+	ais.type5.to_starboard = 3;
+	(void)aistarget_update(table, &ais, now);
+    }
+}
+
+static double brute_distance(double lat1, double lon1, double lat2,
+			     double lon2)
+/* what the table measures */
+{
+    double dlon = lon2 - lon1;
+
+    if (dlon > 180.0)
+	dlon -= 360.0;
+    else if (dlon < -180.0)
+	dlon += 360.0;
+    return hypot(dlon * cos((lat1 + lat2) / 2 * DEG_2_RAD), lat2 - lat1)
+	* 111120.0;
+}
+
+static bool brute_match(const struct aistarget_query_t *query,
+			const struct aistarget_t *t)
+{
+    if (!isfinite(t->lat))
+	return false;
+    if (query->kind == aistarget_radius)
+	return brute_distance(query->lat, query->lon, t->lat, t->lon)
+	    <= query->radius;
+    if (t->lat < query->south || t->lat > query->north)
+	return false;
+    if (query->west > query->east)
+	return t->lon >= query->west || t->lon <= query->east;
+    return t->lon >= query->west && t->lon <= query->east;
+}
+
+static bool check_query(struct aistarget_table_t *table,
+			const struct aistarget_query_t *query, uint32_t now)
+/* the grid finds what looking at every target finds */
+{
+    unsigned char *found;
+    uint32_t i, hits, expected = 0;
+    bool ok = true;
+
+    hits = aistarget_select(table, query, now);
+    found = calloc(table->count + 1, 1);
+    if (found == NULL)
+	return false;
+    for (i = 0; i < hits; i++) {
+	int32_t idx = table->hit[i].index;
+
+	if (found[idx] || !brute_match(query, &table->target[idx]))
+	    ok = false;
+	found[idx] = 1;
+	if (i > 0 && table->hit[i].key < table->hit[i - 1].key)
+	    ok = false;
+    }
+    for (i = 0; i < table->count; i++)
+	if (brute_match(query, &table->target[i])) {
+	    expected++;
+	    if (!found[i])
+		ok = false;
+	}
+    free(found);
+    if (expected != hits)
+	ok = false;
+    if (!ok)
+	(void)fprintf(stderr,
+		      "bench_ais: query %d found %u targets, expected %u\n",
+		      (int)query->kind, (unsigned)hits, (unsigned)expected);
+    return ok;
+}
+
+static bool check_table(struct aistarget_table_t *table, uint32_t now)
+{
+    struct aistarget_query_t query;
+    uint32_t i;
+    int q;
+
+    /* every target is found by its MMSI */
+    for (i = 0; i < table->count; i++)
+	if (aistarget_find(table, table->target[i].mmsi)
+	    != &table->target[i]) {
+	    (void)fprintf(stderr, "bench_ais: MMSI %u lost\n",
+			  table->target[i].mmsi);
+	    return false;
+	}
+
+    for (q = 0; q < 200; q++) {
+	double lat, lon;
+
+	(void)memset(&query, 0, sizeof(query));
+	random_place(&lat, &lon);
+	if (q % 2 == 0) {
+	    query.kind = aistarget_radius;
+	    query.lat = lat;
+	    query.lon = lon;
+	    query.radius = 1000.0 + uniform() * 60000.0;
+	} else {
+	    double h = 0.02 + uniform() * 0.5, w = 0.02 + uniform() * 0.8;
+
+	    query.kind = aistarget_box;
+	    query.south = lat - h;
+	    query.north = lat + h;
+	    query.west = lon - w;
+	    query.east = lon + w;
+	    if (query.west < -180.0)
+		query.west += 360.0;
+	    if (query.east > 180.0)
+		query.east -= 360.0;
+	}
+	if (!check_query(table, &query, now))
+	    return false;
+    }
+    return true;
+}
+
+static double ns_since(const struct timespec *start)
+{
+    struct timespec end;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start->tv_sec) * 1e9
+	+ (end.tv_nsec - start->tv_nsec);
+}
+
+struct result_t {
+    uint32_t targets, near;
+    double update, radius, box, cpa, json;	/* ns */
+    size_t bytes;
+};
+
+static bool bench(uint32_t n, int loops, struct result_t *r)
+{
+    static char reply[GPS_JSON_RESPONSE_MAX];
+    struct aistarget_table_t *table = aistarget_new();
+    struct aistarget_query_t near, box, all;
+    struct timespec start;
+    struct ais_t ais;
+    uint32_t now = START, i;
+    int l;
+
+    if (table == NULL)
+	return false;
+    seed = 1;
+    aistarget_own(table, OWN_LAT, OWN_LON, 90.0, 3.0, now);
+    fill(table, n, now);
+    if (table->count != n || !check_table(table, now))
+	return false;
+
+    (void)memset(&near, 0, sizeof(near));
+    near.kind = aistarget_radius;
+    near.lat = OWN_LAT;
+    near.lon = OWN_LON;
+    near.radius = NEAR;
+    (void)memset(&box, 0, sizeof(box));
+    box.kind = aistarget_box;
+    box.south = OWN_LAT - 0.125;
+    box.north = OWN_LAT + 0.125;
+    box.west = OWN_LON - 0.125;
+    box.east = OWN_LON + 0.125;
+    (void)memset(&all, 0, sizeof(all));
+    all.kind = aistarget_all;
+
+    r->targets = n;
+    r->near = aistarget_select(table, &near, now);
+
+    /* a report per target, each moving it a little */
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops; l++)
+	for (i = 0; i < n; i++) {
+	    const struct aistarget_t *t = &table->target[i];
+
+	    position(&ais, t->mmsi, t->lat + 0.0001, t->lon);
+	    (void)aistarget_update(table, &ais, ++now);
+	}
+    r->update = ns_since(&start) / ((double)loops * n);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops * 100; l++)
+	(void)aistarget_select(table, &near, now);
+    r->radius = ns_since(&start) / (loops * 100);
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops * 100; l++)
+	(void)aistarget_select(table, &box, now);
+    r->box = ns_since(&start) / (loops * 100);
+
+    /* own ship turning every time, nothing it worked out holds */
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops; l++) {
+	aistarget_own(table, OWN_LAT, OWN_LON, (l % 2) ? 90.0 : 100.0, 3.0,
+		      now);
+	(void)aistarget_select(table, &all, now);
+    }
+    r->cpa = ns_since(&start) / loops;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops * 10; l++)
+	aistarget_json_dump(table, &near, now, reply, sizeof(reply));
+    r->json = ns_since(&start) / (loops * 10);
+    r->bytes = strlen(reply);
+
+    /* half of them silent long enough to age out */
+    for (i = 0; i < n; i += 2) {
+	position(&ais, 211000000 + i, OWN_LAT, OWN_LON + 0.01);
+	(void)aistarget_update(table, &ais, now + AISTARGET_AGE);
+    }
+    aistarget_expire(table, now + AISTARGET_AGE + 1);
+    if (table->count != (n + 1) / 2 || !check_table(table, now)) {
+	(void)fputs("bench_ais: ageing broke the table\n", stderr);
+	return false;
+    }
+
+    aistarget_free(table);
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    static const uint32_t sizes[] = {1000, 10000};
+    struct result_t r;
+    int option, loops = 10;
+    bool json = false;
+    unsigned int s;
+
+    while ((option = getopt(argc, argv, "jn:h")) != -1) {
+	switch (option) {
+	case 'j':
+	    json = true;
+	    break;
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_ais [-j] [-n loops]\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+
+    if (!json)
+	(void)printf("%8s %6s %10s %10s %10s %10s %10s\n", "targets", "near",
+		     "update ns", "radius us", "box us", "cpa us", "json us");
+    for (s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+	if (!bench(sizes[s], loops, &r))
+	    exit(EXIT_FAILURE);
+	if (json)
+	    (void)printf("{\"class\":\"BENCH\",\"bench\":\"ais\","
+			 "\"targets\":%u,\"near\":%u,\"loops\":%d,"
+			 "\"update_ns\":%.1f,\"radius_us\":%.2f,"
+			 "\"box_us\":%.2f,\"cpa_us\":%.2f,\"json_us\":%.2f,"
+			 "\"json_bytes\":%zu}\n",
+			 r.targets, r.near, loops, r.update, r.radius / 1e3,
+			 r.box / 1e3, r.cpa / 1e3, r.json / 1e3, r.bytes);
+	else
+	    (void)printf("%8u %6u %10.1f %10.2f %10.2f %10.2f %10.2f\n",
+			 r.targets, r.near, r.update, r.radius / 1e3,
+			 r.box / 1e3, r.cpa / 1e3, r.json / 1e3);
+    }
+    return 0;
+}
+
+/* bench_ais.c ends here */
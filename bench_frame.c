@@ -0,0 +1,335 @@
+/* bench_frame.c -- throughput of the HDLC framing of the serial port
+ *
+ * Frames a mix of what the vyacht board sends (NMEA2000 packets,
+ * NMEA0183 and AIS sentences) and a stream of binary payload with the
+ * odd byte to escape, then reports MB/s of payload for
+ *
+ *   encode	frm_toHDLC8() on every frame
+ *   decode	the whole stream back, split into read() sized chunks
+ *
+ * "bytewise" is the escaping through one call per byte and frm_put()
+ * on every character, the way it was done before frm_decode(),
+ * "bulk" calls the real functions.  Both have to produce the same
+ * frames before anything is timed.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "frame.h"
+
+#define STREAM_MAX	(1 << 20)
+#define CHUNK		4096	/* bytes per read() */
+
+static const char *sentences[] = {
+    "$GPRMC,094530.00,A,5419.7050,N,01008.7530,E,6.4,187.2,261015,1.3,E,A*0C",
+    "$IIMWV,034.0,R,07.9,N,A*1E",
+    "$SDDBT,0041.6,f,0012.7,M,0006.9,F*3C",
+    "!AIVDM,1,1,,A,13aEOK?P00PD2wVMdLDRhgvL289?,0*26",
+    "$GPGSV,3,1,11,03,03,111,00,04,15,270,00,06,01,010,00,13,06,292,00*74",
+};
+
+static void ref_addByte(uint8_t *dest, uint16_t *q, uint8_t b)
+{
+    if (b == 0x7d || b == 0x7e) {
+	dest[(*q)++] = 0x7d;
+	dest[*q] = b ^ (1 << 5);
+    } else
+	dest[*q] = b;
+    (*q)++;
+}
+
+static uint16_t ref_toHDLC8(uint8_t *dest, uint16_t destlen,
+			    uint8_t frameType, uint8_t frameVersion,
+			    const uint8_t *src, const uint16_t srclen)
+/* frm_toHDLC8() as it was, one byte at a time */
+{
+    uint16_t q, i, checksum = 0;
+
+    dest[0] = 0x7e;
+    dest[1] = frameType;
+    q = 2;
+    if (frameVersion > 0) {
+	dest[1] |= 0x80;
+	dest[2] = 0;
+	dest[3] = 0;
+	q = 4;
+    }
+    if (srclen & 0xff80) {
+	ref_addByte(dest, &q, (0xff & srclen) | 0x80);
+	ref_addByte(dest, &q, (0xff80 & srclen) >> 7);
+    } else
+	ref_addByte(dest, &q, 0xff & srclen);
+    for (i = 0; i < srclen; i++) {
+	if (destlen < q + 2)
+	    return 0;
+	ref_addByte(dest, &q, src[i]);
+    }
+    if (frameVersion > 0) {
+	if (destlen < q + 2)
+	    return 0;
+	for (i = 1; i < q; i++)
+	    if (dest[i] != 0x7d)
+		checksum ^= dest[i];
+	ref_addByte(dest, &q, checksum & 0xff);
+	ref_addByte(dest, &q, (checksum >> 8) & 0xff);
+    }
+    return q;
+}
+
+/* payloads of one workload, back to back */
+struct workload_t {
+    const char *name;
+    uint8_t payload[STREAM_MAX];
+    uint16_t len[STREAM_MAX / 8];
+    uint8_t type[STREAM_MAX / 8];
+    int frames;
+    size_t bytes;
+    uint8_t stream[STREAM_MAX * 2];
+    size_t streamlen;
+};
+
+static struct workload_t work[2];
+
+static void add_frame(struct workload_t *w, uint8_t type,
+		      const uint8_t *p, uint16_t len)
+{
+    memcpy(w->payload + w->bytes, p, len);
+    w->type[w->frames] = type;
+    w->len[w->frames++] = len;
+    w->bytes += len;
+}
+
+static void fill(void)
+{
+    struct workload_t *w;
+    uint8_t p[256];
+    int i, j;
+
+    srand(1);
+
+    /* the board: eight NMEA2000 packets to a sentence, now and then AIS */
+    w = &work[0];
+    w->name = "board";
+    for (i = 0; w->bytes + 256 < STREAM_MAX / 2; i++) {
+	if (i % 9 < 8) {
+	    uint32_t pgn = 127488 + i % 7 * 129;
+	    memcpy(p, &pgn, 4);
+	    p[4] = 2;		/* prio */
+	    p[5] = 17 + i % 3;	/* source */
+	    p[6] = 255;		/* dest */
+	    for (j = 7; j < 15; j++)
+		p[j] = (uint8_t)rand();
+	    add_frame(w, FRM_TYPE_NMEA2000, p, 15);
+	} else {
+	    const char *s = sentences[(i / 9) % 5];
+	    add_frame(w, s[0] == '!' ? FRM_TYPE_AIS : FRM_TYPE_NMEA0183,
+		      (const uint8_t *)s, (uint16_t)strlen(s));
+	}
+    }
+
+    /* binary payload of all lengths, every byte value equally likely */
+    w = &work[1];
+    w->name = "binary";
+    for (i = 0; w->bytes + 256 < STREAM_MAX / 2; i++) {
+	uint16_t len = (uint16_t)(rand() % 240 + 1);
+	for (j = 0; j < len; j++)
+	    p[j] = (uint8_t)rand();
+	add_frame(w, FRM_TYPE_CMD, p, len);
+    }
+}
+
+static void check_encode(struct workload_t *w)
+/* both encoders have to produce the same bytes */
+{
+    uint8_t want[600], got[600];
+    const uint8_t *p = w->payload;
+    int i, version;
+
+    for (i = 0; i < w->frames; p += w->len[i++]) {
+	for (version = 0; version < 2; version++) {
+	    uint16_t a = ref_toHDLC8(want, sizeof(want), w->type[i],
+				     version, p, w->len[i]);
+	    uint16_t b = frm_toHDLC8(got, sizeof(got), w->type[i],
+				     version, p, w->len[i]);
+	    if (a != b || memcmp(want, got, a) != 0) {
+		(void)fprintf(stderr,
+			      "bench_frame: %s frame %d version %d encodes "
+			      "to %u bytes, not %u\n",
+			      w->name, i, version, b, a);
+		exit(EXIT_FAILURE);
+	    }
+	}
+    }
+}
+
+static void encode_stream(struct workload_t *w)
+{
+    const uint8_t *p = w->payload;
+    int i;
+
+    w->streamlen = 0;
+    for (i = 0; i < w->frames; p += w->len[i++])
+	w->streamlen += frm_toHDLC8(w->stream + w->streamlen, 600,
+				    w->type[i], 1, p, w->len[i]);
+}
+
+/* what the decoder handed on, compared against the payload */
+struct collect_t {
+    struct workload_t *w;
+    int frames;
+    size_t bytes;
+    int bad;
+};
+
+static void collect(frmBuffer_t *frm, void *arg)
+{
+    struct collect_t *c = (struct collect_t *)arg;
+    struct workload_t *w = c->w;
+
+    if (c->frames >= w->frames
+	|| frm->len != w->len[c->frames]
+	|| frm->type != w->type[c->frames]
+	|| frm->act_checksum != frm->shall_checksum
+	|| memcmp(frm->data, w->payload + c->bytes, frm->len) != 0)
+	c->bad++;
+    if (c->frames < w->frames)
+	c->bytes += w->len[c->frames];
+    c->frames++;
+}
+
+static void check_decode(struct workload_t *w)
+/* both decoders have to find every frame, whatever the chunking */
+{
+    static frmBuffer_t frm;
+    struct collect_t bytewise = {w, 0, 0, 0}, bulk = {w, 0, 0, 0};
+    size_t i, n;
+
+    frm_init(&frm);
+    for (i = 0; i < w->streamlen; i++)
+	if (frm_put(&frm, w->stream[i]))
+	    collect(&frm, &bytewise);
+
+    frm_init(&frm);
+    for (i = 0; i < w->streamlen; i += n) {
+	n = (size_t)(rand() % 300 + 1);
+	if (n > w->streamlen - i)
+	    n = w->streamlen - i;
+	(void)frm_decode(&frm, w->stream + i, n, collect, &bulk);
+    }
+
+    if (bytewise.bad || bytewise.frames != w->frames
+	|| bulk.bad || bulk.frames != w->frames) {
+	(void)fprintf(stderr,
+		      "bench_frame: %s decodes to %d/%d frames (%d bad) "
+		      "bytewise and %d/%d (%d bad) bulk\n",
+		      w->name, bytewise.frames, w->frames, bytewise.bad,
+		      bulk.frames, w->frames, bulk.bad);
+	exit(EXIT_FAILURE);
+    }
+}
+
+static volatile size_t sink;
+
+static void count(frmBuffer_t *frm, void *arg)
+{
+    *(size_t *)arg += frm->len;
+}
+
+static double run(struct workload_t *w, int which, int loops)
+/* MB/s of payload */
+{
+    static frmBuffer_t frm;
+    static uint8_t out[600];
+    struct timespec start, end;
+    size_t i, n;
+    int l, f;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops; l++) {
+	const uint8_t *p = w->payload;
+	size_t got = 0;
+
+	switch (which) {
+	case 0:			/* encode bytewise */
+	    for (f = 0; f < w->frames; p += w->len[f++])
+		got += ref_toHDLC8(out, sizeof(out), w->type[f], 1,
+				   p, w->len[f]);
+	    break;
+	case 1:			/* encode bulk */
+	    for (f = 0; f < w->frames; p += w->len[f++])
+		got += frm_toHDLC8(out, sizeof(out), w->type[f], 1,
+				   p, w->len[f]);
+	    break;
+	case 2:			/* decode bytewise */
+	    frm_init(&frm);
+	    for (i = 0; i < w->streamlen; i++)
+		if (frm_put(&frm, w->stream[i]))
+		    got += frm.len;
+	    break;
+	default:		/* decode bulk */
+	    frm_init(&frm);
+	    for (i = 0; i < w->streamlen; i += n) {
+		n = w->streamlen - i < CHUNK ? w->streamlen - i : CHUNK;
+		(void)frm_decode(&frm, w->stream + i, n, count, &got);
+	    }
+	    break;
+	}
+	sink += got;
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    return (double)w->bytes * loops
+	/ ((end.tv_sec - start.tv_sec) * 1e6
+	   + (end.tv_nsec - start.tv_nsec) / 1e3);
+}
+
+int main(int argc, char **argv)
+{
+    int option, i, loops = 200;
+
+    while ((option = getopt(argc, argv, "n:h")) != -1) {
+	switch (option) {
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_frame [-n loops]\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+
+    fill();
+    for (i = 0; i < 2; i++) {
+	check_encode(&work[i]);
+	encode_stream(&work[i]);
+	check_decode(&work[i]);
+    }
+
+    (void)printf("%8s %8s %8s %10s %10s %10s %10s\n", "stream", "frames",
+		 "bytes", "enc-byte", "enc-bulk", "dec-byte", "dec-bulk");
+    for (i = 0; i < 2; i++) {
+	struct workload_t *w = &work[i];
+	double mbs[4];
+	int which;
+
+	for (which = 0; which < 4; which++) {
+	    (void)run(w, which, loops / 10 + 1);
+	    mbs[which] = run(w, which, loops);
+	}
+	(void)printf("%8s %8d %8lu %10.1f %10.1f %10.1f %10.1f\n", w->name,
+		     w->frames, (unsigned long)w->streamlen,
+		     mbs[0], mbs[1], mbs[2], mbs[3]);
+    }
+    (void)printf("MB/s of payload\n");
+    return 0;
+}
+
+/* bench_frame.c ends here */
@@ -0,0 +1,720 @@
+/* bench_ingest.c -- frames per second through the vyspi ingest pipeline
+ *
+ * Replays a serial byte stream of the vyacht board from memory through
+ * everything gpsd does with it: gpsd_poll() with vyspi_get() reading
+ * the stream from a socket in read() sized chunks into the lexer,
+ * vyspi_parse_serial_input() and the PGN and sentence decoders behind
+ * it, then all_reports() of the daemon itself, linked in built with
+ * GPSD_BENCH, for a JSON watcher, a pseudo-NMEA client, a SignalK
+ * subscriber and a UDP interface.  These and the device write back
+ * to sockets the bench drains after every report, what they read is
+ * what counts as rendered.
+ *
+ * The stream is a capture of the serial port given with -f, or a
+ * synthetic minute of a busy bus: attitude, heading, rudder, engine and
+ * position at 10Hz, the usual slower navigation, wind and environment
+ * PGNs, a few NMEA0183 sentences and AIS.
+ *
+ * Reported are frames/s and ns per frame for the whole stream and for
+ * every frame type in it (PGN, sentence or AIS) replayed on its own,
+ * bytes read and rendered per frame and heap allocations per frame.
+ * -j prints the same as one JSON object, to be kept and compared
+ * between releases.  -L turns on the latency histograms of gpsd -L
+ * and prints the ?STATS; response of the last run of the whole stream.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "gpsd.h"
+#include "gps_json.h"
+#include "bits.h"
+#include "frame.h"
+#include "n2kcodec.h"
+#include "latency.h"
+
+#define SECONDS		60	/* of the synthetic stream */
+#define MAX_KINDS	64
+#define PAYLOAD_MAX	223	/* of a fast packet */
+
+#define SINKS		5	/* three clients, UDP and the device */
+
+extern const struct gps_type_t driver_vyspi;
+
+/* in gpsd.c built with GPSD_BENCH */
+extern struct gps_device_t *gpsd_bench_device(const struct vessel_t *);
+extern bool gpsd_bench_client(int, const struct policy_t *);
+extern void gpsd_bench_udp(int, const struct sockaddr_in *, int);
+extern void gpsd_bench_report(struct gps_device_t *, gps_mask_t);
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+/* count what goes to the heap, glibc does the actual work */
+extern void *__libc_malloc(size_t);
+extern void *__libc_calloc(size_t, size_t);
+extern void *__libc_realloc(void *, size_t);
+
+static unsigned long allocations;
+static const bool allocations_counted = true;
+
+void *malloc(size_t size)
+{
+    allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc(size_t n, size_t size)
+{
+    allocations++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t size)
+{
+    allocations++;
+    return __libc_realloc(p, size);
+}
+#else
+static unsigned long allocations;
+static const bool allocations_counted = false;
+#endif /* __GLIBC__ */
+
+static struct gps_device_t *device;
+static const struct policy_t clients[] = {
+    {.watcher = true, .json = true, .protocol = tcp},
+    {.watcher = true, .nmea = true, .protocol = tcp},
+    {.watcher = true, .signalk = true, .protocol = tcp},
+};
+static const struct vessel_t vessel = {
+    .uuid = "c0d79334-4e25-4245-8892-54e8ccc8021d",
+    .mmsi = 211457160,
+};
+static int feedfd;
+static int sinks[SINKS];	/* far ends of what the daemon writes to */
+static int nsinks;
+
+/* the frames of the stream, by type */
+struct kind_t {
+    char name[12];
+    int frames;
+    uint8_t *stream;		/* just the frames of this kind */
+    size_t len;
+    gps_mask_t mask;		/* what they reported */
+    double ns;
+};
+
+static struct kind_t kinds[MAX_KINDS];
+static int nkinds;
+static int frames;
+
+/* what one replay did */
+struct tally_t {
+    unsigned long frames;
+    size_t rendered;
+    gps_mask_t mask;
+};
+
+/*
+ * The synthetic stream
+ */
+
+static uint8_t *synth;
+static size_t synthlen;
+
+static void add_frame(uint8_t type, const uint8_t *payload, uint16_t len)
+{
+    synthlen += frm_toHDLC8(synth + synthlen, 600, type, 1, payload, len);
+}
+
+static void add_sentence(const char *body)
+/* body is all between '$' or '!' and '*' */
+{
+    char s[NMEA_MAX];
+    unsigned char sum = 0;
+    const char *p;
+
+    for (p = body + 1; *p != '\0'; p++)
+	sum ^= (unsigned char)*p;
+    (void)snprintf(s, sizeof(s), "%s*%02X\r\n", body, sum);
+    add_frame(body[0] == '!' ? FRM_TYPE_AIS : FRM_TYPE_NMEA0183,
+	      (const uint8_t *)s, (uint16_t)strlen(s));
+}
+
+static void add_pgn(uint32_t pgn, uint8_t src, const uint8_t *data,
+		    int len)
+/* version 2 payload: PGN, prio, source, destination and the data */
+{
+    uint8_t p[7 + PAYLOAD_MAX];
+
+    putle32(p, 0, pgn);
+    p[4] = 2;
+    p[5] = src;
+    p[6] = 255;
+    memcpy(p + 7, data, (size_t)len);
+    add_frame(FRM_TYPE_NMEA2000, p, (uint16_t)(7 + len));
+}
+
+static void add_codec(struct gps_data_t *boat, uint32_t pgn, uint8_t src)
+{
+    const struct n2k_codec_t *codec = n2k_codec_find(pgn);
+    uint8_t data[PAYLOAD_MAX];
+    int len;
+
+    if (codec == NULL
+	|| (len = codec->encode(boat, 0, data, sizeof(data))) == 0) {
+	(void)fprintf(stderr, "bench_ingest: no encoder for PGN %u\n", pgn);
+	exit(EXIT_FAILURE);
+    }
+    add_pgn(pgn, src, data, len);
+}
+
+static void put64(uint8_t *d, int off, int64_t v)
+{
+    putle32(d, off, (uint32_t)((uint64_t)v & 0xffffffff));
+    putle32(d, off + 4, (uint32_t)((uint64_t)v >> 32));
+}
+
+static void add_position(double lat, double lon, uint32_t day,
+			 uint32_t tenthms, bool rapid)
+{
+    uint8_t d[43];
+
+    if (rapid) {
+	putle32(d, 0, (uint32_t)(int32_t)lrint(lat * 1e7));
+	putle32(d, 4, (uint32_t)(int32_t)lrint(lon * 1e7));
+	add_pgn(129025, 18, d, 8);
+	return;
+    }
+    memset(d, 0, sizeof(d));
+    putle16(d, 1, day);
+    putle32(d, 3, tenthms);
+    put64(d, 7, llrint(lat * 1e16));
+    put64(d, 15, llrint(lon * 1e16));
+    put64(d, 23, 12000000);	/* 12m */
+    d[31] = 0x10 | 0x0f;	/* GNSS fix, GPS+GLONASS */
+    d[33] = 9;			/* satellites */
+    putle16(d, 34, 90);		/* HDOP 0.9 */
+    putle16(d, 36, 160);	/* PDOP 1.6 */
+    putle32(d, 38, 3870);	/* geoidal separation */
+    add_pgn(129029, 18, d, 43);
+}
+
+static void synthesize(struct gps_data_t *boat)
+/* a minute of a busy bus, 100ms at a time */
+{
+    static const char *ais[] = {
+	"!AIVDM,1,1,,A,13aEOK?P00PD2wVMdLDRhgvL289?,0",
+	"!AIVDM,1,1,,B,15MgK45P3@G?fl0E`JbR0OwT0@MS,0",
+    };
+    char s[NMEA_MAX];
+    double lat = 54.328417, lon = 10.145883;
+    uint32_t day = 16734, tenthms = 35130000;
+    struct single_engine_t *e = &boat->engine.instance[single_or_double_port];
+    int tick;
+
+    synth = malloc(SECONDS * 10 * 1024);
+    if (synth == NULL) {
+	(void)fputs("bench_ingest: out of memory\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    boat->navigation.rate_of_turn = 0.0123;
+    boat->navigation.heading[compass_true] = 187.7;
+    boat->navigation.speed_thru_water = 6.1;
+    boat->navigation.depth = 12.7;
+    boat->navigation.depth_offset = 0.4;
+    boat->navigation.rudder_angle = -2.5;
+    boat->navigation.set = NAV_ROT_PSET | NAV_HDG_TRUE_PSET
+	| NAV_STW_PSET | NAV_DPT_PSET | NAV_DPT_OFF_PSET | NAV_RUDDER_ANGLE_PSET;
+    boat->environment.variation = 1.3;
+    boat->environment.deviation = -0.8;
+    boat->environment.wind[wind_true_north].angle = 238.0;
+    boat->environment.wind[wind_true_north].speed = 5.4;
+    boat->environment.temp[temp_water] = 287.3;
+    boat->environment.temp[temp_air] = 291.6;
+    boat->environment.set = ENV_VARIATION_PSET | ENV_DEVIATION_PSET
+	| ENV_WIND_TRUE_NORTH_ANGLE_PSET | ENV_WIND_TRUE_NORTH_SPEED_PSET
+	| ENV_TEMP_WATER_PSET | ENV_TEMP_AIR_PSET;
+    boat->attitude.roll = -3.4;
+    boat->attitude.pitch = 1.2;
+    boat->attitude.yaw = 187.5;
+    e->speed = 2150;
+    e->boost_pressure = 120000;
+    e->tilt = 0;
+    e->oil_pressure = 412000;
+    e->oil_temperature = 361.0;
+    e->temperature = 355.2;
+    e->alternator_voltage = 14.2;
+    e->fuel_rate = 8.6;
+    e->total_hours = 3600.0 * 1312.5;
+    e->coolant_pressure = 95000;
+    e->fuel_pressure = 350000;
+    e->load = 63;
+    e->torque = 48;
+    boat->engine.set = ENG_PORT_PSET | ENG_SPEED_PSET
+	| ENG_BOOST_PRESSURE_PSET | ENG_TILT_PSET
+	| ENG_OIL_PRESSURE_PSET | ENG_OIL_TEMPERATURE_PSET
+	| ENG_TEMPERATURE_PSET | ENG_ALTERNATOR_VOLTAGE_PSET
+	| ENG_FUEL_RATE_PSET | ENG_TOTAL_HOURS_PSET
+	| ENG_COOLANT_PRESSURE_PSET | ENG_FUEL_PRESSURE_PSET
+	| ENG_LOAD_PSET | ENG_TORQUE_PSET;
+
+    for (tick = 0; tick < SECONDS * 10; tick++) {
+	int t = tick % 10;
+
+	/* steering a little, the engine hunting */
+	boat->navigation.heading[compass_true] =
+	    187.7 + 2.0 * sin(tick / 37.0);
+	boat->attitude.roll = -3.4 + (tick % 13) * 0.1;
+	e->speed = 2150 + (tick % 7) * 5;
+	lat += 0.0000017;
+	lon -= 0.0000004;
+	tenthms += 1000;
+
+	add_codec(boat, 127250, 17);
+	add_codec(boat, 127251, 17);
+	add_codec(boat, 127257, 17);
+	add_codec(boat, 127245, 19);
+	add_codec(boat, 127488, 20);
+	add_position(lat, lon, day, tenthms, true);
+	if (t % 5 == 0) {
+	    add_codec(boat, 127489, 20);
+	    add_codec(boat, 130306, 21);
+	}
+	if (t % 5 == 0 || t % 5 == 2) {
+	    uint8_t d[8] = {0, 0xfc, 0, 0, 0, 0, 0xff, 0xff};
+	    putle16(d, 2, 32670);		/* COG 187.2 deg */
+	    putle16(d, 4, 329);		/* SOG 6.4 knots */
+	    add_pgn(129026, 18, d, 8);
+	}
+	if (t == 0) {
+	    uint8_t d[8] = {0, 0xf0, 0, 0, 0, 0, 0, 0};
+	    putle16(d, 2, day);
+	    putle32(d, 4, tenthms);
+	    add_pgn(126992, 18, d, 8);
+	    add_position(lat, lon, day, tenthms, false);
+	    add_codec(boat, 128259, 22);
+	    add_codec(boat, 128267, 22);
+	    if (tick % 20 == 0)
+		add_codec(boat, 130310, 23);
+	}
+	if (t == 3) {
+	    (void)snprintf(s, sizeof(s),
+			   "$GPRMC,%02u%02u%02u.00,A,5419.7050,N,01008.7530,E,"
+			   "6.4,187.2,261015,1.3,E,A",
+			   tenthms / 36000000, tenthms / 600000 % 60,
+			   tenthms / 10000 % 60);
+	    add_sentence(s);
+	}
+	if (t == 6)
+	    add_sentence("$IIMWV,034.0,R,07.9,N,A");
+	if (t == 8)
+	    add_sentence("$SDDBT,0041.6,f,0012.7,M,0006.9,F");
+	if (t == 1 || t == 6)
+	    add_sentence(ais[tick / 5 % 2]);
+    }
+}
+
+/*
+ * Splitting the stream into kinds of frames
+ */
+
+static void kind_name(const frmBuffer_t *frm, char *name, size_t len)
+{
+    size_t n;
+
+    switch (frm->type) {
+    case FRM_TYPE_NMEA2000:
+	if (frm->len >= 4) {
+	    (void)snprintf(name, len, "%u", getleu32(frm->data, 0));
+	    return;
+	}
+	break;
+    case FRM_TYPE_NMEA0183:
+    case FRM_TYPE_AIS:
+	/* talker and sentence, "GPRMC" or "AIVDM" */
+	for (n = 0; n + 1 < len && n + 1 < frm->len && n < 5; n++) {
+	    char c = (char)frm->data[n + 1];
+	    if (c == ',' || c == '*')
+		break;
+	    name[n] = c;
+	}
+	name[n] = '\0';
+	if (n > 0)
+	    return;
+	break;
+    case FRM_TYPE_ST:
+	(void)strlcpy(name, "seatalk", len);
+	return;
+    case FRM_TYPE_CMD:
+	(void)strlcpy(name, "command", len);
+	return;
+    }
+    (void)strlcpy(name, "other", len);
+}
+
+static void split(frmBuffer_t *frm, void *arg)
+/* file every frame with its kind, re-encoded the way it came */
+{
+    size_t cap = *(size_t *)arg;
+    struct kind_t *k;
+    char name[sizeof(kinds[0].name)];
+    int i;
+
+    kind_name(frm, name, sizeof(name));
+    for (i = 0; i < nkinds; i++)
+	if (strcmp(kinds[i].name, name) == 0)
+	    break;
+    if (i == nkinds) {
+	if (nkinds == MAX_KINDS)
+	    i = nkinds - 1;	/* lump the rest together */
+	else {
+	    k = &kinds[nkinds++];
+	    (void)strlcpy(k->name, name, sizeof(k->name));
+	    k->stream = malloc(cap);
+	    if (k->stream == NULL) {
+		(void)fputs("bench_ingest: out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	    }
+	}
+    }
+    k = &kinds[i];
+    k->len += frm_toHDLC8(k->stream + k->len, 600, frm->type,
+			  frm->new_version, frm->data, frm->len);
+    k->frames++;
+    frames++;
+}
+
+/*
+ * The pipeline
+ */
+
+static int sink(int type)
+/* a socket for the daemon to write to, its far end goes to the sinks */
+{
+    int fds[2], i;
+
+    if (type == SOCK_DGRAM) {
+	/* UDP to a socket of our own on the loopback */
+	struct sockaddr_in addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	if ((fds[0] = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+	    || (fds[1] = socket(AF_INET, SOCK_DGRAM, 0)) < 0
+	    || bind(fds[1], (struct sockaddr *)&addr, sizeof(addr)) != 0)
+	    fds[0] = -1;
+    } else if (socketpair(AF_UNIX, type, 0, fds) != 0)
+	fds[0] = -1;
+    if (fds[0] < 0) {
+	(void)fprintf(stderr, "bench_ingest: socket: %s\n", strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < 2; i++)
+	(void)fcntl(fds[i], F_SETFL, fcntl(fds[i], F_GETFL) | O_NONBLOCK);
+    sinks[nsinks++] = fds[1];
+    return fds[0];
+}
+
+static size_t drain(void)
+/* read back and throw away what the report wrote, returns the bytes */
+{
+    static char buf[65536];
+    size_t bytes = 0;
+    ssize_t n;
+    int i;
+
+    for (i = 0; i < nsinks; i++)
+	while ((n = read(sinks[i], buf, sizeof(buf))) > 0)
+	    /* the device's own writes are not rendered output */
+	    if (i != 0)
+		bytes += (size_t)n;
+    return bytes;
+}
+
+static void feed(const uint8_t *stream, size_t len, size_t chunk,
+		 struct tally_t *tally)
+/* write the stream chunk by chunk and poll until each one is eaten */
+{
+    size_t off, n;
+
+    for (off = 0; off < len; off += n) {
+	n = len - off < chunk ? len - off : chunk;
+	if (write(feedfd, stream + off, n) != (ssize_t)n) {
+	    (void)fprintf(stderr, "bench_ingest: write: %s\n",
+			  strerror(errno));
+	    exit(EXIT_FAILURE);
+	}
+	/* the lexer may take a chunk in several reads */
+	for (;;) {
+	    gps_mask_t changed = gpsd_poll(device);
+
+	    if ((changed & PACKET_SET) != 0) {
+		tally->frames += device->packet.out_count;
+		tally->mask |= changed;
+		gpsd_bench_report(device, changed);
+		tally->rendered += drain();
+	    } else if ((changed & (NODATA_IS | ERROR_SET)) != 0
+		       && packet_buffered_input(&device->packet) <= 0)
+		break;
+	}
+    }
+}
+
+static double run(const uint8_t *stream, size_t len, size_t chunk,
+		  int loops, struct tally_t *tally)
+/* nanoseconds for all loops */
+{
+    struct timespec start, end;
+    int l;
+
+    memset(tally, 0, sizeof(*tally));
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops; l++)
+	feed(stream, len, chunk, tally);
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - start.tv_sec) * 1e9
+	+ (end.tv_nsec - start.tv_nsec);
+}
+
+static void check(const uint8_t *stream, size_t len, size_t chunk,
+		  const struct gps_data_t *boat)
+/* everything has to come through, and decode, before timing */
+{
+    struct tally_t tally;
+    int i;
+
+    (void)run(stream, len, chunk, 1, &tally);
+    if (tally.frames != (unsigned long)frames) {
+	(void)fprintf(stderr,
+		      "bench_ingest: %lu of %d frames reached the decoders\n",
+		      tally.frames, frames);
+	exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < nkinds; i++) {
+	(void)run(kinds[i].stream, kinds[i].len, chunk, 1, &tally);
+	kinds[i].mask = tally.mask & ~(ONLINE_SET | PACKET_SET);
+    }
+    if (boat == NULL)
+	return;
+
+    /* the synthetic stream is known, all of it has to decode */
+    for (i = 0; i < nkinds; i++)
+	if (kinds[i].mask == 0) {
+	    (void)fprintf(stderr, "bench_ingest: %s decodes to nothing\n",
+			  kinds[i].name);
+	    exit(EXIT_FAILURE);
+	}
+    if (fabs(device->gpsdata.navigation.heading[compass_true]
+	     - boat->navigation.heading[compass_true]) > 0.01
+	|| fabs(device->gpsdata.navigation.depth
+		- boat->navigation.depth) > 0.01
+	|| device->gpsdata.engine.instance[single_or_double_port].speed
+	!= boat->engine.instance[single_or_double_port].speed) {
+	(void)fprintf(stderr,
+		      "bench_ingest: decoded heading %.2f, depth %.2f, "
+		      "rpm %.0f instead of %.2f, %.2f, %.0f\n",
+		      device->gpsdata.navigation.heading[compass_true],
+		      device->gpsdata.navigation.depth,
+		      device->gpsdata.engine.instance[single_or_double_port].speed,
+		      boat->navigation.heading[compass_true],
+		      boat->navigation.depth,
+		      boat->engine.instance[single_or_double_port].speed);
+	exit(EXIT_FAILURE);
+    }
+}
+
+static uint8_t *load(const char *path, size_t *len)
+{
+    FILE *fp = fopen(path, "rb");
+    uint8_t *buf = NULL;
+    size_t cap = 0, n;
+
+    if (fp == NULL) {
+	(void)fprintf(stderr, "bench_ingest: %s: %s\n", path,
+		      strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+    *len = 0;
+    do {
+	if (*len == cap) {
+	    cap = cap ? cap * 2 : 1 << 16;
+	    buf = realloc(buf, cap);
+	    if (buf == NULL) {
+		(void)fputs("bench_ingest: out of memory\n", stderr);
+		exit(EXIT_FAILURE);
+	    }
+	}
+	n = fread(buf + *len, 1, cap - *len, fp);
+	*len += n;
+    } while (n > 0);
+    (void)fclose(fp);
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    static struct gps_data_t boat;
+    static frmBuffer_t frm;
+    struct tally_t tally;
+    const char *path = NULL;
+    static uint8_t *stream;
+    size_t len, chunk = 256;
+    int option, i, loops = 50;
+    bool json = false, stats = false;
+    char reply[GPS_JSON_RESPONSE_MAX + 1];
+    unsigned long allocs;
+    double ns;
+
+    while ((option = getopt(argc, argv, "c:f:jLn:h")) != -1) {
+	switch (option) {
+	case 'c':
+	    chunk = (size_t)atoi(optarg);
+	    break;
+	case 'f':
+	    path = optarg;
+	    break;
+	case 'j':
+	    json = true;
+	    break;
+	case 'L':
+	    stats = true;
+	    break;
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_ingest [-c read-size] [-f capture] "
+			"[-j] [-L] [-n loops]\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+    /* a socket pair holds 4096 bytes for sure */
+    if (chunk < 1 || chunk > 4096)
+	chunk = 4096;
+
+    if (path != NULL)
+	stream = load(path, &len);
+    else {
+	synthesize(&boat);
+	stream = synth;
+	len = synthlen;
+    }
+    frm_init(&frm);
+    (void)frm_decode(&frm, stream, len, split, &len);
+    if (frames == 0) {
+	(void)fputs("bench_ingest: no frames in the stream\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    device = gpsd_bench_device(&vessel);
+    /* frames of a kind replayed alone may lack the date, no complaints */
+    device->context->debug = LOG_ERROR - 1;
+    device->device_type = &driver_vyspi;
+    device->gpsdata.gps_fd = sink(SOCK_STREAM);
+    device->gpsdata.dev.isSerial = 1;
+    /* the stream goes in where the device's writes come out */
+    feedfd = sinks[0];
+    for (i = 0; i < (int)NITEMS(clients); i++)
+	if (!gpsd_bench_client(sink(SOCK_STREAM), &clients[i])) {
+	    (void)fputs("bench_ingest: no client slot\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    {
+	struct sockaddr_in to;
+	socklen_t tolen = (socklen_t)sizeof(to);
+	int sock = sink(SOCK_DGRAM);
+
+	if (getsockname(sinks[nsinks - 1], (struct sockaddr *)&to,
+			&tolen) != 0) {
+	    (void)fprintf(stderr, "bench_ingest: getsockname: %s\n",
+			  strerror(errno));
+	    exit(EXIT_FAILURE);
+	}
+	gpsd_bench_udp(sock, &to, UDP_BATCH_MMSG);
+    }
+
+    check(stream, len, chunk, path == NULL ? &boat : NULL);
+    latency_enable(stats);
+
+    (void)run(stream, len, chunk, loops / 10 + 1, &tally);
+    allocs = allocations;
+    ns = run(stream, len, chunk, loops, &tally);
+    allocs = allocations - allocs;
+    for (i = 0; i < nkinds; i++) {
+	struct kind_t *k = &kinds[i];
+	/* about as many frames as the whole stream gets */
+	int n = (int)((long)loops * frames / k->frames / 10) + 1;
+
+	(void)run(k->stream, k->len, chunk, n / 10 + 1, &tally);
+	k->ns = run(k->stream, k->len, chunk, n, &tally) / ((double)n * k->frames);
+    }
+    latency_reset();
+    (void)run(stream, len, chunk, 1, &tally);
+    if (stats)
+	(void)latency_dump(reply, sizeof(reply));
+
+    if (json) {
+	char name[GPS_PATH_MAX * 2];
+
+	(void)json_stringify(name, sizeof(name),
+			     path != NULL ? path : "synthetic");
+	(void)printf("{\"class\":\"BENCH\",\"bench\":\"ingest\","
+		     "\"stream\":\"%s\",\"bytes\":%zu,\"frames\":%d,"
+		     "\"read_size\":%zu,\"loops\":%d,"
+		     "\"frames_per_sec\":%.0f,\"ns_per_frame\":%.1f,"
+		     "\"read_per_frame\":%.1f,\"rendered_per_frame\":%.1f,",
+		     name, len, frames, chunk,
+		     loops, 1e9 * frames * loops / ns,
+		     ns / ((double)frames * loops),
+		     (double)len / frames, (double)tally.rendered / frames);
+	if (allocations_counted)
+	    (void)printf("\"allocs_per_frame\":%.3f,",
+			 (double)allocs / ((double)frames * loops));
+	(void)printf("\"types\":[");
+	for (i = 0; i < nkinds; i++)
+	    (void)printf("%s{\"type\":\"%s\",\"frames\":%d,\"ns_per_frame\":%.1f}",
+			 i > 0 ? "," : "", kinds[i].name, kinds[i].frames,
+			 kinds[i].ns);
+	(void)printf("]}\n");
+	if (stats)
+	    (void)fputs(reply, stderr);
+	return 0;
+    }
+
+    (void)printf("%10s %8s %8s %10s %9s %9s %9s %10s\n", "stream", "frames",
+		 "bytes", "frames/s", "ns/frame", "read/frm", "rend/frm",
+		 "allocs/frm");
+    (void)printf("%10.10s %8d %8zu %10.0f %9.1f %9.1f %9.1f ",
+		 path != NULL ? path : "synthetic", frames, len,
+		 1e9 * frames * loops / ns, ns / ((double)frames * loops),
+		 (double)len / frames, (double)tally.rendered / frames);
+    if (allocations_counted)
+	(void)printf("%10.3f\n", (double)allocs / ((double)frames * loops));
+    else
+	(void)printf("%10s\n", "n/a");
+    (void)printf("\n%10s %8s %9s\n", "type", "frames", "ns/frame");
+    for (i = 0; i < nkinds; i++)
+	(void)printf("%10s %8d %9.1f\n", kinds[i].name, kinds[i].frames,
+		     kinds[i].ns);
+    (void)printf("bytes read and rendered are per frame of the stream\n");
+    if (stats)
+	(void)printf("\n%s", reply);
+    return 0;
+}
+
+/* bench_ingest.c ends here */
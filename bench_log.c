@@ -0,0 +1,167 @@
+/* bench_log.c -- what logging costs the vyspi PGN decoders
+ *
+ * Runs the handler of every PGN of a busy bus over a sample payload
+ * and reports the nanoseconds per decode twice: with the debug level
+ * at LOG_ERROR, where the log gate skips every message together with
+ * its arguments, and at LOG_IO, where the messages are formatted the
+ * way the daemon formats them before writing them out.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+#include "driver_vyspi.h"
+
+ssize_t gpsd_write(struct gps_device_t *session,
+		   const char *buf,
+		   const size_t len)
+/* pass low-level data to devices straight through */
+{
+    return gpsd_serial_write(session, buf, len);
+}
+
+static char logbuf[BUFSIZ];
+static unsigned long formatted;
+
+static void format(const int debuglevel, const int errlevel,
+		   const char *fmt, va_list ap)
+/* everything the daemon does with a message short of writing it */
+{
+    if (debuglevel < errlevel && gpsd_log_sublevel < errlevel)
+	return;
+    (void)vsnprintf(logbuf, sizeof(logbuf), fmt, ap);
+    formatted++;
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char * buf UNUSED) {}
+void gpsd_report(const int debuglevel, const int errlevel,
+		 const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    format(debuglevel, errlevel, fmt, ap);
+    va_end(ap);
+}
+void gpsd_external_report(const int debuglevel, const int errlevel,
+			  const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    format(debuglevel, errlevel, fmt, ap);
+    va_end(ap);
+}
+
+/* the PGNs of a boat with engine, instruments and AIS on the bus */
+static struct {
+    uint32_t pgn;
+    int len;		/* payload bytes */
+} bus[] = {
+    {127488,   8},	/* engine rapid */
+    {127489,  26},	/* engine dynamic */
+    {127257,   8},	/* attitude */
+    {127251,   8},	/* rate of turn */
+    {127250,   8},	/* heading */
+    {129025,   8},	/* position rapid */
+    {129026,   8},	/* COG and SOG */
+    {130306,   8},	/* wind */
+    {128259,   8},	/* speed */
+    {128267,   8},	/* depth */
+    {130312,   8},	/* temperature */
+    {129029,  43},	/* GNSS position */
+    {129540, 200},	/* satellites in view */
+    {129038,  28},	/* AIS class A position */
+    {129039,  27},	/* AIS class B position */
+    {129794,  75},	/* AIS class A static and voyage */
+};
+
+static struct gps_context_t context;
+static struct gps_device_t session;
+static unsigned char payload[NITEMS(bus)][256];
+
+static void fill_payloads(void)
+{
+    int i, k;
+
+    for (i = 0; i < NITEMS(bus); i++) {
+	for (k = 0; k < bus[i].len; k++)
+	    payload[i][k] = (unsigned char)((k * 37 + i * 11) & 0xff);
+	payload[i][0] = 0;	/* instance, SID or message id */
+    }
+}
+
+static volatile gps_mask_t sink;
+
+static double run(int i, int debug, int loops)
+/* ns per decode of one PGN */
+{
+    struct PGN *work = vyspi_find_pgn(bus[i].pgn);
+    struct timespec start, end;
+    gps_mask_t acc = 0;
+    int n;
+
+    context.debug = debug;
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < loops; n++)
+	acc |= (work->func)(payload[i], bus[i].len, work, &session);
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    sink = acc;
+    return ((end.tv_sec - start.tv_sec) * 1e9
+	    + (end.tv_nsec - start.tv_nsec)) / loops;
+}
+
+int main(int argc, char **argv)
+{
+    int option, i, loops = 200000;
+    double quiet = 0, verbose = 0;
+
+    while ((option = getopt(argc, argv, "n:h")) != -1) {
+	switch (option) {
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_log [-n decodes-per-pgn]\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+
+    gps_context_init(&context);
+    gpsd_init(&session, &context, NULL);
+    fill_payloads();
+
+    for (i = 0; i < NITEMS(bus); i++)
+	if (vyspi_find_pgn(bus[i].pgn) == NULL) {
+	    (void)fprintf(stderr, "bench_log: no handler for PGN %u\n",
+			  bus[i].pgn);
+	    exit(EXIT_FAILURE);
+	}
+
+    (void)printf("%8s %12s %12s %8s\n", "pgn", "LOG_ERROR", "LOG_IO", "msgs");
+    for (i = 0; i < NITEMS(bus); i++) {
+	double q, v;
+	unsigned long before;
+
+	(void)run(i, LOG_IO, loops / 10 + 1);
+	q = run(i, LOG_ERROR, loops);
+	before = formatted;
+	v = run(i, LOG_IO, loops);
+	(void)printf("%8u %9.1f ns %9.1f ns %8.1f\n", bus[i].pgn, q, v,
+		     (double)(formatted - before) / loops);
+	quiet += q;
+	verbose += v;
+    }
+    (void)printf("%8s %9.1f ns %9.1f ns\n", "mean",
+		 quiet / NITEMS(bus), verbose / NITEMS(bus));
+    return 0;
+}
+
+/* bench_log.c ends here */
@@ -0,0 +1,195 @@
+/* bench_nmea.c -- sentences per second through the NMEA0183 parser
+ *
+ * Reads the NMEA0183 sentences out of the logs given, normally all the
+ * .log files of test/daemon, and times nmea_parse_len() over all of
+ * them the way a multiplexer feed hits it: one session, every sentence
+ * in the order of the logs.  Comment lines and anything not
+ * starting with '$' are left out, binary logs give no sentences.
+ *
+ * Reported are sentences/s and ns per sentence, for all of them and for
+ * the sentences no decoder knows, which only go through the tokenizer
+ * and the tag lookup.  -j prints the same as one JSON object.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+
+ssize_t gpsd_write(struct gps_device_t *session,
+		   const char *buf,
+		   const size_t len)
+/* pass low-level data to devices straight through */
+{
+    return gpsd_serial_write(session, buf, len);
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char * buf UNUSED) {}
+void gpsd_report(const int debuglevel UNUSED, const int errlevel UNUSED,
+		 const char *fmt UNUSED, ...) {}
+void gpsd_external_report(const int debuglevel UNUSED,
+			  const int errlevel UNUSED,
+			  const char *fmt UNUSED, ...) {}
+
+struct corpus_t {
+    char *text;			/* the sentences, NUL terminated */
+    size_t len, cap;
+    unsigned int count, cap_sentences;
+    size_t *offset;		/* where each sentence starts */
+    size_t *length;		/* without the NUL */
+};
+
+static struct gps_context_t context;
+static struct gps_device_t device;
+
+static void *grow(void *p, size_t size)
+{
+    p = realloc(p, size);
+    if (p == NULL) {
+	(void)fputs("bench_nmea: out of memory\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static void add(struct corpus_t *c, const char *line, size_t len)
+{
+    if (c->len + len + 1 > c->cap) {
+	c->cap = (c->cap + len + 1) * 2;
+	c->text = grow(c->text, c->cap);
+    }
+    if (c->count == c->cap_sentences) {
+	c->cap_sentences = c->cap_sentences ? c->cap_sentences * 2 : 1024;
+	c->offset = grow(c->offset, c->cap_sentences * sizeof(size_t));
+	c->length = grow(c->length, c->cap_sentences * sizeof(size_t));
+    }
+    (void)memcpy(c->text + c->len, line, len);
+    c->text[c->len + len] = '\0';
+    c->offset[c->count] = c->len;
+    c->length[c->count] = len;
+    c->count++;
+    c->len += len + 1;
+}
+
+static void load(struct corpus_t *c, const char *path)
+/* the sentences of a log, with their CR LF as the lexer hands them on */
+{
+    FILE *fp = fopen(path, "rb");
+    char line[BUFSIZ];
+
+    if (fp == NULL) {
+	(void)fprintf(stderr, "bench_nmea: %s: %s\n", path, strerror(errno));
+	exit(EXIT_FAILURE);
+    }
+    while (fgets(line, (int)sizeof(line), fp) != NULL) {
+	size_t len = strlen(line);
+
+	if (line[0] != '$' || len < 6 || len > NMEA_MAX)
+	    continue;
+	add(c, line, len);
+    }
+    (void)fclose(fp);
+}
+
+static double run(const struct corpus_t *c, const bool *only, int loops)
+/* ns per sentence, over those only says (or all of them) */
+{
+    struct timespec start, end;
+    unsigned int i, n = 0;
+    int l;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (l = 0; l < loops; l++)
+	for (i = 0; i < c->count; i++) {
+	    if (only != NULL && !only[i])
+		continue;
+	    (void)nmea_parse_len(c->text + c->offset[i], c->length[i],
+				 &device);
+	    n++;
+	}
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    if (n == 0)
+	return 0.0;
+    return ((end.tv_sec - start.tv_sec) * 1e9
+	    + (end.tv_nsec - start.tv_nsec)) / n;
+}
+
+int main(int argc, char **argv)
+{
+    static struct corpus_t corpus;
+    bool *unknown;
+    unsigned int i, nunknown = 0;
+    int option, loops = 20;
+    bool json = false;
+    double all, idle;
+
+    while ((option = getopt(argc, argv, "jn:h")) != -1) {
+	switch (option) {
+	case 'j':
+	    json = true;
+	    break;
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_nmea [-j] [-n loops] log...\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+    if (optind == argc) {
+	(void)fputs("usage: bench_nmea [-j] [-n loops] log...\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+    for (; optind < argc; optind++)
+	load(&corpus, argv[optind]);
+    if (corpus.count == 0) {
+	(void)fputs("bench_nmea: no sentences in the logs\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+
+    gps_context_init(&context);
+    gpsd_init(&device, &context, NULL);
+
+    /* a sentence no decoder takes leaves the tag empty */
+    unknown = grow(NULL, corpus.count * sizeof(bool));
+    for (i = 0; i < corpus.count; i++) {
+	device.gpsdata.tag[0] = '\0';
+	(void)nmea_parse_len(corpus.text + corpus.offset[i],
+			     corpus.length[i], &device);
+	unknown[i] = device.gpsdata.tag[0] == '\0';
+	if (unknown[i])
+	    nunknown++;
+    }
+
+    (void)run(&corpus, NULL, loops / 10 + 1);
+    all = run(&corpus, NULL, loops);
+    idle = run(&corpus, unknown, loops);
+
+    if (json) {
+	(void)printf("{\"class\":\"BENCH\",\"bench\":\"nmea\","
+		     "\"sentences\":%u,\"unknown\":%u,\"bytes\":%zu,"
+		     "\"loops\":%d,\"sentences_per_sec\":%.0f,"
+		     "\"ns_per_sentence\":%.1f,\"ns_per_unknown\":%.1f}\n",
+		     corpus.count, nunknown, corpus.len - corpus.count,
+		     loops, 1e9 / all, all, idle);
+    } else {
+	(void)printf("%u sentences, %u of them unknown, %zu bytes\n",
+		     corpus.count, nunknown, corpus.len - corpus.count);
+	(void)printf("%10s %12s %12s\n", "", "sentences/s", "ns/sentence");
+	(void)printf("%10s %12.0f %12.1f\n", "all", 1e9 / all, all);
+	if (nunknown > 0)
+	    (void)printf("%10s %12.0f %12.1f\n", "unknown", 1e9 / idle, idle);
+    }
+    return 0;
+}
+
+/* bench_nmea.c ends here */
@@ -0,0 +1,221 @@
+/* bench_pgn.c -- per frame cost of the NMEA2000 PGN lookups
+ *
+ * Replays one second of a busy bus (engine and attitude at 10Hz, the
+ * usual navigation PGNs, GNSS satellites and AIS bursts) many times
+ * and reports the nanoseconds per CAN frame spent deciding fast-packet
+ * handling and finding the handler of every completed packet.
+ *
+ * "linear" walks the tables front to back the way vyspi_find_pgn()
+ * and nmea2000_isfast() used to, "indexed" calls the real functions.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+#include "driver_vyspi.h"
+#include "nmea2000.h"
+
+extern uint32_t n2k_fixed_fast_list[];
+extern uint32_t n2k_dynamic_fast_list[];
+
+ssize_t gpsd_write(struct gps_device_t *session,
+		   const char *buf,
+		   const size_t len)
+/* pass low-level data to devices straight through */
+{
+    return gpsd_serial_write(session, buf, len);
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char * buf UNUSED) {}
+void gpsd_report(const int debuglevel UNUSED, const int errlevel UNUSED,
+		 const char *fmt UNUSED, ...) {}
+void gpsd_external_report(const int debuglevel UNUSED,
+			  const int errlevel UNUSED,
+			  const char *fmt UNUSED, ...) {}
+
+/* one second worth of traffic */
+static struct {
+    uint32_t pgn;
+    int rate;		/* packets per second */
+    int len;		/* payload bytes */
+} bus[] = {
+    {127488, 20,   8},	/* engine rapid, two engines */
+    {127489, 10,  26},	/* engine dynamic */
+    {127257, 10,   8},	/* attitude */
+    {127251, 10,   8},	/* rate of turn */
+    {127250, 10,   8},	/* heading */
+    {129025, 10,   8},	/* position rapid */
+    {129026,  4,   8},	/* COG and SOG */
+    {130306, 10,   8},	/* wind */
+    {128259,  1,   8},	/* speed */
+    {128267,  1,   8},	/* depth */
+    {129029,  1,  43},	/* GNSS position */
+    {129540,  1, 200},	/* satellites in view */
+    {129038, 30,  28},	/* AIS burst: class A position */
+    {129039, 15,  27},	/* class B position */
+    {129794,  3,  75},	/* class A static and voyage */
+    {129809,  2,  27},	/* class B static A */
+    {129810,  2,  34},	/* class B static B */
+    { 65280,  5,   8},	/* proprietary, not handled */
+    {130316,  2,   8},	/* extended temperature, not handled */
+};
+
+struct frame_t {
+    uint32_t pgn;
+    bool last;		/* completes a packet */
+};
+
+static struct frame_t *frames;
+static int nframes;
+
+static void build_bus(void)
+/* interleave the packets of one second frame by frame */
+{
+    int i, k, slots = 0, n = 0;
+
+    for (i = 0; i < NITEMS(bus); i++) {
+	int per = bus[i].len <= 8 ? 1 : 1 + (bus[i].len - 6 + 6) / 7;
+	slots += bus[i].rate * per;
+    }
+    if ((frames = calloc((size_t)slots, sizeof(*frames))) == NULL) {
+	(void)fputs("bench_pgn: out of memory\n", stderr);
+	exit(EXIT_FAILURE);
+    }
+    /* round robin over the sources, sending a whole packet per turn */
+    for (k = 0; n < slots; k++)
+	for (i = 0; i < NITEMS(bus); i++) {
+	    int per = bus[i].len <= 8 ? 1 : 1 + (bus[i].len - 6 + 6) / 7;
+	    int f;
+	    if (k >= bus[i].rate)
+		continue;
+	    for (f = 0; f < per; f++) {
+		frames[n].pgn = bus[i].pgn;
+		frames[n].last = (f == per - 1);
+		n++;
+	    }
+	}
+    nframes = n;
+}
+
+/* the table vyspi_find_pgn() indexes, recovered in its original order */
+static struct PGN *table[256];
+static int ntable;
+
+static int by_address(const void *a, const void *b)
+{
+    const struct PGN *pa = *(struct PGN * const *)a;
+    const struct PGN *pb = *(struct PGN * const *)b;
+    return (pa > pb) - (pa < pb);
+}
+
+static void recover_table(void)
+{
+    uint32_t pgn;
+
+    for (pgn = 1; pgn <= 0x3ffff && ntable < NITEMS(table); pgn++) {
+	struct PGN *work = vyspi_find_pgn(pgn);
+	if (work != NULL)
+	    table[ntable++] = work;
+    }
+    qsort(table, (size_t)ntable, sizeof(table[0]), by_address);
+}
+
+static struct PGN *linear_find_pgn(uint32_t pgn)
+{
+    int l1;
+
+    for (l1 = 0; l1 < ntable; l1++)
+	if (table[l1]->pgn == pgn)
+	    return table[l1];
+    return NULL;
+}
+
+static int linear_isfast(uint32_t pgn)
+{
+    uint16_t cnt;
+
+    for (cnt = 0; n2k_fixed_fast_list[cnt] > 0; cnt++)
+	if (pgn == n2k_fixed_fast_list[cnt])
+	    return 1;
+    for (cnt = 0; n2k_dynamic_fast_list[cnt] > 0; cnt++)
+	if (pgn == n2k_dynamic_fast_list[cnt])
+	    return 1;
+    return 0;
+}
+
+static volatile uintptr_t sink;
+
+static double run(bool indexed, int seconds)
+/* ns per frame over the replayed bus */
+{
+    struct timespec start, end;
+    uintptr_t acc = 0;
+    int s, n;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (s = 0; s < seconds; s++)
+	for (n = 0; n < nframes; n++) {
+	    uint32_t pgn = frames[n].pgn;
+	    int fast = indexed ? nmea2000_isfast(pgn) : linear_isfast(pgn);
+	    if (!fast || frames[n].last) {
+		struct PGN *work = indexed ? vyspi_find_pgn(pgn)
+		    : linear_find_pgn(pgn);
+		acc += (uintptr_t)work;
+	    }
+	    acc += (uintptr_t)fast;
+	}
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    sink = acc;
+    return ((end.tv_sec - start.tv_sec) * 1e9
+	    + (end.tv_nsec - start.tv_nsec)) / ((double)seconds * nframes);
+}
+
+int main(int argc, char **argv)
+{
+    int option, n, seconds = 20000;
+
+    while ((option = getopt(argc, argv, "n:h")) != -1) {
+	switch (option) {
+	case 'n':
+	    seconds = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_pgn [-n seconds-of-traffic]\n", stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (seconds < 1)
+	seconds = 1;
+
+    nmea2000_init();
+    build_bus();
+    recover_table();
+
+    /* both paths have to agree before their speed means anything */
+    for (n = 0; n < nframes; n++)
+	if (nmea2000_isfast(frames[n].pgn) != linear_isfast(frames[n].pgn)
+	    || vyspi_find_pgn(frames[n].pgn) != linear_find_pgn(frames[n].pgn)) {
+	    (void)fprintf(stderr, "bench_pgn: lookups disagree on PGN %u\n",
+			  frames[n].pgn);
+	    exit(EXIT_FAILURE);
+	}
+
+    /* warm up both paths before timing */
+    (void)run(false, 10);
+    (void)run(true, 10);
+
+    (void)printf("%d frames per bus second, %d PGNs in table\n",
+		 nframes, ntable);
+    (void)printf("linear:  %7.2f ns/frame\n", run(false, seconds));
+    (void)printf("indexed: %7.2f ns/frame\n", run(true, seconds));
+    return 0;
+}
+
+/* bench_pgn.c ends here */
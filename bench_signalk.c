@@ -0,0 +1,424 @@
+/* bench_signalk.c -- cost of rendering the SignalK reports
+ *
+ * Fills a device the way a boat with a GPS, instruments, wind and
+ * an engine on the bus does and times the three SignalK dumpers:
+ *
+ *   full	the GET reply, rendered into the buffer gpsd uses for it
+ *   update	the delta sent to every websocket watcher per report
+ *   update-ref	the same delta written the way it was before its text
+ *		was pre-rendered, to see what that saves
+ *   track	4096 raw speed over ground samples from the history
+ *   day	a day of depth at 1Hz downsampled to 5 minute buckets
+ *
+ * Before timing anything the number formatting of the writer is
+ * checked against printf and the update against the reference, the
+ * reports have to come out unchanged.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gpsd.h"
+#include "gps_json.h"
+#include "signalk.h"
+#include "jsonout.h"
+#include "history.h"
+
+ssize_t gpsd_write(struct gps_device_t *session,
+		   const char *buf,
+		   const size_t len)
+/* pass low-level data to devices straight through */
+{
+    return gpsd_serial_write(session, buf, len);
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char * buf UNUSED) {}
+void gpsd_report(const int debuglevel UNUSED, const int errlevel UNUSED,
+		 const char *fmt UNUSED, ...) {}
+void gpsd_external_report(const int debuglevel UNUSED,
+			  const int errlevel UNUSED,
+			  const char *fmt UNUSED, ...) {}
+
+static struct gps_context_t context;
+static struct gps_device_t device;
+static struct vessel_t vessel = {
+    .uuid = "c0d79334-4e25-4245-8892-54e8ccc8021d",
+    .mmsi = 211457160,
+};
+
+static void fill_device(int samples)
+{
+    struct single_engine_t *e;
+    uint32_t msec;
+    int i;
+
+    gps_context_init(&context);
+    gpsd_init(&device, &context, NULL);
+
+    device.gpsdata.fix.mode = MODE_3D;
+    device.gpsdata.fix.time = 1445849073.0;
+    device.gpsdata.fix.latitude = 54.328417;
+    device.gpsdata.fix.longitude = 10.145883;
+    device.gpsdata.attitude.roll = -3.4;
+    device.gpsdata.attitude.pitch = 1.2;
+    device.gpsdata.attitude.yaw = 187.5;
+
+    device.gpsdata.navigation.rate_of_turn = 0.0123;
+    device.gpsdata.navigation.course_over_ground[compass_true] = 187.2;
+    device.gpsdata.navigation.course_over_ground[compass_magnetic] = 185.9;
+    device.gpsdata.navigation.heading[compass_true] = 189.0;
+    device.gpsdata.navigation.heading[compass_magnetic] = 187.7;
+    device.gpsdata.navigation.speed_over_ground = 6.4;
+    device.gpsdata.navigation.speed_thru_water = 6.1;
+    device.gpsdata.navigation.distance_total = 18342.7;
+    device.gpsdata.navigation.distance_trip = 23.45;
+    device.gpsdata.navigation.depth = 12.7;
+    device.gpsdata.navigation.depth_offset = 0.4;
+    device.gpsdata.navigation.set = NAV_ROT_PSET | NAV_COG_TRUE_PSET
+	| NAV_COG_MAGN_PSET | NAV_HDG_TRUE_PSET | NAV_HDG_MAGN_PSET
+	| NAV_SOG_PSET | NAV_STW_PSET | NAV_DIST_TOT_PSET
+	| NAV_DIST_TRIP_PSET | NAV_DPT_PSET;
+
+    device.gpsdata.environment.variation = 1.3;
+    device.gpsdata.environment.wind[wind_apparent].angle = 34.0;
+    device.gpsdata.environment.wind[wind_apparent].speed = 7.9;
+    device.gpsdata.environment.wind[wind_true_to_boat].angle = 51.0;
+    device.gpsdata.environment.wind[wind_true_to_boat].speed = 5.2;
+    device.gpsdata.environment.wind[wind_true_north].angle = 238.0;
+    device.gpsdata.environment.wind[wind_true_north].speed = 5.4;
+    device.gpsdata.environment.wind[wind_magnetic_north].angle = 236.7;
+    device.gpsdata.environment.temp[temp_water] = 287.3;
+    device.gpsdata.environment.set = ENV_VARIATION_PSET
+	| ENV_WIND_APPARENT_ANGLE_PSET | ENV_WIND_APPARENT_SPEED_PSET
+	| ENV_WIND_TRUE_TO_BOAT_ANGLE_PSET | ENV_WIND_TRUE_TO_BOAT_SPEED_PSET
+	| ENV_WIND_TRUE_NORTH_ANGLE_PSET | ENV_WIND_TRUE_NORTH_SPEED_PSET
+	| ENV_WIND_MAGN_ANGLE_PSET | ENV_TEMP_WATER_PSET;
+
+    e = &device.gpsdata.engine.instance[single_or_double_port];
+    e->speed = 2150;
+    e->load = 63;
+    e->temperature = 355.2;
+    e->oil_pressure = 412000;
+    e->alternator_voltage = 14.2;
+    e->total_hours = 3600.0 * 1312.5;
+    device.gpsdata.engine.set = ENG_SPEED_PSET | ENG_LOAD_PSET
+	| ENG_TEMPERATURE_PSET | ENG_OIL_PRESSURE_PSET
+	| ENG_ALTERNATOR_VOLTAGE_PSET | ENG_TOTAL_HOURS_PSET;
+
+    device.gpsdata.set = LATLON_SET | ATTITUDE_SET | NAVIGATION_SET
+	| ENVIRONMENT_SET | ENGINE_SET;
+
+    /* one sample a second, sog wandering around 6 knots */
+    for (i = 0, msec = 1000; i < samples; i++, msec += 1000) {
+	double sog = 6.0 + 1.5 * sin(i / 40.0) + (i % 7) * 0.013;
+	history_record(&device, hist_speed_over_ground, msec, &sog);
+    }
+    /* a day of depth over a tidal range, with a little jitter in time */
+    for (i = 0, msec = 1000; i < 86400; i++, msec += 1000 + (i % 3) * 7) {
+	double depth = 8.0 + 2.5 * sin(i / 7000.0) + (i % 11) * 0.02;
+	history_record(&device, hist_depth, msec, &depth);
+    }
+}
+
+static void check_numbers(void)
+/* the writer has to format exactly like the printf it replaces */
+{
+    static const int decimals[] = {2, 4, 6};
+    char want[64], got[64];
+    struct jsonout_t out;
+    unsigned int n, d;
+
+    srand(1);
+    for (n = 0; n < 200000; n++) {
+	double v;
+	switch (n % 4) {
+	case 0:		/* instrument readings */
+	    v = (rand() / (double)RAND_MAX - 0.5) * 400.0;
+	    break;
+	case 1:		/* positions */
+	    v = (rand() / (double)RAND_MAX - 0.5) * 360.0;
+	    break;
+	case 2:		/* close to rounding ties */
+	    v = (rand() % 200000 - 100000) / 1000.0 + 0.005;
+	    break;
+	default:	/* large and tiny magnitudes */
+	    v = ldexp(rand() / (double)RAND_MAX, rand() % 80 - 40);
+	    break;
+	}
+	for (d = 0; d < NITEMS(decimals); d++) {
+	    (void)snprintf(want, sizeof(want), "%.*f", decimals[d], v);
+	    jsonout_init(&out, got, sizeof(got));
+	    jsonout_fixed(&out, v, decimals[d]);
+	    if (strcmp(want, got) != 0) {
+		(void)fprintf(stderr,
+			      "bench_signalk: %.17g as %%.%df gives %s, not %s\n",
+			      v, decimals[d], got, want);
+		exit(EXIT_FAILURE);
+	    }
+	}
+    }
+}
+
+/*
+ * The update dump as it was before its text was pre-rendered: every
+ * path written out piece by piece, the timestamp through strftime.  The
+ * paths are those of signalk.c, in the same order.
+ */
+extern char *unix_to_signalk(timestamp_t, char[], size_t);
+
+#define NAV(field)	offsetof(struct gps_data_t, navigation.field)
+#define ENV(field)	offsetof(struct gps_data_t, environment.field)
+#define ENG(field)	offsetof(struct gps_data_t, \
+				 engine.instance[single_or_double_port].field)
+#define POSITION	((size_t)-1)
+#define ATTITUDE	((size_t)-2)
+
+static const struct {
+    const char *path;
+    size_t offset;
+    double factor;
+} ref_paths[SIGNALK_PATHS] = {
+    {"navigation.rateOfTurn", NAV(rate_of_turn), 1.0},
+    {"navigation.courseOverGroundMagnetic",
+     NAV(course_over_ground[compass_magnetic]), DEG_2_RAD},
+    {"navigation.courseOverGroundTrue",
+     NAV(course_over_ground[compass_true]), DEG_2_RAD},
+    {"navigation.magneticVariation", ENV(variation), DEG_2_RAD},
+    {"navigation.headingMagnetic", NAV(heading[compass_magnetic]), DEG_2_RAD},
+    {"navigation.headingTrue", NAV(heading[compass_true]), DEG_2_RAD},
+    {"navigation.speedOverGround", NAV(speed_over_ground), KNOTS_TO_MPS},
+    {"navigation.speedThroughWater", NAV(speed_thru_water), KNOTS_TO_MPS},
+    {"navigation.log", NAV(distance_total), 1.0},
+    {"navigation.logTrip", NAV(distance_trip), 1.0},
+    {"environment.depth.belowTransducer", NAV(depth), 1.0},
+    {"environment.depth.surfaceToTransducer", NAV(depth_offset), 1.0},
+    {"environment.wind.angleApparent",
+     ENV(wind[wind_apparent].angle), DEG_2_RAD},
+    {"environment.wind.speedApparent", ENV(wind[wind_apparent].speed), 1.0},
+    {"environment.wind.speedTrue", ENV(wind[wind_true_to_boat].speed), 1.0},
+    {"environment.wind.angleTrueWater",
+     ENV(wind[wind_true_to_boat].angle), DEG_2_RAD},
+    {"environment.wind.speedOverGround",
+     ENV(wind[wind_true_north].speed), 1.0},
+    {"environment.wind.directionTrue",
+     ENV(wind[wind_true_north].angle), DEG_2_RAD},
+    {"environment.wind.directionMagnetic",
+     ENV(wind[wind_magnetic_north].angle), DEG_2_RAD},
+    {"environment.waterTemp", ENV(temp[temp_water]), 1.0},
+    {"navigation.position", POSITION, 1.0},
+    {"navigation.attitude", ATTITUDE, 1.0},
+    {"propulsion.port_engine.engineLoad", ENG(load), 1.0},
+    {"propulsion.port_engine.revolutions", ENG(speed), 60.0},
+    {"propulsion.port_engine.temperatur", ENG(temperature), 1.0},
+    {"propulsion.port_engine.oilTemperatur", ENG(oil_temperature), 1.0},
+    {"propulsion.port_engine.oilPressure", ENG(oil_pressure), 1.0},
+    {"propulsion.port_engine.alternatorVoltage",
+     ENG(alternator_voltage), 1.0},
+    {"propulsion.port_engine.runTime", ENG(total_hours), 1.0},
+    {"propulsion.port_engine.coolantTemperature",
+     ENG(coolant_temperature), 1.0},
+    {"propulsion.port_engine.coolantPressure", ENG(coolant_pressure), 1.0},
+    {"propulsion.port_engine.engineTorque", ENG(torque), 1.0},
+    {"propulsion.port_engine.fuel.rate", ENG(fuel_rate), 1.0},
+    {"propulsion.port_engine.fuel.pressure", ENG(fuel_pressure), 1.0},
+    {"propulsion.port_engine.drive.trimState", ENG(tilt), 1.0},
+};
+
+static void ref_update_dump(const struct gps_device_t *dev,
+			    const struct vessel_t *v, char reply[],
+			    size_t replylen)
+{
+    uint64_t paths = signalk_changed_paths(dev);
+    struct jsonout_t out;
+    char isotime[64];
+    timestamp_t when;
+    int i, pt = 0;
+
+    if ((dev->gpsdata.navigation.set & LATLON_SET) != 0
+	&& dev->gpsdata.fix.mode > MODE_NO_FIX)
+	when = dev->gpsdata.fix.time;
+    else
+	when = timestamp();
+
+    jsonout_init(&out, reply, replylen);
+    jsonout_lit(&out, "{\"updates\":[{\"timestamp\":\"");
+    jsonout_str(&out, unix_to_signalk(when, isotime, sizeof(isotime)));
+    jsonout_lit(&out, "\",\"values\":[");
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+	if ((paths & SIGNALK_PATH(i)) == 0)
+	    continue;
+	if (pt++ > 0)
+	    jsonout_char(&out, ',');
+	jsonout_lit(&out, "{\"path\":\"");
+	jsonout_str(&out, ref_paths[i].path);
+	if (ref_paths[i].offset == POSITION) {
+	    jsonout_lit(&out, "\",\"value\":{\"longitude\":");
+	    jsonout_fixed(&out, dev->gpsdata.fix.longitude, 6);
+	    jsonout_lit(&out, ",\"latitude\":");
+	    jsonout_fixed(&out, dev->gpsdata.fix.latitude, 6);
+	    jsonout_lit(&out, "}}");
+	} else if (ref_paths[i].offset == ATTITUDE) {
+	    jsonout_lit(&out, "\",\"value\":{\"roll\":");
+	    jsonout_fixed(&out, dev->gpsdata.attitude.roll, 6);
+	    jsonout_lit(&out, "}}");
+	} else {
+	    double value = *(const double *)((const char *)&dev->gpsdata
+					     + ref_paths[i].offset);
+	    jsonout_lit(&out, "\",\"value\":");
+	    jsonout_fixed(&out, value * ref_paths[i].factor, 2);
+	    jsonout_char(&out, '}');
+	}
+    }
+    jsonout_lit(&out, "]}],");
+    if (v->mmsi != 0) {
+	jsonout_lit(&out, "\"context\":\"vessels.urn:mrn:imo:mmsi:");
+	jsonout_uint(&out, v->mmsi, 0);
+	jsonout_lit(&out, "9\"");
+    } else {
+	jsonout_lit(&out, "\"context\":\"vessels.urn:mrn:signalk:uuid:");
+	jsonout_str(&out, v->uuid);
+	jsonout_char(&out, '"');
+    }
+    jsonout_char(&out, '}');
+}
+
+static void check_update(char *buf, size_t len)
+/* the pre-rendered update has to be what the reference writes */
+{
+    static char want[SIGNALK_UPDATE_MAX];
+    static const struct vessel_t nommsi = {
+	.uuid = "c0d79334-4e25-4245-8892-54e8ccc8021d",
+    };
+    const struct vessel_t *vessels[] = {&vessel, &nommsi, &vessel};
+    unsigned int n;
+
+    srand(2);
+    for (n = 0; n < 3000; n++) {
+	const struct vessel_t *v = vessels[n % NITEMS(vessels)];
+	gps_mask_t set = device.gpsdata.set;
+
+	/* vary values, seconds and the paths that changed */
+	device.gpsdata.fix.time = 1445849073.0 + n / 7 + (n % 10) / 10.0;
+	device.gpsdata.fix.mode = (n % 5 == 0) ? MODE_NO_FIX : MODE_3D;
+	device.gpsdata.navigation.speed_over_ground = 6.4 + (rand() % 1000) / 97.0;
+	device.gpsdata.environment.wind[wind_apparent].angle = rand() % 3600 / 10.0;
+	device.gpsdata.set = LATLON_SET
+	    | ((n & 1) ? ATTITUDE_SET : 0) | ((n & 2) ? NAVIGATION_SET : 0)
+	    | ((n & 4) ? ENVIRONMENT_SET : 0) | ((n & 8) ? ENGINE_SET : 0);
+	ref_update_dump(&device, v, want, sizeof(want));
+	(void)signalk_update_dump(&device, v, buf, len);
+	if (strcmp(want, buf) != 0) {
+	    /* unless the clock went to the next second in between */
+	    ref_update_dump(&device, v, want, sizeof(want));
+	    (void)signalk_update_dump(&device, v, buf, len);
+	}
+	device.gpsdata.set = set;
+	if (strcmp(want, buf) != 0) {
+	    (void)fprintf(stderr, "bench_signalk: update dump is\n%s\nnot\n%s\n",
+			  buf, want);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    device.gpsdata.fix.time = 1445849073.0;
+    device.gpsdata.fix.mode = MODE_3D;
+    device.gpsdata.navigation.speed_over_ground = 6.4;
+    device.gpsdata.environment.wind[wind_apparent].angle = 34.0;
+}
+
+static volatile size_t sink;
+
+static double run(int which, char *buf, size_t len, int loops, size_t *bytes)
+/* microseconds per dump */
+{
+    struct timespec start, end;
+    int n;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &start);
+    for (n = 0; n < loops; n++) {
+	switch (which) {
+	case 0:
+	    (void)signalk_full_dump(&device, &vessel, buf, len);
+	    break;
+	case 1:
+	    (void)signalk_update_dump(&device, &vessel, buf, len);
+	    break;
+	case 2:
+	    ref_update_dump(&device, &vessel, buf, len);
+	    break;
+	case 3:
+	    (void)signalk_track_dump(&device, 0, UINT32_MAX, 0,
+				     "speedOverGround", buf, len);
+	    break;
+	default:
+	    (void)signalk_track_dump(&device, 0, UINT32_MAX, 300000,
+				     "depthBelowTransducer", buf, len);
+	    break;
+	}
+	sink += (size_t)buf[0];
+    }
+    (void)clock_gettime(CLOCK_MONOTONIC, &end);
+    *bytes = strlen(buf);
+    return ((end.tv_sec - start.tv_sec) * 1e6
+	    + (end.tv_nsec - start.tv_nsec) / 1e3) / loops;
+}
+
+int main(int argc, char **argv)
+{
+    static char getbuf[GPS_JSON_RESPONSE_MAX - 256];
+    static char updatebuf[SIGNALK_UPDATE_MAX];
+    static char trackbuf[4096 * 96];
+    static char daybuf[SIGNALK_GET_MAX];
+    static const char *names[] = {"full", "update", "update-ref", "track",
+				  "day"};
+    char *bufs[] = {getbuf, updatebuf, updatebuf, trackbuf, daybuf};
+    size_t lens[] = {sizeof(getbuf), sizeof(updatebuf), sizeof(updatebuf),
+		     sizeof(trackbuf), sizeof(daybuf)};
+    int option, which, loops = 20000, samples = 4096;
+
+    while ((option = getopt(argc, argv, "n:s:h")) != -1) {
+	switch (option) {
+	case 'n':
+	    loops = atoi(optarg);
+	    break;
+	case 's':
+	    samples = atoi(optarg);
+	    break;
+	default:
+	    (void)fputs("usage: bench_signalk [-n loops] [-s track-samples]\n",
+			stderr);
+	    exit(EXIT_FAILURE);
+	}
+    }
+    if (loops < 1)
+	loops = 1;
+    if (samples < 0)
+	samples = 0;
+
+    check_numbers();
+    fill_device(samples);
+    check_update(updatebuf, sizeof(updatebuf));
+
+    (void)printf("%10s %8s %10s %10s\n", "dump", "bytes", "us/dump", "MB/s");
+    for (which = 0; which < (int)NITEMS(names); which++) {
+	size_t bytes;
+	/* the track dumps are tens of times the size of the others */
+	int n = which >= 3 ? loops / 100 + 1 : loops;
+	double us;
+
+	(void)run(which, bufs[which], lens[which], n / 10 + 1, &bytes);
+	us = run(which, bufs[which], lens[which], n, &bytes);
+	(void)printf("%10s %8lu %10.3f %10.1f\n", names[which],
+		     (unsigned long)bytes, us, bytes / us);
+    }
+    return 0;
+}
+
+/* bench_signalk.c ends here */
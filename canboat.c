@@ -0,0 +1,111 @@
+/* canboat.c -- NMEA2000 records in the formats canboat reads
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "canboat.h"
+#include "bits.h"
+
+size_t canboat_pack(uint8_t *buf, size_t buflen,
+		    const struct canboat_record_t *rec)
+/* a binary record into buf, its length or 0 if it doesn't fit */
+{
+    size_t len = CANBOAT_HEADER + (size_t)rec->len;
+
+    if (len > buflen)
+	return 0;
+    putbyte(buf, 0, CANBOAT_MAGIC);
+    putle16(buf, 1, rec->len);
+    putle32(buf, 3, (uint32_t)rec->stamp);
+    putle32(buf, 7, (uint32_t)(rec->stamp >> 32));
+    putle32(buf, 11, (uint32_t)rec->offset);
+    putle32(buf, 15, (uint32_t)((uint64_t)rec->offset >> 32));
+    putle32(buf, 19, rec->pgn);
+    putbyte(buf, 23, rec->prio);
+    putbyte(buf, 24, rec->src);
+    putbyte(buf, 25, rec->dst);
+    (void)memcpy(buf + CANBOAT_HEADER, rec->data, (size_t)rec->len);
+    return len;
+}
+
+ssize_t canboat_unpack(const uint8_t *buf, size_t buflen,
+		       struct canboat_record_t *rec)
+/* the record buf starts with: its length, 0 if it isn't all there yet
+   or -1 if buf doesn't start with one; data points into buf */
+{
+    if (buflen == 0)
+	return 0;
+    if (getub(buf, 0) != CANBOAT_MAGIC)
+	return -1;
+    if (buflen < CANBOAT_HEADER)
+	return 0;
+    rec->len = getleu16(buf, 1);
+    if (buflen < CANBOAT_HEADER + (size_t)rec->len)
+	return 0;
+    rec->stamp = getleu64(buf, 3);
+    rec->offset = getles64(buf, 11);
+    rec->pgn = getleu32(buf, 19);
+    rec->prio = getub(buf, 23);
+    rec->src = getub(buf, 24);
+    rec->dst = getub(buf, 25);
+    rec->data = buf + CANBOAT_HEADER;
+    return (ssize_t)(CANBOAT_HEADER + rec->len);
+}
+
+size_t canboat_text(char *buf, size_t buflen, const char *when,
+		    const struct canboat_record_t *rec)
+/* a text line with CR LF into buf, its length or 0 if it doesn't fit */
+{
+    static const char hexchar[] = "0123456789abcdef";
+    size_t i, len;
+    int n;
+
+    n = snprintf(buf, buflen, "%s,%u,%u,%u,%u,%u",
+		 when, rec->prio, rec->pgn, rec->src, rec->dst, rec->len);
+    if (n < 0 || (size_t)n + (size_t)rec->len * 3 + 3 > buflen)
+	return 0;
+    len = (size_t)n;
+    for (i = 0; i < (size_t)rec->len; i++) {
+	buf[len++] = ',';
+	buf[len++] = hexchar[rec->data[i] >> 4];
+	buf[len++] = hexchar[rec->data[i] & 0x0f];
+    }
+    buf[len++] = '\r';
+    buf[len++] = '\n';
+    buf[len] = '\0';
+    return len;
+}
+
+int64_t canboat_offset(void)
+/* what to add to a monotonic stamp for the realtime, in ns */
+{
+    struct timespec mono, real;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &mono);
+    (void)clock_gettime(CLOCK_REALTIME, &real);
+    return ((int64_t)real.tv_sec - (int64_t)mono.tv_sec) * 1000000000LL
+	+ ((int64_t)real.tv_nsec - (int64_t)mono.tv_nsec);
+}
+
+void canboat_time(char *buf, size_t buflen, uint64_t stamp, int64_t offset)
+/* the UTC time of a monotonic stamp the way canboat writes it */
+{
+    uint64_t now;
+    time_t sec;
+    struct tm tm;
+    unsigned int msec;
+
+    now = stamp + (uint64_t)offset;
+    sec = (time_t)(now / 1000000000ULL);
+    msec = (unsigned int)(now % 1000000000ULL / 1000000ULL);
+    (void)gmtime_r(&sec, &tm);
+    (void)snprintf(buf, buflen, "%04d-%02d-%02d-%02d:%02d:%02d.%03u",
+		   tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+		   tm.tm_hour, tm.tm_min, tm.tm_sec, msec);
+}
+
+/* canboat.c ends here */
@@ -0,0 +1,65 @@
+/* canboat.h -- NMEA2000 records in the formats canboat reads
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _CANBOAT_H_
+#define _CANBOAT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * Subscribers of the canboat output get every NMEA2000 record of a
+ * device, either as the text lines of canboat's analyzer
+ *
+ *	2016-04-01-07:54:13.595,3,127250,2,255,8,ff,...
+ *
+ * (time, priority, PGN, source, destination, length, payload in hex)
+ * or, with "canboat":2 in ?WATCH, as binary records that keep the
+ * receive time to the ns and cost no formatting:
+ *
+ *	byte 0		CANBOAT_MAGIC
+ *	bytes 1-2	payload length
+ *	bytes 3-10	receive time, CLOCK_MONOTONIC ns
+ *	bytes 11-18	CLOCK_REALTIME less CLOCK_MONOTONIC then, ns, signed
+ *	bytes 19-22	PGN
+ *	byte 23		priority
+ *	byte 24		source address
+ *	byte 25		destination address
+ *	bytes 26-	the payload
+ *
+ * Numbers are little endian.  The magic byte lets a reader that lost
+ * its place find the next record; the offset lets it tell the UTC
+ * time of every record without asking the daemon's clocks.
+ */
+#define CANBOAT_MAGIC		0xcb
+#define CANBOAT_HEADER		26
+#define CANBOAT_TEXT_HEADER	64	/* longest text line before the payload */
+
+/* what frames of the old protocol version don't carry */
+#define CANBOAT_PRIO		3
+#define CANBOAT_SRC		2
+#define CANBOAT_DST		255
+
+struct canboat_record_t {
+    uint64_t stamp;		/* monotonic ns of the read() */
+    int64_t offset;		/* realtime less monotonic ns at the time */
+    uint32_t pgn;
+    uint8_t prio, src, dst;
+    uint16_t len;
+    /*@dependent@*/const uint8_t *data;
+};
+
+extern size_t canboat_pack(/*@out@*/uint8_t *, size_t,
+			   const struct canboat_record_t *);
+extern ssize_t canboat_unpack(const uint8_t *, size_t,
+			      /*@out@*/struct canboat_record_t *);
+extern size_t canboat_text(/*@out@*/char *, size_t, const char *,
+			   const struct canboat_record_t *);
+extern int64_t canboat_offset(void);
+extern void canboat_time(/*@out@*/char *, size_t, uint64_t, int64_t);
+
+#endif /* _CANBOAT_H_ */
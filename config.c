@@ -183,7 +183,7 @@ config_parse_interface_option(struct device_port_t * port, const char * name, st
 	  gpsd_report(uci_debuglevel, LOG_INF, 
 		      "type: %s\n", o->v.string);
 
-      strcpy(port->type_str, o->v.string);
+      strlcpy(port->type_str, o->v.string, sizeof(port->type_str));
 
 
       
@@ -216,7 +216,11 @@ config_next_free_interface(struct interface_t * ints) {
 /* 
  * parse an udp/tcp specific interface
  * 
- * at this point in time only port option is supported
+ * options are proto, port and ipaddr, plus for udp how sentences
+ * are sent: batch 'none' is a sendto() per sentence, 'mmsg' (the
+ * default) sends the sentences of a report cycle with one sendmmsg(),
+ * 'pack' packs them into as few datagrams of up to mtu bytes as
+ * possible, which most marine apps split into lines again.
  */
 static void
 config_parse_proto_interface(struct interface_t * intf,
@@ -228,6 +232,8 @@ config_parse_proto_interface(struct interface_t * intf,
     strncpy(intf->name, name, DEVICE_SHORTNAME_MAX);
 
     intf->port = DEFAULT_UDP_BROADCAST_PORT;
+    intf->batch = UDP_BATCH_MMSG;
+    intf->mtu = UDP_DEFAULT_MTU;
 
 	// parse and assign all options
 	struct uci_element *e;
@@ -258,6 +264,35 @@ config_parse_proto_interface(struct interface_t * intf,
                         "ipaddr: %s\n", o->v.string);
 
             intf->ipaddr.sin_addr.s_addr = inet_addr(o->v.string);
+
+        } else if(strcmp(e->name, "batch") == 0) {
+
+            gpsd_report(uci_debuglevel, LOG_INF, 
+                        "batch: %s\n", o->v.string);
+
+            if(strcmp(o->v.string, "none") == 0)
+                intf->batch = UDP_BATCH_NONE;
+            else if(strcmp(o->v.string, "mmsg") == 0)
+                intf->batch = UDP_BATCH_MMSG;
+            else if(strcmp(o->v.string, "pack") == 0)
+                intf->batch = UDP_BATCH_PACK;
+            else
+                gpsd_report(uci_debuglevel, LOG_ERROR, 
+                            "unknown batch mode %s, keeping %d\n",
+                            o->v.string, intf->batch);
+
+        } else if(strcmp(e->name, "mtu") == 0) {
+
+            gpsd_report(uci_debuglevel, LOG_INF, 
+                        "mtu: %s\n", o->v.string);
+
+            int mtu = atol(o->v.string);
+            if((mtu >= 576) && (mtu <= 65507))
+                intf->mtu = mtu;
+            else
+                gpsd_report(uci_debuglevel, LOG_ERROR, 
+                            "mtu %s out of range, keeping %d\n",
+                            o->v.string, intf->mtu);
         }
     }
 }
@@ -0,0 +1,327 @@
+/* devreader.c -- device input threads handing frames to the main loop
+ *
+ * See devreader.h for how the ring works.  Everything here that runs in
+ * the thread only touches the struct devreader_t, never the session,
+ * and never logs: gpsd_report() takes the reporting lock and writes to
+ * clients.  The thread counts what went wrong and the main loop tells.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "gpsd.h"
+#include "devreader.h"
+#include "driver_vyspi.h"
+#include "latency.h"
+
+#if defined(VYSPI_ENABLE)
+
+#define RING_MASK	(DEVREADER_RING_BYTES - 1)
+/* header and payload, padded so the next header is aligned */
+#define RECORD_BYTES(len)	\
+	((uint32_t)(sizeof(struct devreader_record_t) + (len) + 7) & ~7u)
+
+/*
+ * head and tail are the only words both sides touch.  Whoever publishes
+ * one does so after the ring bytes it covers are written (or read), and
+ * the other side loads it before looking at those bytes.
+ */
+#define publish(word, value)	__atomic_store_n(&(word), (value), __ATOMIC_RELEASE)
+#define observe(word)		__atomic_load_n(&(word), __ATOMIC_ACQUIRE)
+
+static int bump(int efd)
+/* add one to an eventfd; EAGAIN means it is set already; errno or 0 */
+{
+    const uint64_t one = 1;
+
+    if (write(efd, &one, sizeof(one)) == -1 && errno != EAGAIN)
+	return errno;
+    return 0;
+}
+
+static void wake(struct devreader_t *reader)
+/* tell the main loop there are frames, or that the thread is done */
+{
+    int error = bump(reader->wakefd);
+
+    if (error != 0) {
+	reader->wake_error = error;
+	publish(reader->wake_failures, reader->wake_failures + 1);
+    }
+}
+
+static void push_frames(struct devreader_t *reader, uint64_t stamp,
+			uint32_t accepted)
+/* copy the frames the lexer just found into the ring */
+{
+    struct gps_packet_t *lexer = &reader->lexer;
+    uint32_t head = reader->head;
+    uint16_t i;
+
+    for (i = 0; i < lexer->out_count; i++) {
+	uint32_t at = head & RING_MASK;
+	uint32_t need = RECORD_BYTES(lexer->out_len[i]);
+	/* a record that does not fit before the end starts over at 0 */
+	uint32_t skip = DEVREADER_RING_BYTES - at < need
+	    ? DEVREADER_RING_BYTES - at : 0;
+	struct devreader_record_t *rec;
+
+	if ((head - reader->tail_seen) + skip + need > DEVREADER_RING_BYTES) {
+	    reader->tail_seen = observe(reader->tail);
+	    if ((head - reader->tail_seen) + skip + need
+		> DEVREADER_RING_BYTES) {
+		publish(reader->dropped, reader->dropped + 1);
+		continue;
+	    }
+	}
+	if (skip != 0) {
+	    /* records are 8 byte aligned, there is room for the marker */
+	    ((struct devreader_record_t *)(reader->ring + at))->len =
+		DEVREADER_WRAP;
+	    head += skip;
+	    at = 0;
+	}
+	rec = (struct devreader_record_t *)(reader->ring + at);
+	rec->len = lexer->out_len[i];
+	rec->type = lexer->out_type[i];
+	rec->version = lexer->out_new_version[i];
+	rec->accepted = accepted;
+	rec->stamp = stamp;
+	memcpy(rec + 1, packet_record(lexer, i), lexer->out_len[i]);
+	head += need;
+	reader->frames++;
+    }
+    publish(reader->head, head);
+}
+
+static void *devreader_thread(void *arg)
+/* read and lex the device until told to stop or it goes away */
+{
+    struct devreader_t *reader = (struct devreader_t *)arg;
+    struct gps_packet_t *lexer = &reader->lexer;
+    struct pollfd pfd[2];
+
+    pfd[0].fd = reader->fd;
+    pfd[0].events = POLLIN;
+    pfd[1].fd = reader->stopfd;
+    pfd[1].events = POLLIN;
+
+    for (;;) {
+	uint64_t stamp;
+	uint32_t accepted = 0, frames = reader->frames;
+	ssize_t n;
+
+	if (poll(pfd, 2, -1) == -1) {
+	    if (errno == EINTR)
+		continue;
+	    reader->error = errno;
+	    break;
+	}
+	if (pfd[1].revents != 0)
+	    return NULL;
+
+	/* everything read before has been scanned */
+	vyspi_lexer_compact(lexer);
+	n = read(reader->fd, lexer->inbuffer + lexer->inbuflen,
+		 sizeof(lexer->inbuffer) - lexer->inbuflen);
+	if (n == -1 && (errno == EAGAIN || errno == EINTR))
+	    continue;
+	if (n <= 0) {
+	    /* a serial port that polls readable and reads 0 has hung up */
+	    reader->error = n == 0 ? 0 : errno;
+	    break;
+	}
+	stamp = latency_now();
+	lexer->inbuflen += (size_t)n;
+
+	/* one scan takes at most MAX_OUT_BUF_RECORDS frames */
+	do {
+	    vyspi_lexer_scan(lexer);
+	    if (reader->timed)
+		accepted = (uint32_t)(latency_now() - stamp);
+	    push_frames(reader, stamp, accepted);
+	} while (packet_buffered_input(lexer) > 0);
+
+	if (reader->frames != frames)
+	    wake(reader);
+    }
+
+    publish(reader->ended, true);
+    wake(reader);
+    return NULL;
+}
+
+bool devreader_activate(struct gps_device_t *session)
+/* read the device in a thread of its own, false if it can't be */
+{
+    struct devreader_t *reader;
+    sigset_t all, old;
+    int status;
+
+    if (session->reader != NULL)
+	return true;
+    if (session->device_type == NULL
+	|| session->device_type->packet_type != VYSPI_PACKET
+	|| !session->gpsdata.dev.isSerial
+	|| BAD_SOCKET(session->gpsdata.gps_fd))
+	return false;
+
+    reader = (struct devreader_t *)calloc(1, sizeof(*reader));
+    if (reader == NULL)
+	return false;
+    reader->fd = session->gpsdata.gps_fd;
+    packet_reset(&reader->lexer);
+    /* the lexer's own diagnostics would come from the thread */
+    reader->lexer.debug = LOG_ERROR - 1;
+    /* the main loop may change latency.enabled, the thread reads its copy */
+    reader->timed = latency.enabled;
+    reader->wakefd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    reader->stopfd = eventfd(0, EFD_CLOEXEC);
+    if (reader->wakefd == -1 || reader->stopfd == -1) {
+	gpsd_report(session->context->debug, LOG_ERROR,
+		    "reader for %s: eventfd: %s\n",
+		    session->gpsdata.dev.path, strerror(errno));
+	goto fail;
+    }
+
+    /* signals are for the main loop */
+    (void)sigfillset(&all);
+    (void)pthread_sigmask(SIG_SETMASK, &all, &old);
+    status = pthread_create(&reader->thread, NULL, devreader_thread, reader);
+    (void)pthread_sigmask(SIG_SETMASK, &old, NULL);
+    if (status != 0) {
+	gpsd_report(session->context->debug, LOG_ERROR,
+		    "reader for %s: pthread_create: %s\n",
+		    session->gpsdata.dev.path, strerror(status));
+	goto fail;
+    }
+
+    session->reader = reader;
+    gpsd_report(session->context->debug, LOG_INF,
+		"%s is read by a thread of its own\n",
+		session->gpsdata.dev.path);
+    return true;
+
+  fail:
+    if (reader->wakefd != -1)
+	(void)close(reader->wakefd);
+    if (reader->stopfd != -1)
+	(void)close(reader->stopfd);
+    free(reader);
+    return false;
+}
+
+void devreader_deactivate(struct gps_device_t *session)
+/* stop the thread, before the device is closed */
+{
+    struct devreader_t *reader = session->reader;
+    int status;
+
+    if (reader == NULL)
+	return;
+    if ((status = bump(reader->stopfd)) != 0)
+	gpsd_report(session->context->debug, LOG_ERROR,
+		    "reader for %s: eventfd: %s\n",
+		    session->gpsdata.dev.path, strerror(status));
+    (void)pthread_join(reader->thread, NULL);
+    /* the thread is gone, what it counted can be read as it is */
+    if (reader->ended)
+	gpsd_report(session->context->debug, LOG_WARN,
+		    "reader for %s: %s\n", session->gpsdata.dev.path,
+		    reader->error == 0 ? "end of input"
+		    : strerror(reader->error));
+    if (reader->wake_failures > 0)
+	gpsd_report(session->context->debug, LOG_ERROR,
+		    "reader for %s: %u wakeups failed, last: %s\n",
+		    session->gpsdata.dev.path, reader->wake_failures,
+		    strerror(reader->wake_error));
+    gpsd_report(session->context->debug,
+		reader->dropped > 0 ? LOG_WARN : LOG_INF,
+		"reader for %s stopped, %u frames, %u dropped\n",
+		session->gpsdata.dev.path, reader->frames, reader->dropped);
+    (void)close(reader->wakefd);
+    (void)close(reader->stopfd);
+    free(reader);
+    session->reader = NULL;
+}
+
+void devreader_wakeup(struct devreader_t *reader)
+/* take a wakeup; what is in the ring now is consumed before the next */
+{
+    uint64_t count;
+
+    /* reset the eventfd first, frames that follow bump it again */
+    if (read(reader->wakefd, &count, sizeof(count)) == -1)
+	count = 0;	/* a wakeup already taken, look at head anyway */
+    reader->limit = observe(reader->head);
+}
+
+ssize_t devreader_get(struct gps_device_t *session)
+/* the driver's get_packet: frames from the ring into the records */
+{
+    struct devreader_t *reader = session->reader;
+    struct gps_packet_t *lexer = &session->packet;
+    uint32_t tail = reader->tail;
+    uint16_t cnt = 0;
+    size_t used = 0;
+
+    lexer->out_types = 0;
+    lexer->in_stamp = 0;
+    while (tail != reader->limit && cnt < MAX_OUT_BUF_RECORDS) {
+	const struct devreader_record_t *rec =
+	    (const struct devreader_record_t *)(reader->ring
+						 + (tail & RING_MASK));
+
+	if (rec->len == DEVREADER_WRAP) {
+	    tail += DEVREADER_RING_BYTES - (tail & RING_MASK);
+	    continue;
+	}
+	/* records are views into inbuffer, with a '\0' behind each */
+	if (used + rec->len + 1 > sizeof(lexer->inbuffer))
+	    break;
+	memcpy(lexer->inbuffer + used, rec + 1, rec->len);
+	lexer->inbuffer[used + rec->len] = '\0';
+	lexer->out_offset[cnt] = (uint16_t)used;
+	lexer->out_len[cnt] = rec->len;
+	lexer->out_type[cnt] = rec->type;
+	lexer->out_new_version[cnt] = rec->version;
+	if (rec->type < FRM_TYPE_MAX)
+	    lexer->out_types |= 1u << rec->type;
+	if (rec->stamp != 0) {
+	    /* a batch is as late as its oldest frame */
+	    if (lexer->in_stamp == 0)
+		lexer->in_stamp = rec->stamp;
+	    if (reader->timed && latency.enabled && rec->type < LATENCY_TYPES)
+		latency_record(&latency.stage[rec->type][lat_accept],
+			       rec->accepted);
+	}
+	used += rec->len + 1;
+	cnt++;
+	tail += RECORD_BYTES(rec->len);
+    }
+    publish(reader->tail, tail);
+
+    lexer->out_count = cnt;
+    lexer->outbuflen = used;
+    lexer->inbuflen = used;
+    lexer->inbufptr = lexer->inbuffer + used;
+    if (cnt > 0) {
+	lexer->type = VYSPI_PACKET;
+	return (ssize_t)used;
+    }
+    /* the thread only gives up after it has pushed what it had */
+    if (observe(reader->ended) && tail == observe(reader->head))
+	return -1;
+    return 0;
+}
+
+#endif /* defined(VYSPI_ENABLE) */
+
+/* devreader.c ends here */
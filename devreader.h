@@ -0,0 +1,89 @@
+/* devreader.h -- device input threads handing frames to the main loop
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _DEVREADER_H_
+#define _DEVREADER_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "gpsd.h"
+
+/*
+ * With gpsd -R a serial vyspi device is read by a thread of its own
+ * that does nothing but read() and lex.  The kernel tty buffer is
+ * drained however long the main loop is busy with clients.  The frames
+ * go through a lock free single producer, single consumer ring to the
+ * main loop, which decodes and reports them as if it had read them
+ * itself.  Decoding stays there because it writes the session that
+ * all of reporting and every client request read.
+ *
+ * The ring holds records of a frame each, in the order they were read.
+ * A record is its header and payload padded to 8 bytes and never wraps;
+ * a header with len DEVREADER_WRAP sends the reader back to the start.
+ * head and tail count bytes and run freely, only the thread writes head
+ * and only the main loop writes tail.  When the ring is full the thread
+ * drops frames rather than wait.  It never takes a lock, the reporting
+ * lock included, so it doesn't log either: it counts drops and failed
+ * wakeups and keeps the errno it stopped on, and the main loop reports
+ * them.
+ *
+ * After each read() that yielded frames the thread bumps an eventfd the
+ * main loop watches in place of the device.
+ */
+#ifndef GPSD_SLIM
+#define DEVREADER_RING_BYTES	65536	/* over 2000 typical frames */
+#else
+#define DEVREADER_RING_BYTES	16384
+#endif /* GPSD_SLIM */
+#define DEVREADER_WRAP		0xffff
+
+struct devreader_record_t {
+    uint16_t len;		/* payload bytes, or DEVREADER_WRAP */
+    uint8_t type;		/* FRM_TYPE_* */
+    uint8_t version;		/* frame version */
+    uint32_t accepted;		/* ns from read() to lexer accept */
+    uint64_t stamp;		/* latency_now() of the read() */
+};
+
+struct devreader_t {
+    /* the thread's */
+    uint32_t head;		/* ring bytes written */
+    uint32_t tail_seen;		/* tail when last looked at */
+    uint32_t frames;		/* frames put into the ring */
+    uint32_t dropped;		/* frames there was no room for */
+    uint32_t wake_failures;	/* eventfd writes that failed */
+    int wake_error;		/* errno of the last of them */
+    int error;			/* errno it ended on, 0 at end of input */
+    bool ended;			/* read() failed or the device hung up */
+    struct gps_packet_t lexer;
+    /* the main loop's */
+    uint32_t tail;		/* ring bytes consumed */
+    uint32_t limit;		/* head at the last wakeup */
+    /* set up before the thread starts */
+    int fd;			/* the device */
+    int wakefd;			/* eventfd, the main loop watches it */
+    int stopfd;			/* eventfd, tells the thread to quit */
+    bool timed;			/* latency.enabled then, the thread's copy */
+    pthread_t thread;
+    uint8_t ring[DEVREADER_RING_BYTES];
+};
+
+#if defined(VYSPI_ENABLE)
+extern bool devreader_activate(struct gps_device_t *);
+extern void devreader_deactivate(struct gps_device_t *);
+extern void devreader_wakeup(struct devreader_t *);
+extern ssize_t devreader_get(struct gps_device_t *);
+#else
+#define devreader_activate(session)	false
+#define devreader_deactivate(session)	do { } while (0)
+#define devreader_wakeup(reader)	do { } while (0)
+#endif /* defined(VYSPI_ENABLE) */
+
+/* what the main loop watches for input of this reader */
+#define devreader_fd(reader)	((reader)->wakefd)
+
+#endif /* _DEVREADER_H_ */
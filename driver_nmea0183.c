@@ -1951,19 +1951,21 @@ gps_mask_t nmea_parse(char *sentence, struct gps_device_t * session) {
     return nmea_parse_len(sentence, strlen(sentence), session);
 }
 
-/*@ -mayaliasunique @*/
-gps_mask_t nmea_parse_len(char *sentence, size_t sentence_len, struct gps_device_t * session)
-/* parse an NMEA sentence, unpack it into a session structure */
+typedef gps_mask_t(*nmea_decoder) (int count, char *f[],
+				   struct gps_device_t * session);
+
+/*
+ * The decoders, and sentence tags as they are known in cycle detection.
+ * Names of 3 characters go with any talker ID, the others are the whole
+ * tag of a proprietary sentence.
+ */
+static const struct
 {
-    typedef gps_mask_t(*nmea_decoder) (int count, char *f[],
-				       struct gps_device_t * session);
-    static struct
-    {
-	char *name;
-	int nf;			/* minimum number of fields required to parse */
-	bool cycle_continue;	/* cycle continuer? */
-	nmea_decoder decoder;
-    } nmea_phrase[] = {
+    char *name;
+    int nf;			/* minimum number of fields required to parse */
+    bool cycle_continue;	/* cycle continuer? */
+    nmea_decoder decoder;
+} nmea_phrase[] = {
 	/*@ -nullassign @*/
 	{"PGRMC", 0, false, NULL},	/* ignore Garmin Sensor Config */
 	{"PGRME", 7, false, processPGRME},
@@ -2026,13 +2028,101 @@ gps_mask_t nmea_parse_len(char *sentence, size_t sentence_len, struct gps_device
 #ifdef MTK3301_ENABLE
 	{"PMTK", 3,  false, processMTK3301},
 #endif /* MTK3301_ENABLE */
-    };
+};
+
+/*
+ * Tags are looked up with up to 8 of their characters packed into a
+ * word, the key, in an open addressed hash of nmea_phrase[] built on
+ * first use.  Tag characters are printable ASCII, so the top bit is
+ * free to tell the 3 character names from proprietary tags.
+ */
+#define NMEA_HASH_BITS	7
+#define NMEA_HASH_SIZE	(1 << NMEA_HASH_BITS)
+#define NMEA_HASH(key)	\
+	((unsigned int)(((key) * 0x9e3779b97f4a7c15ULL) >> (64 - NMEA_HASH_BITS)))
+#define NMEA_TALKER_KEY	(1ULL << 63)	/* a name without talker ID */
+
+/*
+ * Probing ends at a free slot, so a full hash would never return.  At
+ * most half full keeps probes short; a slot holds the index plus one.
+ * The build fails here when nmea_phrase[] outgrows NMEA_HASH_BITS.
+ */
+typedef char nmea_hash_roomy[NITEMS(nmea_phrase) * 2 <= NMEA_HASH_SIZE
+			     && NITEMS(nmea_phrase) < UINT8_MAX ? 1 : -1];
+
+static uint64_t nmea_phrase_key[NMEA_HASH_SIZE];
+static uint8_t nmea_phrase_slot[NMEA_HASH_SIZE];	/* index + 1, 0 if free */
+static bool nmea_phrase_hashed = false;
+
+static uint64_t nmea_tag_key(const char *tag, size_t len)
+/* pack up to 8 characters of a tag */
+{
+    uint64_t key = 0;
+
+    while (len-- > 0)
+	key = (key << 8) | (unsigned char)*tag++;
+    return key;
+}
+
+static void nmea_phrase_hash(void)
+/* hash every name of nmea_phrase[], the first of duplicates wins */
+{
+    unsigned int i;
+
+    for (i = 0; i < (unsigned int)NITEMS(nmea_phrase); i++) {
+	size_t len = strlen(nmea_phrase[i].name);
+	uint64_t key = nmea_tag_key(nmea_phrase[i].name, len);
+	unsigned int h;
+
+	if (len == 3)
+	    key |= NMEA_TALKER_KEY;
+	for (h = NMEA_HASH(key); nmea_phrase_slot[h] != 0;
+	     h = (h + 1) & (NMEA_HASH_SIZE - 1))
+	    if (nmea_phrase_key[h] == key)
+		break;
+	if (nmea_phrase_slot[h] == 0) {
+	    nmea_phrase_key[h] = key;
+	    nmea_phrase_slot[h] = (uint8_t)(i + 1);
+	}
+    }
+    nmea_phrase_hashed = true;
+}
+
+static unsigned int nmea_phrase_find(uint64_t key)
+/* index into nmea_phrase[] plus one, 0 if the key is unknown */
+{
+    unsigned int h;
+
+    for (h = NMEA_HASH(key); nmea_phrase_slot[h] != 0;
+	 h = (h + 1) & (NMEA_HASH_SIZE - 1))
+	if (nmea_phrase_key[h] == key)
+	    return nmea_phrase_slot[h];
+    return 0;
+}
 
+static int nmea_hexdigit(char c)
+/* value of a checksum digit, -1 if it is none */
+{
+    if (c >= '0' && c <= '9')
+	return c - '0';
+    if (c >= 'A' && c <= 'F')
+	return c - 'A' + 10;
+    if (c >= 'a' && c <= 'f')
+	return c - 'a' + 10;
+    return -1;
+}
+
+/*@ -mayaliasunique @*/
+gps_mask_t nmea_parse_len(char *sentence, size_t sentence_len, struct gps_device_t * session)
+/* parse an NMEA sentence, unpack it into a session structure */
+{
     int count;
     gps_mask_t retval = 0;
     unsigned int i, thistag;
-    char *p, *s, *e;
-    volatile char *t;
+    unsigned char sum = 0;
+    size_t taglen = 0;
+    const char *p, *end = sentence + sentence_len;
+    char *q, *e, **field = session->driver.nmea.field;
 
     /*
      * We've had reports that on the Garmin GPS-10 the device sometimes
@@ -2045,75 +2135,83 @@ gps_mask_t nmea_parse_len(char *sentence, size_t sentence_len, struct gps_device
     if (sentence_len > NMEA_MAX) {
 	gpsd_report(session->context->debug, LOG_WARN,
 		    "Overlong packet of %zd chars rejected.\n",
-		    strlen(sentence));
+		    sentence_len);
 	return ONLINE_SET;
     }
 
-    /*@ -usedef @*//* splint 3.1.1 seems to have a bug here */
-    /* make an editable copy of the sentence */
-    (void)strlcpy((char *)session->driver.nmea.fieldcopy, sentence, NMEA_MAX);
-    /* discard the checksum part */
-    for (p = (char *)session->driver.nmea.fieldcopy;
-	 (*p != '*') && (*p >= ' ');)
-	++p;
-    if (*p == '*')
-	*p++ = ',';		/* otherwise we drop the last field */
-    *p = '\0';
-    e = p;
-
-    /* split sentence copy on commas, filling the field array */
+    /*
+     * Copy the sentence, without its '$' and checksum, splitting it on
+     * commas into the field array and summing it up on the way.  The
+     * '*' ends the last field, a sentence without one loses its last
+     * field, as it always did.
+     */
+    q = (char *)session->driver.nmea.fieldcopy;
+    field[0] = q;
     count = 0;
-    t = p;			/* end of sentence */
-    p = (char *)session->driver.nmea.fieldcopy + 1;	/* beginning of tag, 'G' not '$' */
-    /* while there is a search string and we haven't run off the buffer... */
-    while ((p != NULL) && (p <= t)) {
-	session->driver.nmea.field[count] = p;	/* we have a field. record it */
-	/*@ -compdef @*/
-	if ((p = strchr(p, ',')) != NULL) {	/* search for the next delimiter */
-	    *p = '\0';		/* replace it with a NUL */
-	    count++;		/* bump the counters and continue */
-	    p++;
+    for (p = sentence + 1; p < end && *p != '*' && *p >= ' '; p++) {
+	sum ^= (unsigned char)*p;
+	if (*p == ',') {
+	    if (count == 0)
+		taglen = (size_t)(q - field[0]);
+	    *q++ = '\0';
+	    field[++count] = q;
+	} else
+	    *q++ = *p;
+    }
+    if (count == 0)
+	taglen = (size_t)(q - field[0]);
+    if (p < end && *p == '*') {
+	*q++ = '\0';
+	count++;
+	/* a checksum the lexer did not verify, the vyspi framing has none */
+	if (end - p > 2) {
+	    int hi = nmea_hexdigit(p[1]), lo = nmea_hexdigit(p[2]);
+
+	    if (hi >= 0 && lo >= 0 && (unsigned char)(hi << 4 | lo) != sum) {
+		gpsd_report(session->context->debug, LOG_WARN,
+			    "bad checksum in NMEA sentence %s, expected %02X.\n",
+			    field[0], (unsigned int)sum);
+		return ONLINE_SET;
+	    }
 	}
-	/*@ +compdef @*/
     }
+    *q = '\0';
+    e = q;
 
     /* point remaining fields at empty string, just in case */
     for (i = (unsigned int)count;
-	 i <
-	 (unsigned)(sizeof(session->driver.nmea.field) /
-		    sizeof(session->driver.nmea.field[0])); i++)
-	session->driver.nmea.field[i] = e;
+	 i < (unsigned int)NITEMS(session->driver.nmea.field); i++)
+	field[i] = e;
 
     /* sentences handlers will tell us whren they have fractional time */
     session->driver.nmea.latch_frac_time = false;
 
     /* dispatch on field zero, the sentence tag */
-    for (thistag = i = 0;
-	 i < (unsigned)(sizeof(nmea_phrase) / sizeof(nmea_phrase[0])); ++i) {
-	s = session->driver.nmea.field[0];
-	if (strlen(nmea_phrase[i].name) == 3)
-	    s += 2;		/* skip talker ID */
-	if (strcmp(nmea_phrase[i].name, s) == 0) {
-	    if (nmea_phrase[i].decoder != NULL
-            && (count >= nmea_phrase[i].nf)) {
-            retval =
-                (nmea_phrase[i].decoder) (count,
-                                          session->driver.nmea.field,
-                                          session);
-            (void)strlcpy(session->gpsdata.tag,
-                          nmea_phrase[i].name,
-                          MAXTAGLEN);
-            if (nmea_phrase[i].cycle_continue)
-                session->driver.nmea.cycle_continue = true;
-            /*
-             * Must force this to be nz, as we're going to rely on a zero
-             * value to mean "no previous tag" later.
-             */
-            thistag = i + 1;
-	    } else
-            retval = ONLINE_SET;	/* unknown sentence */
-	    break;
-	}
+    if (!nmea_phrase_hashed)
+	nmea_phrase_hash();
+    thistag = 0;
+    if (taglen <= 8)
+	i = nmea_phrase_find(nmea_tag_key(field[0], taglen));
+    else
+	i = 0;
+    /* skip the talker ID */
+    if (i == 0 && taglen == 5)
+	i = nmea_phrase_find(nmea_tag_key(field[0] + 2, 3) | NMEA_TALKER_KEY);
+    if (i-- > 0) {
+	if (nmea_phrase[i].decoder != NULL
+	    && (count >= nmea_phrase[i].nf)) {
+	    retval = (nmea_phrase[i].decoder) (count, field, session);
+	    (void)strlcpy(session->gpsdata.tag, nmea_phrase[i].name,
+			  MAXTAGLEN);
+	    if (nmea_phrase[i].cycle_continue)
+		session->driver.nmea.cycle_continue = true;
+	    /*
+	     * Must force this to be nz, as we're going to rely on a zero
+	     * value to mean "no previous tag" later.
+	     */
+	    thistag = i + 1;
+	} else
+	    retval = ONLINE_SET;	/* unknown sentence */
     }
 
     /* timestamp recording for fixes happens here */
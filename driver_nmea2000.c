@@ -23,6 +23,8 @@
 #include "gpsd.h"
 #if defined(NMEA2000_ENABLE)
 #include "driver_nmea2000.h"
+#include "pgnindex.h"
+#include "n2kcodec.h"
 #include "bits.h"
 
 #ifndef S_SPLINT_S
@@ -958,144 +960,19 @@ static gps_mask_t hnd_127513(unsigned char *bu, int len, PGN *pgn, struct gps_de
 
 
 /*
- *   PGN 127245: NAV Rudder
+ *   PGNs described in n2kpgns.json, see n2kcodec.h
  */
-static gps_mask_t hnd_127245(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
+static gps_mask_t hnd_codec(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
 {
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    return(0);
-}
-
-/*
- *   PGN 127250: NAV Vessel Heading
- */
-static gps_mask_t hnd_127250(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
-{
-  /*
-    1 SID
-    2 Heading Sensor Reading
-    3 Deviation
-    4 Variation
-    5 Heading Sensor Reference
-    6 Reserved Bits
-    */
-
-    uint8_t sid;
-    uint16_t hdg;
-    int16_t dev;
-    int16_t var;
-    double heading = 0.0;
-    uint8_t ref = 0; // Heading Sensor Reference (M&T?)
-    const size_t buflen = 255;
-    // [3] says ref = 1 for magnetic north (how many bits?)
+    const struct n2k_codec_t *codec = n2k_codec_find(pgn->pgn);
 
     print_data(session->context, bu, len, pgn);
-
-    sid = getub(bu, 0);
-
-    /*@-type@*/
-    hdg = getleu16(bu, 1);
-    if (hdg != 0xffff) {
-        heading = hdg * RAD_2_DEG * 0.0001;
-    }
-
-    dev = getles16(bu, 3);
-    if (dev != 0x7fff) {
-        heading += dev * RAD_2_DEG * 0.0001;
-        session->gpsdata.environment.set       = ENV_DEVIATION_PSET;
-        session->gpsdata.environment.deviation = dev * RAD_2_DEG * 0.0001;
-    }
-
-    var = getles16(bu, 5);
-    if (var != 0x7fff) {
-        heading += var * RAD_2_DEG * 0.0001;
-        session->gpsdata.environment.set       |= ENV_VARIATION_PSET;
-        session->gpsdata.environment.variation = var * RAD_2_DEG * 0.0001;
-    }
-
-    // observed b0000 0001, 1 = magnetic (see also [3]), 0 = true
-    ref = getub(bu, 7) & 0x01; // ??? len, only a couple of bits
-
-    /*@+type@*/
-    if (hdg != 0xffff) {
-      if(ref == 1) {
-	session->gpsdata.navigation.set |= NAV_HDG_MAGN_PSET;
-	session->gpsdata.navigation.heading[compass_magnetic] = heading;
-      } else {
-	session->gpsdata.navigation.set |= NAV_HDG_TRUE_PSET;
-	session->gpsdata.navigation.heading[compass_true] = heading;
-      }
-    } else {
-	session->gpsdata.navigation.heading[compass_magnetic] = NAN;
-	session->gpsdata.navigation.heading[compass_true] = NAN;
-    }
-
     gpsd_report(session->context->debug, LOG_DATA,
 		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
-    char bufp[buflen];
-    memset(bufp, 0, buflen);
-
-    if (hdg == 0xffff) {
-      (void)sprintf(bufp, "Heading= %s, ", "-");
-      (void)sprintf(bufp + strlen(bufp), "Sensor= %s, ", "-");
-    } else {
-      (void)snprintf(bufp, buflen, "Heading= %.2f, ", heading);
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp), "Sensor= %.2f, ", 
-		     hdg  * RAD_2_DEG * 0.0001);
-    }
-    if (dev == 0x7fff) {
-      (void)sprintf(bufp + strlen(bufp), "Deviation= %s, ", "-");
-    } else {
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp), 
-		     "Deviation= %.2f, ", 
-		     dev * RAD_2_DEG * 0.0001);
-    }
-    if (var == 0x7fff) {
-      (void)sprintf(bufp + strlen(bufp), "Variation= %s", "-");
-    } else {
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp), "Variation= %.2f", var * RAD_2_DEG * 0.0001);
-    }
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %d, %s, Heading Sensor Reference= %s (%u), Reserved = %u\n", 
-		sid, 
-		bufp,
-		ref == 1? "Magnetic":"True",
-		ref,
-		0);
-
-    return (ONLINE_SET | NAVIGATION_SET);
-}
-
-
-/*
- *   PGN 128259: NAV Speed
- */
-static gps_mask_t hnd_128259(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
-{
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    return(0);
-}
-
-
-/*
- *   PGN 128267: NAV Water Depth
- */
-static gps_mask_t hnd_128267(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
-{
-    print_data(session->context, bu, len, pgn);
-
-    /*@i@*/session->gpsdata.navigation.depth = getleu32(bu, 1) *.01;
-    session->gpsdata.navigation.set = NAV_DPT_PSET;
-
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    return(ONLINE_SET | NAVIGATION_SET);
+    if (codec == NULL)
+	return(0);
+    return codec->decode(bu, len, &session->gpsdata);
 }
 
 
@@ -1147,30 +1024,6 @@ static gps_mask_t hnd_129285(unsigned char *bu, int len, PGN *pgn, struct gps_de
 }
 
 
-/*
- *   PGN 130306: NAV Wind Data
- */
-static gps_mask_t hnd_130306(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
-{
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    return(0);
-}
-
-
-/*
- *   PGN 130310: NAV Water Temp., Outside Air Temp., Atmospheric Pressure
- */
-static gps_mask_t hnd_130310(unsigned char *bu, int len, PGN *pgn, struct gps_device_t *session)
-{
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    return(0);
-}
-
-
 /*
  *   PGN 130311: NAV Environmental Parameters
  */
@@ -1277,40 +1130,63 @@ static PGN navpgn[] = {{ 59392, 0, 0, hnd_059392, &msg_059392[0]},
 		       {126464, 1, 0, hnd_126464, &msg_126464[0]},
 		       {126992, 0, 0, hnd_126992, &msg_126992[0]},
 		       {126996, 1, 0, hnd_126996, &msg_126996[0]},
-		       {127245, 0, 4, hnd_127245, &msg_127245[0]},
-		       {127250, 0, 4, hnd_127250, &msg_127250[0]},
+		       {127245, 0, 4, hnd_codec,  &msg_127245[0]},
+		       {127250, 0, 4, hnd_codec,  &msg_127250[0]},
 		       {127258, 0, 0, hnd_127258, &msg_127258[0]},
-		       {128259, 0, 4, hnd_128259, &msg_128259[0]},
-		       {128267, 0, 4, hnd_128267, &msg_128267[0]},
+		       {128259, 0, 4, hnd_codec,  &msg_128259[0]},
+		       {128267, 0, 4, hnd_codec,  &msg_128267[0]},
 		       {128275, 1, 4, hnd_128275, &msg_128275[0]},
 		       {129283, 0, 0, hnd_129283, &msg_129283[0]},
 		       {129284, 1, 0, hnd_129284, &msg_129284[0]},
 		       {129285, 1, 0, hnd_129285, &msg_129285[0]},
-		       {130306, 0, 4, hnd_130306, &msg_130306[0]},
-		       {130310, 0, 4, hnd_130310, &msg_130310[0]},
+		       {130306, 0, 4, hnd_codec,  &msg_130306[0]},
+		       {130310, 0, 4, hnd_codec,  &msg_130310[0]},
 		       {130311, 0, 4, hnd_130311, &msg_130311[0]},
 		       {0     , 0, 0, NULL,       &msg_error [0]}};
 
 
 /*@+usereleased@*/
 
+/* every table search_pgnlist() gets handed, each indexed on first use */
+static PGN *pgnlists[] = {gpspgn, aispgn, pwrpgn, navpgn};
+static const unsigned int pgnlist_sizes[] = {
+    NITEMS(gpspgn), NITEMS(aispgn), NITEMS(pwrpgn), NITEMS(navpgn)
+};
+static struct pgnindex_t pgnindexes[NITEMS(pgnlists)];
+
 /*@-immediatetrans@*/
-static /*@null@*/ PGN *search_pgnlist(unsigned int pgn, PGN *pgnlist)
+static /*@null@*/ PGN *search_pgnlist(struct gps_device_t *session,
+				      unsigned int pgn, PGN *pgnlist)
 {
-    int l1;
-    PGN *work;
+    int l1, l2;
+    struct pgnindex_t *idx;
 
-    l1 = 0;
-    work = NULL;
-    while (pgnlist[l1].pgn != 0) {
-        if (pgnlist[l1].pgn == pgn) {
-	    work = &pgnlist[l1];
+    for (l1 = 0; l1 < NITEMS(pgnlists); l1++)
+        if (pgnlists[l1] == pgnlist)
 	    break;
-	} else {
-	    l1 = l1 + 1;
-	    }
-	}
-    return work;
+    if (l1 == NITEMS(pgnlists))
+        return NULL;
+
+    idx = &pgnindexes[l1];
+    if (!idx->built) {
+	bool ok = pgnindex_init(idx, pgnlist_sizes[l1]);
+	for (l2 = 0; ok && pgnlist[l2].pgn != 0; l2++)
+	    ok = pgnindex_add(idx, pgnlist[l2].pgn, l2);
+	if (!ok)
+	    gpsd_report(session->context->debug, LOG_ERROR,
+			"NMEA2000: can't index PGN table %d, walking it\n",
+			l1);
+    }
+
+    if (idx->usable)
+	l2 = pgnindex_find(idx, pgn);
+    else {
+	for (l2 = 0; pgnlist[l2].pgn != 0 && pgnlist[l2].pgn != pgn; l2++)
+	    continue;
+	if (pgnlist[l2].pgn == 0)
+	    l2 = -1;
+    }
+    return (l2 < 0) ? NULL : &pgnlist[l2];
 }
 /*@+immediatetrans@*/
 
@@ -1402,23 +1278,23 @@ static void find_pgn(struct can_frame *frame, struct gps_device_t *session)
 	if (source_unit == session->driver.nmea2000.unit) {
 	    PGN *work;
 	    if (session->driver.nmea2000.pgnlist != NULL) {
-	        work = search_pgnlist(source_pgn, session->driver.nmea2000.pgnlist);
+	        work = search_pgnlist(session, source_pgn, session->driver.nmea2000.pgnlist);
 	    } else {
 	        PGN *pgnlist;
 
 		pgnlist = &gpspgn[0];
-		work = search_pgnlist(source_pgn, pgnlist);
+		work = search_pgnlist(session, source_pgn, pgnlist);
 		if (work == NULL) {
 		    pgnlist = &aispgn[0];
-		    work = search_pgnlist(source_pgn, pgnlist);
+		    work = search_pgnlist(session, source_pgn, pgnlist);
 		}
 		if (work == NULL) {
 		    pgnlist = &pwrpgn[0];
-		    work = search_pgnlist(source_pgn, pgnlist);
+		    work = search_pgnlist(session, source_pgn, pgnlist);
 		}
 		if (work == NULL) {
 		    pgnlist = &navpgn[0];
-		    work = search_pgnlist(source_pgn, pgnlist);
+		    work = search_pgnlist(session, source_pgn, pgnlist);
 		}
 		if ((work != NULL) && (work->type > 0)) {
 		    session->driver.nmea2000.pgnlist = pgnlist;
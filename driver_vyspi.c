@@ -36,16 +36,24 @@
 #if defined(VYSPI_ENABLE)
 #include "frame.h"
 #include "driver_vyspi.h"
+#include "pgnindex.h"
+#include "n2kcodec.h"
 #include "bits.h"
 
 #include "json.h"
 #include "utils.h"
 #include "navigation.h"
 #include "timeutil.h"
+#include "latency.h"
+#include "devreader.h"
+#include "aistarget.h"
 
 #define LOG_FILE 1
 #define VYSPI_RESET 0x04
 
+// free input space below which a partial serial frame is moved down
+#define VYSPI_ARENA_SLACK MAX_PACKET_LENGTH
+
 // package types
 #define PKG_TYPE_NMEA0183 0x01
 #define PKG_TYPE_NMEA2000 0x02
@@ -92,32 +100,23 @@ static gps_mask_t hnd_130842(unsigned char *bu, int len, struct PGN *pgn, struct
 static gps_mask_t hnd_127506(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127508(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127513(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127488(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127489(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127493(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127505(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127237(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127245(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127250(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127257(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_127251(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_127258(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_128259(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_128267(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_128275(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_129033(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_129283(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_129284(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_129285(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_129291(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_130306(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
-static gps_mask_t hnd_130310(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_130311(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_130312(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_130824(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_130845(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_130850(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 
+static gps_mask_t hnd_codec(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 static gps_mask_t hnd_unknown(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session);
 
 static struct PGN pgnlist[] = {
@@ -147,26 +146,26 @@ static struct PGN pgnlist[] = {
     {127506, 1, 3, 0, 0, hnd_127506, "PWR DC Detailed Status"},
     {127508, 1, 3, 0, 0, hnd_127508, "PWR Battery Status"},
     {127513, 1, 3, 0, 0, hnd_127513, "PWR Battery Configuration Status"},
-    {127488, 0, 0, 1, 0, hnd_127488, "Engine Parameters, Rapid"},
-    {127489, 1, 3, 1, 0, hnd_127489, "Engine Parameters, Dynamic"},
+    {127488, 0, 0, 1, 0, hnd_codec, "Engine Parameters, Rapid"},
+    {127489, 1, 3, 1, 0, hnd_codec, "Engine Parameters, Dynamic"},
     {127493, 1, 3, 0, 0, hnd_127493, "Transmissions Parameters, Dynamic"},
     {127505, 1, 3, 0, 0, hnd_127505, "Fluid "},
     {127237, 0, 0, 0, 0, hnd_127237, "Heading/Track Control"},
-    {127245, 0, 4, 1, 0, hnd_127245, "NAV Rudder"},
-    {127250, 0, 4, 1, 1, hnd_127250, "NAV Vessel Heading"},
-    {127257, 0, 0, 1, 0, hnd_127257, "Attitude"},
-    {127251, 0, 0, 1, 0, hnd_127251, "Rate of Turn"},
+    {127245, 0, 4, 1, 0, hnd_codec, "NAV Rudder"},
+    {127250, 0, 4, 1, 1, hnd_codec, "NAV Vessel Heading"},
+    {127257, 0, 0, 1, 0, hnd_codec, "Attitude"},
+    {127251, 0, 0, 1, 0, hnd_codec, "Rate of Turn"},
     {127258, 0, 0, 1, 0, hnd_127258, "GNSS Magnetic Variation"},
-    {128259, 0, 4, 1, 0, hnd_128259, "NAV Speed"},
-    {128267, 0, 4, 1, 0, hnd_128267, "NAV Water Depth"},
+    {128259, 0, 4, 1, 0, hnd_codec, "NAV Speed"},
+    {128267, 0, 4, 1, 0, hnd_codec, "NAV Water Depth"},
     {128275, 1, 4, 1, 0, hnd_128275, "NAV Distance Log"},
     {129033, 1, 1, 0, 1, hnd_129033, "Time & Date"},
     {129283, 0, 0, 1, 0, hnd_129283, "NAV Cross Track Error"},
     {129284, 1, 0, 0, 0, hnd_129284, "NAV Navigation Data"},
     {129285, 1, 0, 0, 0, hnd_129285, "NAV Navigation - Route/WP Information"},
     {129291, 0, 0, 0, 0, hnd_129291, "NAV Set & Drift, Rapid Update"},
-    {130306, 0, 4, 1, 1, hnd_130306, "NAV Wind Data"},
-    {130310, 0, 4, 1, 0, hnd_130310, "NAV Water Temp., Outside Air Temp., Atmospheric Pressure"},
+    {130306, 0, 4, 1, 1, hnd_codec, "NAV Wind Data"},
+    {130310, 0, 4, 1, 0, hnd_codec, "NAV Water Temp., Outside Air Temp., Atmospheric Pressure"},
     {130311, 0, 4, 1, 0, hnd_130311, "NAV Temperature"},
     {130312, 0, 4, 1, 0, hnd_130312, "NAV Temperature"},
     {130824, 0, 0, 0, 0, hnd_130824, "Maretron: Annunciator"},
@@ -185,7 +184,6 @@ ssize_t vyspi_write_with_protocol(struct gps_device_t *session,
 
 // some functions from packet.c we only use here
 extern void packet_accept(struct gps_packet_t *lexer, int packet_type);
-extern void nextstate(struct gps_packet_t *lexer, unsigned char c);
 extern void character_discard(struct gps_packet_t *lexer);
 
 extern gps_mask_t seatalk_parse_input(struct gps_device_t *session);
@@ -200,10 +198,6 @@ extern bool aivdm_decode(const char *buf, size_t buflen,
 static void print_data(struct gps_context_t *context,
                        unsigned char *buffer, int len, struct PGN *pgn);
 
-
-// from driver_seatalk.c
-extern void character_skip(struct gps_packet_t *lexer);
-
 int vy_port_list_read(struct gps_device_t *session, struct devconfig_t * dev);
 int vy_port2cmd(struct device_port_t * vy, uint8_t *cmd);
 
@@ -219,7 +213,7 @@ static void print_data(struct gps_context_t *context,
 {
 #ifdef LIBGPS_DEBUG
     /*@-bufferoverflowhigh@*/
-    if ((libgps_debuglevel >= LOG_IO) != 0) {
+    if (libgps_debuglevel >= LOG_IO && gpsd_log_wanted(context->debug, LOG_IO)) {
         int   l1, l2, ptr;
         char  bu[128];
 
@@ -228,7 +222,7 @@ static void print_data(struct gps_context_t *context,
         ptr += l2;
         for (l1=0;l1<len;l1++) {
             if (((l1 % 20) == 0) && (l1 != 0)) {
-                gpsd_report(context->debug, LOG_IO,"%s\n", bu);
+                GPSD_LOG(context->debug, LOG_IO,"%s\n", bu);
                 ptr = 0;
                 l2 = sprintf(&bu[ptr], "                   : ");
                 ptr += l2;
@@ -236,7 +230,7 @@ static void print_data(struct gps_context_t *context,
             l2 = sprintf(&bu[ptr], "0x%02x ", (unsigned int)buffer[l1]);
             ptr += l2;
         }
-        gpsd_report(context->debug, LOG_IO,"%s\n", bu);
+        GPSD_LOG(context->debug, LOG_IO,"%s\n", bu);
     }
     /*@+bufferoverflowhigh@*/
 #endif
@@ -268,17 +262,17 @@ static int vy_decode_ais_header(struct gps_device_t *device,
         ais->mmsi  &= mask;
         if(ais->mmsi == device->gpsdata.own_mmsi)
             ais->own_mmsi = 1;
-        gpsd_report(device->context->debug, LOG_INF,
-                    "VY:NMEA2000 AIS message type %u, own MMSI %09u, %s MMSI %09u:\n",
-                    ais->type, device->gpsdata.own_mmsi, ais->own_mmsi?"own":"", ais->mmsi);
+        GPSD_LOG(device->context->debug, LOG_INF,
+                 "VY:NMEA2000 AIS message type %u, own MMSI %09u, %s MMSI %09u:\n",
+                 ais->type, device->gpsdata.own_mmsi, ais->own_mmsi?"own":"", ais->mmsi);
         return(1);
     } else {
         ais->type   =  0;
         ais->repeat =  0;
         ais->mmsi   =  0;
-        gpsd_report(device->context->debug, LOG_ERROR,
-                    "VY:NMEA2000 AIS message type %u, too short message.\n",
-                    ais->type);
+        GPSD_LOG(device->context->debug, LOG_ERROR,
+                 "VY:NMEA2000 AIS message type %u, too short message.\n",
+                 ais->type);
     }
     return(0);
 }
@@ -349,10 +343,10 @@ static gps_mask_t hnd_059392(unsigned char *bu, int len, struct PGN *pgn, struct
   */
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO Ack\n");
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO Ack\n");
     return(0);
 }
 
@@ -376,8 +370,8 @@ static uint16_t crt_059904(uint8_t bufp[], size_t len,
     set8leu16(bufp, (uint16_t)(pgn & 0xffff), 7);
     set8leu8(bufp, (uint8_t)((pgn >> 16) & 0xffff), 7 + 2);
 
-    gpsd_report(session->context->debug, LOG_DATA,
-                "creating pgn %6u requesting pgn %u:\n", 59904, pgn);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "creating pgn %6u requesting pgn %u:\n", 59904, pgn);
 
     return 8+7;
 }
@@ -413,9 +407,9 @@ static void vyspi_send_product_information(struct gps_device_t *session) {
     // using protocol version 1
     vyspi_write_with_protocol(session, FRM_TYPE_NMEA2000, bu, 134 + 7, 1);
 
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - sent product information from src= %u\n",
-                session->driver.nmea2000.own_src_id);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - sent product information from src= %u\n",
+             session->driver.nmea2000.own_src_id);
 }
 
 static void vyspi_send_pgn_list(struct gps_device_t *session) {
@@ -455,9 +449,9 @@ static void vyspi_send_pgn_list(struct gps_device_t *session) {
         print_data(session->context, bu, 8+l2*3, &pgn);
     }
 
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - sent receive & transmit list from src= %u\n",
-                session->driver.nmea2000.own_src_id);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - sent receive & transmit list from src= %u\n",
+             session->driver.nmea2000.own_src_id);
 }
 
 /**
@@ -468,10 +462,10 @@ static gps_mask_t hnd_059904(unsigned char *bu, int len UNUSED, struct PGN *pgn,
     uint32_t request_pgn =
         (uint32_t)( (uint16_t)getleu16(bu, 0) | ((uint16_t)(bu[2]) << 16));
 
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - PGN requested= %u\n", request_pgn);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - PGN requested= %u\n", request_pgn);
 
     if((session->driver.vyspi.dest == 0xff)
        || (session->driver.vyspi.dest == session->driver.nmea2000.own_src_id)) {
@@ -507,9 +501,9 @@ static void vyspi_claim_our_source_addr(struct gps_device_t *session)
         // using protocol version 1
         vyspi_write_with_protocol(session, FRM_TYPE_NMEA2000, cmd, len, 1);
 
-        gpsd_report(session->context->debug, LOG_IO,
+        GPSD_LOG(session->context->debug, LOG_IO,
                 "                   NMEA 2000 ISO - claimed source src= %u\n",
-                    session->driver.nmea2000.own_src_id);
+                 session->driver.nmea2000.own_src_id);
 
         // nothing more to do here
         // - if other nodes "complains" it will send address claims and we'll just react to that
@@ -534,8 +528,8 @@ static void vyspi_addr_claim_call(struct gps_device_t *session)
                      60928,
                      session);
 
-    gpsd_report(session->context->debug, LOG_INF,
-                "NMEA 2000 ISO - making an address claim call.\n");
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "NMEA 2000 ISO - making an address claim call.\n");
 
     // using protocol version 1
     vyspi_write_with_protocol(session, FRM_TYPE_NMEA2000, cmd, len, 1);
@@ -563,18 +557,18 @@ static void vyspi_claim_free_source_addr(struct gps_device_t *session)
             uint16_t manu   = (ecu >> 21) & 0x7ff;
 
             if(ecu != 0)
-                gpsd_report(session->context->debug, LOG_INF,
-                            "Search free src addr: 0x%02x in use by %u:%u\n", e, manu, uniq);
+                GPSD_LOG(session->context->debug, LOG_INF,
+                         "Search free src addr: 0x%02x in use by %u:%u\n", e, manu, uniq);
             else
-                gpsd_report(session->context->debug, LOG_INF,
-                            "Search free src addr: 0x%02x in use by unkown device\n", e);
+                GPSD_LOG(session->context->debug, LOG_INF,
+                         "Search free src addr: 0x%02x in use by unkown device\n", e);
 
         }
     }
 
-    gpsd_report(session->context->debug, LOG_INF,
-                "Claim (new) source address %u.\n",
-                session->driver.nmea2000.own_src_id);
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "Claim (new) source address %u.\n",
+             session->driver.nmea2000.own_src_id);
 
     if(session->driver.nmea2000.own_src_id < 240) {
         vyspi_claim_our_source_addr(session);
@@ -613,8 +607,8 @@ static uint16_t crt_060928(uint8_t bufp[], size_t len,
 
     set8leu64(bufp, ECU_name, 7);
 
-    gpsd_report(session->context->debug, LOG_DATA,
-                "creating pgn %6d with ecu name %lu:\n", 60928, ECU_name);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "creating pgn %6d with ecu name %lu:\n", 60928, ECU_name);
 
     return 8+7;
 }
@@ -658,18 +652,18 @@ static gps_mask_t hnd_060928(unsigned char *bu, int len, struct PGN *pgn, struct
     dc     = (getub(bu, 6) >> 1) & 0x7F;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - Id= %u, Manufacturer= %u, Industry Group = %u, "
-                "Device Class = %u, "
-                "Device Instance Lower = %u, "
-                "Device Instance Upper = %u, "
-                "Device Function = %u\n",
-                uniq,
-                manu,
-                grp, dc, ilo, ihi, bu[5]);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - Id= %u, Manufacturer= %u, Industry Group = %u, "
+             "Device Class = %u, "
+             "Device Instance Lower = %u, "
+             "Device Instance Upper = %u, "
+             "Device Function = %u\n",
+             uniq,
+             manu,
+             grp, dc, ilo, ihi, bu[5]);
 
     if(session->gpsdata.dev.protocol_version) {
         // record that we have seen this source address with this ecu name
@@ -679,9 +673,9 @@ static gps_mask_t hnd_060928(unsigned char *bu, int len, struct PGN *pgn, struct
 
     if(session->driver.nmea2000.own_src_id == session->driver.vyspi.src) {
 
-        gpsd_report(session->context->debug, LOG_INF,
-                    "NMEA 2000 ISO - source address 0x%02x claims our own source address.\n",
-                    session->driver.nmea2000.own_src_id);
+        GPSD_LOG(session->context->debug, LOG_INF,
+                 "NMEA 2000 ISO - source address 0x%02x claims our own source address.\n",
+                 session->driver.nmea2000.own_src_id);
 
         // someone claims our source address
         uint64_t our_ecu_name;
@@ -689,13 +683,13 @@ static gps_mask_t hnd_060928(unsigned char *bu, int len, struct PGN *pgn, struct
 
         // lower wins, then claim a new one if we are higer
         if(ECU_name < our_ecu_name) {
-            gpsd_report(session->context->debug, LOG_INF,
-                        "NMEA 2000 ecu name higher, we loose.\n");
+            GPSD_LOG(session->context->debug, LOG_INF,
+                     "NMEA 2000 ecu name higher, we loose.\n");
             // all info should be collected already
             vyspi_claim_free_source_addr(session);
         } else {
-            gpsd_report(session->context->debug, LOG_INF,
-                        "NMEA 2000 ecu name higher, we win.\n");
+            GPSD_LOG(session->context->debug, LOG_INF,
+                     "NMEA 2000 ecu name higher, we win.\n");
             // reclaim our so that other node knows
             vyspi_claim_our_source_addr(session);
         }
@@ -711,10 +705,10 @@ static gps_mask_t hnd_060928(unsigned char *bu, int len, struct PGN *pgn, struct
 static gps_mask_t hnd_126208(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-                "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - Commandd/Request/Ack\n");
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - Commandd/Request/Ack\n");
     return(0);
 }
 
@@ -726,26 +720,26 @@ static gps_mask_t hnd_126464(unsigned char *bu, int len, struct PGN *pgn, struct
     int i = 0;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if(session->context->debug >= LOG_IO) {
-        gpsd_report(session->context->debug, LOG_IO,
-                    "                   NMEA 2000 ISO - Transmit/Receive PGN List\n");
+        GPSD_LOG(session->context->debug, LOG_IO,
+                 "                   NMEA 2000 ISO - Transmit/Receive PGN List\n");
 
         if(bu[0] == 0) {
-            gpsd_report(session->context->debug, LOG_IO,
-                        "                   NMEA 2000 ISO - Transmit\n");
+            GPSD_LOG(session->context->debug, LOG_IO,
+                     "                   NMEA 2000 ISO - Transmit\n");
         } else {
-            gpsd_report(session->context->debug, LOG_IO,
-                        "                   NMEA 2000 ISO - Receive\n");
+            GPSD_LOG(session->context->debug, LOG_IO,
+                     "                   NMEA 2000 ISO - Receive\n");
         }
 
         // staring at 0 as we need last 3 of 4 bytes read starting at 1
         for(i = 1; i < len; i+= 3) {
             uint32_t p = getleu24(bu, i);
-            gpsd_report(session->context->debug, LOG_IO,
-                        "                   [%u] %u\n", i, p);
+            GPSD_LOG(session->context->debug, LOG_IO,
+                     "                   [%u] %u\n", i, p);
         }
     }
 
@@ -779,58 +773,29 @@ static gps_mask_t hnd_126996(unsigned char *bu, int len, struct PGN *pgn, struct
     memcpy(model_version, bu + 68, 32);
     memcpy(model_serial_code, bu + 100, 32);
 
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   NMEA 2000 ISO - Product Information\n");
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   n2k version= %u, product code= %u\n",
-                n2k_version, prod_code);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   cert level= %u, load= %u\n",
-                cert_level, load_equivalency);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   model id          = %s\n", model_id);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   software version  = %s\n", software_version);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   model version     = %s\n", model_version);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   model serial code = %s\n", model_serial_code);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   NMEA 2000 ISO - Product Information\n");
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   n2k version= %u, product code= %u\n",
+             n2k_version, prod_code);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   cert level= %u, load= %u\n",
+             cert_level, load_equivalency);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   model id          = %s\n", model_id);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   software version  = %s\n", software_version);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   model version     = %s\n", model_version);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   model serial code = %s\n", model_serial_code);
 
     return(0);
 }
 
 
-static gps_mask_t setles8value(unsigned char * bu, int pos, gps_mask_t set, gps_mask_t pset, double factor,
-                          double * dest_val, gps_mask_t * dest_set) {
-
-    gps_mask_t mask = 0;
-    int8_t val = (int8_t)bu[pos];
-
-    if(val != 0x7f) {
-        *dest_val = val*factor;
-        *dest_set |= pset;
-        mask = set;
-    }
-
-    return mask;
-}
-
-
-static gps_mask_t setleu8value(unsigned char * bu, int pos, gps_mask_t set, gps_mask_t pset, double factor,
-                         double * dest_val, gps_mask_t * dest_set) {
-
-    gps_mask_t mask = 0;
-    uint8_t val = (uint8_t)bu[pos];
-    if(val != 0xff) {
-        *dest_val = val*factor;
-        *dest_set |= pset;
-        mask = set;
-    }
-    return mask;
-}
-
 static gps_mask_t setleu16value(unsigned char * bu, int pos, gps_mask_t set, gps_mask_t pset, double factor,
                           double * dest_val, gps_mask_t * dest_set) {
 
@@ -883,148 +848,50 @@ static gps_mask_t setles32value(unsigned char * bu, int pos, gps_mask_t set, gps
     return mask;
 }
 
-/*
- *   PGN 127488: Engine Parameter Rapid Update
+/**
+ *   \PGN 127245: NAV Rudder
+ *
+ *   \PGN 127250: NAV Vessel Heading
+ *
+ *   \PGN 127251: Rate of Turn
+ *
+ *   \PGN 127257: Attitude
+ *
+ *   \PGN 127488: Engine Parameter Rapid Update
+ *
+ *   \PGN 127489: Engine Parameter Dynamic
+ *
+ *   \PGN 128259: NAV Speed
+ *
+ *   \PGN 128267: NAV Water Depth
+ *
+ *   \PGN 130306: NAV Wind Data
+ *
+ *   \PGN 130310: NAV Water Temp., Outside Air Temp., Atmospheric Pressure
+ *
+ *   are described in n2kpgns.json, see n2kcodec.h
  */
-static gps_mask_t hnd_127488(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
+static gps_mask_t hnd_codec(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
-  /* [17]
-    1   0   uint8  Engine instance
-    2 1-2   uint16 RPM (x .25 RPM)
-    3 3-4   uint16 Boost Pressure (100Pa)
-    4   6   sint8  Engine Tilt/Trim (+/- 1%)
-    5 6-7   uint16 Reserved Bits
-   */
-
-    gps_mask_t pset = 0;
-    gps_mask_t mask = 0;
-    uint8_t instance  = bu[0];
-
-    if(instance == 0)
-        pset = ENG_PORT_PSET;
-    else if(instance == 1)
-        pset = ENG_STARBOARD_PSET;
-    else {
-        gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d): unkown engine instance %d\n",
-                    pgn->pgn, session->driver.nmea2000.unit, instance);
-        return 0;
-    }
-
-    mask |= setleu16value(bu, 1, ENGINE_SET, pset | ENG_SPEED_PSET, 0.25,
-                  &session->gpsdata.engine.instance[instance].speed, &session->gpsdata.engine.set);
-
-    mask |= setleu16value(bu, 3, ENGINE_SET, pset | ENG_BOOST_PRESSURE_PSET, 100.0,
-                  &session->gpsdata.engine.instance[instance].boost_pressure, &session->gpsdata.engine.set);
-
-    mask |= setleu8value(bu, 6, ENGINE_SET, pset | ENG_TILT_PSET, 1,
-                  &session->gpsdata.engine.instance[instance].tilt, &session->gpsdata.engine.set);
+    const struct n2k_codec_t *codec = n2k_codec_find(pgn->pgn);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n",
-                pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO, "instance= %s, speed= %0.2f rpm, boost pres= %0.2f, tilt= %0.2f\n",
-                instance?"starboard":"single/port",
-                session->gpsdata.engine.instance[instance].speed,
-                session->gpsdata.engine.instance[instance].boost_pressure,
-                session->gpsdata.engine.instance[instance].tilt);
-
-    if(mask > 0)
-        return ONLINE_SET | mask;
-
-    return 0;
-}
-
-/*
- *   PGN 127489: Engine Parameter Dynamic
- */
-static gps_mask_t hnd_127489(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /* [17]
-    1      0           uint8    Engine Instance  (port, starboard, forward, etc.)
-    2   1- 2           uint16   Engine Oil Pressure (100Pa)
-    3   3- 4           uint16   Engine Oil Temperature (0.1K)
-    4   5- 6           uint16   Engine Temperature (0.01K)
-    5   7- 8           sint16   Alternator potential (0.01V)
-    6   9-10           sint16   Fuel rate (cm³ / hour)
-    7  11-14           uint32   Total engine hours (1sec)
-    8  15-16           uint16   Engine coolant pressure (100Pa)
-    9  17-18           uint16   Fuel Pressure (1000Pa)
-    10    19           uint8    Not Available
-    11    20 bits 0-7  bits     Engine Discrete Status 1
-    12    21 bits 0-7  bits     Engine Discrete Status 2
-    13    22           sint8    Percent Engine Load (1%)
-    14    23           sint8    Percent Engine Torque (1%)
-   */
-
-    gps_mask_t pset = 0;
-    gps_mask_t mask = 0;
-    uint8_t instance  = bu[0];
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
-    if(instance == 0)
-        pset = ENG_PORT_PSET;
-    else if(instance == 1)
-        pset = ENG_STARBOARD_PSET;
-    else
+    if (codec == NULL)
         return 0;
-
-    mask |= setleu16value(bu, 1, ENGINE_SET, pset | ENG_OIL_PRESSURE_PSET, 100.0,
-                  &session->gpsdata.engine.instance[instance].oil_pressure, &session->gpsdata.engine.set);
-    mask |= setleu16value(bu, 3, ENGINE_SET, pset | ENG_OIL_TEMPERATURE_PSET, 0.1,
-                  &session->gpsdata.engine.instance[instance].oil_temperature, &session->gpsdata.engine.set);
-    mask |= setleu16value(bu, 5, ENGINE_SET, pset | ENG_TEMPERATURE_PSET, 0.01,
-                  &session->gpsdata.engine.instance[instance].temperature, &session->gpsdata.engine.set);
-    mask |= setleu16value(bu, 7, ENGINE_SET, pset | ENG_ALTERNATOR_VOLTAGE_PSET, 0.01,
-                  &session->gpsdata.engine.instance[instance].alternator_voltage, &session->gpsdata.engine.set);
-
-    mask |= setleu16value(bu, 9, ENGINE_SET, pset | ENG_FUEL_RATE_PSET, 1000,
-                  &session->gpsdata.engine.instance[instance].fuel_rate, &session->gpsdata.engine.set);
-    mask |= setleu32value(bu, 11, ENGINE_SET, pset | ENG_TOTAL_HOURS_PSET, 1.0,
-                  &session->gpsdata.engine.instance[instance].total_hours, &session->gpsdata.engine.set);
-    mask |= setleu16value(bu, 15, ENGINE_SET, pset | ENG_COOLANT_PRESSURE_PSET, 1000.0,
-                  &session->gpsdata.engine.instance[instance].coolant_pressure, &session->gpsdata.engine.set);
-    mask |= setleu16value(bu, 17, ENGINE_SET, pset | ENG_FUEL_PRESSURE_PSET, 0.01,
-                  &session->gpsdata.engine.instance[instance].fuel_pressure, &session->gpsdata.engine.set);
-
-    // TODO - descrete statuses
-
-    mask |= setles8value(bu, 22, ENGINE_SET, pset | ENG_TORQUE_PSET, 0.01,
-                 &session->gpsdata.engine.instance[instance].torque, &session->gpsdata.engine.set);
-    mask |= setles8value(bu, 23, ENGINE_SET, pset | ENG_LOAD_PSET, 0.01,
-                 &session->gpsdata.engine.instance[instance].load, &session->gpsdata.engine.set);
-
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO, "instance= %s, oil pres= %0.2f, oil temp= %0.2f, temp= %0.2f (%04x)\n",
-                instance?"starboard":"single/port",
-                session->gpsdata.engine.instance[instance].oil_pressure,
-                session->gpsdata.engine.instance[instance].oil_temperature - 273.15,
-                session->gpsdata.engine.instance[instance].temperature - 273.15,
-                getleu16(bu, 5));
-    gpsd_report(session->context->debug, LOG_IO, "volt= %0.2fV, fule rate= %0.2fL/h, run time= %0.2fsecs, coolant pres= %0.2f\n",
-                session->gpsdata.engine.instance[instance].alternator_voltage,
-                session->gpsdata.engine.instance[instance].fuel_rate,
-                session->gpsdata.engine.instance[instance].total_hours,
-                session->gpsdata.engine.instance[instance].coolant_pressure);
-    gpsd_report(session->context->debug, LOG_IO, "fuel press= %0.2fpa, torque= %0.2f%%, load= %0.2f%%\n",
-                session->gpsdata.engine.instance[instance].fuel_pressure,
-                session->gpsdata.engine.instance[instance].torque,
-                session->gpsdata.engine.instance[instance].load);
-
-
-    if(mask > 0)
-        return ONLINE_SET | mask;
-    return 0;
+    return codec->decode(bu, len, &session->gpsdata);
 }
 
+
 /*
  *   PGN 127493: Transmission Parameters, Dynamic
  */
 static gps_mask_t hnd_127493(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
@@ -1042,65 +909,10 @@ static gps_mask_t hnd_127505(unsigned char *bu, int len, struct PGN *pgn, struct
     */
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
-/*
- *   PGN 127257: Attitude
- */
-static gps_mask_t hnd_127257(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /* [8] The SSC200 uses this PGN to indicate the vessel’s attitude (pitch and roll). The Yaw (field 2) is not used, therefore this field always contains 0x7FFF (data not available).
-
-           1:  SID – The sequence identifier field is used to tie related PGNs together. For example, the SSC200 will transmit identical SIDs for Vessel Heading (PGN 127250), Attitude (127257), and Rate of Turn (127251) to indicate that the readings are linked together (i.e., the data from each PGN was taken at the same time although they are reported at slightly different times).
-
-           2:  Yaw – This field always contains a value of 0x7FFF (data not available).
-
-           3:  Pitch – This field is used to report the vessel’s pitch.
-
-           4:  Roll – This field is used to report the vessel’s roll.
-
-           5:  Reserved – This field is reserved by NMEA; therefore, the SSC200 sets all bits to a logic 1.
-  */
-    gps_mask_t mask = 0;
-    uint8_t sid    = bu[0];
-
-    // testing with a67
-    int16_t yaw   = getles16(bu, 1);
-    int16_t pitch = getles16(bu, 3);
-    int16_t roll  = getles16(bu, 5);
-
-    if(yaw == 0x7fff) {
-      session->gpsdata.attitude.yaw = NAN;
-    } else
-      session->gpsdata.attitude.yaw = yaw * 0.0001 * RAD_2_DEG;
-
-    if(roll == 0x7fff) {
-      session->gpsdata.attitude.roll = NAN;
-    } else
-      session->gpsdata.attitude.roll = roll * 0.0001 * RAD_2_DEG;
-
-    if(pitch == 0x7fff) {
-      session->gpsdata.attitude.pitch = NAN;
-    } else
-      session->gpsdata.attitude.pitch = pitch * 0.0001 * RAD_2_DEG;
-
-    mask |= (ONLINE_SET | ATTITUDE_SET);
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-                "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   SID= %u, yaw=%f, roll=%f, pitch= %f\n",
-                sid,
-                (session->gpsdata.attitude.yaw==NAN?0:session->gpsdata.attitude.yaw),
-                (session->gpsdata.attitude.yaw==NAN?0:session->gpsdata.attitude.roll),
-                (session->gpsdata.attitude.yaw==NAN?0:session->gpsdata.attitude.pitch));
-
-    return mask;
-}
 
 /*
  *   PGN 127258: GNSS Magnetic Variation
@@ -1136,20 +948,20 @@ static gps_mask_t hnd_127258(unsigned char *bu, int len, struct PGN *pgn, struct
     reserved2       = getleu16(bu, 6);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID= %u, Variation Source= %u, Reserved Bits= %u\n",
-		sid,
-		src,
-		reserved1);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID= %u, Variation Source= %u, Reserved Bits= %u\n",
+             sid,
+             src,
+             reserved1);
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Age of Service (Date)= %u, Variation= %f, Reserved Bits= 0x%04x\n",
-		age,
-		var,
-		reserved2);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Age of Service (Date)= %u, Variation= %f, Reserved Bits= 0x%04x\n",
+             age,
+             var,
+             reserved2);
 
     return(0);
 }
@@ -1168,8 +980,8 @@ static gps_mask_t hnd_129025(unsigned char *bu, int len, struct PGN *pgn, struct
     lon = getles32(bu, 4);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if((lat != 0x7fffffff) && (lon != 0x7fffffff)) {
       /*@-type@*//* splint has a bug here */
@@ -1181,10 +993,10 @@ static gps_mask_t hnd_129025(unsigned char *bu, int len, struct PGN *pgn, struct
 
     (void)strlcpy(session->gpsdata.tag, "129025", sizeof(session->gpsdata.tag));
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   lat = %f, lon = %f\n",
-		(lat != 0x7fffffff)?session->newdata.latitude:NAN,
-		(lon != 0x7fffffff)?session->newdata.longitude:NAN);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   lat = %f, lon = %f\n",
+             (lat != 0x7fffffff)?session->newdata.latitude:NAN,
+             (lon != 0x7fffffff)?session->newdata.longitude:NAN);
 
     return mask;
 }
@@ -1205,8 +1017,8 @@ static gps_mask_t hnd_129026(unsigned char *bu, int len, struct PGN *pgn, struct
     gps_mask_t mask = 0;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     session->driver.nmea2000.sid[0]  =  bu[0];
 
@@ -1241,13 +1053,13 @@ static gps_mask_t hnd_129026(unsigned char *bu, int len, struct PGN *pgn, struct
 
     (void)strlcpy(session->gpsdata.tag, "129026", sizeof(session->gpsdata.tag));
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID= %u, cog ref= %s, track= %.2f deg, speed= %.2f m/s; %.2f knots\n",
-		session->driver.nmea2000.sid[0],
-		(COG_Reference == 0) ? "True" : "Magnetic",
-		(track != 0xffff)?session->gpsdata.navigation.course_over_ground[f] : 0.0,
-		(speed != 0xffff)?session->gpsdata.navigation.speed_over_ground * KNOTS_TO_MPS : 0.0,
-		(speed != 0xffff)?session->gpsdata.navigation.speed_over_ground : 0.0);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID= %u, cog ref= %s, track= %.2f deg, speed= %.2f m/s; %.2f knots\n",
+             session->driver.nmea2000.sid[0],
+             (COG_Reference == 0) ? "True" : "Magnetic",
+             (track != 0xffff)?session->gpsdata.navigation.course_over_ground[f] : 0.0,
+             (speed != 0xffff)?session->gpsdata.navigation.speed_over_ground * KNOTS_TO_MPS : 0.0,
+             (speed != 0xffff)?session->gpsdata.navigation.speed_over_ground : 0.0);
 
     return mask;
 }
@@ -1267,8 +1079,8 @@ static gps_mask_t hnd_129029(unsigned char *bu, int len, struct PGN *pgn, struct
 
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     mask                             = 0;
     session->driver.nmea2000.sid[3]  = bu[0];
@@ -1353,21 +1165,21 @@ static gps_mask_t hnd_129029(unsigned char *bu, int len, struct PGN *pgn, struct
 
     char times[JSON_DATE_MAX + 1];
     unix_to_iso8601(session->newdata.time, times, sizeof(times));
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %u, time = %s, lat = %f, lon = %f, alt = %f\n",
-		session->driver.nmea2000.sid[3],
-		times,
-		session->newdata.latitude,
-		session->newdata.longitude,
-		session->newdata.altitude + session->gpsdata.separation);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   status = %d, sep = %f, sats = %d, hdop = %f, pdop = %f, mode=%u\n",
-		session->gpsdata.status,
-		session->gpsdata.separation,
-		session->gpsdata.satellites_used,
-		session->gpsdata.dop.hdop,
-		session->gpsdata.dop.pdop,
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID = %u, time = %s, lat = %f, lon = %f, alt = %f\n",
+             session->driver.nmea2000.sid[3],
+             times,
+             session->newdata.latitude,
+             session->newdata.longitude,
+             session->newdata.altitude + session->gpsdata.separation);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   status = %d, sep = %f, sats = %d, hdop = %f, pdop = %f, mode=%u\n",
+             session->gpsdata.status,
+             session->gpsdata.separation,
+             session->gpsdata.satellites_used,
+             session->gpsdata.dop.hdop,
+             session->gpsdata.dop.pdop,
         session->driver.nmea2000.mode);
 
     return mask | get_mode(session);
@@ -1385,8 +1197,8 @@ static gps_mask_t hnd_126992(unsigned char *bu, int len, struct PGN *pgn, struct
     //    uint8_t        reserved; // [7] 4 bits
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     sid        = bu[0];
     source     = (bu[1] >> 0) & 0x0f;
@@ -1399,11 +1211,11 @@ static gps_mask_t hnd_126992(unsigned char *bu, int len, struct PGN *pgn, struct
     char tbuf[JSON_DATE_MAX + 1];
     unix_to_iso8601(session->newdata.time, tbuf, sizeof(tbuf));
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %u, source = %u, time = %s\n",
-		sid,
-		source,
-		tbuf);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID = %u, source = %u, time = %s\n",
+             sid,
+             source,
+             tbuf);
 
     (void)strlcpy(session->gpsdata.tag, "126992", sizeof(session->gpsdata.tag));
 
@@ -1436,8 +1248,8 @@ static gps_mask_t hnd_129539(unsigned char *bu, int len, struct PGN *pgn, struct
     int16_t hdop, vdop, tdop;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     mask                             = 0;
     session->driver.nmea2000.sid[1]  = bu[0];
@@ -1473,14 +1285,14 @@ static gps_mask_t hnd_129539(unsigned char *bu, int len, struct PGN *pgn, struct
     }
     /*@+type@*/
 
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID:%02x hdop:%5.2f vdop:%5.2f tdop:%5.2f mode:%u\n",
-		session->driver.nmea2000.sid[1],
-		session->gpsdata.dop.hdop,
-		session->gpsdata.dop.vdop,
-		session->gpsdata.dop.tdop,
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID:%02x hdop:%5.2f vdop:%5.2f tdop:%5.2f mode:%u\n",
+             session->driver.nmea2000.sid[1],
+             session->gpsdata.dop.hdop,
+             session->gpsdata.dop.vdop,
+             session->gpsdata.dop.tdop,
         session->driver.nmea2000.mode);
 
     (void)strlcpy(session->gpsdata.tag, "129539", sizeof(session->gpsdata.tag));
@@ -1536,8 +1348,8 @@ static gps_mask_t hnd_129540(unsigned char *bu, int len, struct PGN *pgn, struct
     int         l1, l2;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     session->driver.nmea2000.sid[2]           = bu[0];
     session->gpsdata.satellites_visible       = (int)bu[2];
@@ -1546,10 +1358,10 @@ static gps_mask_t hnd_129540(unsigned char *bu, int len, struct PGN *pgn, struct
         session->gpsdata.used[l2] = 0;
     }
 
-   gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d): satellites visible: %d\n",
-               pgn->pgn, session->driver.nmea2000.unit,
-               session->gpsdata.satellites_visible);
+   GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d): satellites visible: %d\n",
+            pgn->pgn, session->driver.nmea2000.unit,
+            session->gpsdata.satellites_visible);
 
     l2 = 0;
     for (l1=0; l1 < session->gpsdata.satellites_visible; l1++) {
@@ -1611,8 +1423,8 @@ static gps_mask_t hnd_129541(unsigned char *bu, int len, struct PGN *pgn, struct
     */
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return 0;
 }
 
@@ -1634,17 +1446,17 @@ static gps_mask_t hnd_129033(unsigned char *bu, int len, struct PGN *pgn, struct
     ts = date * 24*60*60 + time/1e4;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     char times[JSON_DATE_MAX + 1];
     unix_to_iso8601(ts, times, sizeof(times));
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   date = %u, time = %u, ts= %s, offset = %u\n",
-		date,
-		time,
-		times,
-		offset);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   date = %u, time = %u, ts= %s, offset = %u\n",
+             date,
+             time,
+             times,
+             offset);
     return mask;
 }
 
@@ -1662,8 +1474,8 @@ static gps_mask_t hnd_129038(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"vy pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "vy pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
 
@@ -1676,16 +1488,16 @@ static gps_mask_t hnd_129038(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type1.lon = (int)(lon * 0.06);
         } else {
             ais->type1.lon = AIS_LON_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LON \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LON \n");
         }
 
         if(lat != 0x7fffffff) {
             ais->type1.lat = (int)(lat * 0.06);
         } else {
             ais->type1.lat = AIS_LAT_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LAT \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LAT \n");
         }
 
 	ais->type1.accuracy  = (bool)         ((bu[13] >> 0) & 0x01);
@@ -1701,8 +1513,8 @@ static gps_mask_t hnd_129038(unsigned char *bu, int len, struct PGN *pgn, struct
     }
     else {
         ais->type1.speed     = AIS_SPEED_NOT_AVAILABLE;
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "NOT AVAILABLE: SPEED \n");
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "NOT AVAILABLE: SPEED \n");
     }
 
 	ais->type1.radio     = (unsigned int) (getleu32(bu, 18) & 0x7ffff);
@@ -1714,23 +1526,23 @@ static gps_mask_t hnd_129038(unsigned char *bu, int len, struct PGN *pgn, struct
 	vy_decode_ais_channel_info(bu, len, 163, session);
 
     if(ais->type1.heading == AIS_HEADING_NOT_AVAILABLE) {
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "NOT AVAILABLE: HEADING \n");
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "NOT AVAILABLE: HEADING \n");
     }
     if(ais->type1.course == AIS_COURSE_NOT_AVAILABLE) {
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "NOT AVAILABLE: COURSE \n");
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "NOT AVAILABLE: COURSE \n");
     }
     if(ais->type1.turn == AIS_TURN_NOT_AVAILABLE) {
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "NOT AVAILABLE: TURN \n");
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "NOT AVAILABLE: TURN \n");
     }
 
     channel = 'A';
     if (session->driver.aivdm.ais_channel == 'B') {
         channel = 'B';
     }
-	gpsd_report(session->context->debug, LOG_IO,
+	GPSD_LOG(session->context->debug, LOG_IO,
                 "                 CLASS %c: lon = %f, lat = %f, course = %u, speed = %u, hdg= %u, turn=%d\n",
                 channel,
                 ais->type1.lon / AIS_LATLON_DIV,
@@ -1758,8 +1570,8 @@ static gps_mask_t hnd_129039(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
 
@@ -1770,16 +1582,16 @@ static gps_mask_t hnd_129039(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type18.lon = (int)(lon * 0.06);
         } else {
             ais->type18.lon = AIS_GNS_LON_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LON \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LON \n");
         }
 
         if(lat != 0x7fffffff) {
             ais->type18.lat = (int)(lat * 0.06);
         } else {
             ais->type18.lat = AIS_GNS_LAT_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LAT \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LAT \n");
         }
 
         speed = getleu16(bu, 16);
@@ -1793,8 +1605,8 @@ static gps_mask_t hnd_129039(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type18.speed    = (unsigned int) (speed * MPS_TO_KNOTS * 0.01 / 0.1);
         } else {
             ais->type18.speed    = AIS_SPEED_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: SPEED\n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: SPEED\n");
         }
         ais->type18.radio    = (unsigned int) (getleu32(bu, 18) & 0x7ffff);
         ais->type18.heading  = (unsigned int)  vy_ais_direction((unsigned int) getleu16(bu, 21), 1.0);
@@ -1813,14 +1625,14 @@ static gps_mask_t hnd_129039(unsigned char *bu, int len, struct PGN *pgn, struct
         if (session->driver.aivdm.ais_channel == 'B') {
             channel = 'B';
         }
-        gpsd_report(session->context->debug, LOG_IO,
-                    "                  CLASS %c: lon = %f, lat = %f, course = %d, speed = %u, ch = %c\n",
-                    channel,
-                    ais->type18.lon / AIS_LATLON_DIV,
-                    ais->type18.lat / AIS_LATLON_DIV,
-                    ais->type18.course,
-                    ais->type18.speed,
-                    session->driver.aivdm.ais_channel);
+        GPSD_LOG(session->context->debug, LOG_IO,
+                 "                  CLASS %c: lon = %f, lat = %f, course = %d, speed = %u, ch = %c\n",
+                 channel,
+                 ais->type18.lon / AIS_LATLON_DIV,
+                 ais->type18.lat / AIS_LATLON_DIV,
+                 ais->type18.course,
+                 ais->type18.speed,
+                 session->driver.aivdm.ais_channel);
 
         return(ONLINE_SET | AIS_SET);
     }
@@ -1840,8 +1652,8 @@ static gps_mask_t hnd_129040(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
         uint16_t length, beam, to_bow, to_starboard;
@@ -1854,16 +1666,16 @@ static gps_mask_t hnd_129040(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type19.lon = (int)(lon * 0.06);
         } else {
             ais->type19.lon = AIS_GNS_LON_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LON \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LON \n");
         }
 
         if(lat != 0x7fffffff) {
             ais->type19.lat = (int)(lat * 0.06);
         } else {
             ais->type19.lat = AIS_GNS_LAT_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LAT \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LAT \n");
         }
 
         speed = getleu16(bu, 16);
@@ -1876,8 +1688,8 @@ static gps_mask_t hnd_129040(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type19.speed    = (unsigned int) (speed * MPS_TO_KNOTS * 0.01 / 0.1);
         } else {
             ais->type19.speed    = AIS_SPEED_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: SPEED\n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: SPEED\n");
         }
         ais->type19.reserved     = (unsigned int) ((bu[18] >> 0) & 0xff);
         ais->type19.regional     = (unsigned int) ((bu[19] >> 0) & 0x0f);
@@ -1924,8 +1736,8 @@ static gps_mask_t hnd_129793(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
     }
@@ -1941,8 +1753,8 @@ static gps_mask_t hnd_129794(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
         uint16_t  length, beam, to_bow, to_starboard, date;
@@ -2042,8 +1854,8 @@ static gps_mask_t hnd_129798(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
 
@@ -2056,16 +1868,16 @@ static gps_mask_t hnd_129798(unsigned char *bu, int len, struct PGN *pgn, struct
             ais->type9.lon = (int)(lon * 0.06);
         } else {
             ais->type9.lon = AIS_LON_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LON \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LON \n");
         }
 
         if(lat != 0x7fffffff) {
             ais->type9.lat = (int)(lat * 0.06);
         } else {
             ais->type9.lat = AIS_LAT_NOT_AVAILABLE;
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: LAT \n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: LAT \n");
         }
 
         ais->type9.accuracy  = (bool)         ((bu[13] >> 0) & 0x01);
@@ -2076,8 +1888,8 @@ static gps_mask_t hnd_129798(unsigned char *bu, int len, struct PGN *pgn, struct
         if(speed != 0xffff) {
             ais->type9.speed     = (unsigned int) (speed * MPS_TO_KNOTS * 0.01 / 0.1);
         } else {
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "NOT AVAILABLE: SPEED\n");
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "NOT AVAILABLE: SPEED\n");
             ais->type9.speed     = AIS_SAR_SPEED_NOT_AVAILABLE;
         }
         ais->type9.radio     = (unsigned int) (getleu32(bu, 18) & 0x7ffff);
@@ -2111,8 +1923,8 @@ static gps_mask_t hnd_129802(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0x3fffffff) != 0) {
         int                   l;
@@ -2139,8 +1951,8 @@ static gps_mask_t hnd_129809(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-                "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
         int                   l;
@@ -2160,9 +1972,9 @@ static gps_mask_t hnd_129809(unsigned char *bu, int len, struct PGN *pgn, struct
         index %= MAX_TYPE24_INTERLEAVE;
         session->driver.aivdm.context[0].type24_queue.index = index;
 
-        gpsd_report(session->context->debug, LOG_PROG,
-                    "NMEA2000: AIS message 24A from %09u stashed: %s.\n",
-                    ais->mmsi, saveptr->shipname);
+        GPSD_LOG(session->context->debug, LOG_PROG,
+                 "NMEA2000: AIS message 24A from %09u stashed: %s.\n",
+                 ais->mmsi, saveptr->shipname);
 
 
         vy_decode_ais_channel_info(bu, len, 200, session);
@@ -2183,8 +1995,8 @@ static gps_mask_t hnd_129810(unsigned char *bu, int len, struct PGN *pgn, struct
 
     ais =  &session->gpsdata.ais;
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if (vy_decode_ais_header(session, bu, len, ais, 0xffffffffU) != 0) {
         int l, i;
@@ -2222,9 +2034,9 @@ static gps_mask_t hnd_129810(unsigned char *bu, int len, struct PGN *pgn, struct
                 beam         = 0;
                 to_starboard = 0;
             }
-            gpsd_report(session->context->debug, LOG_DATA,
-                        "mmsi: %09u length: %u, beam: %u\n",
-                        ais->mmsi, length, beam);
+            GPSD_LOG(session->context->debug, LOG_DATA,
+                     "mmsi: %09u length: %u, beam: %u\n",
+                     ais->mmsi, length, beam);
         }
 
         for (i = 0; i < MAX_TYPE24_INTERLEAVE; i++) {
@@ -2234,23 +2046,23 @@ static gps_mask_t hnd_129810(unsigned char *bu, int len, struct PGN *pgn, struct
                 }
                 ais->type24.shipname[AIS_SHIPNAME_MAXLEN] = (char) 0;
 
-                gpsd_report(session->context->debug, LOG_PROG,
-                            "NMEA2000: AIS 24B from %09u matches a 24A.\n",
-                            ais->mmsi);
+                GPSD_LOG(session->context->debug, LOG_PROG,
+                         "NMEA2000: AIS 24B from %09u matches a 24A.\n",
+                         ais->mmsi);
                 /* prevent false match if a 24B is repeated */
                 session->driver.aivdm.context[0].type24_queue.ships[i].mmsi = 0;
 
-                gpsd_report(session->context->debug, LOG_DATA,
-                            "AIS: MMSI:  %09u\n", ais->mmsi);
-                gpsd_report(session->context->debug, LOG_DATA,
-                            "AIS: name:  %-20.20s v:%-8.8s c:%-8.8s b:%6u s:%6u p:%6u s:%6u\n",
-                            ais->type24.shipname,
-                            ais->type24.vendorid,
-                            ais->type24.callsign,
-                            ais->type24.dim.to_bow,
-                            ais->type24.dim.to_stern,
-                            ais->type24.dim.to_port,
-                            ais->type24.dim.to_starboard);
+                GPSD_LOG(session->context->debug, LOG_DATA,
+                         "AIS: MMSI:  %09u\n", ais->mmsi);
+                GPSD_LOG(session->context->debug, LOG_DATA,
+                         "AIS: name:  %-20.20s v:%-8.8s c:%-8.8s b:%6u s:%6u p:%6u s:%6u\n",
+                         ais->type24.shipname,
+                         ais->type24.vendorid,
+                         ais->type24.callsign,
+                         ais->type24.dim.to_bow,
+                         ais->type24.dim.to_stern,
+                         ais->type24.dim.to_port,
+                         ais->type24.dim.to_starboard);
 
                 vy_decode_ais_channel_info(bu, len, 264, session);
                 ais->type24.part = both;
@@ -2258,17 +2070,17 @@ static gps_mask_t hnd_129810(unsigned char *bu, int len, struct PGN *pgn, struct
             }
         }
 
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "AIS: MMSI  :  %09u\n", ais->mmsi);
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "AIS: MMSI  :  %09u\n", ais->mmsi);
 
-        gpsd_report(session->context->debug, LOG_DATA,
-                    "AIS: vendor:  %-8.8s c:%-8.8s b:%6u s:%6u p:%6u s:%6u\n",
-                    ais->type24.vendorid,
-                    ais->type24.callsign,
-                    ais->type24.dim.to_bow,
-                    ais->type24.dim.to_stern,
-                    ais->type24.dim.to_port,
-                    ais->type24.dim.to_starboard);
+        GPSD_LOG(session->context->debug, LOG_DATA,
+                 "AIS: vendor:  %-8.8s c:%-8.8s b:%6u s:%6u p:%6u s:%6u\n",
+                 ais->type24.vendorid,
+                 ais->type24.callsign,
+                 ais->type24.dim.to_bow,
+                 ais->type24.dim.to_stern,
+                 ais->type24.dim.to_port,
+                 ais->type24.dim.to_starboard);
 
         vy_decode_ais_channel_info(bu, len, 264, session);
         ais->type24.part = part_b;
@@ -2284,8 +2096,8 @@ static gps_mask_t hnd_129810(unsigned char *bu, int len, struct PGN *pgn, struct
 static gps_mask_t hnd_130842(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if(len == 0x1d)
         return hnd_129809(bu, len, pgn, session);
@@ -2301,8 +2113,8 @@ static gps_mask_t hnd_130842(unsigned char *bu, int len, struct PGN *pgn, struct
 static gps_mask_t hnd_127506(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
@@ -2321,7 +2133,7 @@ static gps_mask_t hnd_127508(unsigned char *bu, int len, struct PGN *pgn, struct
     */
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA, "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
@@ -2331,170 +2143,12 @@ static gps_mask_t hnd_127508(unsigned char *bu, int len, struct PGN *pgn, struct
 static gps_mask_t hnd_127513(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
 
-/**
- *   \PGN 127245: NAV Rudder
- */
-static gps_mask_t hnd_127245(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /*
-   [2], [5]
-   1 Rudder Instance, generated by rudder instance switch, can have values 0 .. 15
-   2 Direction Order, 0 if no order provided
-   3 Reserved Bits,   1s
-   4 Angle Order,     0x7fff is n/a
-   5 Position,        signed rudder angle in units of 0.0001 radians
-   6 Reserved Bits
-   PGN 127245 - Rudder, may be used to report rudder position or it may be used to set a rudder demand. [6]
-   Only Position is mapped to RSA [4]
-   */
-    uint8_t rudder_inst;
-    uint8_t dir_order;
-    uint8_t reserved1;
-    uint8_t angle_order;
-    double  position;
-    uint8_t reserved2;
-
-    // TODO: these are only wild guesses since we know byte pos of "position"
-    rudder_inst  = bu[0] & 0x0f;       // TODO: which bits lower/higher 0 .. 15
-    dir_order    = bu[1] & 0xff;       // TODO: guess would be 1 bit?
-    reserved1    = bu[1];
-    angle_order  = getles16(bu, 2);    // TODO N/A
-
-    // corresponds to RSA port rudder sensor
-    position     = getles16(bu, 4) * 0.0001 * RAD_2_DEG;
-
-    reserved2    = getub(bu, 6);
-
-    session->gpsdata.navigation.rudder_angle = position;
-    session->gpsdata.navigation.set          = NAV_RUDDER_ANGLE_PSET;
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Rudder Instance= %u, Direction Order= %u, Reserved Bits= %u\n",
-		rudder_inst,
-		dir_order,
-		reserved1);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Angle Order = %u, Position = %f, Reserved Bits= %u\n",
-		angle_order,
-		position,
-		reserved2);
-
-    return NAVIGATION_SET;
-}
-
-
-/**
- *   \PGN 127250: NAV Vessel Heading
- */
-static gps_mask_t hnd_127250(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /*
-    1 SID
-    2 Heading Sensor Reading
-    3 Deviation
-    4 Variation
-    5 Heading Sensor Reference
-    6 Reserved Bits
-    */
-
-    uint8_t sid;
-    uint16_t hdg;
-    int16_t dev;
-    int16_t var;
-    double heading = 0.0;
-    uint8_t ref = 0; // Heading Sensor Reference (M&T?)
-    const size_t buflen = 255;
-    // [3] says ref = 1 for magnetic north (how many bits?)
-
-    print_data(session->context, bu, len, pgn);
-
-    sid = getub(bu, 0);
-
-    /*@-type@*/
-    hdg = getleu16(bu, 1);
-    if (hdg != 0xffff) {
-        heading = hdg * RAD_2_DEG * 0.0001;
-    }
-
-    dev = getles16(bu, 3);
-    if (dev != 0x7fff) {
-        session->gpsdata.environment.set       |= ENV_DEVIATION_PSET;
-        session->gpsdata.environment.deviation = dev * RAD_2_DEG * 0.0001;
-    }
-
-    var = getles16(bu, 5);
-    if (var != 0x7fff) {
-        session->gpsdata.environment.set       |= ENV_VARIATION_PSET;
-        session->gpsdata.environment.variation = var * RAD_2_DEG * 0.0001;
-    }
-
-    // observed b0000 0001, 1 = magnetic (see also [3]), 0 = true
-    ref = getub(bu, 7) & 0x01; // ??? len, only a couple of bits
-
-    /*@+type@*/
-    if (hdg != 0xffff) {
-        if(ref == 1) {
-            session->gpsdata.navigation.set = NAV_HDG_MAGN_PSET;
-            session->gpsdata.navigation.heading[compass_magnetic] = heading;
-        } else {
-            session->gpsdata.navigation.set = NAV_HDG_TRUE_PSET;
-            session->gpsdata.navigation.heading[compass_true] = heading;
-        }
-    } else {
-        session->gpsdata.navigation.set = 0;
-        session->gpsdata.navigation.heading[compass_magnetic] = NAN;
-        session->gpsdata.navigation.heading[compass_true] = NAN;
-    }
-
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    char bufp[buflen];
-    memset(bufp, 0, buflen);
-
-    if (hdg == 0xffff) {
-      (void)sprintf(bufp, "Heading= %s, ", "-");
-      (void)sprintf(bufp + strlen(bufp), "Sensor= %s, ", "-");
-    } else {
-      (void)snprintf(bufp, buflen, "Heading= %.2f, ", heading);
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp), "Sensor= %.2f, ",
-		     hdg  * RAD_2_DEG * 0.0001);
-    }
-    if (dev == 0x7fff) {
-      (void)sprintf(bufp + strlen(bufp), "Deviation= %s, ", "-");
-    } else {
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp),
-		     "Deviation= %.2f, ",
-		     dev * RAD_2_DEG * 0.0001);
-    }
-    if (var == 0x7fff) {
-      (void)sprintf(bufp + strlen(bufp), "Variation= %s", "-");
-    } else {
-      (void)snprintf(bufp + strlen(bufp), buflen - strlen(bufp), "Variation= %.2f", var * RAD_2_DEG * 0.0001);
-    }
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   VY: SID = %d, %s, Heading Sensor Reference= %s (%u), Reserved = %u\n",
-		sid,
-		bufp,
-		ref == 1? "Magnetic":"True",
-		ref,
-		0);
-
-    return (ONLINE_SET | NAVIGATION_SET | ENVIRONMENT_SET);
-}
-
 /**
  * \todo PGN 128237: Heading/Track Control
  * is missing a mask and a storage structure for storing the results
@@ -2570,174 +2224,45 @@ static gps_mask_t hnd_127237(unsigned char *bu, int len, struct PGN *pgn, struct
     vessel_heading               = getleu16(bu, 19);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Rudder Limit Exceeded= %u, Off-Heading Limit Exceeded = %u, Off-Track Limit Exceeded= %u\n",
-		rudder_limit_exceeded,
-		off_heading_limit_exceeded,
-		off_track_limit_exceeded);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Override= %u, Steering Mode= %u, Turn Mode= %u, Heading Reference= %u\n",
-		override,
-		steering_mode,
-		turn_mode,
-		heading_reference);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Reserved Bits= %u, Commanded Rudder Direction= %u, Commanded Rudder Angle= %u\n",
-		reserved,
-		commanded_rudder_direction,
-		commanded_rudder_angle);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Heading-To-Steer (Course)= %f, Track= %u, Rudder Limit= %u, Off-Heading Limit= %u\n",
-		heading_to_steer,
-		track,
-		rudder_limit,
-		off_heading_limit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Radius of Turn Order= %u, Rate of Turn Order= %u, Off-Track Limit= %u, Vessel Heading= %u\n",
-		radius_of_turn_order,
-		rate_of_turn_order,
-		off_track_limit,
-		vessel_heading);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Rudder Limit Exceeded= %u, Off-Heading Limit Exceeded = %u, Off-Track Limit Exceeded= %u\n",
+             rudder_limit_exceeded,
+             off_heading_limit_exceeded,
+             off_track_limit_exceeded);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Override= %u, Steering Mode= %u, Turn Mode= %u, Heading Reference= %u\n",
+             override,
+             steering_mode,
+             turn_mode,
+             heading_reference);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Reserved Bits= %u, Commanded Rudder Direction= %u, Commanded Rudder Angle= %u\n",
+             reserved,
+             commanded_rudder_direction,
+             commanded_rudder_angle);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Heading-To-Steer (Course)= %f, Track= %u, Rudder Limit= %u, Off-Heading Limit= %u\n",
+             heading_to_steer,
+             track,
+             rudder_limit,
+             off_heading_limit);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Radius of Turn Order= %u, Rate of Turn Order= %u, Off-Track Limit= %u, Vessel Heading= %u\n",
+             radius_of_turn_order,
+             rate_of_turn_order,
+             off_track_limit,
+             vessel_heading);
 
     return(0);
 }
 
-/**
- *   \PGN 128251: Rate of Turn
- */
-static gps_mask_t hnd_127251(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-    uint8_t sid;
-    double rot;
-
-    sid = getub(bu, 0);
-
-    // TODO : find explain for odd magic number 3/16 deg/min (or 3/16/60 in deg/sec)
-    rot = getles32(bu, 1) * 0.00001 * 3.0/16.0/60.0 * RAD_2_DEG; // per sec, let compiler optimize
-
-    session->gpsdata.navigation.set              = NAV_ROT_PSET;
-    session->gpsdata.navigation.rate_of_turn     = rot;
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   sid = %d, rate = %f deg/s\n",
-		sid,
-		rot);
-
-    return NAVIGATION_SET;
-}
-
-
-/**
- *   \PGN 128259: NAV Speed
- */
-static gps_mask_t hnd_128259(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-    const double nm = 1852; // nm in meter
-    gps_mask_t mask = 0;
-
-    print_data(session->context, bu, len, pgn);
-
-    uint8_t sid = getub(bu, 0);
-    uint16_t speed_water = getleu16(bu, 1);   // 1 x 10-2 m/s
-    // [3] says not available means 0xffff, usually not used
-    uint16_t speed_ground = getleu16(bu, 3);
-
-    /*
-      http://askjackrabbit.typepad.com/ask_jack_rabbit/page/6/
-
-      The allowable reference values are:
-
-      1) Paddle Wheel
-      2) Pitot Tube
-      3) Doppler Log
-      4) Correlation Log (Ultra-Sound)
-      5) EM Log (Electro-Mechanical)
-    */
-
-    uint16_t type = getleu16(bu, 5);          // TODO: len in bytes? what does it mean?
-    //    uint8_t reserved = getub(bu, 7);          // TODO: all 1 for DST100UM
-
-    if(speed_water != 0xffff) {
-        session->gpsdata.navigation.set = NAV_STW_PSET;
-        session->gpsdata.navigation.speed_thru_water = speed_water * 0.01;
-        mask |= NAVIGATION_SET;
-    } else {
-        session->gpsdata.navigation.speed_thru_water = NAN;
-    }
-
-    if(speed_ground != 0xffff) {
-        session->gpsdata.navigation.set = NAV_SOG_PSET;
-        session->gpsdata.navigation.speed_over_ground = speed_ground * 0.01;
-        mask |= NAVIGATION_SET;
-    } else {
-        session->gpsdata.navigation.speed_over_ground = NAN;
-    }
-
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   sid = %d, speed= %f m/s, %f knots, %f km/h, speed ground= %u, type= %u\n",
-		sid,
-		speed_water * 0.01,
-		speed_water * 0.01 * 3600.0/nm,
-		speed_water * 0.01 * 3.6,
-		speed_ground,
-		type);
-
-    return mask;
-}
-
-
-/**
- *   \PGN 128267: NAV Water Depth
- */
-static gps_mask_t hnd_128267(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-    print_data(session->context, bu, len, pgn);
-
-    uint8_t sid = getub(bu, 0); // can be tied to 128259
-    uint32_t depth = getleu32(bu, 1);  // 1x10-2m
-    int16_t offset = getles16(bu, 5); // TODO: 0x7fff N/A, 1x10-3m
-    //    uint8_t res = getub(bu, 7); // reserved, len in bits?
-
-
-    if(depth == 0xffffffff) {
-      session->gpsdata.navigation.depth = NAN;
-    } else {
-      session->gpsdata.navigation.depth = depth *.01;
-      session->gpsdata.navigation.set = NAV_DPT_PSET;
-    }
-
-    if(offset == 0x7fff) {
-      session->gpsdata.navigation.depth_offset = NAN;
-    } else {
-      session->gpsdata.navigation.depth_offset = offset * 0.001;
-      session->gpsdata.navigation.set |= NAV_DPT_OFF_PSET;
-    }
-
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %d, depth = %f m, offset = %f m\n",
-		sid,
-	        session->gpsdata.navigation.depth,
-		session->gpsdata.navigation.depth_offset);
-
-    return (ONLINE_SET | NAVIGATION_SET);
-}
 
 
 /**
@@ -2762,8 +2287,8 @@ static gps_mask_t hnd_128275(unsigned char *bu, int len, struct PGN *pgn, struct
     session->gpsdata.navigation.set |= NAV_DIST_TRIP_PSET;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     char d[255]; char t[255];
     if(date != 0xffff)
@@ -2775,12 +2300,12 @@ static gps_mask_t hnd_128275(unsigned char *bu, int len, struct PGN *pgn, struct
     else
       sprintf(t, "-");
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   date = %s, time = %s, dist= %um, dist since reset = %um\n",
-		d,
-		t,
-		dist,
-		rest);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   date = %s, time = %s, dist= %um, dist since reset = %um\n",
+             d,
+             t,
+             dist,
+             rest);
 
     return NAVIGATION_SET;
 }
@@ -2819,20 +2344,20 @@ static gps_mask_t hnd_129283(unsigned char *bu, int len, struct PGN *pgn, struct
     reserved     = getleu16(bu, 7);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %u, XTE Mode = %u, reserve = %d, \n",
-		sid,
-		mode,
-		reserve);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID = %u, XTE Mode = %u, reserve = %d, \n",
+             sid,
+             mode,
+             reserve);
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   Navigation Terminated= %d, XTE= %fm, res = %u\n",
-		terminated,
-		(session->gpsdata.waypoint.set & WPY_XTE_PSET)?session->gpsdata.waypoint.xte:NAN,
-		reserved);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   Navigation Terminated= %d, XTE= %fm, res = %u\n",
+             terminated,
+             (session->gpsdata.waypoint.set & WPY_XTE_PSET)?session->gpsdata.waypoint.xte:NAN,
+             reserved);
 
     return mask;
 }
@@ -2950,31 +2475,31 @@ static gps_mask_t hnd_129284(unsigned char *bu, int len, struct PGN *pgn, struct
                   &session->gpsdata.waypoint.speed_to_destination, &session->gpsdata.waypoint.set);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if(session->context->debug >= LOG_IO) {
         if((eta_date < 0xffff) || (eta_time < 0xffffffff))
             unix_to_iso8601(session->gpsdata.waypoint.eta, etas, sizeof(etas));
 
 
-        gpsd_report(session->context->debug, LOG_IO,
+        GPSD_LOG(session->context->debug, LOG_IO,
             "                   SID= %u, Perpendicular Crossed= %u, Arrival Circle Entered= %u, Calculation Type= %u\n",
             sid,
             perpendicular_crossed,
             arrival_circle_entered,
             calc_type);
 
-        gpsd_report(session->context->debug, LOG_IO,
+        GPSD_LOG(session->context->debug, LOG_IO,
             "                   ETA= %s\n", etas);
 
-        gpsd_report(session->context->debug, LOG_IO,
+        GPSD_LOG(session->context->debug, LOG_IO,
             "                   Bearing, Org To Dest Wpt= %f, Bearing, Pos To Dest Wpt= %f, Course/Bearing Ref.= %u\n",
             (session->gpsdata.waypoint.set & WPY_BEARING_FROM_ORG_TO_PSET)?session->gpsdata.waypoint.bearing_from_org_to_destination:NAN,
             (session->gpsdata.waypoint.set & WPY_BEARING_FROM_POS_TO_PSET)?session->gpsdata.waypoint.bearing_from_pos_to_destination:NAN,
             (course_bearing_ref != 3)?course_bearing_ref:3);
 
-        gpsd_report(session->context->debug, LOG_IO,
+        GPSD_LOG(session->context->debug, LOG_IO,
             "                   Org Wpt #= %u, Dest Wpt #= %u, Dest Wpt Lat= %f, Dest Wpt Lon= %f, Dist to Dest Wpt= %fm, Wpt Closing Velocity= %fm/s\n",
             org_wpt_number,
             dest_wpt_number,
@@ -3010,8 +2535,8 @@ static gps_mask_t hnd_129285(unsigned char *bu, int len, struct PGN *pgn, struct
     14 Fields 10 thru 13 repeat as needed
     */
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
@@ -3035,159 +2560,11 @@ static gps_mask_t hnd_129291(unsigned char *bu, int len, struct PGN *pgn, struct
     6 Reserved Bits
     */
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
     return(0);
 }
 
-/**
- *   \PGN 130306: NAV Wind Data
- *   http://askjackrabbit.typepad.com/ask_jack_rabbit/page/7/
- */
-static gps_mask_t hnd_130306(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /*
-    1 Sequence ID
-    2 Wind Speed
-    3 Wind Direction
-    4 Wind Reference
-    5 Reserv
-
-    0) Theoretical Wind (ground referenced, referenced to True North; calculated using COG/SOG)
-    1) Theoretical Wind (ground referenced, referenced to Magnetic North; calculated using COG/SOG)
-    2) Apparent Wind (relative to the vessel centerline)
-    3) Theoretical (Calculated to Centerline of the vessel, referenced to ground; calculated using COG/SOG)
-    4) Theoretical (Calculated to Centerline of the vessel, referenced to water; calculated using Heading/Speed through Water)
-
-    According to
-
-    http://www.maretron.com/support/manuals/USB100UM_1.6.pdf
-
-    0 - 1 are translated to MWD and 2 - 4 to MWV:
-
-    MWD,dir,T,dir,M,speed,N,speed,M
-    MWV,dir,ref,speed,M,A
-
-    Speed is in knots.
-
-  */
-
-    static char * wind_ref[] = {
-      "True North",
-      "Magnetic North",
-      "Apparent",
-      "True to Boat",
-      "True to Water"
-    };
-
-    static gps_mask_t angles[] = {
-        ENV_WIND_TRUE_NORTH_ANGLE_PSET,
-        ENV_WIND_MAGN_ANGLE_PSET,
-        ENV_WIND_APPARENT_ANGLE_PSET,
-        ENV_WIND_TRUE_TO_BOAT_ANGLE_PSET,
-        ENV_WIND_TRUE_TO_WATER_ANGLE_PSET
-    };
-
-    static gps_mask_t speeds[] = {
-        ENV_WIND_TRUE_NORTH_SPEED_PSET,
-        ENV_WIND_MAGN_ANGLE_PSET,
-        ENV_WIND_APPARENT_SPEED_PSET,
-        ENV_WIND_TRUE_TO_BOAT_SPEED_PSET,
-        ENV_WIND_TRUE_TO_WATER_SPEED_PSET
-    };
-
-    gps_mask_t pset = 0, mask = 0, pset_s = 0, pset_a = 0;
-    double * speed = NULL;
-    double * angle = NULL;
-
-    uint8_t sid;
-    uint8_t ref = 0xff;
-    uint8_t res;
-
-    sid          = getub(bu, 0);
-    ref          = getub(bu, 5) & 0x07;         // see res 24 - 21 bits
-    res          = getub(bu, 6);                // 21 bits ([19]), makes ref == 3 bits
-
-    if(ref > 0x04)
-        return 0;
-
-    // accidentally ref and enum wind_reference are identical
-    angle = &session->gpsdata.environment.wind[ref].angle;
-    speed = &session->gpsdata.environment.wind[ref].speed;
-    pset_s = speeds[ref];
-    pset_a = angles[ref];
-
-    mask |= setleu16value(bu, 1, ENVIRONMENT_SET, pset|pset_s, 0.01,
-                    speed, &session->gpsdata.environment.set);
-    mask |= setleu16value(bu, 3, ENVIRONMENT_SET, pset|pset_a, RAD_2_DEG * 0.0001,
-                    angle, &session->gpsdata.environment.set);
-
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-        "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-        "                   SID = %u, wind speed = %f m/s, dir = %f, ref = %s (%02x), res = %u\n",
-        sid,
-        (!isnan(session->gpsdata.environment.wind[ref].speed))?session->gpsdata.environment.wind[ref].speed:NAN,
-        (!isnan(session->gpsdata.environment.wind[ref].angle))?session->gpsdata.environment.wind[ref].angle:NAN,
-        (ref < 5) ? wind_ref[ref] : "-", ref, res);
-
-    return ONLINE_SET | mask;
-}
-
-
-/**
- *   \PGN 130310: NAV Water Temp., Outside Air Temp., Atmospheric Pressure
- */
-static gps_mask_t hnd_130310(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
-{
-  /*
-    1 Sequence ID
-    2 Water Temp
-    3 Outside Ambient Air Temp.
-    4 Atmospheric Pressure
-    5 Reserved Bits
-  */
-
-    uint8_t sid;
-    uint16_t pres;
-    uint8_t res;
-
-    gps_mask_t mask = 0, pset = 0;
-
-    sid          = getub(bu, 0);
-    pres         = getleu16(bu, 5);
-    res          = getsb(bu, 7);
-
-    #define PSI_2_BAR 1.0/14.50377
-
-    // Kelvin
-    mask |= setleu16value(bu, 1, ENVIRONMENT_SET, pset|ENV_TEMP_WATER_PSET, 0.01,
-                    &session->gpsdata.environment.temp[temp_water], &session->gpsdata.environment.set);
-    mask |= setleu16value(bu, 3, ENVIRONMENT_SET, pset|ENV_TEMP_AIR_PSET, 0.01,
-                    &session->gpsdata.environment.temp[temp_air], &session->gpsdata.environment.set);
-
-
-
-    if(pres != 0xffff) {
-    }
-
-    print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID = %u, water = %f C, outside = %f C, pressure = %f mbar, res = %u\n",
-		sid,
-		(!isnan(session->gpsdata.environment.temp[temp_water]))?session->gpsdata.environment.temp[temp_water] + KELVIN_2_CELSIUS:NAN,
-        (!isnan(session->gpsdata.environment.temp[temp_air]))?session->gpsdata.environment.temp[temp_air] + KELVIN_2_CELSIUS:NAN,
-		pres * PSI_2_BAR * 0.001,
-		res);
-
-    return mask;
-}
 
 
 /**
@@ -3233,17 +2610,17 @@ static gps_mask_t hnd_130311(unsigned char *bu, int len, struct PGN *pgn, struct
         return 0;
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
-
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID= %u, temp inst= %d, hum inst= %d, temp = %f C, hum = %f%%, pres = %f\n",
-		sid,
-		temp_inst,
-		hum_inst,
-		(!isnan(session->gpsdata.environment.temp[temp_air]))?session->gpsdata.environment.temp[temp_air] + KELVIN_2_CELSIUS:NAN,
-		hum / 0.004,
-		pres * 0.0001);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID= %u, temp inst= %d, hum inst= %d, temp = %f C, hum = %f%%, pres = %f\n",
+             sid,
+             temp_inst,
+             hum_inst,
+             (!isnan(session->gpsdata.environment.temp[temp_air]))?session->gpsdata.environment.temp[temp_air] + KELVIN_2_CELSIUS:NAN,
+             hum / 0.004,
+             pres * 0.0001);
 
     return mask;
 }
@@ -3299,8 +2676,8 @@ static gps_mask_t hnd_130312(unsigned char *bu, int len, struct PGN *pgn, struct
     reserve       = getub(bu, 7);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d):\n", pgn->pgn, session->driver.nmea2000.unit);
 
     if(0) {
         // TODO - not sure yet with instance/source/value
@@ -3309,14 +2686,14 @@ static gps_mask_t hnd_130312(unsigned char *bu, int len, struct PGN *pgn, struct
         mask |= ENVIRONMENT_SET;
     }
 
-    gpsd_report(session->context->debug, LOG_IO,
-		"                   SID= %u, temp inst = %u, temp src = %s, temp = %f, temp set = %f, res = %u\n",
-		sid,
-		temp_inst,
-		(temp_src < 2) ? temp_src_list[temp_src] : " not listed yet ",
-		temp * 0.01 - 273.15,
-		temp_set * 0.01 - 273.15,
-		reserve);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   SID= %u, temp inst = %u, temp src = %s, temp = %f, temp set = %f, res = %u\n",
+             sid,
+             temp_inst,
+             (temp_src < 2) ? temp_src_list[temp_src] : " not listed yet ",
+             temp * 0.01 - 273.15,
+             temp_set * 0.01 - 273.15,
+             reserve);
 
     return mask;
 }
@@ -3345,9 +2722,9 @@ static gps_mask_t hnd_130824(unsigned char *bu, int len UNUSED, struct PGN *pgn
     uint16_t ind = (code >> 0) & 0x07;  //  3 bit industry
     
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
         "                   manu = %u, ind= %u\n",
         man, ind);
     
@@ -3387,9 +2764,9 @@ static gps_mask_t hnd_130845(unsigned char *bu, int len UNUSED, struct PGN *pgn
     uint16_t type_id = getleu16(bu, 6);
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
         "                   manu = %u, ind= %u, msg= %u, rpt= %u, type= %u\n",
         man, ind, msg_id, repeat_id, type_id);
 
@@ -3430,11 +2807,11 @@ static gps_mask_t hnd_130850(unsigned char *bu, int len UNUSED, struct PGN *pgn
     */
 
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
-    gpsd_report(session->context->debug, LOG_IO,
-                "                   manu = %u, ind= %u, prop= %u, dev= %u, ev= %u, dir= %u, deg= %.02f\n",
-                man, ind, prop_id, dev_id, event, dir_id, rad*RAD_2_DEG * 0.0001);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_IO,
+             "                   manu = %u, ind= %u, prop= %u, dev= %u, ev= %u, dir= %u, deg= %.02f\n",
+             man, ind, prop_id, dev_id, event, dir_id, rad*RAD_2_DEG * 0.0001);
 
     return 0;
 }
@@ -3446,8 +2823,8 @@ static gps_mask_t hnd_130850(unsigned char *bu, int len UNUSED, struct PGN *pgn
 static gps_mask_t hnd_unknown(unsigned char *bu, int len, struct PGN *pgn, struct gps_device_t *session)
 {
     print_data(session->context, bu, len, pgn);
-    gpsd_report(session->context->debug, LOG_DATA,
-		"pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "pgn %6d(%3d): unkown\n", pgn->pgn, session->driver.nmea2000.unit);
 
     return 0;
 }
@@ -3480,36 +2857,45 @@ static void vyspi_report_packet(struct gps_packet_t *pkg) {
 }
 #endif
 
+static struct pgnindex_t vyspi_pgnindex;
+
+/* build the PGN index, false if lookups have to walk the table */
+static bool vyspi_index_pgns(void) {
+
+    bool ok = pgnindex_init(&vyspi_pgnindex, NITEMS(pgnlist));
+    int l1;
+
+    for (l1 = 0; ok && pgnlist[l1].pgn != 0; l1++)
+        ok = pgnindex_add(&vyspi_pgnindex, pgnlist[l1].pgn, l1);
+    return ok;
+}
+
 struct PGN *vyspi_find_pgn(uint32_t pgn) {
 
-    struct PGN *work = NULL;
     int l1;
 
-    l1 = 0;
-    while (pgnlist[l1].pgn != 0) {
-        if (pgnlist[l1].pgn == pgn) {
-            work = &pgnlist[l1];
-            break;
-        } else {
-            l1 = l1 + 1;
-	    }
-	}
+    if (!vyspi_pgnindex.built)
+        (void)vyspi_index_pgns();
+
+    if (vyspi_pgnindex.usable)
+        l1 = pgnindex_find(&vyspi_pgnindex, pgn);
+    else {
+        for (l1 = 0; pgnlist[l1].pgn != 0 && pgnlist[l1].pgn != pgn; l1++)
+            continue;
+        if (pgnlist[l1].pgn == 0)
+            l1 = -1;
+    }
 
     // should never be NULL, just catching last one which is unknown
-    return work;
+    return (l1 < 0) ? NULL : &pgnlist[l1];
 }
 
 static void vyspi_reset_outbuffer(struct gps_packet_t *lexer) {
 
-    uint16_t cnt = 0;
+    /* records are views into inbuffer, forgetting them is enough */
     lexer->out_count = 0;
+    lexer->out_types = 0;
     lexer->outbuflen = 0;
-
-    for(cnt = 0; cnt < MAX_OUT_BUF_RECORDS; cnt++) {
-        lexer->out_type[cnt] = 0;
-        lexer->out_offset[cnt] = 0;
-        lexer->out_len[cnt] = 0;
-    }
 }
 
 static void vyspi_n_discard(struct gps_packet_t *lexer, uint8_t nchars)
@@ -3527,12 +2913,12 @@ static void vyspi_n_discard(struct gps_packet_t *lexer, uint8_t nchars)
 
   if (lexer->debug >= LOG_RAW+1) {
     char scratchbuf[MAX_PACKET_LENGTH*2+1];
-    gpsd_report(lexer->debug, LOG_RAW+1,
-		"Packet type %d discarded %lu chars remaining %lu = %s\n",
-		lexer->type, discard, remaining,
-		gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-				(char *)lexer->inbuffer,
-				lexer->inbufptr - lexer->inbuffer));
+    GPSD_LOG(lexer->debug, LOG_RAW+1,
+             "Packet type %d discarded %lu chars remaining %lu = %s\n",
+             lexer->type, discard, remaining,
+             gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
+                             (char *)lexer->inbuffer,
+                             lexer->inbufptr - lexer->inbuffer));
   }
 }
 
@@ -3543,46 +2929,19 @@ static void vyspi_packet_discard(struct gps_packet_t *lexer)
 }
 
 static void vyspi_packet_accept(struct gps_packet_t *lexer, int packet_type)
-/* packet grab succeeded, move to output buffer */
+/* frame complete, record where its payload sits in the input arena */
 {
+    uint16_t cnt = lexer->out_count;
+    size_t packetlen = lexer->frm_length;
 
-    uint16_t newoffset = 0;
-    uint8_t cnt = lexer->out_count;
-
-    size_t packetlen = lexer->inbufptr - lexer->inbuffer;
-
-    // there is 2 bytes checksum
-    if(lexer->frm_version) // they are not in the package len but in frm_length
-        packetlen -= 2;
-    assert(packetlen == lexer->frm_length);
-
-#define max(a,b) \
-   ({ __typeof__ (a) _a = (a); \
-       __typeof__ (b) _b = (b); \
-     _a > _b ? _a : _b; })
-
-    if(packetlen != lexer->frm_length) {
-        char scratchbuf[MAX_PACKET_LENGTH*2+1];
-        gpsd_report(lexer->debug, LOG_ERROR,
-                    "Fatal error with packet length %zu != frame length %u\n%s\n",
-                    packetlen, lexer->frm_length,
-                    gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-                                    (char *)lexer->inbuffer,
-                                    max(packetlen, lexer->frm_length)));
-    }
-
-    if(cnt > 0)
-        newoffset = lexer->out_offset[cnt - 1] + lexer->out_len[cnt - 1];
+    if (cnt < MAX_OUT_BUF_RECORDS) {
 
-    if (newoffset + packetlen < sizeof(lexer->outbuffer)) {
-
-        memcpy(lexer->outbuffer + newoffset, lexer->inbuffer, packetlen);
-
-        // we add a '\0' for all and also non-text packages
-        lexer->outbuffer[newoffset + packetlen] = '\0';
+        /* the payload was unescaped towards the frame start, so the
+           byte behind it was header or escape and is free for a '\0' */
+        lexer->inbuffer[lexer->frm_start + packetlen] = '\0';
         lexer->outbuflen += packetlen + 1;
 
-        lexer->out_offset[cnt] = newoffset;
+        lexer->out_offset[cnt] = lexer->frm_start;
         lexer->out_new_version[cnt] = lexer->frm_version;
         lexer->out_len[cnt] = packetlen;
 
@@ -3593,153 +2952,139 @@ static void vyspi_packet_accept(struct gps_packet_t *lexer, int packet_type)
 
         lexer->type = VYSPI_PACKET;
         lexer->out_count++;
+        if (lexer->out_type[cnt] < FRM_TYPE_MAX) {
+            lexer->out_types |= 1u << lexer->out_type[cnt];
+            latency_stage(lexer->out_type[cnt], lat_accept, lexer->in_stamp);
+        }
 
         if (lexer->debug >= LOG_DATA) {
             char scratchbuf[MAX_PACKET_LENGTH*2+1];
-            gpsd_report(lexer->debug, LOG_DATA, // LOG_RAW+1,
-                        "vy-packet no %u type %d with frame type %u accepted %zu = %s\n",
-                        cnt, packet_type, lexer->out_type[cnt], packetlen,
-                        gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-                                        (char *)lexer->outbuffer,
-                                        lexer->outbuflen));
+            GPSD_LOG(lexer->debug, LOG_DATA, // LOG_RAW+1,
+                     "vy-packet no %u type %d with frame type %u accepted %zu = %s\n",
+                     cnt, packet_type, lexer->out_type[cnt], packetlen,
+                     gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
+                                     (char *)packet_record(lexer, cnt),
+                                     packetlen));
         }
 
-
     } else {
-        gpsd_report(lexer->debug, LOG_ERROR,
-                    "Rejected too long packet type %d len %zu\n",
-                    packet_type, packetlen);
+        GPSD_LOG(lexer->debug, LOG_ERROR,
+                 "Rejected packet type %d len %zu, %u records pending\n",
+                 packet_type, packetlen, cnt);
     }
 }
 
-static size_t vyspi_packetlen( struct gps_packet_t *lexer ) {
-
-  return lexer->inbufptr - lexer->inbuffer + lexer->inbuflen;
-}
-
-
-enum
+void vyspi_lexer_compact(struct gps_packet_t *lexer)
+/* make room in the input arena before reading more serial data */
 {
-#include "packet_states.h"
-};
-
-static int vyspi_packet_parse(struct gps_packet_t *lexer, unsigned char c) {
-
-    char *state_table[] = {
-#include "packet_names.h"
-    };
-
-    nextstate(lexer, c);
-    gpsd_report(lexer->debug, LOG_RAW + 2,
-                "%08ld: character '%c' [%02x], new state: %s\n",
-                lexer->char_counter, (isprint(c) ? c : '.'), c,
-                state_table[lexer->state]);
-
-    lexer->char_counter++;
+    /* all input has been scanned, only the payload of a frame still
+       being collected is alive; everything else is spent */
+    bool partial = false;
+    size_t live = 0;
+
+    if (lexer->frm_state == FRM_START) {
+        partial = true;
+        live = lexer->frm_read;
+    } else if (lexer->frm_state == FRM_CS) {
+        partial = true;
+        live = lexer->frm_length;
+    }
 
-    if (lexer->state == GROUND_STATE) {
-        character_skip(lexer);
-    } else if (lexer->state == COMMENT_RECOGNIZED) {
-        lexer->state = GROUND_STATE;
-        return COMMENT_PACKET;
+    if (partial && lexer->frm_start + live > lexer->inbuflen) {
+        /* packet_reset() emptied the arena under a partial frame */
+        lexer->frm_state = FRM_GND;
+        partial = false;
     }
 
-#ifdef NMEA_ENABLE
-    else if (lexer->state == NMEA_RECOGNIZED) {
-        /*
-         * $PASHR packets have no checksum. Avoid the possibility
-         * that random garbage might make it look like they do.
-         */
-        if (strncmp((const char *)lexer->inbuffer, "$PASHR,", 7) != 0) {
-            bool checksum_ok = true;
-            char csum[3] = { '0', '0', '0' };
-            char *end;
-            /*
-             * Back up past any whitespace.  Need to do this because
-             * at least one GPS (the Firefly 1a) emits \r\r\n
-             */
-            for (end = (char *)lexer->inbufptr - 1; isspace(*end); end--)
-                continue;
-            while (strchr("0123456789ABCDEF", *end))
-                --end;
-            if (*end == '*') {
-                unsigned int n, crc = 0;
-                for (n = 1; (char *)lexer->inbuffer + n < end; n++)
-                    crc ^= lexer->inbuffer[n];
-                (void)snprintf(csum, sizeof(csum), "%02X", crc);
-                checksum_ok = (csum[0] == toupper(end[1])
-                               && csum[1] == toupper(end[2]));
-            }
-            if (!checksum_ok) {
-                char scratchbuf[MAX_PACKET_LENGTH*2+1];
-                gpsd_report(lexer->debug, LOG_WARN,
-                            "NMEA packet accepted = %s\n",
-                            gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-                                            (char *)lexer->outbuffer,
-                                            lexer->outbuflen));
-                gpsd_report(lexer->debug, LOG_WARN,
-                            "bad checksum in NMEA packet; expected %s.\n",
-                            csum);
-                lexer->state = GROUND_STATE;
-                return BAD_PACKET;
-            }
-        }
+    if (!partial) {
+        /* nothing to keep, start over at the front for free */
+        lexer->frm_start = 0;
+        lexer->inbuflen = 0;
+        lexer->inbufptr = lexer->inbuffer;
+        return;
+    }
 
-        /* checksum passed or not present */
-#ifdef AIVDM_ENABLE
-        if (strncmp((char *)lexer->inbuffer, "!AIVDM", 6) == 0)
-            return AIVDM_PACKET;
-        else if (strncmp((char *)lexer->inbuffer, "!AIVDO", 6) == 0)
-            return AIVDM_PACKET;
-        else if (strncmp((char *)lexer->inbuffer, "!BSVDM", 6) == 0)
-            return AIVDM_PACKET;
-        else if (strncmp((char *)lexer->inbuffer, "!BSVDO", 6) == 0)
-            return AIVDM_PACKET;
-        else
-#endif /* AIVDM_ENABLE */
-            return NMEA_PACKET;
+    /* move a partial frame only once the arena runs out of room */
+    if (sizeof(lexer->inbuffer) - lexer->inbuflen >= VYSPI_ARENA_SLACK)
+        return;
 
-    }
-#endif /* NMEA_ENABLE */
+    memmove(lexer->inbuffer, lexer->inbuffer + lexer->frm_start, live);
+    lexer->frm_start = 0;
+    /* keep a spent byte behind the payload to hold its '\0' */
+    lexer->inbuflen = live + 1;
+    lexer->inbufptr = lexer->inbuffer + live + 1;
 
-    return -2;
+    GPSD_LOG(lexer->debug, LOG_RAW + 1,
+             "VYSPI: compacted input arena, %zu bytes kept\n", live);
 }
 
+static size_t vyspi_packetlen( struct gps_packet_t *lexer ) {
+
+  return lexer->inbufptr - lexer->inbuffer + lexer->inbuflen;
+}
 
-static void vyspi_preparse_serial(struct gps_device_t *session) {
 
+void vyspi_lexer_scan(struct gps_packet_t *lexer)
+/* turn the buffered serial input into frame records */
+{
     static char * type_names [] = {
         "COMMAND", "NMEA0183", "NMEA2000", "SEATALK", "AIS"
     };
 
-    struct gps_packet_t *lexer = &session->packet;
-    int packet_type = -2;
-
-    gpsd_report(session->context->debug, LOG_RAW + 1,
-                "VYSPI: preparse serial called with input len = %lu and ptr at %lu\n",
-                lexer->inbuflen, lexer->inbufptr - lexer->inbuffer);
-    // one extra for reading both, len and type/origin
+    GPSD_LOG(lexer->debug, LOG_RAW + 1,
+             "VYSPI: preparse serial called with input len = %lu and ptr at %lu\n",
+             lexer->inbuflen, lexer->inbufptr - lexer->inbuffer);
 
     vyspi_reset_outbuffer(lexer);
 
+    /*
+     * inbuffer is an arena: frames are never shifted down.  The payload
+     * of a frame is unescaped in place towards its own 0x7e, which keeps
+     * it contiguous, and accepted frames are handed on as views.
+     */
     while(packet_buffered_input(lexer)) {
 
-        uint8_t * bp = lexer->inbufptr; // need this for storing back
+        /*
+         * Payload between escapes is moved down as a whole run.  The
+         * last byte of a payload is left to the state machine below,
+         * it completes the frame.
+         */
+        if((lexer->frm_state == FRM_START) && !lexer->frm_7dflag
+           && (lexer->frm_read + 1 < lexer->frm_length)) {
+
+            size_t n = lexer->frm_length - 1 - lexer->frm_read;
+            uint8_t checksum = 0;
+            size_t run;
+
+            if(n > (size_t)packet_buffered_input(lexer))
+                n = packet_buffered_input(lexer);
+            run = frm_span(lexer->inbufptr, n, &checksum);
+
+            if(run > 0) {
+                memmove(lexer->inbuffer + lexer->frm_start + lexer->frm_read,
+                        lexer->inbufptr, run);
+                lexer->frm_read += run;
+                lexer->frm_act_checksum ^= checksum;
+                lexer->inbufptr += run;
+                if(!packet_buffered_input(lexer))
+                    break;
+            }
+        }
+
         uint8_t b = *lexer->inbufptr++;
-        
-        gpsd_report(session->context->debug, LOG_RAW + 1,
-                    "VYSPI: preparse serial [%c] %02x @ %p state= %u\n",
-                    (isprint(b) ? b : '.'), b, lexer->inbufptr, lexer->frm_state);
+
+        GPSD_LOG(lexer->debug, LOG_RAW + 1,
+                 "VYSPI: preparse serial [%c] %02x @ %p state= %u\n",
+                 (isprint(b) ? b : '.'), b, lexer->inbufptr, lexer->frm_state);
 
         if(b == 0x7d) {
             lexer->frm_7dflag = 1;
-            character_skip(lexer);
             continue;
         }
 
         // an unchanged 0x7e is always a frame start, escaped or not
         if(b == 0x7e) {
-            vyspi_packet_discard(lexer);
+            lexer->frm_start   = (lexer->inbufptr - 1) - lexer->inbuffer;
             lexer->frm_length  = 0;
             lexer->frm_read    = 0;
             lexer->frm_version = 0;
@@ -3758,7 +3103,6 @@ static void vyspi_preparse_serial(struct gps_device_t *session) {
         if(lexer->frm_7dflag) {
             lexer->frm_7dflag = 0;
             b ^= (1 << 5);
-            *bp = b;
         }
 
         switch(lexer->frm_state) {
@@ -3779,7 +3123,6 @@ static void vyspi_preparse_serial(struct gps_device_t *session) {
                 lexer->frm_length = 0;
                 lexer->frm_version = 0;
                 lexer->frm_state = FRM_GND;
-                vyspi_packet_discard(lexer);
             }
             break;
 
@@ -3797,16 +3140,15 @@ static void vyspi_preparse_serial(struct gps_device_t *session) {
             // if MSB is set we have a 2 byte len (well, 15 bit)
             // we store in big endian
 
-            if(lexer->frm_length > 0) {
+            // frm_read counts the length bytes until the payload starts,
+            // the low 7 bits alone can be 0 (a length of 128)
+            if(lexer->frm_read > 0) {
                 // if MSB is set in len already then we are in second byte
                 lexer->frm_state = FRM_START;
+                lexer->frm_read = 0;
 
                 // add low byte
                 lexer->frm_length |= (b << 7);
-                lexer->frm_offset = 3;
-                if(lexer->frm_version)
-                    lexer->frm_offset += 2;
-                vyspi_n_discard(lexer, lexer->frm_offset);
 
             } else {
                 // if its not set in len, then this is low byte and maybe only byte
@@ -3814,48 +3156,39 @@ static void vyspi_preparse_serial(struct gps_device_t *session) {
                 if(!(b & 0x80)) {
                     // even the last byte and only byte
                     lexer->frm_state = FRM_START;
-                    lexer->frm_offset = 2;
-                    if(lexer->frm_version)
-                        lexer->frm_offset += 2;
-                    vyspi_n_discard(lexer, lexer->frm_offset);
-                }
+                } else
+                    lexer->frm_read = 1;
             }
 
+            // payload and its '\0' have to fit into the arena
+            if((lexer->frm_state == FRM_START)
+               && (lexer->frm_length >= sizeof(lexer->inbuffer))) {
+                GPSD_LOG(lexer->debug, LOG_WARN,
+                         "VYSPI: dropping frame with len %u\n",
+                         lexer->frm_length);
+                lexer->frm_length = 0;
+                lexer->frm_version = 0;
+                lexer->frm_state = FRM_GND;
+            }
             break;
 
         case FRM_END:
             // odd if we got here
             lexer->frm_length = 0;
             lexer->frm_version = 0;
-            vyspi_packet_discard(lexer);
+            lexer->frm_state = FRM_GND;
             break;
 
         case FRM_START:
 
-            /* trying to avoid a new buffer and changing existing code;
-               thus parsing inline here */
-            if(lexer->frm_type == FRM_TYPE_NMEA0183) {
-                lexer->type = VYSPI_PACKET;
-                packet_type = vyspi_packet_parse(lexer, b);
-                if(packet_type > -2) {
-                    gpsd_report(session->context->debug, LOG_RAW,
-                                "VYSPI: preparse serial discovered a packet type = %d\n",
-                                packet_type);
-
-                }
-            }
-
+            lexer->inbuffer[lexer->frm_start + lexer->frm_read] = b;
             lexer->frm_read++;
 
-            /* we may take inbufptr and inbuffer as a criteria here since
-             * we are always having the recent frame start at inbuffer
-             * even if there is multiple frames in the buffer
-             */
-            if((size_t)(lexer->inbufptr - lexer->inbuffer) >= lexer->frm_length) {
+            if(lexer->frm_read >= lexer->frm_length) {
                 // frame is complete
-                gpsd_report(session->context->debug, LOG_RAW,
-                            "VYSPI: preparse serial discovered complete frame with len %u >= %lu\n",
-                            lexer->frm_length, lexer->inbufptr - lexer->inbuffer);
+                GPSD_LOG(lexer->debug, LOG_RAW,
+                         "VYSPI: preparse serial discovered complete frame with len %u\n",
+                         lexer->frm_length);
                 if(lexer->frm_version) {
                     lexer->frm_read= 0;
                     lexer->frm_state = FRM_CS;
@@ -3879,45 +3212,26 @@ static void vyspi_preparse_serial(struct gps_device_t *session) {
             break;
         }
 
-/*
-        if(((lexer->frm_type == FRM_TYPE_NMEA0183)
-           || (lexer->frm_type == FRM_TYPE_AIS)) && (packet_type > -2)) {
-            vyspi_packet_accept(lexer, packet_type);
-            vyspi_packet_discard(lexer);
-            break;
-        }
-*/
-
         if(lexer->frm_state == FRM_END) {
 
-            gpsd_report(session->context->debug, LOG_RAW,
-                        "VYSPI: preparse serial complete frame type %s version %u with len %u, %lu\n",
-                        type_names[lexer->frm_type],
-                        lexer->frm_version,
-                        lexer->frm_length,
-                        lexer->inbufptr - lexer->inbuffer);
-
+            GPSD_LOG(lexer->debug, LOG_RAW,
+                     "VYSPI: preparse serial complete frame type %s version %u with len %u\n",
+                     type_names[lexer->frm_type],
+                     lexer->frm_version,
+                     lexer->frm_length);
 
             if((lexer->frm_type == FRM_TYPE_NMEA0183)
-               || (lexer->frm_type == FRM_TYPE_AIS) ) {
-                /* we parsed packet inline during FRM_START
-                   - just discard here from inbuffer */
+               || (lexer->frm_type == FRM_TYPE_AIS)
+               || (lexer->frm_type == FRM_TYPE_NMEA2000)
+               || (lexer->frm_type == FRM_TYPE_ST)
+               || (lexer->frm_type == FRM_TYPE_CMD)) {
                 vyspi_packet_accept(lexer, VYSPI_PACKET);
-                vyspi_packet_discard(lexer);
-
-            } else if((lexer->frm_type == FRM_TYPE_NMEA2000)
-                      || (lexer->frm_type == FRM_TYPE_ST)
-                      || (lexer->frm_type == FRM_TYPE_CMD)) {
-
-                // accept the NMEA 2000 or Seatalk 1 packet
-                vyspi_packet_accept(lexer, VYSPI_PACKET);
-                vyspi_packet_discard(lexer);
             }
 
-            /* TODO - this break prevents that multiple sentences that are all
-                read in one read() will be processed at once - which might or
-                might not be desirable */
-            break;
+            /* keep going, all frames of one read() are handed on at
+               once; only stop when there is no record left for them */
+            if(lexer->out_count >= MAX_OUT_BUF_RECORDS)
+                break;
         }
     }
 }
@@ -3932,8 +3246,8 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
 
   size_t packetlen = vyspi_packetlen(lexer);
 
-  gpsd_report(session->context->debug, LOG_DATA,
-	      "VYSPI: preparse called with packet len = %lu\n", packetlen);
+  GPSD_LOG(session->context->debug, LOG_DATA,
+           "VYSPI: preparse called with packet len = %lu\n", packetlen);
 
   // one extra for reading both, len and type/origin
   while(packet_buffered_input(lexer)) {
@@ -3945,14 +3259,14 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
     b = *lexer->inbufptr++;
     uint8_t pkgLen  =  b & 0xFF;
 
-    gpsd_report(session->context->debug, LOG_DATA, "VYSPI: ptype= %s, org= %d, len= %d\n",
-		((pkgType > PKG_TYPE_NMEA2000) && (pkgType < PKG_TYPE_NMEA0183))
-		? typeNames[0] : typeNames[pkgType],
-		pkgOrg, pkgLen);
+    GPSD_LOG(session->context->debug, LOG_DATA, "VYSPI: ptype= %s, org= %d, len= %d\n",
+             ((pkgType > PKG_TYPE_NMEA2000) && (pkgType < PKG_TYPE_NMEA0183))
+             ? typeNames[0] : typeNames[pkgType],
+             pkgOrg, pkgLen);
 
     if((lexer->inbuffer + lexer->inbuflen < lexer->inbufptr) || (pkgLen <= 0)) {
       // discard
-      gpsd_report(session->context->debug, LOG_WARN, "VYSPI: input too short\n");
+      GPSD_LOG(session->context->debug, LOG_WARN, "VYSPI: input too short\n");
       lexer->inbufptr = lexer->inbuffer + lexer->inbuflen;
       vyspi_packet_discard(lexer);
       break;
@@ -3961,8 +3275,8 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
     if(pkgType == PKG_TYPE_NMEA2000) {
 
       if((size_t)lexer->inbuflen < (size_t)(lexer->inbufptr - lexer->inbuffer) + pkgLen + 8) {
-          gpsd_report(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %ld + 8 + %d > %lu\n",
-                      (lexer->inbufptr - lexer->inbuffer), pkgLen, packetlen);
+          GPSD_LOG(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %ld + 8 + %d > %lu\n",
+                   (lexer->inbufptr - lexer->inbuffer), pkgLen, packetlen);
           // discard
           lexer->inbufptr = lexer->inbuffer + lexer->inbuflen;
           vyspi_packet_discard(lexer);
@@ -3975,9 +3289,9 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
       uint32_t pkgid = getleu32(lexer->inbufptr, 0);
       lexer->inbufptr += 4;
 
-      gpsd_report(session->context->debug, LOG_DATA,
-		  "VYSPI: PGN = %u, pid= %u, org= %u, len= %u\n",
-		  session->driver.vyspi.last_pgn, pkgid, pkgOrg, pkgLen);
+      GPSD_LOG(session->context->debug, LOG_DATA,
+               "VYSPI: PGN = %u, pid= %u, org= %u, len= %u\n",
+               session->driver.vyspi.last_pgn, pkgid, pkgOrg, pkgLen);
 
       memcpy(lexer->outbuffer, lexer->inbufptr, pkgLen);
       lexer->outbuflen = pkgLen;
@@ -3998,15 +3312,15 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
     } else if (pkgType == PKG_TYPE_NMEA0183) {
 
         if(lexer->inbuflen < (unsigned int)(lexer->inbufptr - lexer->inbuffer + pkgLen)) {
-          gpsd_report(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %ld + %d > %lu\n",
-                      (lexer->inbufptr - lexer->inbuffer), pkgLen, packetlen);
+          GPSD_LOG(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %ld + %d > %lu\n",
+                   (lexer->inbufptr - lexer->inbuffer), pkgLen, packetlen);
           // discard
           lexer->inbufptr = lexer->inbuffer + lexer->inbuflen;
 	break;
       }
 
-      gpsd_report(session->context->debug, LOG_DATA, "VYSPI: org= %d, len= %d\n",
-		  pkgOrg, pkgLen);
+      GPSD_LOG(session->context->debug, LOG_DATA, "VYSPI: org= %d, len= %d\n",
+               pkgOrg, pkgLen);
 
 
       memcpy(lexer->outbuffer, lexer->inbuffer, pkgLen);
@@ -4023,8 +3337,8 @@ static void vyspi_preparse_spi(struct gps_device_t *session) {
 
     } else {
 
-      gpsd_report(session->context->debug, LOG_ERROR, "UNKOWN: len= %d\n",
-		  pkgLen);
+      GPSD_LOG(session->context->debug, LOG_ERROR, "UNKOWN: len= %d\n",
+               pkgLen);
 
       // discard
       lexer->inbufptr = lexer->inbuffer + lexer->inbuflen;
@@ -4044,6 +3358,10 @@ static ssize_t vyspi_get(struct gps_device_t *session)
 
   ssize_t          status = 0;
 
+  /* a reader thread has done the read() and lexing already */
+  if(session->reader != NULL)
+      return devreader_get(session);
+
   errno = 0;
 
   // we still need to process old package before getching a new
@@ -4069,41 +3387,46 @@ static ssize_t vyspi_get(struct gps_device_t *session)
 
   if(!packet_buffered_input(pkg)) {
 
+      if(session->gpsdata.dev.isSerial)
+          vyspi_lexer_compact(pkg);
+
       status = read(fd, pkg->inbuffer + pkg->inbuflen,
                     sizeof(pkg->inbuffer) - (pkg->inbuflen));
 
-      gpsd_report(session->context->debug, LOG_IO,
-                  "VYSPI reading from device with status %zd\n", status);
+      GPSD_LOG(session->context->debug, LOG_IO,
+               "VYSPI reading from device with status %zd\n", status);
 
       pkg->outbuflen = 0;
       if(status == -1) {
           if ((errno == EAGAIN) || (errno == EINTR)) {
-              gpsd_report(session->context->debug, LOG_IO, "no bytes ready\n");
+              GPSD_LOG(session->context->debug, LOG_IO, "no bytes ready\n");
               status = 0;
               /* fall through, input buffer may be nonempty */
           } else {
-              gpsd_report(session->context->debug, LOG_ERROR,
-                          "errno: %s\n", strerror(errno));
+              GPSD_LOG(session->context->debug, LOG_ERROR,
+                       "errno: %s\n", strerror(errno));
               return -1;
           }
       } else {
           if (session->context->debug >= LOG_IO) {
               char scratchbuf[MAX_PACKET_LENGTH*2+1];
-              gpsd_report(session->context->debug, LOG_IO,
-                          "Read %zd chars to buffer offset %zd (total %zd): %s\n",
-                          status, pkg->inbuflen, pkg->inbuflen + status,
-                          gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
-                                          (char *)pkg->inbuffer + pkg->inbuflen, (size_t)status));
+              GPSD_LOG(session->context->debug, LOG_IO,
+                       "Read %zd chars to buffer offset %zd (total %zd): %s\n",
+                       status, pkg->inbuflen, pkg->inbuflen + status,
+                       gpsd_packetdump(scratchbuf, sizeof(scratchbuf),
+                                       (char *)pkg->inbuffer + pkg->inbuflen, (size_t)status));
           }
       }
 
       if(status <= 0) {
-          gpsd_report(session->context->debug, LOG_WARN,
-                      "VYSPI: exit with len in bytes= %lu, errno= %d\n",
-                      status, errno);
+          GPSD_LOG(session->context->debug, LOG_WARN,
+                   "VYSPI: exit with len in bytes= %lu, errno= %d\n",
+                   status, errno);
           return 0;
       }
 
+      pkg->in_stamp = latency_now();
+
       if(session->gpsdata.dev.isSerial) {
           pkg->inbuflen += status;
       } else {
@@ -4112,21 +3435,21 @@ static ssize_t vyspi_get(struct gps_device_t *session)
           pkg->inbufptr = pkg->inbuffer;
       }
   } else {
-      gpsd_report(session->context->debug, LOG_DATA,
-                  "not reading new data - processing queue with %lu bytes remaining\n",
-                  packet_buffered_input(pkg));
+      GPSD_LOG(session->context->debug, LOG_DATA,
+               "not reading new data - processing queue with %lu bytes remaining\n",
+               packet_buffered_input(pkg));
 
       if (session->context->debug >= LOG_DATA) {
           char scratchbuf[MAX_PACKET_LENGTH*2+1];
-          gpsd_report(session->context->debug, LOG_DATA, // LOG_RAW+1,
-                      "bytes remaining: %s\n",
-                      gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
-                                      (char *)pkg->inbuffer, packet_buffered_input(pkg)));
+          GPSD_LOG(session->context->debug, LOG_DATA, // LOG_RAW+1,
+                   "bytes remaining: %s\n",
+                   gpsd_packetdump(scratchbuf,  sizeof(scratchbuf),
+                                   (char *)pkg->inbuffer, packet_buffered_input(pkg)));
       }
   } // if(!packet_buffered_input(pkg))
 
   if(session->gpsdata.dev.isSerial) {
-      vyspi_preparse_serial(session);
+      vyspi_lexer_scan(pkg);
   } else {
       vyspi_preparse_spi(session);
   }
@@ -4134,12 +3457,12 @@ static ssize_t vyspi_get(struct gps_device_t *session)
   if (pkg->outbuflen > 0) {
       if ((session->driver.nmea2000.workpgn == NULL)
           && (session->packet.type == NMEA2000_PACKET)) {
-          gpsd_report(session->context->debug, LOG_DATA,
-                      "VYSPI: exit with 0 with with no known PGN in N2k\n");
+          GPSD_LOG(session->context->debug, LOG_DATA,
+                   "VYSPI: exit with 0 with with no known PGN in N2k\n");
           return 0;
       }
 
-      gpsd_report(session->context->debug, LOG_RAW,
+      GPSD_LOG(session->context->debug, LOG_RAW,
         "VYSPI: exit with outbuf len = %lu and %lu bytes remaining\n",
         pkg->outbuflen,
         packet_buffered_input(pkg));
@@ -4150,9 +3473,9 @@ static ssize_t vyspi_get(struct gps_device_t *session)
        * It can still be 0 or -1 at this point even if buffer data
        * was consumed.
        */
-      gpsd_report(session->context->debug, LOG_RAW,
+      GPSD_LOG(session->context->debug, LOG_RAW,
         "VYSPI: exit with outbuf len = 0 and %lu bytes read and %lu bytes remaining\n",
-                  status, packet_buffered_input(pkg));
+               status, packet_buffered_input(pkg));
       return status;
   }
 
@@ -4170,9 +3493,9 @@ static ssize_t vyspi_get(struct gps_device_t *session)
     session->packet.outbuflen = len;
     session->packet.type = VYSPI_PACKET;
 
-    gpsd_report(session->context->debug, LOG_DATA,
-		"VYSPI: len = %d, bytes= %d, errno= %d\n",
-		len, status, errno);
+    GPSD_LOG(session->context->debug, LOG_DATA,
+             "VYSPI: len = %d, bytes= %d, errno= %d\n",
+             len, status, errno);
   }
 
   return len;
@@ -4192,17 +3515,17 @@ static gps_mask_t vyspi_parse_serial_input(struct gps_device_t *session)
       "COMMAND", "NMEA0183", "NMEA2000", "SEATALK", "AIS", "UNKOWN"
   };
 
-  gpsd_report(session->context->debug, LOG_RAW,
-              "VYSPI: parse_input called with packet len = %lu and %u frames\n",
-              lexer->outbuflen, lexer->out_count);
+  GPSD_LOG(session->context->debug, LOG_RAW,
+           "VYSPI: parse_input called with packet len = %lu and %u frames\n",
+           lexer->outbuflen, lexer->out_count);
 
 
   for(ct = 0; ct < lexer->out_count; ct++) {
 
-      gpsd_report(session->context->debug, LOG_DATA, "VYSPI: type= %s, len= %u\n",
-                  (lexer->out_type[ct] < FRM_TYPE_MAX)
-                  ? typeNames[lexer->out_type[ct]] : typeNames[FRM_TYPE_MAX],
-                  lexer->out_len[ct]);
+      GPSD_LOG(session->context->debug, LOG_DATA, "VYSPI: type= %s, len= %u\n",
+               (lexer->out_type[ct] < FRM_TYPE_MAX)
+               ? typeNames[lexer->out_type[ct]] : typeNames[FRM_TYPE_MAX],
+               lexer->out_len[ct]);
 
       if(lexer->out_type[ct] == FRM_TYPE_NMEA2000) {
 
@@ -4213,36 +3536,36 @@ static gps_mask_t vyspi_parse_serial_input(struct gps_device_t *session)
               offset = 7;
 
           if(offset > lexer->out_len[ct]) {
-              gpsd_report(session->context->debug, LOG_WARN,
-                          "VYSPI: exit prematurely: %u > %lu\n",
-                          offset, lexer->outbuflen);
+              GPSD_LOG(session->context->debug, LOG_WARN,
+                       "VYSPI: exit prematurely: %u > %lu\n",
+                       offset, lexer->outbuflen);
               return 0;
           }
 
           session->driver.vyspi.last_pgn =
-              getleu32(lexer->outbuffer, lexer->out_offset[ct] + 0);
+              getleu32(packet_record(lexer, ct), 0);
 
           if(lexer->out_new_version[ct]){
 
               // this info must be available when parsing
               // the actual data in the PGN specific functions
 
-              session->driver.vyspi.prio = getub(lexer->outbuffer, lexer->out_offset[ct] + 4);
-              session->driver.vyspi.src = getub(lexer->outbuffer, lexer->out_offset[ct] + 5);
-              session->driver.vyspi.dest = getub(lexer->outbuffer, lexer->out_offset[ct] + 6);
-              gpsd_report(session->context->debug, LOG_DATA,
-                          "VYSPI: version 2 PGN = %u, prio= %u, src= %u, dest=%u\n",
-                          session->driver.vyspi.last_pgn,
-                          session->driver.vyspi.prio,
-                          session->driver.vyspi.src,
-                          session->driver.vyspi.dest);
+              session->driver.vyspi.prio = getub(packet_record(lexer, ct), 4);
+              session->driver.vyspi.src = getub(packet_record(lexer, ct), 5);
+              session->driver.vyspi.dest = getub(packet_record(lexer, ct), 6);
+              GPSD_LOG(session->context->debug, LOG_DATA,
+                       "VYSPI: version 2 PGN = %u, prio= %u, src= %u, dest=%u\n",
+                       session->driver.vyspi.last_pgn,
+                       session->driver.vyspi.prio,
+                       session->driver.vyspi.src,
+                       session->driver.vyspi.dest);
 
               session->gpsdata.src_addr_seen[session->driver.vyspi.src] = 1;
 
           } else {
-              gpsd_report(session->context->debug, LOG_DATA,
-                          "VYSPI: version 1 PGN = %u\n",
-                          session->driver.vyspi.last_pgn);
+              GPSD_LOG(session->context->debug, LOG_DATA,
+                       "VYSPI: version 1 PGN = %u\n",
+                       session->driver.vyspi.last_pgn);
           }
 
           work = vyspi_find_pgn( session->driver.vyspi.last_pgn );
@@ -4250,22 +3573,28 @@ static gps_mask_t vyspi_parse_serial_input(struct gps_device_t *session)
           if (work != NULL) {
 
               unsigned char * b =
-                  session->packet.outbuffer + offset + lexer->out_offset[ct];
+                  packet_record(lexer, ct) + offset;
+
+              gps_mask_t frame = (work->func)(b, lexer->out_len[ct] - offset,
+                                              work, session);
 
-              mask |= (work->func)(b, lexer->out_len[ct] - offset, work, session);
+              /* the next frame of the batch overwrites gpsdata.ais */
+              if ((frame & AIS_SET) != 0)
+                  aistarget_report(session);
+              mask |= frame;
 
           } else {
-              gpsd_report(session->context->debug, LOG_ERROR,
-                          "VYSPI: no work PGN found for pgn = %u\n",
-                          session->driver.vyspi.last_pgn);
+              GPSD_LOG(session->context->debug, LOG_ERROR,
+                       "VYSPI: no work PGN found for pgn = %u\n",
+                       session->driver.vyspi.last_pgn);
           }
 
       } else if (lexer->out_type[ct] == FRM_TYPE_NMEA0183) {
 
-          gpsd_report(session->context->debug, LOG_IO, "<= GPS: %s\n",
-                      lexer->outbuffer + lexer->out_offset[ct]);
+          GPSD_LOG(session->context->debug, LOG_IO, "<= GPS: %s\n",
+                   packet_record(lexer, ct));
 
-          mask |= nmea_parse_len((char *)lexer->outbuffer + lexer->out_offset[ct],
+          mask |= nmea_parse_len((char *)packet_record(lexer, ct),
                                  lexer->out_len[ct],
                                  session);
 
@@ -4273,47 +3602,50 @@ static gps_mask_t vyspi_parse_serial_input(struct gps_device_t *session)
 
           // TODO - handle multiple AIS sentences in one sentence
           if (aivdm_decode
-              ((char *)session->packet.outbuffer + lexer->out_offset[ct],
+              ((char *)packet_record(lexer, ct),
                lexer->out_len[ct],
                session, &session->gpsdata.ais,
                session->context->debug)) {
-              mask = ONLINE_SET | AIS_SET;
+              aistarget_report(session);
+              mask |= ONLINE_SET | AIS_SET;
           } else
-              mask = ONLINE_SET;
+              mask |= ONLINE_SET;
 
       } else if (lexer->out_type[ct] == FRM_TYPE_ST) {
 
-          gpsd_report(session->context->debug, LOG_RAW,
-                      "VYSPI: Seatalk len= %u (or %lu)\n",
-                      lexer->out_len[ct], lexer->outbuflen);
+          GPSD_LOG(session->context->debug, LOG_RAW,
+                   "VYSPI: Seatalk len= %u (or %lu)\n",
+                   lexer->out_len[ct], lexer->outbuflen);
 
-          mask |= process_seatalk(session->packet.outbuffer + lexer->out_offset[ct],
+          mask |= process_seatalk(packet_record(lexer, ct),
                                   lexer->out_len[ct], session);
 
       } else if (lexer->out_type[ct] == FRM_TYPE_CMD) {
 
-          if(memcmp(session->packet.outbuffer + lexer->out_offset[ct], "stat", 4) == 0) {
-              gpsd_report(session->context->debug, LOG_DATA, "DATA with STATS\n");
-              if(memcmp(session->packet.outbuffer + lexer->out_offset[ct] + 4, "n2k", 3) == 0) {
-                  uint32_t error_count = getleu32(session->packet.outbuffer, lexer->out_offset[ct] + 7);
-                  uint32_t packet_count = getleu32(session->packet.outbuffer, lexer->out_offset[ct] + 11);
-                  uint32_t frame_count = getleu32(session->packet.outbuffer, lexer->out_offset[ct] + 15);
-                  gpsd_report(session->context->debug, LOG_DATA,
-                              "DATA with N2K: packets= %u, frames= %u, errors= %u\n",
-                              packet_count, frame_count, error_count);
+          if(memcmp(packet_record(lexer, ct), "stat", 4) == 0) {
+              GPSD_LOG(session->context->debug, LOG_DATA, "DATA with STATS\n");
+              if(memcmp(packet_record(lexer, ct) + 4, "n2k", 3) == 0) {
+                  uint32_t error_count = getleu32(packet_record(lexer, ct), 7);
+                  uint32_t packet_count = getleu32(packet_record(lexer, ct), 11);
+                  uint32_t frame_count = getleu32(packet_record(lexer, ct), 15);
+                  GPSD_LOG(session->context->debug, LOG_DATA,
+                           "DATA with N2K: packets= %u, frames= %u, errors= %u\n",
+                           packet_count, frame_count, error_count);
               }
           } else {
-                  gpsd_report(session->context->debug, LOG_ERROR, "UNKOWN CMD: %s len= %u\n",
-                              session->packet.outbuffer + lexer->out_offset[ct], lexer->out_len[ct]);
+                  GPSD_LOG(session->context->debug, LOG_ERROR, "UNKOWN CMD: %s len= %u\n",
+                           packet_record(lexer, ct), lexer->out_len[ct]);
           }
 
       } else {
 
-          gpsd_report(session->context->debug, LOG_ERROR, "UNKOWN: len= %u\n",
+          GPSD_LOG(session->context->debug, LOG_ERROR, "UNKOWN: len= %u\n",
 
-                      lexer->out_len[ct]);
+                   lexer->out_len[ct]);
 
       }
+
+      latency_stage(lexer->out_type[ct], lat_decode, lexer->in_stamp);
   }
 
   // calling it here - just to make sure we are not missing a beat
@@ -4322,12 +3654,29 @@ static gps_mask_t vyspi_parse_serial_input(struct gps_device_t *session)
   return mask;
 }
 
+static void vyspi_claim_due(struct gpsd_timer_t *timer, uint64_t now UNUSED)
+/* the other nodes had VYSPI_CLAIM_WAIT to report, claim a free address */
+{
+    struct gps_device_t *session = (struct gps_device_t *)gpsd_timer_owner(timer);
+
+    if(session->gpsdata.dev.node_state != node_starting)
+        return;
+
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "NMEA 2000 node waited %d ms for others to report. Claiming source address now.\n",
+             VYSPI_CLAIM_WAIT);
+
+    vyspi_claim_free_source_addr(session);
+
+    session->gpsdata.dev.node_state = node_ready;
+}
+
 void vyspi_handle_time_trigger(struct gps_device_t *session)
 {
     if(!session->driver.nmea2000.enable_writing) {
         // nothing to do here currently if we do not want to enablle writing
-        gpsd_report(session->context->debug, LOG_RAW,
-                    "N2K not marked for write handling. Ignoring startup sequence.\n");
+        GPSD_LOG(session->context->debug, LOG_RAW,
+                 "N2K not marked for write handling. Ignoring startup sequence.\n");
         return;
     }
 
@@ -4344,9 +3693,9 @@ void vyspi_handle_time_trigger(struct gps_device_t *session)
 
                 // if we have a configured source addr lets use that and claim directly
 
-                gpsd_report(session->context->debug, LOG_INF,
-                            "NMEA 2000 node starting. Claiming stored source address 0x%02x.\n",
-                            session->driver.nmea2000.own_src_id);
+                GPSD_LOG(session->context->debug, LOG_INF,
+                         "NMEA 2000 node starting. Claiming stored source address 0x%02x.\n",
+                         session->driver.nmea2000.own_src_id);
 
                 vyspi_claim_our_source_addr(session);
 
@@ -4355,8 +3704,8 @@ void vyspi_handle_time_trigger(struct gps_device_t *session)
 
             } else {
 
-                gpsd_report(session->context->debug, LOG_INF,
-                            "NMEA 2000 node starting. No pre-configured source address. Making address claim call.\n");
+                GPSD_LOG(session->context->debug, LOG_INF,
+                         "NMEA 2000 node starting. No pre-configured source address. Making address claim call.\n");
 
                 // waiting for incoming answers now
                 session->gpsdata.dev.node_state = node_starting;
@@ -4364,22 +3713,15 @@ void vyspi_handle_time_trigger(struct gps_device_t *session)
 
                 // make a poll call to all other devices
                 vyspi_addr_claim_call(session);
+
+                // and claim when they had their time to answer
+                session->driver_timer.fire = vyspi_claim_due;
+                gpsd_timer_after(session->context, &session->driver_timer,
+                                 VYSPI_CLAIM_WAIT);
             }
 
         }
 
-    } else if(session->gpsdata.dev.node_state == node_starting) {
-
-        // give it 2 seconds to collect other node's addresses
-        if(tu_get_millis_since(&session->gpsdata.dev.node_state_time) > 2000) {
-
-            gpsd_report(session->context->debug, LOG_INF,
-                        "NMEA 2000 node waited 2 sec for others to report. Claiming source address now.\n");
-
-            vyspi_claim_free_source_addr(session);
-
-            session->gpsdata.dev.node_state = node_ready;
-        }
     }
 }
 /*@+mustfreeonly@*/
@@ -4400,8 +3742,8 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
 
   uint8_t len = 0;
 
-  gpsd_report(session->context->debug, LOG_ERROR,
-	      "VYSPI: parse_input called with packet len = %d\n", packet_len);
+  GPSD_LOG(session->context->debug, LOG_ERROR,
+           "VYSPI: parse_input called with packet len = %d\n", packet_len);
 
   // one extra for reading both, len and type/origin
   while(len + 1 < packet_len) {
@@ -4410,10 +3752,10 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
     uint8_t pkgOrg  = (uint8_t)((buf[len] & 0xF0) >> 5);
     uint8_t pkgLen =  (uint8_t)buf[len + 1] & 0xFF;
 
-    gpsd_report(session->context->debug, LOG_DATA, "VYSPI: ptype= %s, org= %d, len= %d\n",
-		((pkgType > PKG_TYPE_NMEA2000) && (pkgType < PKG_TYPE_NMEA0183))
-		? typeNames[0] : typeNames[pkgType],
-		pkgOrg, pkgLen);
+    GPSD_LOG(session->context->debug, LOG_DATA, "VYSPI: ptype= %s, org= %d, len= %d\n",
+             ((pkgType > PKG_TYPE_NMEA2000) && (pkgType < PKG_TYPE_NMEA0183))
+             ? typeNames[0] : typeNames[pkgType],
+             pkgOrg, pkgLen);
 
     // skip 2 byte header now
     len += 2;
@@ -4423,17 +3765,17 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
     if(pkgType == PKG_TYPE_NMEA2000) {
 
         if(len + pkgLen + 8 > packet_len) {
-            gpsd_report(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %d + 8 + %d > %d\n",
-                        len, pkgLen, packet_len);
+            GPSD_LOG(session->context->debug, LOG_WARN, "VYSPI: exit prematurely: %d + 8 + %d > %d\n",
+                     len, pkgLen, packet_len);
             break;
       }
 
       session->driver.vyspi.last_pgn = getleu32(buf, len);
       uint32_t pkgid = getleu32(buf, len + 4);
 
-      gpsd_report(session->context->debug, LOG_DATA,
-                  "VYSPI: PGN = %u, pid= %u, org= %u, len= %u\n",
-                  session->driver.vyspi.last_pgn, pkgid, pkgOrg, pkgLen);
+      GPSD_LOG(session->context->debug, LOG_DATA,
+               "VYSPI: PGN = %u, pid= %u, org= %u, len= %u\n",
+               session->driver.vyspi.last_pgn, pkgid, pkgOrg, pkgLen);
 
       work = vyspi_find_pgn( session->driver.vyspi.last_pgn );
 
@@ -4443,9 +3785,9 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
           mask |= (work->func)(&session->packet.outbuffer[len],
                                (int)pkgLen, work, session);
       } else {
-          gpsd_report(session->context->debug, LOG_ERROR,
-                      "VYSPI: no work PGN found for pgn = %u\n",
-                      session->driver.vyspi.last_pgn);
+          GPSD_LOG(session->context->debug, LOG_ERROR,
+                   "VYSPI: no work PGN found for pgn = %u\n",
+                   session->driver.vyspi.last_pgn);
       }
 
       // length is packet length + 8 bytes pgn/pid
@@ -4458,8 +3800,8 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
 
       gps_mask_t st = 0;
 
-      gpsd_report(session->context->debug, LOG_DATA, "VYSPI: org= %d, len= %d\n",
-		  pkgOrg, pkgLen);
+      GPSD_LOG(session->context->debug, LOG_DATA, "VYSPI: org= %d, len= %d\n",
+               pkgOrg, pkgLen);
 
       char sentence[NMEA_MAX + 1];
 
@@ -4467,12 +3809,12 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
       memcpy(sentence, (char *)&session->packet.outbuffer[len], pkgLen);
 
       if (sentence[strlen(sentence)-1] != '\n')
-          gpsd_report(session->context->debug, LOG_IO, "<= GPS: %s\n", sentence);
+          GPSD_LOG(session->context->debug, LOG_IO, "<= GPS: %s\n", sentence);
       else
-          gpsd_report(session->context->debug, LOG_IO, "<= GPS: %s", sentence);
+          GPSD_LOG(session->context->debug, LOG_IO, "<= GPS: %s", sentence);
 
       if ((st= nmea_parse(sentence, session)) == 0) {
-          gpsd_report(session->context->debug, LOG_WARN, "unknown sentence: \"%s\"\n",	sentence);
+          GPSD_LOG(session->context->debug, LOG_WARN, "unknown sentence: \"%s\"\n",	sentence);
       }
 
       mask |= st;
@@ -4482,8 +3824,8 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
 
     } else {
 
-      gpsd_report(session->context->debug, LOG_ERROR, "UNKOWN: len= %d\n",
-		  pkgLen);
+      GPSD_LOG(session->context->debug, LOG_ERROR, "UNKOWN: len= %d\n",
+               pkgLen);
 
       break;
     }
@@ -4494,6 +3836,10 @@ static gps_mask_t vyspi_parse_spi_input(struct gps_device_t *session)
 /*@+mustfreeonly@*/
 
 static gps_mask_t vyspi_parse_input(struct gps_device_t *session) {
+  // built here rather than on the first lookup, to say if it fails
+  if(!vyspi_pgnindex.built && !vyspi_index_pgns())
+    GPSD_LOG(session->context->debug, LOG_ERROR,
+             "VYSPI: can't index the PGN table, walking it\n");
   if(session->gpsdata.dev.isSerial) {
     return vyspi_parse_serial_input(session);
   } else {
@@ -4509,8 +3855,8 @@ static void vyspi_set_serial(struct gps_device_t *session, speed_t speed) {
   memset (&tty, 0, sizeof tty);
 
   if (tcgetattr(session->gpsdata.gps_fd, &session->ttyset_old) != 0) {
-    gpsd_report(session->context->debug, LOG_ERROR,
-		"SEATALK tcgetattr error %d: %s\n", errno, strerror(errno));
+    GPSD_LOG(session->context->debug, LOG_ERROR,
+             "SEATALK tcgetattr error %d: %s\n", errno, strerror(errno));
     session->gpsdata.gps_fd = -1;
     return;
   }
@@ -4532,12 +3878,12 @@ static void vyspi_set_serial(struct gps_device_t *session, speed_t speed) {
 
   /* Set Baud Rate */
   if(cfsetospeed (&session->ttyset, (speed_t)speed) < 0) {
-    gpsd_report(session->context->debug, LOG_ERROR,
-		"Failed to set new speed %d: %s\n", errno, strerror(errno));
+    GPSD_LOG(session->context->debug, LOG_ERROR,
+             "Failed to set new speed %d: %s\n", errno, strerror(errno));
   }
   if(cfsetispeed (&session->ttyset, (speed_t)speed) < 0) {
-    gpsd_report(session->context->debug, LOG_ERROR,
-		"Failed to set new speed %d: %s\n", errno, strerror(errno));
+    GPSD_LOG(session->context->debug, LOG_ERROR,
+             "Failed to set new speed %d: %s\n", errno, strerror(errno));
   }
 
   /* Setting other Port Stuff */
@@ -4588,8 +3934,8 @@ static void vyspi_set_serial(struct gps_device_t *session, speed_t speed) {
   tcflush( session->gpsdata.gps_fd, TCIFLUSH );
 
   if ( tcsetattr ( session->gpsdata.gps_fd, TCSANOW, &session->ttyset ) != 0) {
-    gpsd_report(session->context->debug, LOG_ERROR,
-		"SEATALK tcsetattr error %d: %s\n", errno, strerror(errno));
+    GPSD_LOG(session->context->debug, LOG_ERROR,
+             "SEATALK tcsetattr error %d: %s\n", errno, strerror(errno));
     session->gpsdata.gps_fd = -1;
     return;
   }
@@ -4619,15 +3965,15 @@ int vy_port_list_read(struct gps_device_t *session, struct devconfig_t * dev) {
 
         } else {
 
-            gpsd_report(session->context->debug, LOG_ERROR,
-                        "Unkown or illegal port type '%s'\n", port->type_str);
+            GPSD_LOG(session->context->debug, LOG_ERROR,
+                     "Unkown or illegal port type '%s'\n", port->type_str);
             return -1;
         }
 
         if(port->type == PORT_TYPE_SEATALK) {
             if((port->speed != 0) && (port->speed != 4800)) {
-                gpsd_report(session->context->debug, LOG_WARN,
-                            "Ignoring odd port speed for seatalk!\n");
+                GPSD_LOG(session->context->debug, LOG_WARN,
+                         "Ignoring odd port speed for seatalk!\n");
             }
         } else if(port->type == PORT_TYPE_NMEA0183) {
 
@@ -4639,17 +3985,17 @@ int vy_port_list_read(struct gps_device_t *session, struct devconfig_t * dev) {
             }
 
             if(!port_speed_matched) {
-                gpsd_report(session->context->debug, LOG_ERROR,
-                            "NMEA0183 requires legal port speed %d!\n", port->speed);
+                GPSD_LOG(session->context->debug, LOG_ERROR,
+                         "NMEA0183 requires legal port speed %d!\n", port->speed);
                 return -1;
             }
         }
 
-        gpsd_report(session->context->debug, LOG_INF,
-                    "port %d: %s @ %d baud\n",
-                    port->no,
-                    port->type_str,
-                    port->type == PORT_TYPE_SEATALK?4800:port->speed);
+        GPSD_LOG(session->context->debug, LOG_INF,
+                 "port %d: %s @ %d baud\n",
+                 port->no,
+                 port->type_str,
+                 port->type == PORT_TYPE_SEATALK?4800:port->speed);
     }
 
     if (status != 0) {
@@ -4680,9 +4026,9 @@ ssize_t vyspi_write_with_protocol(struct gps_device_t *session,
                                   const uint8_t protocol_version)
 /* pass low-level data to devices straight through */
 {
-    gpsd_report(session->context->debug, LOG_INF,
-                "vyspi_write: %s (%s) ports= %d\n",
-                buf, session->gpsdata.dev.path, session->gpsdata.dev.port_count);
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "vyspi_write: %s (%s) ports= %d\n",
+             buf, session->gpsdata.dev.path, session->gpsdata.dev.port_count);
 
     uint8_t frm[255];
     if(len == 0)
@@ -4705,10 +4051,10 @@ ssize_t vyspi_write_with_protocol(struct gps_device_t *session,
         uint32_t diff = nowms - session->driver.vyspi.bytes_written_last_ms;
         double rate = 1000.0*((double)(frmlen))/((double)diff);
         
-        gpsd_report(session->context->debug, LOG_IO,
-                    "Wrote %f bytes/s (%0.2fkBit/s) as %lu bytes in %u ms\n",
-                    rate, rate*8.0/1024.0,
-                    frmlen, diff);
+        GPSD_LOG(session->context->debug, LOG_IO,
+                 "Wrote %f bytes/s (%0.2fkBit/s) as %lu bytes in %u ms\n",
+                 rate, rate*8.0/1024.0,
+                 frmlen, diff);
         session->driver.vyspi.bytes_written_last_ms = nowms;
         
         if(session->driver.vyspi.bytes_written_last_sec + 1000 < nowms) {
@@ -4719,20 +4065,20 @@ ssize_t vyspi_write_with_protocol(struct gps_device_t *session,
                     ((double)(nowms - session->driver.vyspi.bytes_written_last_sec));
                 double rate_r = 1000.0*((double)(session->driver.vyspi.bytes_written_raw[i]))/
                     ((double)(nowms - session->driver.vyspi.bytes_written_last_sec));
-                gpsd_report(session->context->debug, LOG_IO,
-                            "%s   %0.2f (%0.2f) kBit/s with %u (%u) bytes in %u ms\n",
-                            ftn[i],
-                            rate_f*8.0/1024.0, rate_r*8.0/1024.0,
-                            session->driver.vyspi.bytes_written_frm[i],
-                            session->driver.vyspi.bytes_written_raw[i],
-                            (nowms - session->driver.vyspi.bytes_written_last_sec));
+                GPSD_LOG(session->context->debug, LOG_IO,
+                         "%s   %0.2f (%0.2f) kBit/s with %u (%u) bytes in %u ms\n",
+                         ftn[i],
+                         rate_f*8.0/1024.0, rate_r*8.0/1024.0,
+                         session->driver.vyspi.bytes_written_frm[i],
+                         session->driver.vyspi.bytes_written_raw[i],
+                         (nowms - session->driver.vyspi.bytes_written_last_sec));
                 
                 session->driver.vyspi.bytes_written_frm[i] = 0;
                 session->driver.vyspi.bytes_written_raw[i] = 0;
             }
-            gpsd_report(session->context->debug, LOG_IO,
-                        "    last= %u ms, now= %u ms\n",
-                        session->driver.vyspi.bytes_written_last_sec, nowms);
+            GPSD_LOG(session->context->debug, LOG_IO,
+                     "    last= %u ms, now= %u ms\n",
+                     session->driver.vyspi.bytes_written_last_sec, nowms);
             session->driver.vyspi.bytes_written_last_sec = nowms;
         }
     }
@@ -4756,14 +4102,14 @@ int vyspi_init(struct gps_device_t *session) {
 
     int i = 0;
 
-    gpsd_report(session->context->debug, LOG_INF,
-                    "initializing configuration for device '%s'.\n",
-		session->gpsdata.dev.path);
+    GPSD_LOG(session->context->debug, LOG_INF,
+                 "initializing configuration for device '%s'.\n",
+             session->gpsdata.dev.path);
 
     if(vy_port_list_read(session, &session->gpsdata.dev) != 0) {
 
-        gpsd_report(session->context->debug, LOG_ERROR,
-                    "Error reading port configuration. Assuming defaults.\n");
+        GPSD_LOG(session->context->debug, LOG_ERROR,
+                 "Error reading port configuration. Assuming defaults.\n");
         return 1;
     }
 
@@ -4781,20 +4127,20 @@ int vyspi_init(struct gps_device_t *session) {
 
         vy_port2cmd(&session->gpsdata.dev.portlist[i], cmd);
 
-        gpsd_report(session->context->debug, LOG_INF,
-                    "setting port configuration for port '%d'.\n",
-                    session->gpsdata.dev.portlist[i].no);
+        GPSD_LOG(session->context->debug, LOG_INF,
+                 "setting port configuration for port '%d'.\n",
+                 session->gpsdata.dev.portlist[i].no);
 
         vyspi_write(session, FRM_TYPE_CMD, cmd, 10);
     }
 
     // send start command to stm32
 
-    gpsd_report(session->context->debug, LOG_INF,
-                "Sending start command.\n");
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "Sending start command.\n");
 
     if(session->driver.nmea2000.enable_writing) {
-        gpsd_report(session->context->debug, LOG_INF,
+        GPSD_LOG(session->context->debug, LOG_INF,
                 "NMEA 2000 - enable writing - requesting new frame protocol.\n");
         memcpy(cmd, "vers", 4);
         cmd[4] = 2;
@@ -4858,8 +4204,8 @@ int vyspi_open(struct gps_device_t *session) {
 
   // this is port in case of TCP/IP or detailed port configuration for serial
 
-  gpsd_report(session->context->debug, LOG_INF,
-		"Device path = %s.\n", path);
+  GPSD_LOG(session->context->debug, LOG_INF,
+             "Device path = %s.\n", path);
 
   // SPI or serial start with "/dev"
   if(path[0] == '/') {
@@ -4868,19 +4214,19 @@ int vyspi_open(struct gps_device_t *session) {
     if(port != NULL)
       *port++ = '\0';
 
-    gpsd_report(session->context->debug, LOG_INF,
-		"Assuming SPI or serial device %s.\n", path);
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "Assuming SPI or serial device %s.\n", path);
 
     if ((dsock = open(path, O_RDWR | O_NOCTTY)) == -1) {
-      gpsd_report(session->context->debug, LOG_ERROR,
-		  "read-only device open failed: %s\n",
-		  strerror(errno));
+      GPSD_LOG(session->context->debug, LOG_ERROR,
+               "read-only device open failed: %s\n",
+               strerror(errno));
       return -1;
     }
 
     session->gpsdata.gps_fd = dsock;
-    gpsd_report(session->context->debug, LOG_INF,
-		"Device %s opened with sock = %d.\n", path, dsock);
+    GPSD_LOG(session->context->debug, LOG_INF,
+             "Device %s opened with sock = %d.\n", path, dsock);
 
     // ugly hack:
     if(strncmp(path, "/dev/vyspi", 10) == 0) {
@@ -4891,13 +4237,13 @@ int vyspi_open(struct gps_device_t *session) {
             ioctl(dsock, VYSPI_RESET, NULL);
         }
         session->gpsdata.dev.isSerial = 0;
-        gpsd_report(session->context->debug, LOG_INF,
-                    "Opened %s as SPI device.\n", path);
+        GPSD_LOG(session->context->debug, LOG_INF,
+                 "Opened %s as SPI device.\n", path);
 
     } else {
 
-        gpsd_report(session->context->debug, LOG_INF,
-                    "opening serial feed at %s.\n", path);
+        GPSD_LOG(session->context->debug, LOG_INF,
+                 "opening serial feed at %s.\n", path);
         session->gpsdata.dev.isSerial = 1;
         vyspi_set_serial(session, (speed_t)B115200);
 
@@ -4915,16 +4261,16 @@ int vyspi_open(struct gps_device_t *session) {
       } else
           *port++ = '\0';
 
-      gpsd_report(session->context->debug, LOG_INF,
-                  "opening UDP VYSPI feed at %s, port %s.\n", path, port);
+      GPSD_LOG(session->context->debug, LOG_INF,
+               "opening UDP VYSPI feed at %s, port %s.\n", path, port);
 
       if ((session->gpsdata.gps_fd = netlib_connectsock(AF_UNSPEC, path, port, "udp")) < 0) {
-          gpsd_report(session->context->debug, LOG_ERROR, "UDP device open error %s.\n",
-                      netlib_errstr(session->gpsdata.gps_fd));
+          GPSD_LOG(session->context->debug, LOG_ERROR, "UDP device open error %s.\n",
+                   netlib_errstr(session->gpsdata.gps_fd));
           return -1;
       } else
-          gpsd_report(session->context->debug, LOG_SPIN,
-                      "TCP device opened on fd %d\n", session->gpsdata.gps_fd);
+          GPSD_LOG(session->context->debug, LOG_SPIN,
+                   "TCP device opened on fd %d\n", session->gpsdata.gps_fd);
       session->gpsdata.dev.isSerial = 1;
   }
 
@@ -4948,24 +4294,19 @@ const char /*@ observer @*/ *gpsd_vyspidump(struct gps_device_t *device) {
   char *scbuf = device->msgbuf;
   size_t scbuflen = sizeof(device->msgbuf);
 
-  char *binbuf = (char *)device->packet.outbuffer;
   size_t binbuflen = device->packet.outbuflen;
 
   /*
-  gpsd_report(session->context->debug, LOG_SPIN,
-	      "VYSPI: gpsd_vyspidump %u entered with len = %ld\n",
-	      device->driver.vyspi.last_pgn, binbuflen);
+  GPSD_LOG(session->context->debug, LOG_SPIN,
+           "VYSPI: gpsd_vyspidump %u entered with len = %ld\n",
+           device->driver.vyspi.last_pgn, binbuflen);
   */
 
   size_t j = 0;
   size_t i = 0;
   int cnt = 0;
 
-  size_t maxlen =
-    (size_t) ((binbuflen >
-	       MAX_PACKET_LENGTH) ? MAX_PACKET_LENGTH : binbuflen);
-
-  if (NULL == binbuf || 0 == binbuflen) {
+  if (0 == binbuflen) {
     scbuf[0] = '\0';
     return scbuf;
   }
@@ -4980,9 +4321,9 @@ const char /*@ observer @*/ *gpsd_vyspidump(struct gps_device_t *device) {
     tu_gettime(&now);
 
     uint32_t nowms = tu_get_time_in_milli(&now);
-    const char * ibuf = (const char *)&binbuf[0];
 
     for(cnt = 0; cnt < device->packet.out_count; cnt++) {
+        const char * ibuf = (const char *)packet_record(&device->packet, cnt);
         char tmp[255];
         sprintf(tmp, "[%.4f]: %d,%u,%u,%u,%u,%d,",
                 nowms/1000.0,
@@ -4999,17 +4340,17 @@ const char /*@ observer @*/ *gpsd_vyspidump(struct gps_device_t *device) {
 
         if (device->packet.out_type[cnt] == FRM_TYPE_CMD) {
 
-            if(memcmp(&ibuf[device->packet.out_offset[cnt]], "stat", 4) == 0) {
-                if(memcmp(&ibuf[device->packet.out_offset[cnt] + 4], "n2k", 3) == 0) {
-                    uint32_t error_count = getleu32(&ibuf[device->packet.out_offset[cnt]], 7);
-                    uint32_t packet_count = getleu32(&ibuf[device->packet.out_offset[cnt]], 11);
-                    uint32_t frame_count = getleu32(&ibuf[device->packet.out_offset[cnt]], 15);
+            if(memcmp(ibuf, "stat", 4) == 0) {
+                if(memcmp(&ibuf[4], "n2k", 3) == 0) {
+                    uint32_t error_count = getleu32(ibuf, 7);
+                    uint32_t packet_count = getleu32(ibuf, 11);
+                    uint32_t frame_count = getleu32(ibuf, 15);
                     snprintf(&scbuf[j], scbuflen - j, "packets= %u, frames= %u, errors= %u\n",
                                 packet_count, frame_count, error_count);
                 }
-                else if(memcmp(&ibuf[device->packet.out_offset[cnt] + 4], "n2e", 3) == 0) {
-                    uint16_t overrun_count = getleu16(&ibuf[device->packet.out_offset[cnt]], 7);
-                    uint32_t cancel_count = getleu32(&ibuf[device->packet.out_offset[cnt]], 9);
+                else if(memcmp(&ibuf[4], "n2e", 3) == 0) {
+                    uint16_t overrun_count = getleu16(ibuf, 7);
+                    uint32_t cancel_count = getleu32(ibuf, 9);
                     snprintf(&scbuf[j], scbuflen - j, "overrun= %u, cancel= %u\n",
                                 overrun_count, cancel_count);
                 }
@@ -5020,11 +4361,10 @@ const char /*@ observer @*/ *gpsd_vyspidump(struct gps_device_t *device) {
             const char *hexchar = "0123456789abcdef";
 
             for (i = 0; j < scbuflen - 2
-                     && i + device->packet.out_offset[cnt] < maxlen
                      && i < device->packet.out_len[cnt]; i++) {
 
-                scbuf[j++] = hexchar[(ibuf[i + device->packet.out_offset[cnt]] & 0xf0) >> 4];
-                scbuf[j++] = hexchar[ibuf[i + device->packet.out_offset[cnt]] & 0x0f];
+                scbuf[j++] = hexchar[(ibuf[i] & 0xf0) >> 4];
+                scbuf[j++] = hexchar[ibuf[i] & 0x0f];
             }
             j--; // back last ',' to overwrite with '\0'
             scbuf[j] = '\0';
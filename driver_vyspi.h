@@ -12,11 +12,20 @@
 
 #include "frame.h"
 
+/* ms the other N2K nodes get to report their addresses before we claim */
+#define VYSPI_CLAIM_WAIT	2000
+/* ms without any input after which the board is configured anew */
+#define VYSPI_SILENCE		8000
+
 int vyspi_open(struct gps_device_t *session);
 int vyspi_init(struct gps_device_t *session);
 
 extern void vyspi_handle_time_trigger(struct gps_device_t *session);
 
+/* the serial frame lexer on its own, devreader.c runs it in a thread */
+extern void vyspi_lexer_compact(struct gps_packet_t *lexer);
+extern void vyspi_lexer_scan(struct gps_packet_t *lexer);
+
 const char *gpsd_vyspidump(struct gps_device_t *);
 ssize_t vyspi_write(struct gps_device_t *, 
                     enum frm_type_t,
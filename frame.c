@@ -1,5 +1,7 @@
 #include <stdint.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <string.h>
 
 #include "frame.h"
 
@@ -15,6 +17,43 @@ void frm_init(frmBuffer_t * frmBuffer) {
 }
 
 
+/*
+  Payload is mostly runs of bytes that need no escaping.  Runs are
+  found a machine word at a time and copied in one go, only the 0x7d
+  and 0x7e between them are handled byte by byte.  Loads go through
+  memcpy() so unaligned buffers are fine on MIPS and ARM as well.
+ */
+#define FRM_ONES        ((unsigned long)-1 / 0xff)  // 0x01 in every byte
+#define FRM_HIGHS       (FRM_ONES * 0x80)
+#define FRM_HASZERO(w)  (((w) - FRM_ONES) & ~(w) & FRM_HIGHS)
+
+size_t frm_span(const uint8_t * p, size_t n, uint8_t * checksum) {
+
+    const uint8_t * s = p;
+    const uint8_t * end = p + n;
+    unsigned long w, acc = 0;
+    uint8_t x = *checksum;
+    unsigned int i;
+
+    while((size_t)(end - s) >= sizeof(w)) {
+        memcpy(&w, s, sizeof(w));
+        if(FRM_HASZERO(w ^ (FRM_ONES * 0x7d)) || FRM_HASZERO(w ^ (FRM_ONES * 0x7e)))
+            break;
+        acc ^= w;
+        s += sizeof(w);
+    }
+    // fold the word checksum into a byte
+    for(i = sizeof(acc) * 4; i >= 8; i /= 2)
+        acc ^= acc >> i;
+    x ^= (uint8_t)acc;
+
+    while((s < end) && (*s != 0x7d) && (*s != 0x7e))
+        x ^= *s++;
+
+    *checksum = x;
+    return s - p;
+}
+
 /**
    to HDLC using a 16 bit destination buffer
 
@@ -53,42 +92,65 @@ uint16_t frm_toHDLC16(uint16_t * dest,
   }
 
   uint16_t i = 0;
-  for(i = 0; i < srclen; i++) {
+  while(i < srclen) {
 
-    if(destlen < q)
-      return 0;
+    uint8_t unused = 0;
+    size_t run = frm_span(src + i, srclen - i, &unused);
 
-    // do we need escaping?
-    if(((src[i] & 0xff) == 0x7d) || ((src[i] & 0xff) == 0x7e)) {
+    // the run and the escaped byte behind it
+    if(destlen < q + run + ((i + run < srclen) ? 2 : 0))
+      return 0;
 
-      // leave headroom for extra escape
-      if(destlen < q + 1)
-	return 0;
+    for(; run > 0; run--)
+      dest[q++] = src[i++];
 
-      dest[q] = 0x007d; 
-      q++; 
+    if(i < srclen) {
+      dest[q++] = 0x007d;
       // flip bit 5
-      dest[q] = 0x00ff & (src[i] ^ (1 << 5));    
-    } else 
-      dest[q] = 0x00ff & src[i];    
-    q++;
+      dest[q++] = 0x00ff & (src[i++] ^ (1 << 5));
+    }
   }
   
   return q;
 }
 
-void frm_addByte(uint8_t * dest, // destination buffer
-                     uint16_t * q,   // position
-                     uint8_t b) {    // byte to set 
+/*
+  append src escaped at dest[q], the checksum runs over what is sent
+  except the escape chars themselves
 
-    if(((b & 0xff) == 0x7d) || ((b & 0xff) == 0x7e)) {
-      dest[*q] = 0x007d; 
-      (*q)++; 
-      // flip bit 5
-      dest[*q] = 0x00ff & (b ^ (1 << 5));    
-    } else 
-      dest[*q] = 0x00ff & b;    
-    (*q)++; 
+  returns the new position or 0 if dest is too short
+ */
+static uint16_t frm_addBytes(uint8_t * dest,
+                             uint16_t q,
+                             uint16_t destlen,
+                             const uint8_t * src,
+                             uint16_t srclen,
+                             uint8_t * checksum) {
+
+    uint16_t i = 0;
+
+    while(i < srclen) {
+
+        size_t run = frm_span(src + i, srclen - i, checksum);
+
+        if(run > 0) {
+            if((size_t)destlen < q + run)
+                return 0;
+            memcpy(dest + q, src + i, run);
+            q += run;
+            i += run;
+            continue;
+        }
+
+        if(destlen < q + 2)
+            return 0;
+        dest[q++] = 0x7d;
+        // flip bit 5
+        dest[q] = src[i++] ^ (1 << 5);
+        *checksum ^= dest[q++];
+    }
+
+    return q;
 }
 
 /**
@@ -107,7 +169,12 @@ uint16_t frm_toHDLC8(uint8_t * dest,
 		     const uint16_t srclen) {
 
     uint16_t q = 1;
-    uint16_t checksum = 0;
+    uint8_t checksum = 0;
+    uint8_t len[2];
+    uint8_t cs[2];
+
+    if(destlen < 4)
+        return 0;
 
     // mark frame start
     dest[0] = 0x7e;    
@@ -120,40 +187,36 @@ uint16_t frm_toHDLC8(uint8_t * dest,
         dest[3] = 0; // port
         q= 4;
     }
+    checksum = dest[1];
 
-    if(srclen & 0x80) {
+    len[0] = 0xff & srclen;
+    if(srclen & 0xff80) {
 
-        frm_addByte(dest, &q, (0xff & srclen) | 0x80);
-        frm_addByte(dest, &q, ((0xff80 & srclen) >> 7));
+        len[0] |= 0x80;
+        len[1] = (0xff80 & srclen) >> 7;
+        q = frm_addBytes(dest, q, destlen, len, 2, &checksum);
 
-    } else {
+    } else if((len[0] != 0x7d) && (len[0] != 0x7e)) {
 
-        frm_addByte(dest, &q, (0xff & srclen));
-    }
+        // the common short frame, nothing to escape
+        dest[q++] = len[0];
+        checksum ^= len[0];
 
-    // payload
-    uint16_t i = 0;
-    for(i = 0; i < srclen; i++) {
+    } else
+        q = frm_addBytes(dest, q, destlen, len, 1, &checksum);
 
-        // leave headroom for extra escape
-        if(destlen < q + 1)
-            return 0;
-
-        frm_addByte(dest, &q, src[i]);
-    }
-
-    if(frameVersion > 0) {
+    // payload
+    if(q > 0)
+        q = frm_addBytes(dest, q, destlen, src, srclen, &checksum);
 
-        uint16_t i = 0;
+    if((q > 0) && (frameVersion > 0)) {
 
-        if(destlen < q + 2)
-            return 0;
-        for(i = 1; i < q; i++) 
-            if(dest[i] != 0x7d)
-                checksum ^= dest[i]; 
+        uint8_t unused = 0;
 
-        frm_addByte(dest, &q, checksum & 0x00ff);
-        frm_addByte(dest, &q, (checksum >> 8) & 0x00ff);
+        // xor of bytes only, the high byte is always 0
+        cs[0] = checksum;
+        cs[1] = 0;
+        q = frm_addBytes(dest, q, destlen, cs, 2, &unused);
     }
 
     return q;
@@ -219,23 +282,23 @@ int frm_put(frmBuffer_t * frm, uint8_t c) {
         // if MSB is set we have a 2 byte len (well, 15 bit)
         // we store in big endian
 
-        if(frm->len > 0) {
+        // read counts the length bytes until the payload starts,
+        // the low 7 bits alone can be 0 (a length of 128)
+        if(frm->read > 0) {
             // if MSB is set in len already then we are in second byte
             frm->state = FRM_START;
-            // printf("frm->len > 0\n");
+            frm->read = 0;
             // add low byte
             frm->len |= (b << 7);
-            // printf("b = %02x\n", b);
             
         } else {
             // if its not set in len, then this is low byte and maybe only byte
             frm->len = b & 0x7f;
-            // printf("frm->len <= 0 %02x\n", frm->len);
             if(!(b & 0x80)) {
                 // even the last byte and only byte
                 frm->state = FRM_START;
-                // printf("FRM_START\n");
-            }
+            } else
+                frm->read = 1;
         }
 
         break;
@@ -284,3 +347,50 @@ int frm_put(frmBuffer_t * frm, uint8_t c) {
     return 0;
 }
 
+int frm_decode(frmBuffer_t * frm,
+               const uint8_t * buf,
+               size_t len,
+               frm_handler_t handler,
+               void * arg) {
+
+    const uint8_t * p = buf;
+    const uint8_t * end = buf + len;
+    int frames = 0;
+
+    while(p < end) {
+
+        // copy payload runs in one go, frm_put() still takes the
+        // escapes, the last byte of a frame and all header bytes
+        if((frm->state == FRM_START) && !frm->frm7d) {
+
+            ptrdiff_t have = frm->ptr - frm->data;
+            ptrdiff_t n = (ptrdiff_t)frm->len - 1 - have;
+
+            if(n > FRM_BUFFER_SIZE - 2 - have)
+                n = FRM_BUFFER_SIZE - 2 - have;
+            if(n > end - p)
+                n = end - p;
+
+            if(n > 0) {
+                uint8_t checksum = 0;
+                size_t run = frm_span(p, n, &checksum);
+
+                memcpy(frm->ptr, p, run);
+                frm->ptr += run;
+                frm->read += run;
+                frm->act_checksum ^= checksum;
+                p += run;
+                if(p == end)
+                    break;
+            }
+        }
+
+        if(frm_put(frm, *p++)) {
+            frames++;
+            if(handler != NULL)
+                handler(frm, arg);
+        }
+    }
+
+    return frames;
+}
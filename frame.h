@@ -1,6 +1,9 @@
 #ifndef _FRM_H_
 #define _FRM_H_
 
+#include <stddef.h>
+#include <stdint.h>
+
 /**
   HDLC
 
@@ -106,6 +109,34 @@ void frm_init(frmBuffer_t * frmBuffer);
  */
 int frm_put(frmBuffer_t * frmBuffer, uint8_t c);
 
+/**
+ called by frm_decode() for every complete frame, the payload is in
+ frmBuffer->data until the next byte is put
+ */
+typedef void (*frm_handler_t)(frmBuffer_t * frmBuffer, void * arg);
+
+/**
+ process a whole buffer, e.g. what one read() returned
+
+ same as frm_put() on every character, but runs of payload are copied
+ in one go. A frame may span calls.
+
+ returns the number of complete frames
+ */
+int frm_decode(frmBuffer_t * frmBuffer,
+               const uint8_t * buf,
+               size_t len,
+               frm_handler_t handler,
+               void * arg);
+
+/**
+ length of the run at p that needs no escaping, i.e. up to the
+ first 0x7d or 0x7e or n
+
+ the bytes of the run are xor'ed into checksum
+ */
+size_t frm_span(const uint8_t * p, size_t n, uint8_t * checksum);
+
 /**
    from to HDLC in 8 bit
 
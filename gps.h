@@ -31,8 +31,6 @@ extern "C" {
 #endif
 #include <netinet/in.h> /* sockaddr_in */
 
-#include "ring_buffer.h"
-
 /*
  * 4.1 - Base version for initial JSON protocol (Dec 2009, release 2.90)
  * 4.2 - AIS application IDs split into DAC and FID (July 2010, release 2.95)
@@ -42,9 +40,12 @@ extern "C" {
  * 5.1 - GPS_PATH_MAX uses system PATH_MAX; split24 flag added. New
  *       model and serial members in part B of AIS type 24, conforming
  *       with ITU-R 1371-4. New timedrift structure (Nov 2013, release 3.10).
+ * 6.0 - The speed ring buffers are gone from navigation_t; device
+ *       type_str is DEVICE_SHORTNAME_MAX long; the canboat member of
+ *       the watch policy is an int, set by the WATCH_CANBOAT flags.
  */
-#define GPSD_API_MAJOR_VERSION	5	/* bump on incompatible changes */
-#define GPSD_API_MINOR_VERSION	1	/* bump on compatible changes */
+#define GPSD_API_MAJOR_VERSION	6	/* bump on incompatible changes */
+#define GPSD_API_MINOR_VERSION	0	/* bump on compatible changes */
 
 #define MAXTAGLEN	8	/* maximum length of sentence tag name */
 #define MAXCHANNELS	72	/* must be > 12 GPS + 12 GLONASS + 2 WAAS */
@@ -1856,13 +1857,11 @@ struct navigation_t {
 
     // speed is knots
     double speed_over_ground;
-    rb_t speed_over_grounds;
 
     double eps;		/* Speed uncertainty, meters/sec */
 
 
     double speed_thru_water;
-    rb_t speed_thru_waters;
 
   // deg north
   double course_over_ground[2];
@@ -2112,7 +2111,7 @@ typedef enum {
 } device_policy_t;
 
 struct device_port_t {
-    char type_str[PATH_MAX];
+    char type_str[DEVICE_SHORTNAME_MAX];	/* nmea0183, nmea2000 or seatalk */
     char name[DEVICE_SHORTNAME_MAX];            /* optional short name for this device */
 
     int no;
@@ -2171,7 +2170,7 @@ struct policy_t {
     bool json;				/* requesting JSON? */
     bool signalk;			/* requesting signalk? */
     bool nmea;				/* requesting dumping as NMEA? */
-    bool canboat;			/* requesting dumping as canboat? */
+    int canboat;			/* canboat records, 1 text, 2 binary */
     int raw;				/* requesting raw data? */
     bool scaled;			/* requesting report scaling? */
     bool timing;			/* requesting timing info */
@@ -2193,6 +2192,11 @@ struct policy_t {
  *   single interface configuration section
  *   e.g. there is no addr giving, then all available addr will create an interface
  */
+#define UDP_BATCH_NONE	0	/* one sendto() per sentence */
+#define UDP_BATCH_MMSG	1	/* one datagram per sentence, one sendmmsg() per cycle */
+#define UDP_BATCH_PACK	2	/* sentences packed into datagrams of up to mtu bytes */
+#define UDP_DEFAULT_MTU	1472	/* ethernet less IP and UDP headers */
+
 struct interface_t {
     char name[DEVICE_SHORTNAME_MAX];            /* optional short name for this device/interface */
     int sock;
@@ -2200,6 +2204,8 @@ struct interface_t {
     char proto[16];
     struct sockaddr_in ipaddr;
     struct sockaddr_in bcast;
+    int batch;                                  /* UDP_BATCH_*, how sentences leave */
+    int mtu;                                    /* largest packed datagram */
 };
 
 #define MAX_UUID_STR_LEN 37
@@ -2243,6 +2249,8 @@ typedef int socket_t;
 #define WATCH_DEVICE	0x000800u	/* watch specific device */
 #define WATCH_SPLIT24	0x001000u	/* split AIS Type 24s */
 #define WATCH_PPS	0x002000u	/* enable PPS JSON */
+#define WATCH_CANBOAT	0x004000u	/* NMEA2000 as canboat text */
+#define WATCH_CANBOAT_BINARY	0x008000u	/* ...as binary canboat records */
 #define WATCH_NEWSTYLE	0x010000u	/* force JSON streaming */
 #define WATCH_OLDSTYLE	0x020000u	/* force old-style streaming */
 
@@ -2386,6 +2394,7 @@ extern int gps_read(/*@out@*/struct gps_data_t *);
 extern int gps_unpack(char *, struct gps_data_t *);
 extern bool gps_waiting(const struct gps_data_t *, int);
 extern int gps_stream(struct gps_data_t *, unsigned int, /*@null@*/void *);
+extern int gps_shm_select(struct gps_data_t *, gps_mask_t);
 extern int gps_mainloop(struct gps_data_t *, int,
 			void (*)(struct gps_data_t *));
 extern const char /*@null observer@*/ *gps_data(const struct gps_data_t *);
@@ -3,7 +3,7 @@
 # This file is Copyright (c) 2010 by the GPSD project
 # BSD terms apply: see the file COPYING in the distribution root for details.
 
-api_major_version = 5   # bumped on incompatible changes
+api_major_version = 6   # bumped on incompatible changes
 api_minor_version = 0   # bumped on compatible changes
 
 from gps import *
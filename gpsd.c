@@ -1,6 +1,6 @@
 /*
  * This is the main sequence of the gpsd daemon. The IO dispatcher, main
- * select loop, and user command handling lives here.
+ * event loop, and user command handling lives here.
  *
  * This file is Copyright (c) 2010 by the GPSD project
  * BSD terms apply: see the file COPYING in the distribution root for details.
@@ -8,8 +8,9 @@
 
 #include <sys/stat.h>
 #include <sys/types.h>
-#include <sys/time.h>		/* for select() */
+#include <sys/time.h>
 #include <sys/select.h>
+#include <sys/epoll.h>
 #include <stdio.h>
 #include <time.h>
 #include <string.h>
@@ -61,12 +62,19 @@
 #include "driver_vyspi.h"
 #include "timeutil.h"
 #include "signalk.h"
+#include "history.h"
+#include "aistarget.h"
+#include "latency.h"
+#include "devreader.h"
+#include "timerwheel.h"
 #include "pseudon2k.h"
+#include "canboat.h"
 
 #if defined(SYSTEMD_ENABLE)
 #include "sd_socket.h"
 #endif
 #include "websocket.h"
+#include "outqueue.h"
 
 /*
  * The name of a tty device from which to pick up whatever the local
@@ -146,12 +154,46 @@ static const int af = AF_UNSPEC;
 static const int af = AF_INET;
 #endif
 
-int no_timeouts;
-
 #define AFCOUNT 2
 
-static fd_set all_fds;
-static int maxfd;
+/*
+ * Event loop.  Every descriptor the daemon reads from is registered
+ * with epoll once, tagged with its kind, the index of its owner (device
+ * or subscriber slot, listener, interface) and the fd itself, so each
+ * wakeup dispatches straight to the descriptors that are ready.  The fd
+ * in the tag catches events still pending for a slot that was reused
+ * earlier in the same wakeup.
+ *
+ * Everything else that has to happen at some time is a timer of the
+ * context (see gpsd_timer_arm()), and epoll sleeps exactly until the
+ * next of them is due, for good when none is.  Client and device
+ * timeouts are scanned by a housekeeping timer, at most once per
+ * HOUSEKEEPING_INTERVAL after anything happened and otherwise at the
+ * next of those timeouts only.
+ */
+enum ev_kind {
+    ev_device, ev_client, ev_listen, ev_canboat_listen,
+    ev_control_listen, ev_control, ev_udp
+};
+
+#define EV_TAG(kind, index, fd)	(((uint64_t)(kind) << 56)		\
+				 | ((uint64_t)((index) & 0xffffff) << 32) \
+				 | (uint32_t)(fd))
+#define EV_KIND(tag)		((enum ev_kind)((tag) >> 56))
+#define EV_INDEX(tag)		((int)(((tag) >> 32) & 0xffffff))
+#define EV_FD(tag)		((int)((tag) & 0xffffffff))
+
+#define EV_BATCH		32	/* events fetched per wakeup */
+#define HOUSEKEEPING_INTERVAL	1000	/* ms */
+
+static int epfd = -1;
+static struct gpsd_timer_t housekeeping_timer;
+#ifdef VYSPI_ENABLE
+static struct gpsd_timer_t vyspi_silence[MAXDEVICES];	/* see VYSPI_SILENCE */
+#endif /* VYSPI_ENABLE */
+static bool unpollable[MAXDEVICES];	/* see device_watch() */
+static unsigned int unpollable_devices;	/* how many are */
+static bool reader_threads = false;	/* -R, see devreader.h */
 #ifndef FORCE_GLOBAL_ENABLE
 static bool listen_global = false;
 #endif /* FORCE_GLOBAL_ENABLE */
@@ -180,9 +222,6 @@ uint32_t last_bytes_send_second = 0,
     last_bytes_send_second_report_ms = 0;
 
 
-const char *gpsd_canboatdump(char *scbuf, size_t scbuflen, struct gps_device_t *device);
-
-static int max_subscriber_loglevel = LOG_ERROR - 1; // -1 is LOG_ERROR
 static void set_max_subscriber_loglevel(void);
 
 static volatile sig_atomic_t signalled;
@@ -207,12 +246,12 @@ ssize_t gpsd_write(struct gps_device_t *session,
 void gpsd_external_report(const int debuglevel, const int errlevel,
      const char *fmt, ...)
 {
-    if((debuglevel < errlevel) && (max_subscriber_loglevel < errlevel))
+    if((debuglevel < errlevel) && (gpsd_log_sublevel < errlevel))
       return;
 
     va_list ap;
     va_start(ap, fmt);
-    gpsd_labeled_report(debuglevel, max_subscriber_loglevel, errlevel, "gpsd:", fmt, ap);
+    gpsd_labeled_report(debuglevel, gpsd_log_sublevel, errlevel, "gpsd:", fmt, ap);
     va_end(ap);
 }
 
@@ -278,7 +317,7 @@ static void typelist(void)
 
 static void usage(void)
 {
-    (void)printf("usage: gpsd [-b] [-n] [-N] [-D n] [-F sockfile] [-G] [-P pidfile] [-S port] [-h] device...\n\
+    (void)printf("usage: gpsd [-b] [-n] [-N] [-D n] [-F sockfile] [-G] [-L] [-P pidfile] [-Q low:high] [-R] [-S port] [-h] device...\n\
   Options include: \n\
   -b		     	    = bluetooth-safe: open data sources read-only\n\
   -n			    = don't wait for client connects to poll GPS\n\
@@ -287,7 +326,10 @@ static void usage(void)
 #ifndef FORCE_GLOBAL_ENABLE
 "  -G         		    = make gpsd listen on INADDR_ANY\n"
 #endif /* FORCE_GLOBAL_ENABLE */
-"  -P pidfile	      	    = set file to record process ID \n\
+"  -L			    = record read to send latency, see ?STATS; \n\
+  -P pidfile	      	    = set file to record process ID \n\
+  -Q low:high		    = set client output queue watermarks in bytes \n\
+  -R			    = read serial vyspi devices in threads of their own \n\
   -D integer (default 0)    = set debug level \n\
   -S integer (default %s) = set port for daemon \n\
   -h		     	    = help message \n\
@@ -341,32 +383,72 @@ static struct vessel_t vessel;
 
 static struct gps_device_t devices[MAXDEVICES];
 
-static void adjust_max_fd(int fd, bool on)
-/* track the largest fd currently in use */
+static void ev_register(int fd, enum ev_kind kind, int index,
+                        uint32_t events)
+/* start watching fd, or change what it is watched for */
 {
-    if (on) {
-    if (fd > maxfd)
-        maxfd = fd;
-    }
-#if !defined(LIMITED_MAX_DEVICES) && !defined(LIMITED_MAX_CLIENT_FD)
-    /*
-     * I suspect there could be some weird interactions here if
-     * either of these were set lower than FD_SETSIZE.  We'll avoid
-     * potential bugs by not scavenging in this case at all -- should
-     * be OK, as the use case for limiting is SBCs where the limits
-     * will be very low (typically 1) and the maximum size of fd
-     * set to scan through correspondingly small.
-     */
-    else {
-    if (fd == maxfd) {
-        int tfd;
+    struct epoll_event ev;
+
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.u64 = EV_TAG(kind, index, fd);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1
+        && (errno != EEXIST || epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == -1))
+        gpsd_report(context.debug, LOG_ERROR,
+                    "epoll_ctl(%d): %s\n", fd, strerror(errno));
+}
+
+static void ev_unregister(int fd)
+/* stop watching fd, harmless if it was never registered */
+{
+    struct epoll_event ev;	/* kernels before 2.6.9 want non-NULL */
+
+    (void)epoll_ctl(epfd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static int device_fd(const struct gps_device_t *device)
+/* what signals input of a device, its fd or that of its reader thread */
+{
+    if (device->reader != NULL)
+        return devreader_fd(device->reader);
+    return device->gpsdata.gps_fd;
+}
 
-        for (maxfd = tfd = 0; tfd < FD_SETSIZE; tfd++)
-    if (FD_ISSET(tfd, &all_fds))
-        maxfd = tfd;
+static void device_watch(struct gps_device_t *device, bool on)
+/* watch a device fd for input, or stop watching it */
+{
+    int index = (int)(device - devices);
+    int fd = device_fd(device);
+    struct epoll_event ev;
+
+    if (unpollable[index]) {
+        unpollable[index] = false;
+        unpollable_devices--;
     }
+    if (!on) {
+        ev_unregister(fd);
+        return;
     }
-#endif /* !defined(LIMITED_MAX_DEVICES) && !defined(LIMITED_MAX_CLIENT_FD) */
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.u64 = EV_TAG(ev_device, index, fd);
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == 0
+        || (errno == EEXIST && epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev) == 0))
+        return;
+    if (errno == EPERM) {
+        /*
+         * Character devices without a poll method (some SPI drivers)
+         * can't be watched.  select() used to report them readable all
+         * the time, so poll them on every pass instead.
+         */
+        gpsd_report(context.debug, LOG_INF,
+                    "device %s (fd %d) can't be watched, polling it\n",
+                    device->gpsdata.dev.path, fd);
+        unpollable[index] = true;
+        unpollable_devices++;
+    } else
+        gpsd_report(context.debug, LOG_ERROR,
+                    "epoll_ctl(%d): %s\n", fd, strerror(errno));
 }
 
 #ifdef SOCKET_EXPORT_ENABLE
@@ -632,6 +714,8 @@ static int udpsocks(void)
                 return -1;
             }
             it->sock = sock;
+            /* written to only, but socket errors still get reported */
+            ev_register(sock, ev_udp, (int)(it - interfaces), 0);
         }
     }
 
@@ -647,22 +731,102 @@ struct subscriber_t
 
     enum wsState state;
     enum wsFrameType frameType;
+
+    struct outqueue_t queue;	/* output the socket would not take yet */
+
+    /* SignalK paths and periods, NULL for all paths as they change */
+    /*@null@*/struct signalk_sub_t *subscription;
+    struct gpsd_timer_t timer;	/* when subscribed paths are next due */
+
+    int index;			/* pool slot, see sub_index() */
+    int watching;		/* watch list we are on, WATCH_NONE if none */
+    struct subscriber_t *next, *prev;	/* watch list or free list */
+    struct subscriber_t *next_active, *prev_active;
 };
 ssize_t throttled_write(struct subscriber_t *sub, const char *buf, size_t len);
 
-#define LIMITED_MAX_CLIENTS 16
 #ifdef LIMITED_MAX_CLIENTS
 #define MAXSUBSCRIBERS LIMITED_MAX_CLIENTS
 #else
-#error
+#define MAXSUBSCRIBERS 1024
 #endif
 
-#define subscribed(sub, devp)    (sub->policy.watcher && (sub->policy.devpath[0]=='\0' || strcmp(sub->policy.devpath, devp->gpsdata.dev.path)==0))
-
-static struct subscriber_t subscribers[MAXSUBSCRIBERS];	/* indexed by client file descriptor */
+/*
+ * The subscriber pool grows a chunk at a time as clients arrive, up
+ * to MAXSUBSCRIBERS.  Chunks are never moved or released, so subscriber
+ * pointers and slot numbers stay valid for the life of the daemon.
+ * Unused slots are kept on a free list.
+ *
+ * Every watching subscriber is on exactly one watch list: the list of
+ * the device its devpath names, WATCH_ALL when it has no devpath, or
+ * WATCH_PENDING while its devpath names no known device.  Reports for
+ * a device walk WATCH_ALL and that device's list and nothing else.
+ */
+#define SUBSCRIBER_CHUNK	16
+#define SUBSCRIBER_CHUNKS	((MAXSUBSCRIBERS + SUBSCRIBER_CHUNK - 1) \
+				 / SUBSCRIBER_CHUNK)
+
+#define WATCH_NONE	-1
+#define WATCH_ALL	MAXDEVICES
+#define WATCH_PENDING	(MAXDEVICES + 1)
+
+static struct subscriber_t *subscriber_chunks[SUBSCRIBER_CHUNKS];
+static int subscriber_slots;		/* slots allocated so far */
+static struct subscriber_t *free_subscribers;
+static struct subscriber_t *active_subscribers;
+static struct subscriber_t *watch_lists[MAXDEVICES + 2];
+
+#define subscriber_at(i)	(&subscriber_chunks[(i) / SUBSCRIBER_CHUNK] \
+				 [(i) % SUBSCRIBER_CHUNK])
+
+#define subscribed(sub, devp)	((sub)->watching == WATCH_ALL \
+				 || (sub)->watching == (int)((devp) - devices))
+
+#define first_watcher(devp)	(watch_lists[WATCH_ALL] != NULL \
+				 ? watch_lists[WATCH_ALL] \
+				 : watch_lists[(devp) - devices])
+#define next_watcher(devp, sub)	((sub)->next != NULL ? (sub)->next \
+				 : (sub)->watching == WATCH_ALL \
+				 ? watch_lists[(devp) - devices] : NULL)
+
+/* these fetch the successor first, so the body may detach sub */
+#define foreach_watcher(sub, nextsub, devp) \
+    for (sub = first_watcher(devp); \
+	 sub != NULL && ((nextsub = next_watcher(devp, sub)), true); \
+	 sub = nextsub)
+#define foreach_active(sub, nextsub) \
+    for (sub = active_subscribers; \
+	 sub != NULL && ((nextsub = sub->next_active), true); \
+	 sub = nextsub)
 
 #define UNALLOCATED_FD	-1
 
+/*
+ * JSON watcher reports are built once per reporting cycle for each
+ * distinct policy signature and the same bytes are handed to every
+ * subscriber with that signature.  Only scaled and timing change the
+ * encoding; split24 and devpath merely decide whether a subscriber gets
+ * the report at all, so they are checked per subscriber instead.
+ */
+#define JSON_SIG_SCALED	0x01
+#define JSON_SIG_TIMING	0x02
+#define JSON_SIG_MAX	4
+
+#define json_signature(policy)	(((policy)->scaled ? JSON_SIG_SCALED : 0) \
+				 | ((policy)->timing ? JSON_SIG_TIMING : 0))
+
+static struct {
+    bool valid[JSON_SIG_MAX];
+    size_t len[JSON_SIG_MAX];
+    char buf[JSON_SIG_MAX][GPS_JSON_RESPONSE_MAX * 4];
+} json_cache;
+
+static struct {
+    uint32_t encoded;		/* json_data_report() calls */
+    uint32_t saved;		/* subscribers served from the cache */
+    uint32_t last_report_ms;
+} json_fanout;
+
 static void lock_subscriber(struct subscriber_t *sub)
 {
     (void)pthread_mutex_lock(&sub->mutex);
@@ -673,33 +837,107 @@ static void unlock_subscriber(struct subscriber_t *sub)
     (void)pthread_mutex_unlock(&sub->mutex);
 }
 
+static void watch_unlink(struct subscriber_t *sub)
+/* take a subscriber off its watch list */
+{
+    if (sub->watching == WATCH_NONE)
+        return;
+    if (sub->prev != NULL)
+        sub->prev->next = sub->next;
+    else
+        watch_lists[sub->watching] = sub->next;
+    if (sub->next != NULL)
+        sub->next->prev = sub->prev;
+    sub->next = sub->prev = NULL;
+    sub->watching = WATCH_NONE;
+}
+
+static void watch_link(struct subscriber_t *sub, int list)
+/* move a subscriber onto the given watch list */
+{
+    watch_unlink(sub);
+    sub->watching = list;
+    sub->prev = NULL;
+    sub->next = watch_lists[list];
+    if (sub->next != NULL)
+        sub->next->prev = sub;
+    watch_lists[list] = sub;
+}
+
+static void signalk_due(struct gpsd_timer_t *, uint64_t);
+
+static bool grow_subscribers(void)
+/* add a chunk of free slots to the subscriber pool */
+{
+    int chunk = subscriber_slots / SUBSCRIBER_CHUNK;
+    int count = MAXSUBSCRIBERS - subscriber_slots;
+    struct subscriber_t *block;
+    int i;
+
+    if (count <= 0)
+        return false;
+    if (count > SUBSCRIBER_CHUNK)
+        count = SUBSCRIBER_CHUNK;
+    block = (struct subscriber_t *)calloc((size_t)count, sizeof(*block));
+    if (block == NULL) {
+        gpsd_report(context.debug, LOG_ERROR,
+                    "subscriber pool can't grow: %s\n", strerror(errno));
+        return false;
+    }
+    subscriber_chunks[chunk] = block;
+    for (i = count - 1; i >= 0; i--) {
+        struct subscriber_t *sub = &block[i];
+        sub->index = subscriber_slots + i;
+        sub->fd = UNALLOCATED_FD;
+        sub->watching = WATCH_NONE;
+        outqueue_init(&sub->queue);
+        gpsd_timer_init(&sub->timer, signalk_due, sub);
+#ifndef S_SPLINT_S
+        (void)pthread_mutex_init(&sub->mutex, NULL);
+#endif /* S_SPLINT_S */
+        sub->next = free_subscribers;
+        free_subscribers = sub;
+    }
+    subscriber_slots += count;
+    gpsd_report(context.debug, LOG_PROG,
+                "subscriber pool grown to %d slots\n", subscriber_slots);
+    return true;
+}
+
 static /*@null@*//*@observer@ */ struct subscriber_t *allocate_client(void)
 /* return the address of a subscriber structure allocated for a new session */
 {
-    int si;
+    struct subscriber_t *sub;
 
 #if UNALLOCATED_FD == 0
 #error client allocation code will fail horribly
 #endif
-    for (si = 0; si < NITEMS(subscribers); si++) {
-        if (subscribers[si].fd == UNALLOCATED_FD) {
-            subscribers[si].fd = 0;	/* mark subscriber as allocated */
+    if (free_subscribers == NULL && !grow_subscribers())
+        return NULL;
+    sub = free_subscribers;
+    free_subscribers = sub->next;
+    sub->next = sub->prev = NULL;
+
+    sub->fd = 0;	/* mark subscriber as allocated */
+
+    sub->policy.raw       = false;
+    sub->policy.nmea      = false;
+    sub->policy.canboat   = 0;
+    sub->policy.watcher   = true;
+    sub->policy.json      = false;
+    sub->policy.signalk   = false;
+    sub->policy.protocol  = tcp;
+    sub->policy.loglevel  = LOG_ERROR - 1;
 
-            subscribers[si].policy.raw       = false;
-            subscribers[si].policy.nmea      = false;
-            subscribers[si].policy.canboat   = false;
-            subscribers[si].policy.watcher   = true;
-            subscribers[si].policy.json      = false;
-            subscribers[si].policy.signalk   = false;
-            subscribers[si].policy.protocol  = tcp;
-            subscribers[si].policy.loglevel  = LOG_ERROR - 1;
+    sub->state = WS_STATE_OPENING;
+    sub->frameType = WS_INCOMPLETE_FRAME;
 
-            subscribers[si].state = WS_STATE_OPENING;
-            subscribers[si].frameType = WS_INCOMPLETE_FRAME;
-            return &subscribers[si];
-        }
-    }
-    return NULL;
+    sub->prev_active = NULL;
+    sub->next_active = active_subscribers;
+    if (active_subscribers != NULL)
+        active_subscribers->prev_active = sub;
+    active_subscribers = sub;
+    return sub;
 }
 
 static void detach_client(struct subscriber_t *sub)
@@ -712,6 +950,21 @@ static void detach_client(struct subscriber_t *sub)
     return;
     }
     c_ip = netlib_sock2ip(sub->fd);
+    if (sub->queue.stats.queued > 0)
+        gpsd_report(context.debug, LOG_INF,
+                    "client(%d) queue: peak %zu bytes, %lu frames queued, "
+                    "%lu frames (%lu bytes) coalesced, %lu writevs\n",
+                    sub_index(sub), sub->queue.stats.depth_max,
+                    sub->queue.stats.queued, sub->queue.stats.dropped,
+                    sub->queue.stats.dropped_bytes, sub->queue.stats.writevs);
+    outqueue_clear(&sub->queue);
+    memset(&sub->queue.stats, 0, sizeof(sub->queue.stats));
+    gpsd_timer_cancel(&context, &sub->timer);
+    if (sub->subscription != NULL) {
+        free(sub->subscription);
+        sub->subscription = NULL;
+    }
+    ev_unregister(sub->fd);
     (void)shutdown(sub->fd, SHUT_RDWR);
     gpsd_report(context.debug, LOG_SPIN,
     "close(%d) in detach_client()\n",
@@ -720,14 +973,12 @@ static void detach_client(struct subscriber_t *sub)
     gpsd_report(context.debug, LOG_INF,
     "detaching %s (sub %d, fd %d) in detach_client\n",
     c_ip, sub_index(sub), sub->fd);
-    FD_CLR(sub->fd, &all_fds);
-    adjust_max_fd(sub->fd, false);
     sub->active         = (timestamp_t)0;
     sub->policy.watcher = false;
     sub->policy.json    = false;
     sub->policy.signalk = false;
     sub->policy.nmea    = false;
-    sub->policy.canboat = false;
+    sub->policy.canboat = 0;
     sub->policy.raw     = 0;
     sub->policy.scaled  = false;
     sub->policy.timing  = false;
@@ -740,6 +991,17 @@ static void detach_client(struct subscriber_t *sub)
     sub->state = WS_STATE_OPENING;
     sub->frameType = WS_INCOMPLETE_FRAME;
 
+    watch_unlink(sub);
+    if (sub->prev_active != NULL)
+        sub->prev_active->next_active = sub->next_active;
+    else
+        active_subscribers = sub->next_active;
+    if (sub->next_active != NULL)
+        sub->next_active->prev_active = sub->prev_active;
+    sub->next_active = sub->prev_active = NULL;
+    sub->next = free_subscribers;
+    free_subscribers = sub;
+
     sub->fd = UNALLOCATED_FD;
     unlock_subscriber(sub);
     set_max_subscriber_loglevel();
@@ -760,8 +1022,8 @@ static const char * getProtocolName(struct subscriber_t *sub) {
 }
 
 static ssize_t throttled_write_(struct subscriber_t *sub, const char *buf,
-           size_t len)
-/* write to client -- throttle if it's gone or we're close to buffer overrun */
+           size_t len, /*@null@*/const struct outqueue_update_t *update)
+/* write to client -- queue what the socket won't take, drop it if it's gone */
 {
     ssize_t status;
 
@@ -787,73 +1049,119 @@ static ssize_t throttled_write_(struct subscriber_t *sub, const char *buf,
         }
     }
 
+    /* anything already queued has to go out first */
+    if (!outqueue_empty(&sub->queue))
+        status = 0;
+    else {
 #if defined(PPS_ENABLE)
-    gpsd_acquire_reporting_lock();
+        gpsd_acquire_reporting_lock();
 #endif /* PPS_ENABLE */
-    status = send(sub->fd, buf, len, 0);
+        status = send(sub->fd, buf, len, 0);
 #if defined(PPS_ENABLE)
-    gpsd_release_reporting_lock();
-
+        gpsd_release_reporting_lock();
 #endif /* PPS_ENABLE */
-    if (status == (ssize_t) len)
+    }
+    if (status == (ssize_t) len) {
+        if (latency.batch != 0)
+            latency_sent(sub->policy.protocol);
         return status;
-    else if (status > -1) {
+    } else if (status < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+            status = 0;		/* nothing written, queue it all */
+        else {
+            if (errno == EBADF)
+                gpsd_report(context.debug, LOG_WARN,
+                            "client(%d) has vanished.\n", sub_index(sub));
+            else
+                gpsd_report(context.debug, LOG_INF,
+                            "client(%d) write: %s\n",
+                            sub_index(sub), strerror(errno));
+            detach_client(sub);
+            return status;
+        }
+    }
+
+    if (latency.batch != 0)
+        latency.queued++;
+
+    /* start watching for writability when the queue forms */
+    if (outqueue_empty(&sub->queue))
+        ev_register(sub->fd, ev_client, sub_index(sub), EPOLLIN | EPOLLOUT);
+
+    /* a frame that is partly on the wire can no longer be coalesced */
+    if (outqueue_push(&sub->queue, buf + status, len - (size_t)status,
+                      status > 0 ? NULL : update) != 0) {
         gpsd_report(context.debug, LOG_INF,
-                    "short write disconnecting client(%d)\n",
-                    sub_index(sub));
+                    "client(%d) not reading, %zu bytes queued, "
+                    "disconnecting\n",
+                    sub_index(sub), sub->queue.depth);
+        {
+            /* lingering on close would stall the daemon for this client */
+            static struct linger nolinger = { 0, 0 };
+            (void)setsockopt(sub->fd, SOL_SOCKET, SO_LINGER,
+                             (char *)&nolinger, (int)sizeof(nolinger));
+        }
         detach_client(sub);
         return 0;
-    } else if (errno == EAGAIN || errno == EINTR)
-        return 0;		/* no data written, and errno says to retry */
-    else if (errno == EBADF)
-        gpsd_report(context.debug, LOG_WARN, "client(%d) has vanished.\n", sub_index(sub));
-    else if (errno == EWOULDBLOCK
-             && timestamp() - sub->active > NOREAD_TIMEOUT)
-        gpsd_report(context.debug, LOG_INF,
-                    "client(%d) timed out.\n", sub_index(sub));
-    else
-        gpsd_report(context.debug, LOG_INF,
-                    "client(%d) write: %s\n",
-                    sub_index(sub), strerror(errno));
-    detach_client(sub);
-    return status;
+    }
+    return (ssize_t) len;
 }
 
-ssize_t throttled_write(struct subscriber_t *sub, const char *buf,
-           size_t len) {
+static ssize_t throttled_frame_write(struct subscriber_t *sub,
+                                     const char *buf, size_t len,
+                                     /*@null@*/const struct outqueue_update_t *update)
+/* frame for the client's protocol, then write or queue */
+{
     if(isWebsocket(sub)) {
       uint8_t reply[GPS_JSON_RESPONSE_MAX + 1];
       size_t replylen = GPS_JSON_RESPONSE_MAX;
       wsMakeFrame(buf, len, reply, &replylen, WS_TEXT_FRAME);
-      return throttled_write_(sub, reply, replylen);
+      return throttled_write_(sub, reply, replylen, update);
     } else
-      return throttled_write_(sub, buf, len);
+      return throttled_write_(sub, buf, len, update);
+}
+
+ssize_t throttled_write(struct subscriber_t *sub, const char *buf,
+           size_t len) {
+    return throttled_frame_write(sub, buf, len, NULL);
+}
+
+static void flush_client(struct subscriber_t *sub)
+/* push queued output to a client whose socket has become writable */
+{
+    if (outqueue_drain(&sub->queue, sub->fd) < 0) {
+        gpsd_report(context.debug, LOG_INF,
+                    "client(%d) write: %s\n",
+                    sub_index(sub), strerror(errno));
+        detach_client(sub);
+    } else if (outqueue_empty(&sub->queue))
+        ev_register(sub->fd, ev_client, sub_index(sub), EPOLLIN);
 }
 
 static void set_max_subscriber_loglevel() {
 
   int dl = 0;
 
-  struct subscriber_t *sub;
-  for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+  struct subscriber_t *sub, *nextsub;
+  foreach_active(sub, nextsub) {
     /*@-nullderef@*/
-    if (sub == NULL || sub->active == 0)
+    if (sub->active == 0)
       continue;
 
     if(dl < sub->policy.loglevel)
       dl = sub->policy.loglevel;
   }
 
-  max_subscriber_loglevel = dl;
+  gpsd_log_sublevel = dl;
 }
 
 
 void gpsd_throttled_report(const int errlevel, const char * buf) {
 
-  struct subscriber_t *sub;
-  for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+  struct subscriber_t *sub, *nextsub;
+  foreach_active(sub, nextsub) {
     /*@-nullderef@*/
-    if (sub == NULL || sub->active == 0)
+    if (sub->active == 0)
       continue;
 
     if(errlevel <= sub->policy.loglevel) {
@@ -869,14 +1177,14 @@ static void notify_watchers(struct gps_device_t *device,
 {
     va_list ap;
     char buf[BUFSIZ];
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
 
     va_start(ap, sentence);
     (void)vsnprintf(buf, sizeof(buf), sentence, ap);
     va_end(ap);
 
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++)
-    if (sub->active != 0 && subscribed(sub, device)) {
+    foreach_watcher(sub, nextsub, device)
+    if (sub->active != 0) {
         if ((onjson && sub->policy.json) || (onpps && sub->policy.pps))
     (void)throttled_write(sub, buf, strlen(buf));
     }
@@ -887,13 +1195,23 @@ static void deactivate_device(struct gps_device_t *device)
 /* deactivate device, but leave it in the pool (do not free it) */
 {
 #ifdef SOCKET_EXPORT_ENABLE
+    struct subscriber_t *sub, *nextsub;
+
     notify_watchers(device, true, false,
         "{\"class\":\"DEVICE\",\"path\":\"%s\",\"activated\":0}\r\n",
         device->gpsdata.dev.path);
+    /* SignalK subscriptions must not send its values any more */
+    foreach_active(sub, nextsub)
+        if (sub->subscription != NULL)
+            signalk_sub_forget(sub->subscription, device);
 #endif /* SOCKET_EXPORT_ENABLE */
+#ifdef VYSPI_ENABLE
+    gpsd_timer_cancel(&context, &vyspi_silence[device - devices]);
+#endif /* VYSPI_ENABLE */
+    gpsd_timer_cancel(&context, &device->reawake_timer);
+    gpsd_timer_cancel(&context, &device->driver_timer);
     if (!BAD_SOCKET(device->gpsdata.gps_fd)) {
-    FD_CLR(device->gpsdata.gps_fd, &all_fds);
-    adjust_max_fd(device->gpsdata.gps_fd, false);
+    device_watch(device, false);
 #if defined(PPS_ENABLE) && defined(TIOCMIWAIT)
 #endif /* defined(PPS_ENABLE) && defined(TIOCMIWAIT) */
 #ifdef NTPSHM_ENABLE
@@ -922,6 +1240,48 @@ static void deactivate_device(struct gps_device_t *device)
 /* *INDENT-ON* */
 #endif /* defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE) */
 
+#ifdef SOCKET_EXPORT_ENABLE
+static void resubscribe(struct subscriber_t *sub)
+/* put a subscriber on the watch list its policy asks for */
+{
+    int list = WATCH_NONE;
+
+    if (sub->policy.watcher) {
+        if (sub->policy.devpath[0] == '\0')
+            list = WATCH_ALL;
+        else {
+            struct gps_device_t *devp = find_device(sub->policy.devpath);
+            list = (devp != NULL) ? (int)(devp - devices) : WATCH_PENDING;
+        }
+    }
+    if (list == WATCH_NONE)
+        watch_unlink(sub);
+    else if (list != sub->watching)
+        watch_link(sub, list);
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
+static void adopt_watchers(struct gps_device_t *device)
+/* a device appeared, collect the watchers that have been waiting for it */
+{
+    struct subscriber_t *sub, *nextsub;
+
+    for (sub = watch_lists[WATCH_PENDING]; sub != NULL; sub = nextsub) {
+        nextsub = sub->next;
+        if (strcmp(sub->policy.devpath, device->gpsdata.dev.path) == 0)
+            watch_link(sub, (int)(device - devices));
+    }
+}
+
+static void orphan_watchers(struct gps_device_t *device)
+/* a device is going away, its watchers wait for it to come back */
+{
+    int list = (int)(device - devices);
+
+    while (watch_lists[list] != NULL)
+        watch_link(watch_lists[list], WATCH_PENDING);
+}
+
 static bool open_device( /*@null@*/struct gps_device_t *device)
 {
     if (NULL == device || gpsd_activate(device, O_OPTIMIZE) < 0) {
@@ -942,11 +1302,14 @@ static bool open_device( /*@null@*/struct gps_device_t *device)
 
     gpsd_report(context.debug, LOG_INF,
     "device %s activated\n", device->gpsdata.dev.path);
-    FD_SET(device->gpsdata.gps_fd, &all_fds);
-    adjust_max_fd(device->gpsdata.gps_fd, true);
+    if (reader_threads)
+        (void)devreader_activate(device);
+    device_watch(device, true);
     return true;
 }
 
+static void device_reawake(struct gpsd_timer_t *, uint64_t);
+
 bool gpsd_add_device(const char *device_name, bool flag_nowait)
 /* add a device to the pool; open it right away if in nowait mode */
 {
@@ -963,6 +1326,8 @@ bool gpsd_add_device(const char *device_name, bool flag_nowait)
     for (devp = devices; devp < devices + MAXDEVICES; devp++)
         if (!allocated_device(devp)) {
             gpsd_init(devp, &context, device_name);
+            gpsd_timer_init(&devp->reawake_timer, device_reawake, devp);
+            adopt_watchers(devp);
 #ifdef NTPSHM_ENABLE
             ntpshm_session_init(devp);
 #endif /* NTPSHM_ENABLE */
@@ -1024,6 +1389,8 @@ static void handle_control(int sfd, char *buf)
         "<= control(%d): removing %s\n", sfd, stash);
     if ((devp = find_device(stash))) {
         deactivate_device(devp);
+        orphan_watchers(devp);
+        history_free(devp);
         free_device(devp);
         ignore_return(write(sfd, "OK\n", 3));
     } else
@@ -1139,6 +1506,12 @@ static void handle_control(int sfd, char *buf)
         ignore_return(write(sfd, "\n", 1));
     }
     ignore_return(write(sfd, "OK\n", 3));
+    } else if (strstr(buf, "?stats")==buf) {
+    /* write back the latency histograms followed by OK */
+    char reply[GPS_JSON_RESPONSE_MAX + 1];
+    size_t len = latency_dump(reply, sizeof(reply));
+    ignore_return(write(sfd, reply, len));
+    ignore_return(write(sfd, "OK\n", 3));
     } else {
     /* unknown command */
     ignore_return(write(sfd, "ERROR\n", 6));
@@ -1157,6 +1530,8 @@ static bool awaken(struct gps_device_t *device)
         gpsd_report(context.debug, LOG_WARN,
     "%s: open failed\n",
     device->gpsdata.dev.path);
+        orphan_watchers(device);
+        history_free(device);
         free_device(device);
         return false;
     }
@@ -1178,8 +1553,9 @@ static bool awaken(struct gps_device_t *device)
         gpsd_report(context.debug, LOG_RAW,
     "flagging descriptor %d in assign_channel()\n",
     device->gpsdata.gps_fd);
-        FD_SET(device->gpsdata.gps_fd, &all_fds);
-        adjust_max_fd(device->gpsdata.gps_fd, true);
+        if (reader_threads)
+            (void)devreader_activate(device);
+        device_watch(device, true);
         return true;
     }
     }
@@ -1190,12 +1566,10 @@ static bool privileged_user(struct gps_device_t *device)
 /* is this channel privileged to change a device's behavior? */
 {
     /* grant user privilege if he's the only one listening to the device */
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
     int subcount = 0;
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
-    if (subscribed(sub, device))
+    foreach_watcher(sub, nextsub, device)
         subcount++;
-    }
     /*
      * Yes, zero subscribers is possible. For example, gpsctl talking
      * to the daemon connects but doesn't necessarily issue a ?WATCH
@@ -1423,29 +1797,220 @@ static void gpsd_device_write(struct gps_device_t * srcdev,
     }
 }
 
-static void gpsd_udp_write(const char *buf, size_t len) {
+/*
+ * Sentences for the UDP interfaces are collected during one
+ * all_reports() cycle and leave in udp_flush() at its end, a vyspi
+ * packet with a dozen records then costs one syscall per interface
+ * rather than a dozen.  What goes out on the wire depends on the
+ * batch mode of the interface, see config_parse_proto_interface().
+ */
+#define UDP_PENDING_BYTES	8192
+#define UDP_PENDING_RECORDS	64
+
+static struct {
+    char buf[UDP_PENDING_BYTES];
+    size_t used;
+    int count;
+    size_t off[UDP_PENDING_RECORDS];
+    size_t len[UDP_PENDING_RECORDS];
+} udp_pending;
+
+#ifdef HAVE_SENDMMSG
+typedef struct mmsghdr udp_msg_t;
+#else
+/* struct mmsghdr comes with sendmmsg(), where there is none sendmsg()
+   only needs the header */
+typedef struct {
+    struct msghdr msg_hdr;
+    unsigned int msg_len;
+} udp_msg_t;
+#endif /* HAVE_SENDMMSG */
+
+static int udp_send(struct interface_t *it, udp_msg_t *msgs, int count)
+/* send count datagrams, return how many went out */
+{
+    int sent = 0;
+
+#ifdef HAVE_SENDMMSG
+    if (it->batch != UDP_BATCH_NONE) {
+        while (sent < count) {
+            int n = sendmmsg(it->sock, msgs + sent,
+                             (unsigned int)(count - sent), 0);
+            if (n < 0) {
+                if (errno == EINTR)
+                    continue;
+                gpsd_report(context.debug, LOG_ERROR,
+                            "gpsd_udp_write: (%s, %d) dropped %d datagrams (%s).\n",
+                            it->name, it->port, count - sent,
+                            strerror(errno));
+                break;
+            }
+            sent += n;
+        }
+        return sent;
+    }
+#endif /* HAVE_SENDMMSG */
+
+    for (; sent < count; sent++) {
+        if (sendmsg(it->sock, &msgs[sent].msg_hdr, 0) < 0) {
+            gpsd_report(context.debug, LOG_ERROR,
+                        "gpsd_udp_write: (%s, %d) failed (%s).\n",
+                        it->name, it->port,
+                        strerror(errno));
+        }
+    }
+    return sent;
+}
 
+static void udp_flush(void)
+/* ship the sentences collected this cycle to every UDP interface */
+{
+    static struct iovec iov[UDP_PENDING_RECORDS];
+    static udp_msg_t msgs[UDP_PENDING_RECORDS];
     struct interface_t * it;
+    int i, n;
+
+    if (udp_pending.count == 0)
+        return;
+
     for (it = interfaces; it < interfaces + MAXINTERFACES; it++) {
 
-        if( (it->name[0] != '\0')
-           && (strcmp(it->proto, "udp") == 0) ) {
+        if( (it->name[0] == '\0')
+           || (strcmp(it->proto, "udp") != 0) )
+            continue;
+
+        /* records lie back to back in the buffer, so a packed
+         * datagram is just a longer slice of it */
+        for (i = 0, n = 0; i < udp_pending.count; n++) {
+            size_t len = udp_pending.len[i];
+
+            iov[n].iov_base = udp_pending.buf + udp_pending.off[i];
+            for (i++; it->batch == UDP_BATCH_PACK
+                     && i < udp_pending.count
+                     && len + udp_pending.len[i] <= (size_t)it->mtu; i++)
+                len += udp_pending.len[i];
+            iov[n].iov_len = len;
+
+            memset(&msgs[n], 0, sizeof(msgs[n]));
+            msgs[n].msg_hdr.msg_name = &it->bcast;
+            msgs[n].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+            msgs[n].msg_hdr.msg_iov = &iov[n];
+            msgs[n].msg_hdr.msg_iovlen = 1;
+        }
+        (void)udp_send(it, msgs, n);
 
-            if(sendto(it->sock, buf, len, 0,
-                      (struct sockaddr *)&it->bcast, sizeof(struct sockaddr_in)) < 0) {
+        gpsd_report(context.debug, LOG_IO,
+                    "gpsd_udp_write: %d sentences in %d datagrams to %s\n",
+                    udp_pending.count, n, it->name);
+    }
 
-                gpsd_report(context.debug, LOG_ERROR,
-                            "gpsd_udp_write: %s (%s, %d) failed (%s).\n", buf,
-                            it->name, it->port,
-                            strerror(errno));
+    udp_pending.used = 0;
+    udp_pending.count = 0;
+}
 
-            }
-            // TODO IP ADDR
-            gpsd_report(context.debug, LOG_IO,
-                        "gpsd_udp_write: %s (%lu)\n", buf, len);
+static void gpsd_udp_write(const char *buf, size_t len) {
+
+    if (len > UDP_PENDING_BYTES)
+        len = UDP_PENDING_BYTES;
+
+    if ((udp_pending.count == UDP_PENDING_RECORDS)
+        || (udp_pending.used + len > UDP_PENDING_BYTES))
+        udp_flush();
+
+    memcpy(udp_pending.buf + udp_pending.used, buf, len);
+    udp_pending.off[udp_pending.count] = udp_pending.used;
+    udp_pending.len[udp_pending.count] = len;
+    udp_pending.used += len;
+    udp_pending.count++;
+
+    gpsd_report(context.debug, LOG_IO,
+                "gpsd_udp_write: %.*s (%lu)\n", (int)len, buf, len);
+}
+
+static void signalk_send(struct subscriber_t *sub, uint64_t paths,
+                         uint64_t now)
+/* send a subscriber the paths given, then time the next that are due */
+{
+    uint64_t next;
+
+    if (paths != 0) {
+        char buf[SIGNALK_UPDATE_MAX];
+
+        signalk_sub_dump(sub->subscription, paths, now, &vessel,
+                         buf, sizeof(buf));
+        gpsd_external_report(context.debug, LOG_INF,
+                             "signalk update: %s\n", buf);
+        /* the paths are marked sent already, so the frame must not be
+           dropped as an update; nothing would send them again */
+        (void)throttled_frame_write(sub, buf, strlen(buf), NULL);
+        /* a failed write detaches the client */
+        if (sub->subscription == NULL)
+            return;
+    }
+    next = signalk_sub_next(sub->subscription);
+    if (next != 0)
+        gpsd_timer_arm(&context, &sub->timer, next);
+    else
+        gpsd_timer_cancel(&context, &sub->timer);
+}
+
+static void signalk_due(struct gpsd_timer_t *timer, uint64_t now)
+/* a subscriber's timer fired, send what is due */
+{
+    struct subscriber_t *sub = (struct subscriber_t *)gpsd_timer_owner(timer);
+
+    if (sub->subscription != NULL)
+        signalk_send(sub, signalk_sub_due(sub->subscription, now), now);
+}
+
+static void signalk_subscribe_request(struct subscriber_t *sub,
+                                      const char *data, size_t len)
+/* a SignalK subscribe or unsubscribe message from a websocket client */
+{
+    char buf[GPS_JSON_RESPONSE_MAX];
+    struct gps_device_t *devp;
+    uint64_t subscribed, now;
+    int status;
+
+    if (len >= sizeof(buf)) {
+        gpsd_report(context.debug, LOG_WARN,
+                    "client(%d): subscription of %zu bytes ignored\n",
+                    sub_index(sub), len);
+        return;
+    }
+    memcpy(buf, data, len);
+    buf[len] = '\0';
+
+    if (sub->subscription == NULL) {
+        /* until now the client got everything */
+        sub->subscription =
+            (struct signalk_sub_t *)malloc(sizeof(struct signalk_sub_t));
+        if (sub->subscription == NULL) {
+            gpsd_report(context.debug, LOG_ERROR,
+                        "client(%d): no memory for a subscription\n",
+                        sub_index(sub));
+            return;
         }
+        signalk_sub_init(sub->subscription, true);
+    }
+    status = signalk_subscribe(sub->subscription, buf, &vessel, &subscribed);
+    if (status != 0) {
+        gpsd_report(context.debug, LOG_WARN,
+                    "client(%d): bad subscription, %s: %s\n",
+                    sub_index(sub), json_error_string(status), buf);
+        return;
     }
+    gpsd_report(context.debug, LOG_INF,
+                "client(%d): subscription %s\n", sub_index(sub), buf);
 
+    /* the values there are of what was just subscribed go out at once */
+    now = timerwheel_now();
+    for (devp = devices; devp < devices + MAXDEVICES; devp++)
+        if (allocated_device(devp))
+            (void)signalk_sub_update(sub->subscription, devp,
+                                     signalk_known_paths(devp) & subscribed,
+                                     now);
+    signalk_send(sub, signalk_sub_due(sub->subscription, now), now);
 }
 
 static ssize_t handle_websocket_request(struct subscriber_t *sub,
@@ -1524,9 +2089,14 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
             bool nmea    = false;
             bool signalk = false;
             bool track   = false;
+            bool subscribe_none = false;
+            bool vessels = false;
+            double lat = NAN, lon = NAN, radius = NAN;
             int debug    = 0;
             uint32_t startAfter = 0;
-            char field[255];
+            uint32_t until = UINT32_MAX;
+            uint32_t bucket = 0;
+            char field[255] = "";
             uint8_t pcnt = 0;
 
             gpsd_report(context.debug, LOG_INF,
@@ -1542,8 +2112,20 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
                     track = true;
                 if(strncmp(hs.params[pcnt].param, "startAfter", 10) == 0)
                     startAfter = atol(hs.params[pcnt].value);
+                if(strncmp(hs.params[pcnt].param, "until", 5) == 0)
+                    until = strtoul(hs.params[pcnt].value, NULL, 10);
+                if(strncmp(hs.params[pcnt].param, "bucket", 6) == 0)
+                    bucket = strtoul(hs.params[pcnt].value, NULL, 10);
                 if(strncmp(hs.params[pcnt].param, "field", 10) == 0)
                     strncpy(field, hs.params[pcnt].value, 254);
+                if(strncmp(hs.params[pcnt].param, "subscribe", 9) == 0)
+                    subscribe_none = strcmp(hs.params[pcnt].value, "none") == 0;
+                if(strcmp(hs.params[pcnt].param, "lat") == 0)
+                    lat = safe_atof(hs.params[pcnt].value);
+                if(strcmp(hs.params[pcnt].param, "lon") == 0)
+                    lon = safe_atof(hs.params[pcnt].value);
+                if(strcmp(hs.params[pcnt].param, "radius") == 0)
+                    radius = safe_atof(hs.params[pcnt].value);
                 pcnt++;
             }
 
@@ -1551,6 +2133,14 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
             if (strncmp(hs.resource, "/signalk", 8) == 0) {
 
                 signalk = true;
+                /* the query string is still on the resource */
+                if (strncmp(hs.resource, "/signalk/v1/api/vessels", 23) == 0) {
+                    const char *rest = hs.resource + 23;
+
+                    if (*rest == '/')
+                        rest++;
+                    vessels = *rest == '\0' || *rest == '?';
+                }
 
 
             } else if (strcmp(hs.resource, "/raw") == 0) {
@@ -1607,31 +2197,56 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
             sub->policy.watcher   = true;
             sub->policy.raw       = raw;
             sub->policy.loglevel  = debug;
+            resubscribe(sub);
             set_max_subscriber_loglevel();
 
             if(sub->frameType == WS_GET_FRAME) {
-                char content[GPS_JSON_RESPONSE_MAX - 256];
-                size_t contentlen = GPS_JSON_RESPONSE_MAX - 256; // leaving headroom for header
+                /* a track covers hours, keep it below what a client
+                   may have queued before it counts as not reading */
+                static char content[SIGNALK_GET_MAX];
+                size_t contentlen;
 
                 // TODO hier muss natürlich ein gemergter gesamt datensatz aller devices hin
                 if(track)
-                    signalk_track_dump(devices, startAfter, field, content, contentlen);
-                else
-                    signalk_full_dump(devices, &vessel, content, contentlen);
+                    signalk_track_dump(devices, startAfter, until, bucket,
+                                       field, content, sizeof(content));
+                else if(vessels) {
+                    /* all targets, or those within radius m of lat/lon */
+                    struct aistarget_query_t query;
+
+                    memset(&query, 0, sizeof(query));
+                    query.kind = aistarget_all;
+                    if(isfinite(lat) && isfinite(lon)
+                       && isfinite(radius) && radius > 0) {
+                        query.kind = aistarget_radius;
+                        query.lat = lat;
+                        query.lon = lon;
+                        query.radius = radius;
+                    }
+                    signalk_vessels_dump(devices, &vessel, context.ais_targets,
+                                         &query, tu_get_independend_time(),
+                                         content, sizeof(content));
+                } else
+                    signalk_full_dump(devices, &vessel, content,
+                                      GPS_JSON_RESPONSE_MAX - 256);
+                contentlen = strlen(content);
 
                 len = snprintf(reply, replylen,
                                "HTTP/1.1 200 OK\r\n"
                                "Content-Length: %lu\r\n"
                                "Connection: close\r\n"
                                "Access-Control-Allow-Origin: *\r\n"
-                               "Content-Type: application/json\r\n\r\n%s",
-                               strlen(content), content);
+                               "Content-Type: application/json\r\n\r\n",
+                               (unsigned long)contentlen);
                 gpsd_report(context.debug, LOG_INF,
-                            "returning GET (%lu): %s\n", replylen, reply);
+                            "returning GET (%lu): %s%s\n",
+                            (unsigned long)contentlen, reply, content);
 
                 sub->policy.protocol  = http;
 
-                return throttled_write(sub, reply, len);
+                if (throttled_write(sub, reply, len) <= 0)
+                    return -1;
+                return throttled_write(sub, content, contentlen);
             }
 
 
@@ -1644,6 +2259,14 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
 
             sub->policy.protocol  = websocket;
 
+            /* the client subscribes to what it wants itself */
+            if (signalk && subscribe_none && sub->subscription == NULL) {
+                sub->subscription = (struct signalk_sub_t *)
+                    malloc(sizeof(struct signalk_sub_t));
+                if (sub->subscription != NULL)
+                    signalk_sub_init(sub->subscription, false);
+            }
+
             sub->state = WS_STATE_NORMAL;
             sub->frameType = WS_INCOMPLETE_FRAME;
             gpsd_report(context.debug, LOG_INF,
@@ -1664,10 +2287,10 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
                 return -1;
             }
         } else if (sub->frameType == WS_TEXT_FRAME) {
-            len = replylen;
-            wsMakeFrame("echo", 6, reply, &len, WS_TEXT_FRAME);
             sub->frameType = WS_INCOMPLETE_FRAME;
-            return 0; // throttled_write(sub, reply, len);
+            if (sub->policy.signalk)
+                signalk_subscribe_request(sub, (const char *)data, dataSize);
+            return 0;
         }
 
         // we should never get here
@@ -1677,6 +2300,43 @@ static ssize_t handle_websocket_request(struct subscriber_t *sub,
     return -1;
 }
 
+static void clients_dump(struct subscriber_t *to,
+                         /*@out@*/char *reply, size_t replylen)
+/* a CLIENT object per connected client, then how many there were */
+{
+    static const char *protocols[] = {"tcp", "ws", "http"};
+    struct subscriber_t *sub, *nextsub;
+    char line[GPS_JSON_RESPONSE_MAX];
+    unsigned int count = 0;
+
+    foreach_active(sub, nextsub) {
+        const char *protocol = "unknown";
+
+        if (sub->fd == UNALLOCATED_FD)
+            continue;
+        if ((unsigned int)sub->policy.protocol < NITEMS(protocols))
+            protocol = protocols[sub->policy.protocol];
+        (void)snprintf(line, sizeof(line),
+                       "{\"class\":\"CLIENT\",\"index\":%d,"
+                       "\"protocol\":\"%s\",\"watcher\":%s,"
+                       "\"pending\":%u,\"depth\":%zu,\"depth_max\":%zu,"
+                       "\"queued\":%lu,\"dropped\":%lu,"
+                       "\"dropped_bytes\":%lu,\"writevs\":%lu}\r\n",
+                       sub_index(sub),
+                       protocol,
+                       sub->policy.watcher ? "true" : "false",
+                       sub->queue.count, sub->queue.depth,
+                       sub->queue.stats.depth_max, sub->queue.stats.queued,
+                       sub->queue.stats.dropped,
+                       sub->queue.stats.dropped_bytes,
+                       sub->queue.stats.writevs);
+        (void)throttled_write(to, line, strlen(line));
+        count++;
+    }
+    (void)snprintf(reply, replylen,
+                   "{\"class\":\"CLIENTS\",\"count\":%u}\r\n", count);
+}
+
 static void handle_request(struct subscriber_t *sub,
        const char *buf, const char **after,
        char *reply, size_t replylen)
@@ -1712,6 +2372,7 @@ static void handle_request(struct subscriber_t *sub,
 #ifndef TIMING_ENABLE
             sub->policy.timing = false;
 #endif /* TIMING_ENABLE */
+            resubscribe(sub);
             if (end == NULL)
                 buf += strlen(buf);
             else {
@@ -1952,6 +2613,42 @@ static void handle_request(struct subscriber_t *sub,
     } else if (strncmp(buf, "VERSION;", 8) == 0) {
         buf += 8;
         json_version_dump(reply, replylen);
+    } else if (strncmp(buf, "STATS;", 6) == 0) {
+        buf += 6;
+        (void)latency_dump(reply, replylen);
+    } else if (strncmp(buf, "CLIENTS;", 8) == 0) {
+        buf += 8;
+        clients_dump(sub, reply, replylen);
+    } else if (strncmp(buf, "AIS", 3) == 0
+           && (buf[3] == ';' || buf[3] == '=')) {
+        struct aistarget_query_t query;
+        int status = 0;
+
+        buf += 3;
+        if (*buf == ';') {
+            ++buf;
+            (void)aistarget_query_parse("{}", &query, NULL);
+        } else {
+            status = aistarget_query_parse(buf + 1, &query, &end);
+            if (end == NULL)
+                buf += strlen(buf);
+            else {
+                if (*end == ';')
+                    ++end;
+                buf = end;
+            }
+        }
+        if (status != 0)
+            (void)snprintf(reply, replylen,
+                "{\"class\":\"ERROR\",\"message\":\"Invalid AIS: %s\"}\r\n",
+                json_error_string(status));
+        else if (context.ais_targets == NULL)
+            (void)strlcpy(reply,
+                "{\"class\":\"ERROR\",\"message\":\"No AIS targets kept\"}\r\n",
+                replylen);
+        else
+            aistarget_json_dump(context.ais_targets, &query,
+                                tu_get_independend_time(), reply, replylen);
     } else {
         const char *errend;
         errend = buf + strlen(buf) - 1;
@@ -1968,56 +2665,82 @@ static void handle_request(struct subscriber_t *sub,
         *after = buf;
 }
 
-/*@-mustdefine@*/
-const char /*@ observer @*/ *gpsd_canboatdump(char *scbuf, size_t scbuflen,
-      struct gps_device_t *device)
+/*
+ * The canboat records of a packet, as text and as binary, are made
+ * once when the first subscriber wants them and then written to every
+ * other one as they are.  raw_report() invalidates them per packet.
+ */
+#define CANBOAT_RECORDS_MAX	(MAX_PACKET_LENGTH * 2 + 1)
+static struct {
+    bool made[2];
+    size_t len[2];
+    char text[MAX_OUT_BUF_RECORDS * (CANBOAT_TEXT_HEADER + 3)
+              + CANBOAT_RECORDS_MAX * 3];
+    uint8_t binary[MAX_OUT_BUF_RECORDS * CANBOAT_HEADER
+                   + CANBOAT_RECORDS_MAX];
+} canboat_out;
+
+static const char *canboat_records(struct gps_device_t *device, bool binary,
+                                   size_t *lenp)
+/* the NMEA2000 records of a packet in canboat format */
 {
-    size_t i;
-    int32_t j, jj = 0;
-    uint16_t ct = 0;
-    const char *hexchar = "0123456789abcdef";
-
-    // no sense in coparing to outbuffer as a fixed size array here
-    if (0 == device->packet.outbuflen)
-        return "";
-
-    for(ct = 0; ct < device->packet.out_count; ct++) {
-
-        if(device->packet.out_type[ct] == FRM_TYPE_NMEA2000) {
+    struct gps_packet_t *lexer = &device->packet;
+    char when[32];
+    int64_t realtime;
+    size_t len = 0;
+    uint16_t ct;
 
-            if(4 > device->packet.out_len[ct]) {
-                continue;
-            }
+    if (canboat_out.made[binary]) {
+        *lenp = canboat_out.len[binary];
+        return binary ? (const char *)canboat_out.binary : canboat_out.text;
+    }
 
-            uint32_t pgn =
-                getleu32(device->packet.outbuffer + device->packet.out_offset[ct], 0);
+    /* every record of a packet came with the same read() */
+    realtime = canboat_offset();
+    if (!binary)
+        canboat_time(when, sizeof(when), lexer->in_stamp, realtime);
 
-            const uint8_t *ibuf =
-                device->packet.outbuffer + 4 + device->packet.out_offset[ct];
+    for (ct = 0; ct < lexer->out_count; ct++) {
+        const uint8_t *frame = packet_record(lexer, ct);
+        struct canboat_record_t rec;
+        uint16_t offset = lexer->out_new_version[ct] ? 7 : 4;
+        size_t n;
 
-            jj = snprintf((char *)(&scbuf[j]), scbuflen - j,
-                          "%s,3,%u,2,255,%u",
-                         "2016-04-01-07:54:13.595",
-                         pgn, device->packet.out_len[ct] - 4);
-            if(jj < 0)
-                continue;
-            j += jj;
+        if (lexer->out_type[ct] != FRM_TYPE_NMEA2000
+            || lexer->out_len[ct] < offset)
+            continue;
 
-            /*@ -shiftimplementation @*/
-            for (i = 0; i < (size_t)device->packet.out_len[ct] - 4 && i * 2 < scbuflen - 2; i++) {
-                scbuf[j++] = ',';
-                scbuf[j++] = hexchar[(ibuf[i] & 0xf0) >> 4];
-                scbuf[j++] = hexchar[ibuf[i] & 0x0f];
-            }
-            /*@ +shiftimplementation @*/
-            scbuf[j++] = '\r';
-            scbuf[j++] = '\n';
-            scbuf[j] = '\0';
+        rec.stamp = lexer->in_stamp;
+        rec.offset = realtime;
+        rec.pgn = getleu32(frame, 0);
+        if (lexer->out_new_version[ct]) {
+            rec.prio = getub(frame, 4);
+            rec.src = getub(frame, 5);
+            rec.dst = getub(frame, 6);
+        } else {
+            rec.prio = CANBOAT_PRIO;
+            rec.src = CANBOAT_SRC;
+            rec.dst = CANBOAT_DST;
         }
+        rec.len = lexer->out_len[ct] - offset;
+        rec.data = frame + offset;
+
+        if (binary)
+            n = canboat_pack(canboat_out.binary + len,
+                             sizeof(canboat_out.binary) - len, &rec);
+        else
+            n = canboat_text(canboat_out.text + len,
+                             sizeof(canboat_out.text) - len, when, &rec);
+        if (n == 0)
+            break;
+        len += n;
     }
-    return scbuf;
+
+    canboat_out.made[binary] = true;
+    canboat_out.len[binary] = len;
+    *lenp = len;
+    return binary ? (const char *)canboat_out.binary : canboat_out.text;
 }
-/*@+mustdefine@*/
 
 static void raw_report_write(struct subscriber_t *sub, struct gps_device_t *device) {
 
@@ -2038,7 +2761,7 @@ static void raw_report_write(struct subscriber_t *sub, struct gps_device_t *devi
             if((device->packet.out_type[cnt] == FRM_TYPE_AIS)
                || (FRM_TYPE_NMEA0183 == device->packet.out_type[cnt])) {
                 (void)throttled_write(sub,
-                                      (char *)(device->packet.outbuffer + device->packet.out_offset[cnt]),
+                                      (char *)packet_record(&device->packet, cnt),
                                       device->packet.out_len[cnt]);
                 gpsd_report(context.debug, LOG_DATA,
                             "<= RAWREPORT write vyspi %s - len=%d\n",
@@ -2053,21 +2776,28 @@ static void raw_report_write(struct subscriber_t *sub, struct gps_device_t *devi
      * super-raw mode.
      */
     if (sub->policy.raw > 1) {
-        (void)throttled_write(sub,
-                              (char *)device->packet.outbuffer,
-                              device->packet.outbuflen);
+        if (VYSPI_PACKET == device->packet.type) {
+            uint16_t cnt = 0;
+
+            for(cnt = 0; cnt < device->packet.out_count; cnt++)
+                (void)throttled_write(sub,
+                                      (char *)packet_record(&device->packet, cnt),
+                                      device->packet.out_len[cnt]);
+        } else
+            (void)throttled_write(sub,
+                                  (char *)device->packet.outbuffer,
+                                  device->packet.outbuflen);
         return;
     }
 
 #ifdef BINARY_ENABLE
-#ifdef VYSPI_ENABLE
-#endif
     if (device->packet.type == VYSPI_PACKET) {
-        if(sub->policy.canboat == 1) {
-            const char * hd =
-                gpsd_canboatdump(device->msgbuf, sizeof(device->msgbuf),
-                                 device);
-            (void)throttled_write(sub, (char *)hd, strlen(hd));
+        if (sub->policy.canboat > 0) {
+            size_t len;
+            const char *records =
+                canboat_records(device, sub->policy.canboat > 1, &len);
+            if (len > 0)
+                (void)throttled_write(sub, (char *)records, len);
         }
         if (sub->policy.raw == 1) {
             const char *hd = gpsd_vyspidump(device);
@@ -2095,7 +2825,7 @@ static void raw_report_write(struct subscriber_t *sub, struct gps_device_t *devi
 static void raw_report(struct gps_device_t *device)
 /* report a raw packet to a subscriber */
 {
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
 
     gpsd_report(context.debug, LOG_DATA,
                 "<= RAWREPORT %s\n",
@@ -2106,10 +2836,11 @@ static void raw_report(struct gps_device_t *device)
      * copied to all clients that are in raw or nmea
      * mode.
      */
+    canboat_out.made[0] = canboat_out.made[1] = false;
     /* update all subscribers associated with this device */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+    foreach_watcher(sub, nextsub, device) {
     /*@-nullderef@*/
-    if (sub == NULL || sub->active == 0 || !subscribed(sub, device))
+    if (sub->active == 0)
     continue;
 
     raw_report_write(sub, device);
@@ -2133,9 +2864,9 @@ static void raw_report(struct gps_device_t *device)
                || (FRM_TYPE_NMEA0183 == device->packet.out_type[cnt])) {
 
                 (void)gpsd_device_write(device,  FRM_TYPE_NMEA0183,
-                                        (char *)(device->packet.outbuffer + device->packet.out_offset[cnt]),
+                                        (char *)packet_record(&device->packet, cnt),
                                         device->packet.out_len[cnt]);
-                (void)gpsd_udp_write((char *)(device->packet.outbuffer + device->packet.out_offset[cnt]),
+                (void)gpsd_udp_write((char *)packet_record(&device->packet, cnt),
                                      device->packet.out_len[cnt]);
             }
         }
@@ -2154,11 +2885,11 @@ static void pseudonmea_write(gps_mask_t changed,
        we just catch an empty buffer here (which would cause trouble with many clients */
     if(len <= 0) return;
 
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
     /* update all subscribers associated with this device */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+    foreach_watcher(sub, nextsub, device) {
         /*@-nullderef@*/
-        if (sub == NULL || sub->active == 0 || !subscribed(sub, device))
+        if (sub->active == 0)
             continue;
         if (sub->policy.watcher && sub->policy.nmea) {
             if (changed & DATA_IS) {
@@ -2301,16 +3032,14 @@ static void signalk_report(gps_mask_t changed,
         return;
     }
 
-    char buf[MAX_PACKET_LENGTH * 3 + 2];
-    struct subscriber_t *sub;
-    gps_mask_t reported = 0;
-
-    if (changed & DATA_IS) {
-        reported = signalk_update_dump(device, &vessel, buf, sizeof(buf));
-    }
+    char buf[SIGNALK_UPDATE_MAX];
+    size_t buflen = 0;
+    struct subscriber_t *sub, *nextsub;
+    struct outqueue_update_t update;
+    uint64_t paths, now = 0;
 
-    // nothing to report - NOTE: this flag needs to be set in signalk-dump
-    if(!reported) {
+    paths = signalk_changed_paths(device);
+    if (paths == 0) {
         gpsd_report(context.debug, LOG_DATA,
                     "<= SIGNALK nothing to report\n");
         return;
@@ -2319,38 +3048,74 @@ static void signalk_report(gps_mask_t changed,
     /* update all subscribers associated with this device
        we are not sending to http protocol which requires explicit GET requests
      */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+    foreach_watcher(sub, nextsub, device) {
         /*@-nullderef@*/
-        if (sub == NULL || sub->active == 0 || !subscribed(sub, device))
+        if (sub->active == 0)
             continue;
-        if (sub->policy.watcher && sub->policy.signalk
-            && sub->policy.protocol != http) {
-            if (changed & DATA_IS) {
-                gpsd_external_report(context.debug, LOG_INF,
-                                     "signalk update: %s\n",
-                                     buf);
-                (void)throttled_write(sub, buf, strlen(buf));
-            }
+        if (!sub->policy.watcher || !sub->policy.signalk
+            || sub->policy.protocol == http)
+            continue;
+        if (sub->subscription != NULL) {
+            /* what is not due yet waits for the subscriber's timer */
+            if (now == 0)
+                now = timerwheel_now();
+            signalk_send(sub, signalk_sub_update(sub->subscription, device,
+                                                 paths, now), now);
+            continue;
+        }
+        /* everything as it changes, the same delta for all of them */
+        if (buflen == 0) {
+            (void)signalk_update_dump(device, &vessel, buf, sizeof(buf));
+            buflen = strlen(buf);
+            update.source = device;
+            update.paths = paths;
         }
+        gpsd_external_report(context.debug, LOG_INF,
+                             "signalk update: %s\n",
+                             buf);
+        (void)throttled_frame_write(sub, buf, buflen, &update);
     }
 }
 
+#ifdef SOCKET_EXPORT_ENABLE
+static void json_fanout_report(void)
+/* once a second, tell how many JSON encodes the report cache saved */
+{
+    struct timespec now;
+    uint32_t nowms, elapsed;
+
+    if (context.debug < LOG_PROG)
+        return;
+
+    tu_gettime(&now);
+    nowms = tu_get_time_in_milli(&now);
+    elapsed = nowms - json_fanout.last_report_ms;
+    if (elapsed < 1000)
+        return;
+
+    gpsd_report(context.debug, LOG_PROG,
+                "JSON fan-out: %u encodes, %0.1f encodes/s saved\n",
+                json_fanout.encoded,
+                1000.0 * json_fanout.saved / elapsed);
+    json_fanout.encoded = 0;
+    json_fanout.saved = 0;
+    json_fanout.last_report_ms = nowms;
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
 static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 /* report on the corrent packet from a specified device */
 {
 #ifdef SOCKET_EXPORT_ENABLE
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
+
+    /* client writes from here on are timed against the device read */
+    if (latency.enabled)
+        latency_dispatch(device->packet.in_stamp, device->packet.out_types);
 
     /* add any just-identified device to watcher lists */
     if ((changed & DRIVER_IS) != 0) {
-    bool listeners = false;
-    for (sub = subscribers;
-         sub < subscribers + MAXSUBSCRIBERS; sub++)
-        if (sub->active != 0
-    && sub->policy.watcher
-    && subscribed(sub, device))
-    listeners = true;
-    if (listeners) {
+    if (first_watcher(device) != NULL) {
         (void)awaken(device);
     }
     }
@@ -2458,9 +3223,8 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
     }
 
 #ifdef SHM_EXPORT_ENABLE
-    if ((changed & (REPORT_IS|GST_SET|SATELLITE_SET|SUBFRAME_SET|
-        ATTITUDE_SET|RTCM2_SET|RTCM3_SET|AIS_SET)) != 0)
-    shm_update(&context, &device->gpsdata);
+    /* rewrites only the sections of this device the report changed */
+    shm_update(&context, device, changed);
 #endif /* SHM_EXPORT_ENABLE */
 
     /* report n2k packages to n2k device, node should never be ready if not write enabled */
@@ -2480,6 +3244,9 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
     /* report raw packets to users subscribed to those */
     raw_report(device);
 
+    /* everything for the UDP interfaces has been collected */
+    udp_flush();
+
     if(context.debug >= LOG_IO) {
         struct timespec now;
         tu_gettime(&now);
@@ -2510,9 +3277,9 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
 
 #ifdef SOCKET_EXPORT_ENABLE
     /* update all subscribers associated with this device */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+    foreach_watcher(sub, nextsub, device) {
     /*@-nullderef@*/
-    if (sub == NULL || sub->active == 0 || !subscribed(sub, device))
+    if (sub->active == 0)
         continue;
 
 #ifdef PASSTHROUGH_ENABLE
@@ -2546,7 +3313,7 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
     "time to report a fix\n");
 
     if (sub->policy.json) {
-        char buf[GPS_JSON_RESPONSE_MAX * 4];
+        int sig = json_signature(&sub->policy);
 
         if ((changed & AIS_SET) != 0)
     if (device->gpsdata.ais.type == 24
@@ -2554,18 +3321,35 @@ static void all_reports(struct gps_device_t *device, gps_mask_t changed)
         && !sub->policy.split24)
         continue;
 
-        json_data_report(changed,
+        if (!json_cache.valid[sig]) {
+    json_data_report(changed,
          device, &sub->policy,
-         buf, sizeof(buf));
-        if (buf[0] != '\0')
-    (void)throttled_write(sub, buf, strlen(buf));
+         json_cache.buf[sig], sizeof(json_cache.buf[sig]));
+    json_cache.len[sig] = strlen(json_cache.buf[sig]);
+    json_cache.valid[sig] = true;
+    json_fanout.encoded++;
+    latency.fanout.encoded++;
+        } else {
+    json_fanout.saved++;
+    latency.fanout.saved++;
+        }
+
+        if (json_cache.len[sig] > 0)
+    (void)throttled_write(sub, json_cache.buf[sig],
+          json_cache.len[sig]);
 
     }
         }
     }
     /*@+nullderef@*/
     } /* subscribers */
+
+    /* cached encodings are only good for this report */
+    memset(json_cache.valid, 0, sizeof(json_cache.valid));
+    json_fanout_report();
 #endif /* SOCKET_EXPORT_ENABLE */
+
+    latency_done();
 }
 
 static void handle_gpsd_cleanstring(const char *buf, char * reply) {
@@ -2596,7 +3380,7 @@ static int handle_gpsd_request(struct subscriber_t *sub, const char *buf)
 /* execute GPSD requests from a buffer */
 {
     char reply[GPS_JSON_RESPONSE_MAX + 1];
-    struct subscriber_t *othersub = NULL;
+    struct subscriber_t *othersub = NULL, *nextsub;
 
     reply[0] = '\0';
     if (((strncmp(buf, "GET ", 4) == 0) || (strncmp(buf, "OPTIONS ", 8) == 0))
@@ -2634,8 +3418,8 @@ static int handle_gpsd_request(struct subscriber_t *sub, const char *buf)
             handle_gpsd_cleanstring(buf, reply);
 
             // copy to web sockets for monitoring as well
-            for (othersub = subscribers; othersub < subscribers + MAXSUBSCRIBERS; othersub++) {
-                if (othersub == NULL || othersub->active == 0
+            foreach_active(othersub, nextsub) {
+                if (othersub->active == 0
                     || !(othersub->policy.protocol == websocket) || !(othersub->policy.nmea))
                         continue;
                 throttled_write(othersub, reply, strlen(reply));
@@ -2760,13 +3544,12 @@ static void gpsd_terminate(struct gps_context_t *context)
 #endif /* PPS_ENABLE */
 }
 
+#ifdef SOCKET_EXPORT_ENABLE
 static struct subscriber_t *
-gpsd_accept_client_socket(fd_set *rfds, int sock) {
+gpsd_accept_client_socket(int sock) {
 
     sockaddr_t fsin;
     struct subscriber_t *client = NULL;
-
-    if (sock >= 0 && FD_ISSET(sock, rfds)) {
     socklen_t alen = (socklen_t) sizeof(fsin);
     /*@+matchanyintegral@*/
     socket_t ssock =
@@ -2803,9 +3586,9 @@ gpsd_accept_client_socket(fd_set *rfds, int sock) {
                     client = NULL;
                 } else {
                     // char announce[GPS_JSON_RESPONSE_MAX];
-                    FD_SET(ssock, &all_fds);
-                    adjust_max_fd(ssock, true);
                     client->fd = ssock;
+                    ev_register(ssock, ev_client, sub_index(client), EPOLLIN);
+                    resubscribe(client);
                     client->active = timestamp();
                     gpsd_report(context.debug, LOG_INF,
                                 "client %s (%d) connect on fd %d\n", c_ip,
@@ -2817,29 +3600,433 @@ gpsd_accept_client_socket(fd_set *rfds, int sock) {
                     */
                 }
     }
-    FD_CLR(sock, rfds);
-    }
 
     return client;
 }
 
+static void read_client(struct subscriber_t *sub)
+/* accept and execute commands from a client */
+{
+    char buf[BUFSIZ];
+    int buflen;
+
+    gpsd_report(context.debug, LOG_PROG,
+                "checking client(%d)\n",
+                sub_index(sub));
+    if ((buflen =
+         (int)recv(sub->fd, buf, sizeof(buf) - 1, 0)) <= 0) {
+        if (buflen < 0 && (errno == EAGAIN || errno == EINTR))
+            return;
+        gpsd_report(context.debug, LOG_ERR,
+                    "recv from client(%d) returned %d: %s\n",
+                    sub_index(sub), buflen, strerror(errno));
+        detach_client(sub);
+    } else {
+        if (buf[buflen - 1] != '\n')
+            buf[buflen++] = '\n';
+        buf[buflen] = '\0';
+        gpsd_report(context.debug, LOG_CLIENT,
+                    "<= client(%d): %s, len=%d\n", sub_index(sub), buf, buflen);
+
+        /*
+         * When a command comes in, update subscriber.active to
+         * timestamp() so we don't close the connection
+         * after COMMAND_TIMEOUT seconds. This makes
+         * COMMAND_TIMEOUT useful.
+         */
+        sub->active = timestamp();
+        if (handle_gpsd_request(sub, buf) < 0)
+            detach_client(sub);
+    }
+}
+
+static timestamp_t check_client_timeouts(struct subscriber_t *sub)
+/* drop clients that never asked for anything, lock idle TCP ones to NMEA;
+   return when to look again, 0 if nothing is pending */
+{
+    if (!sub->policy.watcher) {
+        if (timestamp() - sub->active > COMMAND_TIMEOUT) {
+            gpsd_report(context.debug, LOG_WARN,
+                        "client(%d) timed out on command wait.\n",
+                        sub_index(sub));
+            detach_client(sub);
+            return 0;
+        }
+        return sub->active + COMMAND_TIMEOUT;
+    }
+    if (sub->policy.protocol == tcp
+        && !sub->policy.nmea && !sub->policy.canboat) {
+        if (timestamp() - sub->active > TCP_GRACE_TIMEOUT) {
+            sub->policy.nmea = true;
+
+            gpsd_report(context.debug, LOG_INF,
+                        "client(%d) timed out on HTTP wait. Locking to raw TCP now.\n",
+                        sub_index(sub));
+            return 0;
+        }
+        return sub->active + TCP_GRACE_TIMEOUT;
+    }
+    return 0;
+}
+#endif /* SOCKET_EXPORT_ENABLE */
+
+#ifdef CONTROL_SOCKET_ENABLE
+static void accept_control(socket_t csock)
+/* be open to new control-socket connections */
+{
+    sockaddr_t fsin;
+    socklen_t alen = (socklen_t) sizeof(fsin);
+    /*@+matchanyintegral@*/
+    socket_t ssock = accept(csock, (struct sockaddr *)&fsin, &alen);
+    /*@-matchanyintegral@*/
+
+    if (BAD_SOCKET(ssock))
+        gpsd_report(context.debug, LOG_ERROR,
+                    "accept: %s\n", strerror(errno));
+    else {
+        gpsd_report(context.debug, LOG_INF,
+                    "control socket connect on fd %d\n",
+                    ssock);
+        /* edge-triggered is safe, read_control() reads to EOF */
+        ev_register(ssock, ev_control, 0, EPOLLIN | EPOLLET);
+    }
+}
+
+static void read_control(socket_t cfd)
+/* read any commands that came in over a control socket connection */
+{
+    char buf[BUFSIZ];
+    ssize_t rd;
+
+    while ((rd = read(cfd, buf, sizeof(buf) - 1)) > 0) {
+        buf[rd] = '\0';
+        gpsd_report(context.debug, LOG_CLIENT,
+                    "<= control(%d): %s\n", cfd, buf);
+        /* coverity[tainted_data] Safe, never handed to exec */
+        handle_control(cfd, buf);
+    }
+    gpsd_report(context.debug, LOG_SPIN,
+                "close(%d) of control socket\n", cfd);
+    ev_unregister(cfd);
+    (void)close(cfd);
+}
+#endif /* CONTROL_SOCKET_ENABLE */
+
+#ifdef VYSPI_ENABLE
+static void vyspi_silent(struct gpsd_timer_t *timer, uint64_t now UNUSED)
+/* a board that went quiet for VYSPI_SILENCE probably was reset */
+{
+    struct gps_device_t *device = (struct gps_device_t *)gpsd_timer_owner(timer);
+
+    if (!allocated_device(device) || BAD_SOCKET(device->gpsdata.gps_fd)
+        || device->device_type == NULL
+        || device->device_type->packet_type != VYSPI_PACKET)
+        return;
+    gpsd_report(context.debug, LOG_WARN,
+                "no input from %s for %d ms - re-activating device\n",
+                device->gpsdata.dev.path, VYSPI_SILENCE);
+    // we assume every config on device is lost and we do re-init
+    vyspi_init(device);
+    gpsd_timer_after(&context, timer, VYSPI_SILENCE);
+}
+#endif /* VYSPI_ENABLE */
+
+static void poll_device(struct gps_device_t *device, bool data_ready);
+
+static void device_reawake(struct gpsd_timer_t *timer, uint64_t now UNUSED)
+/* a device that read nothing gets another chance, see gpsd_multipoll() */
+{
+    struct gps_device_t *device = (struct gps_device_t *)gpsd_timer_owner(timer);
+
+    if (allocated_device(device) && !BAD_SOCKET(device->gpsdata.gps_fd))
+        poll_device(device, false);
+}
+
+static void poll_device(struct gps_device_t *device, bool data_ready)
+/* consume input from a device, or see whether it is due to be reawakened */
+{
+    if (data_ready && device->reader != NULL)
+        devreader_wakeup(device->reader);
+
+    switch (gpsd_multipoll(data_ready, device, all_reports, DEVICE_REAWAKE))
+    {
+    case DEVICE_READY:
+        if (!BAD_SOCKET(device->gpsdata.gps_fd))
+            device_watch(device, true);
+        break;
+    case DEVICE_UNREADY:
+        if (device->reader != NULL) {
+            /* an earlier wakeup took the frames, the thread waits on */
+            device->reawake = 0;
+            gpsd_timer_cancel(&context, &device->reawake_timer);
+        } else
+            device_watch(device, false);
+        break;
+    case DEVICE_UNCHANGED:
+        gpsd_report(context.debug, LOG_SPIN,
+                    "device unchanged\n");
+        break;
+    case DEVICE_ERROR:
+    case DEVICE_EOF:
+        deactivate_device(device);
+        break;
+    default:
+        break;
+    }
+
+#ifdef VYSPI_ENABLE
+    // TODO - find a better place for this - many fragments scanned can have this being called rarely
+    if(device->device_type && (device->device_type->packet_type == VYSPI_PACKET)) {
+        gpsd_report(device->context->debug, LOG_RAW,
+                    "VYSPI should access time trigger.\n");
+        vyspi_handle_time_trigger(device);
+        /* input or not, the board has VYSPI_SILENCE from now on */
+        if (data_ready && !BAD_SOCKET(device->gpsdata.gps_fd))
+            gpsd_timer_after(&context, &vyspi_silence[device - devices],
+                             VYSPI_SILENCE);
+    }
+#endif /* VYSPI_ENABLE */
+}
+
+static void poll_unpollable_devices(void)
+/* devices epoll can't watch get polled on every pass, as select() did */
+{
+    struct gps_device_t *device;
+
+    for (device = devices; device < devices + MAXDEVICES; device++)
+        if (unpollable[device - devices]
+            && allocated_device(device) && device->gpsdata.gps_fd > 0)
+            poll_device(device, true);
+}
+
+static timestamp_t sooner(timestamp_t next, timestamp_t when)
+/* the earlier of two deadlines, 0 standing for none */
+{
+    return (next == 0 || (when != 0 && when < next)) ? when : next;
+}
+
+static void housekeeping(struct gpsd_timer_t *timer, uint64_t now)
+/* client and device timeouts, then sleep until the next of them */
+{
+    timestamp_t next = 0;
+#ifdef SOCKET_EXPORT_ENABLE
+    struct gps_device_t *device;
+    struct subscriber_t *sub, *nextsub;
+
+    foreach_active(sub, nextsub)
+        if (sub->active != 0)
+            next = sooner(next, check_client_timeouts(sub));
+
+    /*
+     * Mark devices with an identified packet type but no
+     * remaining subscribers to be closed in RELEASE_TIME seconds.
+     * See the explanation of RELEASE_TIME for the reasoning.
+     *
+     * Re-poll devices that are disconnected, but have potential
+     * subscribers in the same cycle.
+     */
+    for (device = devices; device < devices + MAXDEVICES; device++) {
+
+        bool device_needed = NOWAIT || first_watcher(device) != NULL;
+
+        if (!allocated_device(device))
+            continue;
+
+        if (!device_needed && device->gpsdata.gps_fd > -1 &&
+        device->packet.type != BAD_PACKET) {
+    if (device->releasetime == 0) {
+        device->releasetime = timestamp();
+        gpsd_report(context.debug, LOG_PROG,
+    "device %d (fd %d) released\n",
+    (int)(device - devices),
+    device->gpsdata.gps_fd);
+    } else if (timestamp() - device->releasetime >
+    RELEASE_TIMEOUT) {
+        gpsd_report(context.debug, LOG_PROG,
+    "device %d closed\n",
+    (int)(device - devices));
+        gpsd_report(context.debug, LOG_RAW,
+    "unflagging descriptor %d\n",
+    device->gpsdata.gps_fd);
+        deactivate_device(device);
+    }
+    if (device->gpsdata.gps_fd > -1)
+        next = sooner(next, device->releasetime + RELEASE_TIMEOUT);
+        }
+
+        if (device_needed && BAD_SOCKET(device->gpsdata.gps_fd) &&
+        (device->opentime == 0 ||
+        timestamp() - device->opentime > DEVICE_RECONNECT)) {
+    device->opentime = timestamp();
+    gpsd_report(context.debug, LOG_INF,
+        "reconnection attempt on device %d\n",
+        (int)(device - devices));
+    (void)awaken(device);
+        }
+        if (device_needed && BAD_SOCKET(device->gpsdata.gps_fd))
+    next = sooner(next, device->opentime + DEVICE_RECONNECT);
+    }
+#endif /* SOCKET_EXPORT_ENABLE */
+
+    /* the timeouts are strict, so a tick after the deadline */
+    if (next != 0) {
+        timestamp_t wait = next - timestamp();
+
+        gpsd_timer_arm(&context, timer, now + TIMERWHEEL_TICK
+                       + (wait > 0 ? (uint64_t)(wait * 1000) : 0));
+    }
+}
+
+static void housekeeping_soon(void)
+/* something happened, look at the timeouts within HOUSEKEEPING_INTERVAL */
+{
+    uint64_t due = timerwheel_now() + HOUSEKEEPING_INTERVAL;
+
+    if (!gpsd_timer_armed(&housekeeping_timer)
+        || gpsd_timer_due(&housekeeping_timer) > due)
+        gpsd_timer_arm(&context, &housekeeping_timer, due);
+}
+
+static void dispatch_event(const struct epoll_event *ev)
+/* hand a ready descriptor to whatever owns it */
+{
+    int fd = EV_FD(ev->data.u64);
+    int index = EV_INDEX(ev->data.u64);
+
+    switch (EV_KIND(ev->data.u64)) {
+    case ev_device:
+        /* errors and hangups show up as EOF or error on read */
+        if (allocated_device(&devices[index])
+            && device_fd(&devices[index]) == fd)
+            poll_device(&devices[index], true);
+        break;
+#ifdef SOCKET_EXPORT_ENABLE
+    case ev_listen:
+        (void)gpsd_accept_client_socket(fd);
+        break;
+    case ev_canboat_listen:
+        {
+            struct subscriber_t *client = gpsd_accept_client_socket(fd);
+            if (client != NULL)
+                client->policy.canboat = 1;
+        }
+        break;
+    case ev_client:
+        {
+            struct subscriber_t *sub;
+            if (index >= subscriber_slots)
+                break;
+            sub = subscriber_at(index);
+            if (sub->fd != fd)
+                break;		/* slot was recycled this wakeup */
+            if ((ev->events & EPOLLOUT) != 0)
+                flush_client(sub);
+            if (sub->fd == fd
+                && (ev->events & (EPOLLIN | EPOLLHUP | EPOLLERR)) != 0)
+                read_client(sub);
+        }
+        break;
+    case ev_udp:
+        {
+            int err = 0;
+            socklen_t errlen = (socklen_t) sizeof(err);
+            /* reading SO_ERROR also clears it */
+            (void)getsockopt(fd, SOL_SOCKET, SO_ERROR, &err, &errlen);
+            gpsd_report(context.debug, LOG_WARN,
+                        "UDP interface %s: %s\n",
+                        interfaces[index].name, strerror(err));
+        }
+        break;
+#endif /* SOCKET_EXPORT_ENABLE */
+#ifdef CONTROL_SOCKET_ENABLE
+    case ev_control_listen:
+        accept_control(fd);
+        break;
+    case ev_control:
+        read_control(fd);
+        break;
+#endif /* CONTROL_SOCKET_ENABLE */
+    default:
+        break;
+    }
+}
+
+#if defined(GPSD_BENCH) && defined(SOCKET_EXPORT_ENABLE)
+/*
+ * bench_ingest links the daemon built with GPSD_BENCH and times the
+ * report path through these.  Clients and the UDP interface are
+ * sockets the bench reads back and throws away.
+ */
+struct gps_device_t *gpsd_bench_device(const struct vessel_t *);
+bool gpsd_bench_client(int, const struct policy_t *);
+void gpsd_bench_udp(int, const struct sockaddr_in *, int);
+void gpsd_bench_report(struct gps_device_t *, gps_mask_t);
+
+struct gps_device_t *gpsd_bench_device(const struct vessel_t *v)
+/* the one device, not opened yet, the caller hands it the fd */
+{
+    struct interface_t *it;
+
+    gps_context_init(&context);
+    for (it = interfaces; it < interfaces + MAXINTERFACES; it++) {
+        it->sock = -1; it->name[0] = '\0';
+    }
+    vessel = *v;
+    gpsd_init(&devices[0], &context, "bench");
+    devices[0].gpsdata.own_mmsi = vessel.mmsi;
+    return &devices[0];
+}
+
+bool gpsd_bench_client(int fd, const struct policy_t *policy)
+/* a watcher writing to fd */
+{
+    struct subscriber_t *sub = allocate_client();
+
+    if (sub == NULL)
+        return false;
+    sub->fd = fd;
+    sub->active = timestamp();
+    sub->policy = *policy;
+    resubscribe(sub);
+    return true;
+}
+
+void gpsd_bench_udp(int sock, const struct sockaddr_in *to, int batch)
+/* a UDP interface sending from sock */
+{
+    struct interface_t *it = &interfaces[0];
+
+    (void)strlcpy(it->name, "bench", sizeof(it->name));
+    (void)strlcpy(it->proto, "udp", sizeof(it->proto));
+    it->sock = sock;
+    it->port = (int)ntohs(to->sin_port);
+    it->bcast = *to;
+    it->batch = batch;
+    it->mtu = UDP_DEFAULT_MTU;
+}
+
+void gpsd_bench_report(struct gps_device_t *device, gps_mask_t changed)
+{
+    all_reports(device, changed);
+}
+
+/* bench_ingest brings its own */
+#define main gpsd_main
+int gpsd_main(int, char *[]);
+#endif /* defined(GPSD_BENCH) && defined(SOCKET_EXPORT_ENABLE) */
+
 /*@ -mustfreefresh @*/
 int main(int argc, char *argv[])
 {
     /* some of these statics suppress -W warnings due to longjmp() */
 #ifdef SOCKET_EXPORT_ENABLE
     static char *gpsd_service = NULL;	/* this static pacifies splint */
-    struct subscriber_t *sub;
+    struct subscriber_t *sub, *nextsub;
 #endif /* SOCKET_EXPORT_ENABLE */
 #ifdef CONTROL_SOCKET_ENABLE
     static socket_t csock;
-    fd_set control_fds, rfds;
-    socket_t cfd;
     static char *control_socket = NULL;
 #endif /* CONTROL_SOCKET_ENABLE */
-#if defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE)
-    sockaddr_t fsin;
-#endif /* defined(SOCKET_EXPORT_ENABLE) || defined(CONTROL_SOCKET_ENABLE) */
     static char *pid_file = NULL;
     struct gps_device_t *device;
     int i, option;
@@ -2848,10 +4035,15 @@ int main(int argc, char *argv[])
     bool go_background = true;
     volatile bool in_restart;
 
-    no_timeouts = 0;
-
     context.debug = 0;
     gps_context_init(&context);
+    gpsd_timer_init(&housekeeping_timer, housekeeping, NULL);
+#ifdef VYSPI_ENABLE
+    for (i = 0; i < MAXDEVICES; i++)
+        gpsd_timer_init(&vyspi_silence[i], vyspi_silent, &devices[i]);
+#endif /* VYSPI_ENABLE */
+    /* the targets of every AIS feed, for ?AIS; and SignalK vessels */
+    context.ais_targets = aistarget_new();
 
 #ifdef CONTROL_SOCKET_ENABLE
     INVALIDATE_SOCKET(csock);
@@ -2860,7 +4052,7 @@ int main(int argc, char *argv[])
     context.pps_hook = ship_pps_drift_message;
 #endif /* PPS_ENABLE */
 
-    while ((option = getopt(argc, argv, "F:D:S:bGhlNnP:V")) != -1) {
+    while ((option = getopt(argc, argv, "F:D:S:bGhlLNnP:Q:RV")) != -1) {
     switch (option) {
     case 'D':
         context.debug = (int)strtol(optarg, 0, 0);
@@ -2887,6 +4079,12 @@ int main(int argc, char *argv[])
     case 'l':		/* list known device types and exit */
         typelist();
         break;
+    case 'L':
+        latency_enable(true);
+        break;
+    case 'R':
+        reader_threads = true;
+        break;
     case 'S':
 #ifdef SOCKET_EXPORT_ENABLE
         gpsd_service = optarg;
@@ -2900,6 +4098,29 @@ int main(int argc, char *argv[])
     case 'P':
         pid_file = optarg;
         break;
+    case 'Q':
+        {
+            char *end;
+            unsigned long low, high = (unsigned long)outqueue_highmark;
+
+            errno = 0;
+            low = strtoul(optarg, &end, 0);
+            if (errno == 0 && end != optarg && *end == ':')
+                high = strtoul(end + 1, &end, 0);
+            /* strtoul() would take a minus sign and wrap around */
+            if (errno != 0 || end == optarg || *end != '\0'
+                || strchr(optarg, '-') != NULL
+                || low == 0 || low >= high) {
+                /* not usage(), it ends with typelist()'s exit(0) */
+                (void)fprintf(stderr,
+                              "gpsd: -Q wants low:high in bytes, "
+                              "0 < low < high, see gpsd -h\n");
+                exit(EXIT_FAILURE);
+            }
+            outqueue_lowmark = (size_t)low;
+            outqueue_highmark = (size_t)high;
+        }
+        break;
     case 'V':
         (void)printf("gpsd: %s (revision %s)\n", VERSION, REVISION);
         exit(EXIT_SUCCESS);
@@ -2937,6 +4158,12 @@ int main(int argc, char *argv[])
     exit(EXIT_FAILURE);
     }
 
+    if ((epfd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+    gpsd_report(context.debug, LOG_ERROR,
+        "epoll_create1: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+    }
+
     /*
      * Control socket has to be created before we go background in order to
      * avoid a race condition in which hotplug scripts can try opening
@@ -2945,8 +4172,7 @@ int main(int argc, char *argv[])
 #ifdef SYSTEMD_ENABLE
     if (sd_socket_count > 0) {
         csock = SD_SOCKET_FDS_START;
-        FD_SET(csock, &all_fds);
-        adjust_max_fd(csock, true);
+        ev_register(csock, ev_control_listen, 0, EPOLLIN);
     }
 #endif
 #ifdef CONTROL_SOCKET_ENABLE
@@ -2961,8 +4187,7 @@ int main(int argc, char *argv[])
         gpsd_report(context.debug, LOG_SPIN,
     "control socket %s is fd %d\n",
     control_socket, csock);
-    FD_SET(csock, &all_fds);
-    adjust_max_fd(csock, true);
+    ev_register(csock, ev_control_listen, 0, EPOLLIN);
     gpsd_report(context.debug, LOG_PROG,
         "control socket opened at %s\n",
         control_socket);
@@ -3101,6 +4326,11 @@ int main(int argc, char *argv[])
                     device->device_type?"yes":"null", device->gpsdata.dev.path);
         if((device->device_type) && (device->device_type->packet_type == VYSPI_PACKET)) {
             vyspi_init(device);
+#ifdef VYSPI_ENABLE
+            /* a board that never answers is configured again */
+            gpsd_timer_after(&context, &vyspi_silence[device - devices],
+                             VYSPI_SILENCE);
+#endif /* VYSPI_ENABLE */
         }
     }
 
@@ -3180,15 +4410,6 @@ int main(int argc, char *argv[])
     gpsd_report(context.debug, LOG_INF,
     "running with effective user ID %d\n", geteuid());
 
-#ifdef SOCKET_EXPORT_ENABLE
-    for (i = 0; i < NITEMS(subscribers); i++) {
-    subscribers[i].fd = UNALLOCATED_FD;
-#ifndef S_SPLINT_S
-    (void)pthread_mutex_init(&subscribers[i].mutex, NULL);
-#endif /* S_SPLINT_S */
-    }
-#endif /* SOCKET_EXPORT_ENABLE*/
-
     /*@-compdef -compdestroy@*/
     {
     struct sigaction sa;
@@ -3222,18 +4443,11 @@ int main(int argc, char *argv[])
     signalled = 0;
 
     for (i = 0; i < AFCOUNT; i++) {
-        if (msocks[i] >= 0) {
-            FD_SET(msocks[i], &all_fds);
-            adjust_max_fd(msocks[i], true);
-        }
-        if (canboat_socks[i] >= 0) {
-            FD_SET(canboat_socks[i], &all_fds);
-            adjust_max_fd(canboat_socks[i], true);
-        }
+        if (msocks[i] >= 0)
+            ev_register(msocks[i], ev_listen, i, EPOLLIN);
+        if (canboat_socks[i] >= 0)
+            ev_register(canboat_socks[i], ev_canboat_listen, i, EPOLLIN);
     }
-#ifdef CONTROL_SOCKET_ENABLE
-    FD_ZERO(&control_fds);
-#endif /* CONTROL_SOCKET_ENABLE */
 
     /* initialize the GPS context's time fields */
     gpsd_time_init(&context, time(NULL));
@@ -3255,138 +4469,35 @@ int main(int argc, char *argv[])
     gpsd_report(context.debug, LOG_INF,
     "gpsd with max %d subscribers\n", MAXSUBSCRIBERS);
 
+    /* devices that failed to open are retried from there on */
+    housekeeping_soon();
     while (0 == signalled) {
-#ifdef EFDS
-    fd_set efds;
-#endif /* EFDS */
-    switch(gpsd_await_data(&rfds, maxfd, &all_fds, context.debug))
-    {
-    case AWAIT_TIMEOUT:
-            no_timeouts++;
-        break;
-    case AWAIT_GOT_INPUT:
-            no_timeouts = 0;
-        break;
-    case AWAIT_NOT_READY:
-#ifdef EFDS
-        for (device = devices; device < devices + MAXDEVICES; device++)
-    if (FD_ISSET(device->gpsdata.gps_fd, &efds)) {
-        deactivate_device(device);
-        free_device(device);
-    }
-#endif /* EFDS*/
-        continue;
-    case AWAIT_FAILED:
+    struct epoll_event events[EV_BATCH];
+    int nready, timeout = 0;
+
+    /* until the next timer, or input, whichever comes first */
+    if (unpollable_devices == 0)
+        timeout = gpsd_timer_timeout(&context, -1);
+    gpsd_report(context.debug, LOG_RAW + 2, "epoll waits %d ms\n", timeout);
+    nready = epoll_wait(epfd, events, EV_BATCH, timeout);
+    if (nready == -1) {
+        if (errno == EINTR)
+            continue;
+        gpsd_report(context.debug, LOG_ERROR,
+                    "epoll_wait: %s\n", strerror(errno));
         exit(EXIT_FAILURE);
     }
 
-#ifdef SOCKET_EXPORT_ENABLE
-    /* always be open to new client connections */
-    for (i = 0; i < AFCOUNT; i++) {
-        struct subscriber_t *client = NULL;
-        gpsd_accept_client_socket(&rfds, msocks[i]);
-
-        client =
-            gpsd_accept_client_socket(&rfds, canboat_socks[i]);
-        if(client != NULL)
-            client->policy.canboat = true;
-    }
-#endif /* SOCKET_EXPORT_ENABLE */
-
-#ifdef CONTROL_SOCKET_ENABLE
-    /* also be open to new control-socket connections */
-    if (csock > -1 && FD_ISSET(csock, &rfds)) {
-        socklen_t alen = (socklen_t) sizeof(fsin);
-        /*@+matchanyintegral@*/
-        socket_t ssock = accept(csock, (struct sockaddr *)&fsin, &alen);
-        /*@-matchanyintegral@*/
-
-        if (BAD_SOCKET(ssock))
-    gpsd_report(context.debug, LOG_ERROR,
-        "accept: %s\n", strerror(errno));
-        else {
-    gpsd_report(context.debug, LOG_INF,
-        "control socket connect on fd %d\n",
-        ssock);
-    FD_SET(ssock, &all_fds);
-    FD_SET(ssock, &control_fds);
-    adjust_max_fd(ssock, true);
-        }
-        FD_CLR(csock, &rfds);
-    }
-
-    /* read any commands that came in over the control socket */
-    for (cfd = 0; cfd < FD_SETSIZE; cfd++)
-        if (FD_ISSET(cfd, &control_fds)) {
-    char buf[BUFSIZ];
-    ssize_t rd;
-
-    while ((rd = read(cfd, buf, sizeof(buf) - 1)) > 0) {
-        buf[rd] = '\0';
-        gpsd_report(context.debug, LOG_CLIENT,
-    "<= control(%d): %s\n", cfd, buf);
-        /* coverity[tainted_data] Safe, never handed to exec */
-        handle_control(cfd, buf);
-    }
-    gpsd_report(context.debug, LOG_SPIN,
-        "close(%d) of control socket\n", cfd);
-    (void)close(cfd);
-    FD_CLR(cfd, &all_fds);
-    FD_CLR(cfd, &control_fds);
-    adjust_max_fd(cfd, false);
-        }
-#endif /* CONTROL_SOCKET_ENABLE */
-
-    /* poll all active devices */
-    for (device = devices; device < devices + MAXDEVICES; device++)
-        if (allocated_device(device) && device->gpsdata.gps_fd > 0) {
-
-            if(device->device_type && (device->device_type->packet_type == VYSPI_PACKET)) {
-               if(no_timeouts > 2) {
-                	gpsd_report(context.debug, LOG_WARN,
-    "No of timeouts > 0: %d.\n", no_timeouts);
-           }
-               if(no_timeouts > 7) {
-                   gpsd_report(context.debug, LOG_WARN,
-    "No of timeouts > 7 - re-activating device\n");
-                   no_timeouts = 0;
-                   // we assume every config on device is lost and we do re-init
-                   vyspi_init(device);
-               }
-            }
-
-            switch (gpsd_multipoll(FD_ISSET(device->gpsdata.gps_fd, &rfds),
-                                   device, all_reports, DEVICE_REAWAKE))
-            {
-            case DEVICE_READY:
-                FD_SET(device->gpsdata.gps_fd, &all_fds);
-                adjust_max_fd(device->gpsdata.gps_fd, true);
-                break;
-            case DEVICE_UNREADY:
-                FD_CLR(device->gpsdata.gps_fd, &all_fds);
-                adjust_max_fd(device->gpsdata.gps_fd, false);
-                break;
-            case DEVICE_UNCHANGED:
-                gpsd_report(context.debug, LOG_SPIN,
-                            "device unchanged\n");
-                break;
-            case DEVICE_ERROR:
-            case DEVICE_EOF:
-                deactivate_device(device);
-                break;
-            default:
-                break;
-            }
-
-            // TODO - find a better place for this - many fragments scanned can have this being called rarely
-            if(device->device_type && (device->device_type->packet_type == VYSPI_PACKET)) {
-                gpsd_report(device->context->debug, LOG_RAW,
-                            "VYSPI should access time trigger.\n");
-                vyspi_handle_time_trigger(device);
-            }
-        }
-
+    /* only the descriptors that are ready */
+    for (i = 0; i < nready; i++)
+        dispatch_event(&events[i]);
+    if (unpollable_devices != 0)
+        poll_unpollable_devices();
+    if (nready > 0 || unpollable_devices != 0)
+        housekeeping_soon();
 
+    /* reawakened devices, subscribed SignalK paths, timeouts */
+    (void)gpsd_timers_run(&context);
 
 #ifdef __UNUSED_AUTOCONNECT__
     if (context.fixcnt > 0 && !context.autconnect) {
@@ -3401,126 +4512,6 @@ int main(int argc, char *argv[])
         }
     }
 #endif /* __UNUSED_AUTOCONNECT__ */
-
-#ifdef SOCKET_EXPORT_ENABLE
-    /* accept and execute commands for all clients */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
-        if (sub->active == 0)
-            continue;
-
-        lock_subscriber(sub);
-        if (FD_ISSET(sub->fd, &rfds)) {
-            char buf[BUFSIZ];
-            int buflen;
-
-            unlock_subscriber(sub);
-
-            gpsd_report(context.debug, LOG_PROG,
-                        "checking client(%d)\n",
-                        sub_index(sub));
-            if ((buflen =
-                 (int)recv(sub->fd, buf, sizeof(buf) - 1, 0)) <= 0) {
-                gpsd_report(context.debug, LOG_ERR,
-                            "recv from client(%d) returned %d: %s\n",
-                            sub_index(sub), buflen, strerror(errno));
-                detach_client(sub);
-            } else {
-                if (buf[buflen - 1] != '\n')
-                    buf[buflen++] = '\n';
-                buf[buflen] = '\0';
-                gpsd_report(context.debug, LOG_CLIENT,
-                            "<= client(%d): %s, len=%d\n", sub_index(sub), buf, buflen);
-
-                /*
-                 * When a command comes in, update subscriber.active to
-                 * timestamp() so we don't close the connection
-                 * after COMMAND_TIMEOUT seconds. This makes
-                 * COMMAND_TIMEOUT useful.
-                 */
-                sub->active = timestamp();
-                if (handle_gpsd_request(sub, buf) < 0)
-                    detach_client(sub);
-            }
-        } else {
-            unlock_subscriber(sub);
-
-            if (!sub->policy.watcher
-                && timestamp() - sub->active > COMMAND_TIMEOUT) {
-                gpsd_report(context.debug, LOG_WARN,
-                            "client(%d) timed out on command wait.\n",
-                            sub_index(sub));
-                detach_client(sub);
-            }
-            if (sub->fd != UNALLOCATED_FD) {
-                if (sub->policy.watcher && (sub->policy.protocol == tcp)
-                    && timestamp() - sub->active > TCP_GRACE_TIMEOUT) {
-
-                    if(!sub->policy.canboat)
-                        sub->policy.nmea = true;
-
-                    gpsd_report(context.debug, LOG_INF,
-                                "client(%d) timed out on HTTP wait. Locking to raw TCP now.\n",
-                                sub_index(sub));
-                }
-            }
-        }
-    }
-
-    /*
-     * Mark devices with an identified packet type but no
-     * remaining subscribers to be closed in RELEASE_TIME seconds.
-     * See the explanation of RELEASE_TIME for the reasoning.
-     *
-     * Re-poll devices that are disconnected, but have potential
-     * subscribers in the same cycle.
-     */
-    for (device = devices; device < devices + MAXDEVICES; device++) {
-
-        bool device_needed = NOWAIT;
-
-        if (!allocated_device(device))
-            continue;
-
-        if (!device_needed)
-    for (sub=subscribers; sub<subscribers+MAXSUBSCRIBERS; sub++) {
-        if (sub->active == 0)
-    continue;
-        device_needed = subscribed(sub, device);
-        if (device_needed)
-    break;
-    }
-
-        if (!device_needed && device->gpsdata.gps_fd > -1 &&
-        device->packet.type != BAD_PACKET) {
-    if (device->releasetime == 0) {
-        device->releasetime = timestamp();
-        gpsd_report(context.debug, LOG_PROG,
-    "device %d (fd %d) released\n",
-    (int)(device - devices),
-    device->gpsdata.gps_fd);
-    } else if (timestamp() - device->releasetime >
-    RELEASE_TIMEOUT) {
-        gpsd_report(context.debug, LOG_PROG,
-    "device %d closed\n",
-    (int)(device - devices));
-        gpsd_report(context.debug, LOG_RAW,
-    "unflagging descriptor %d\n",
-    device->gpsdata.gps_fd);
-        deactivate_device(device);
-    }
-        }
-
-        if (device_needed && BAD_SOCKET(device->gpsdata.gps_fd) &&
-        (device->opentime == 0 ||
-        timestamp() - device->opentime > DEVICE_RECONNECT)) {
-    device->opentime = timestamp();
-    gpsd_report(context.debug, LOG_INF,
-        "reconnection attempt on device %d\n",
-        (int)(device - devices));
-    (void)awaken(device);
-        }
-    }
-#endif /* SOCKET_EXPORT_ENABLE */
     }
 
     /* if we make it here, we got a signal... deal with it */
@@ -3542,7 +4533,7 @@ int main(int argc, char *argv[])
      * This is an attempt to avoid the sporadic race errors at the ends
      * of our regression tests.
      */
-    for (sub = subscribers; sub < subscribers + MAXSUBSCRIBERS; sub++) {
+    foreach_active(sub, nextsub) {
     if (sub->active != 0)
         detach_client(sub);
     }
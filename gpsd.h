@@ -19,6 +19,7 @@ extern "C" {
 #include <stdarg.h>
 #include "gps.h"
 #include "gpsd_config.h"
+#include "timerwheel.h"
 
 /*
  * Tell GCC that we want thread-safe behavior with _REENTRANT;
@@ -182,7 +183,7 @@ struct gps_packet_t {
     unsigned int frm_type;
     unsigned int frm_state;
     unsigned int frm_7dflag;
-    unsigned int frm_offset;
+    unsigned int frm_start;	/* inbuffer offset of the frame's payload */
     unsigned int frm_length;
     unsigned int frm_read;
     unsigned int frm_version;
@@ -200,12 +201,18 @@ struct gps_packet_t {
     unsigned /*@observer@*/char *inbufptr;
     /* outbuffer needs to be able to hold 4 GPGSV records at once */
 
+    /* VYSPI_PACKET records are (offset, len, type) views into inbuffer,
+       valid until the device is read again */
 #define MAX_OUT_BUF_RECORDS 312 // something safe above MAX_PACKET_LENGTH*2+1 / 3
+#define packet_record(lexer, n)	((lexer)->inbuffer + (lexer)->out_offset[n])
     uint16_t   out_count;
     uint8_t   out_type[MAX_OUT_BUF_RECORDS];
     uint8_t   out_new_version[MAX_OUT_BUF_RECORDS];
     uint16_t  out_offset[MAX_OUT_BUF_RECORDS];
     uint16_t  out_len[MAX_OUT_BUF_RECORDS];
+    unsigned  out_types;	/* 1 << FRM_TYPE_* of every record */
+    uint64_t  in_stamp;		/* latency_now() of the read() the records
+				   came from */
     uint8_t   outbuffer[MAX_PACKET_LENGTH*2+1];
     size_t outbuflen;
     unsigned long char_counter;		/* count characters processed */
@@ -264,6 +271,27 @@ extern int packet_sniff(struct gps_packet_t *);
 #define AIVDM_CHANNELS	2		/* A, B */
 
 struct gps_device_t;
+struct history_t;
+struct devreader_t;
+struct aistarget_table_t;
+
+/*
+ * Deadlines, on one timer wheel per context: whatever waits for input
+ * sleeps until the next of them is due, and not at all when none is
+ * armed.  A timer is embedded in what it times, fire gets the timer and
+ * the ms of timerwheel_now() it went off at.
+ */
+struct gpsd_timer_t;
+typedef void (*gpsd_timer_fire_t)(struct gpsd_timer_t *, uint64_t);
+
+struct gpsd_timer_t {
+    struct wheel_timer_t wheel;
+    /*@null@*/gpsd_timer_fire_t fire;
+};
+
+#define gpsd_timer_owner(timer)	((timer)->wheel.data)
+#define gpsd_timer_armed(timer)	timerwheel_armed(&(timer)->wheel)
+#define gpsd_timer_due(timer)	((timer)->wheel.due)
 
 struct gps_context_t {
     int valid;				/* member validity flags */
@@ -281,6 +309,8 @@ struct gps_context_t {
     double gps_tow;                     /* GPS time of week, actually 19 bits */
     int century;			/* for NMEA-only devices without ZDA */
     int rollovers;			/* rollovers since start of run */
+    /*@null@*/struct aistarget_table_t *ais_targets;	/* see aistarget.h */
+    struct timerwheel_t timers;		/* see gpsd_timer_arm() */
 #ifdef TIMEHINT_ENABLE
     int leap_notify;			/* notification state from subframe */
 #define LEAP_NOWARNING  0x0     /* normal, no leap second warning */
@@ -485,7 +515,7 @@ struct ntrip_stream_t
 #define MAXDEVICES	4
 #endif
 
-#define sub_index(s) (int)((s) - subscribers)
+#define sub_index(s) ((s)->index)
 #define allocated_device(devp)	 ((devp)->gpsdata.dev.path[0] != '\0')
 #define free_device(devp)	 (devp)->gpsdata.dev.path[0] = '\0'
 #define initialized_device(devp) ((devp)->context != NULL)
@@ -513,13 +543,16 @@ struct gps_device_t {
 #endif /* FIXED_PORT_SPEED */
     int saved_baud;
     struct gps_packet_t packet;
+    /*@null@*/struct devreader_t *reader;	/* input thread, see devreader.c */
     int badcount;
     int subframe_count;
     char subtype[64];			/* firmware version or subtype ID */
     timestamp_t opentime;
     timestamp_t releasetime;
     bool zerokill;
-    timestamp_t reawake;
+    uint64_t reawake;			/* ms of timerwheel_now(), 0 if not */
+    struct gpsd_timer_t reawake_timer;	/* the application may set fire */
+    struct gpsd_timer_t driver_timer;	/* for deadlines of the driver */
 #ifdef TIMING_ENABLE
     timestamp_t sor;	/* timestamp start of this reporting cycle */
     unsigned long chars;	/* characters in the cycle */
@@ -555,6 +588,19 @@ struct gps_device_t {
     int fixcnt;				/* count of fixes from this device */
     struct gps_fix_t newdata;		/* where drivers put their data */
     struct gps_fix_t oldfix;		/* previous fix for error modeling */
+#ifdef CHEAPFLOATS_ENABLE
+    /*
+     * DOPs from the skyview, worked out again only when the azimuth
+     * and elevation of the satellites used change.
+     */
+    struct {
+	int n;				/* satellites used, -1 before the first */
+	int sky[MAXCHANNELS][2];	/* their azimuth and elevation */
+	bool valid;			/* whether they gave DOPs */
+	struct dop_t dop;
+    } skydop;
+#endif /* CHEAPFLOATS_ENABLE */
+    /*@null@*/struct history_t *history;	/* time series, see history.h */
     /*
      * The rest of this structure is driver-specific private storage.
      * It used to be a union, but that turned out to be unsafe.  Dual-mode
@@ -1012,15 +1058,104 @@ extern void clear_dop(/*@out@*/struct dop_t *);
 
 /* shmexport.c */
 #define GPSD_KEY	0x47505344	/* "GPSD" */
+#define SHM_EXPORT_VERSION	2
+#define SHM_EXPORT_SLOTS	MAXUSERDEVS
+
+/*
+ * The segment has a slot per device, and a slot is cut into sections
+ * that are written independently: an engine report rewrites the
+ * engine section of its own device and nothing else.  Every section
+ * is guarded by a sequence lock.  The writer makes the sequence odd,
+ * changes the data and makes it even again; a reader that sees the
+ * same even number before and after its copy got a consistent one.
+ * A reader that remembers the sequence it last copied skips sections
+ * that did not change since.
+ */
+enum shm_section_t {
+    shm_fix,
+    shm_sky,
+    shm_navigation,
+    shm_environment,
+    shm_engine,
+    shm_ais,
+    shm_attitude,
+    SHM_SECTIONS
+};
+
+struct shm_fix_t {
+    gps_mask_t set;		/* fix related bits of the last update */
+    timestamp_t online;
+    struct gps_fix_t fix;
+    double separation;
+    int status;
+    struct dop_t dop;
+    double epe;
+};
+
+struct shm_sky_t {
+    int satellites_used;
+    int used[MAXCHANNELS];
+    timestamp_t skyview_time;
+    int satellites_visible;
+    int PRN[MAXCHANNELS];
+    int elevation[MAXCHANNELS];
+    int azimuth[MAXCHANNELS];
+    double ss[MAXCHANNELS];
+};
+
+struct shmexport_slot_t
+{
+    char path[GPS_PATH_MAX];	/* device in the slot, empty if unused */
+    unsigned int tick;		/* segment tick of the last update */
+    unsigned int seq[SHM_SECTIONS];
+    struct shm_fix_t fix;
+    struct shm_sky_t sky;
+    struct navigation_t navigation;
+    struct environment_t environment;
+    struct engine_t engine;
+    struct ais_t ais;
+    struct attitude_t attitude;
+};
+
 struct shmexport_t
 {
-    int bookend1;
-    struct gps_data_t gpsdata;
-    int bookend2;
+    int version;		/* SHM_EXPORT_VERSION */
+    int slots;			/* SHM_EXPORT_SLOTS */
+    unsigned int tick;		/* counts updates of all slots */
+    struct shmexport_slot_t slot[SHM_EXPORT_SLOTS];
 };
+
+#define SHM_FIX_MASK	(REPORT_IS|TIME_SET|TIMERR_SET|LATLON_SET \
+			 |ALTITUDE_SET|CLIMB_SET|STATUS_SET|MODE_SET|DOP_SET \
+			 |HERR_SET|VERR_SET|CLIMBERR_SET)
+
+static /*@unused@*/ inline gps_mask_t shm_section_mask(int section)
+/* the report bits that concern a section */
+{
+    switch (section) {
+    case shm_fix:
+	return SHM_FIX_MASK;
+    case shm_sky:
+	return SATELLITE_SET;
+    case shm_navigation:
+	return NAVIGATION_SET;
+    case shm_environment:
+	return ENVIRONMENT_SET;
+    case shm_engine:
+	return ENGINE_SET;
+    case shm_ais:
+	return AIS_SET;
+    case shm_attitude:
+	return ATTITUDE_SET;
+    default:
+	return 0;
+    }
+}
+
 extern bool shm_acquire(struct gps_context_t *);
 extern void shm_release(struct gps_context_t *);
-extern void shm_update(struct gps_context_t *, struct gps_data_t *);
+extern void shm_update(struct gps_context_t *, struct gps_device_t *,
+		       gps_mask_t);
 
 
 /* dbusexport.c */
@@ -1039,6 +1174,15 @@ extern unsigned char hc(unsigned char);
 
 /* application interface */
 extern void gps_context_init(struct gps_context_t *context);
+extern void gpsd_timer_init(/*@out@*/struct gpsd_timer_t *,
+			    /*@null@*/gpsd_timer_fire_t, /*@null@*/void *);
+extern void gpsd_timer_arm(struct gps_context_t *, struct gpsd_timer_t *,
+			   uint64_t);
+extern void gpsd_timer_after(struct gps_context_t *, struct gpsd_timer_t *,
+			     unsigned int);
+extern void gpsd_timer_cancel(struct gps_context_t *, struct gpsd_timer_t *);
+extern int gpsd_timer_timeout(const struct gps_context_t *, int);
+extern unsigned int gpsd_timers_run(struct gps_context_t *);
 extern void gpsd_init(struct gps_device_t *,
 		      struct gps_context_t *,
 		      /*@null@*/const char *);
@@ -1057,7 +1201,7 @@ extern void gpsd_deactivate(struct gps_device_t *);
 extern int gpsd_await_data(/*@out@*/fd_set *,
 			    const int, 
 			    /*@in@*/fd_set *,
-			    const int);
+			    struct gps_context_t *);
 extern gps_mask_t gpsd_poll(struct gps_device_t *);
 #define DEVICE_EOF	-3
 #define DEVICE_ERROR	-2
@@ -1104,6 +1248,33 @@ void gpsd_report(const int, const int, const char *, ...);
 void gpsd_external_report(const int, const int, const char *, ...);
 #endif
 
+/*
+ * gpsd_report() throws away what is above the debug level, but only
+ * after the caller has evaluated all of its arguments: conversions,
+ * lookups, a gpsd_packetdump() into a scratch buffer.  GPSD_LOG() and
+ * GPSD_EXTERNAL_LOG() check the level first and skip the call with
+ * its arguments when nobody is going to see the message.  The daemon
+ * also passes gpsd_external_report() messages on to subscribers that
+ * asked for them, up to gpsd_log_sublevel.
+ */
+extern int gpsd_log_sublevel;
+
+#define gpsd_log_wanted(debuglevel, errlevel) \
+	((errlevel) <= (debuglevel))
+#define gpsd_external_log_wanted(debuglevel, errlevel) \
+	((errlevel) <= (debuglevel) || (errlevel) <= gpsd_log_sublevel)
+
+#define GPSD_LOG(debuglevel, errlevel, ...) \
+	do { \
+	    if (gpsd_log_wanted(debuglevel, errlevel)) \
+		gpsd_report(debuglevel, errlevel, __VA_ARGS__); \
+	} while (0)
+#define GPSD_EXTERNAL_LOG(debuglevel, errlevel, ...) \
+	do { \
+	    if (gpsd_external_log_wanted(debuglevel, errlevel)) \
+		gpsd_external_report(debuglevel, errlevel, __VA_ARGS__); \
+	} while (0)
+
 int config_parse(struct interface_t *, struct vessel_t *, struct gps_device_t *);
 
 #ifdef S_SPLINT_S
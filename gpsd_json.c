@@ -490,6 +490,9 @@ void json_watch_dump(const struct policy_t *ccp,
 		   ccp->timing ? "true" : "false",
 		   ccp->split24 ? "true" : "false",
 		   ccp->pps ? "true" : "false");
+    if (ccp->canboat != 0)
+	(void)snprintf(reply + strlen(reply), replylen - strlen(reply),
+		       "\"canboat\":%d,", ccp->canboat);
     if (ccp->devpath[0] != '\0')
 	(void)snprintf(reply + strlen(reply), replylen - strlen(reply),
 		       "\"device\":\"%s\",", ccp->devpath);
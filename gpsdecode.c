@@ -13,6 +13,7 @@
 
 #include "gpsd.h"
 #include "gps_json.h"
+#include "canboat.h"
 
 static int verbose = 0;
 static bool scaled = true;
@@ -643,13 +644,55 @@ static void encode(FILE *fpin, FILE *fpout)
 /*@ +compdestroy +compdef +usedef @*/
 #endif /* SOCKET_EXPORT_ENABLE */
 
+static void canboat(FILE *fpin, FILE *fpout)
+/* binary canboat records on fpin to canboat text on fpout */
+{
+    static uint8_t inbuf[CANBOAT_HEADER + UINT16_MAX];
+    static char line[CANBOAT_TEXT_HEADER + UINT16_MAX * 3 + 3];
+    size_t len = 0, skipped = 0;
+
+    for (;;) {
+	size_t n, used = 0;
+
+	n = fread(inbuf + len, 1, sizeof(inbuf) - len, fpin);
+	if (n == 0)
+	    break;
+	len += n;
+	while (used < len) {
+	    struct canboat_record_t rec;
+	    char when[32];
+	    ssize_t status = canboat_unpack(inbuf + used, len - used, &rec);
+
+	    if (status == 0)
+		break;
+	    if (status < 0) {
+		/* not where a record starts, look for the next one */
+		used++;
+		skipped++;
+		continue;
+	    }
+	    /* the daemon's realtime clock, as it was at the read() */
+	    canboat_time(when, sizeof(when), rec.stamp, rec.offset);
+	    if (canboat_text(line, sizeof(line), when, &rec) > 0)
+		(void)fputs(line, fpout);
+	    used += (size_t)status;
+	}
+	(void)memmove(inbuf, inbuf + used, len - used);
+	len -= used;
+    }
+    if (verbose > 0 && skipped + len > 0)
+	(void)fprintf(stderr,
+		      "gpsdecode: %zu bytes between and %zu after records\n",
+		      skipped, len);
+}
+
 int main(int argc, char **argv)
 {
     int c;
     enum
-    { doencode, dodecode } mode = dodecode;
+    { doencode, dodecode, docanboat } mode = dodecode;
 
-    while ((c = getopt(argc, argv, "cdejpst:uvVD:")) != EOF) {
+    while ((c = getopt(argc, argv, "cdejnpst:uvVD:")) != EOF) {
 	switch (c) {
 	case 'c':
 	    json = false;
@@ -667,6 +710,10 @@ int main(int argc, char **argv)
 	    json = true;
 	    break;
 
+	case 'n':
+	    mode = docanboat;
+	    break;
+
 	case 's':
 	    split24 = true;
 	    break;
@@ -718,7 +765,9 @@ int main(int argc, char **argv)
 	(void)fprintf(stderr, "gpsdecode: encoding support isn't compiled.\n");
 	exit(EXIT_FAILURE);
 #endif /* SOCKET_EXPORT_ENABLE */
-    } else
+    } else if (mode == docanboat)
+	canboat(stdin, stdout);
+    else
 	decode(stdin, stdout);
     exit(EXIT_SUCCESS);
 }
@@ -1288,7 +1288,7 @@ int main(int argc, char **argv)
 #ifdef EFDS
 	    fd_set efds;
 #endif /* EFDS */
-	    switch(gpsd_await_data(&rfds, maxfd, &all_fds, context.debug))
+	    switch(gpsd_await_data(&rfds, maxfd, &all_fds, &context))
 	    {
 	    case AWAIT_GOT_INPUT:
 		break;
@@ -16,6 +16,11 @@
  * This will dump the GPSD and the NMEA sentences from gpsd to stdout
  *      gpspipe -wr
  *
+ * This will dump NMEA2000 as canboat text, or binary canboat records
+ * for gpsdecode -n, to stdout
+ *      gpspipe -c
+ *      gpspipe -C
+ *
  * Original code by: Gary E. Miller <gem@rellim.com>.  Cleanup by ESR.
  *
  * This file is Copyright (c) 2010 by the GPSD project
@@ -99,6 +104,8 @@ static void usage(void)
 		  "-h Show this help.\n"
 		  "-r Dump raw NMEA.\n"
 		  "-R Dump super-raw mode (GPS binary).\n"
+		  "-c Dump NMEA2000 as canboat text.\n"
+		  "-C Dump NMEA2000 as binary canboat records.\n"
 		  "-w Dump gpsd native data.\n"
 		  "-S Set scaled flag.\n"
 		  "-2 Set the split24 flag.\n"
@@ -112,7 +119,7 @@ static void usage(void)
 		  "-p Include profiling info in the JSON.\n"
 		  "-P Include PPS JSON in NMEA or raw mode.\n"
 		  "-V Print version and exit.\n\n"
-		  "You must specify one, or more, of -r, -R, or -w\n"
+		  "You must specify one, or more, of -r, -R, -c, -C or -w\n"
 		  "You must use -o if you use -d.\n");
 }
 
@@ -128,6 +135,7 @@ int main(int argc, char **argv)
     bool sleepy = false;
     bool new_line = true;
     bool raw = false;
+    bool canboat = false;
     bool watch = false;
     bool profile = false;
     int option_u = 0;                   // option to show uSeconds
@@ -144,7 +152,7 @@ int main(int argc, char **argv)
 
     /*@-branchstate@*/
     flags = WATCH_ENABLE;
-    while ((option = getopt(argc, argv, "?dD:lhrRwStT:vVn:s:o:pPu2")) != -1) {
+    while ((option = getopt(argc, argv, "?dD:lhrRcCwStT:vVn:s:o:pPu2")) != -1) {
 	switch (option) {
 	case 'D':
 	    debug = atoi(optarg);
@@ -167,6 +175,14 @@ int main(int argc, char **argv)
 	    flags |= WATCH_RAW;
 	    binary = true;
 	    break;
+	case 'c':
+	    flags |= WATCH_CANBOAT;
+	    canboat = true;
+	    break;
+	case 'C':
+	    flags |= WATCH_CANBOAT_BINARY;
+	    binary = true;
+	    break;
 	case 'd':
 	    daemonize = true;
 	    break;
@@ -238,9 +254,9 @@ int main(int argc, char **argv)
 	exit(EXIT_FAILURE);
     }
 
-    if (!raw && !watch && !binary) {
+    if (!raw && !watch && !binary && !canboat) {
 	(void)fprintf(stderr,
-		      "gpspipe: one of '-R', '-r', or '-w' is required.\n");
+		      "gpspipe: one of '-R', '-r', '-c', '-C' or '-w' is required.\n");
 	exit(EXIT_FAILURE);
     }
 
@@ -41,8 +41,6 @@ uint8_t n2k_payload_offset = 4;
 
 uint8_t report_format = 0;
 
-extern struct nmea2000_packet nmea2000_packets[32 + 1];
-
 int sock, status, sinlen;
 struct sockaddr_in sock_in;
 
@@ -525,9 +523,9 @@ void decode_line(struct gps_device_t *session, char * line) {
         int mb;
 
         mb = nmea2000_parsemsg(&frame);
-        packet = &nmea2000_packets[mb];
+        packet = (mb > -1) ? &nmea2000_packets[mb] : NULL;
 
-        if((mb > -1) && (packet->state == complete)) {
+        if(packet != NULL && packet->state == complete) {
 
             outbuffer = &packet->outbuffer[0];
             outbuflen = packet->outbuflen;
@@ -876,6 +874,7 @@ int main(int argc, char**argv) {
 
 
     context.debug = loglevel;
+    nmea2000_debug = loglevel;
     context.readonly = 0;
     session.context = &context;
 
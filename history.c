@@ -0,0 +1,415 @@
+/* history.c -- per device time series of SignalK values
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdlib.h>
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+
+#include "gpsd.h"
+#include "timeutil.h"
+#include "history.h"
+
+/* a sample after the first of a block, three varints of up to 64 bits */
+#define HISTORY_SAMPLE_MAX	(10 * (1 + HISTORY_DIMS))
+
+/* *INDENT-OFF* */
+const struct history_path_t history_paths[HISTORY_SERIES] = {
+    [hist_speed_over_ground]	= {"navigation", "speedOverGround",
+				   1, 0.01, 1.0/KNOTS_TO_MPS},
+    [hist_speed_thru_water]	= {"navigation", "speedThroughWater",
+				   1, 0.01, 1.0/KNOTS_TO_MPS},
+    [hist_course_over_ground]	= {"navigation", "courseOverGroundTrue",
+				   1, 0.01, DEG_2_RAD, 360.0},
+    [hist_heading_true]		= {"navigation", "headingTrue",
+				   1, 0.01, DEG_2_RAD, 360.0},
+    [hist_heading_magnetic]	= {"navigation", "headingMagnetic",
+				   1, 0.01, DEG_2_RAD, 360.0},
+    [hist_depth]		= {"environment", "depthBelowTransducer",
+				   1, 0.01, 1.0},
+    [hist_wind_apparent_angle]	= {"environment.wind", "angleApparent",
+				   1, 0.01, DEG_2_RAD, 360.0},
+    [hist_wind_apparent_speed]	= {"environment.wind", "speedApparent",
+				   1, 0.01, 1.0},
+    [hist_wind_true_speed]	= {"environment.wind", "speedTrue",
+				   1, 0.01, 1.0},
+    [hist_wind_true_direction]	= {"environment.wind", "directionTrue",
+				   1, 0.01, DEG_2_RAD, 360.0},
+    [hist_water_temp]		= {"environment", "waterTemp",
+				   1, 0.01, 1.0},
+    [hist_engine_speed]		= {"propulsion.port_engine", "revolutions",
+				   1, 1.0, 60.0},
+    [hist_position]		= {"navigation", "position",
+				   2, 1e-7, 1.0},
+};
+
+/* where in the session the values come from */
+#define NAV(f)	offsetof(struct gps_data_t, navigation.f)
+#define ENV(f)	offsetof(struct gps_data_t, environment.f)
+#define ENG(f)	offsetof(struct gps_data_t, engine.instance[single_or_double_port].f)
+
+static const struct {
+    gps_mask_t mask;		/* report group carrying the value */
+    size_t set;			/* its pset word, 0 if it has none */
+    gps_mask_t pset;
+    size_t value[HISTORY_DIMS];
+} history_sources[HISTORY_SERIES] = {
+    [hist_speed_over_ground]	= {NAVIGATION_SET, NAV(set), NAV_SOG_PSET,
+				   {NAV(speed_over_ground)}},
+    [hist_speed_thru_water]	= {NAVIGATION_SET, NAV(set), NAV_STW_PSET,
+				   {NAV(speed_thru_water)}},
+    [hist_course_over_ground]	= {NAVIGATION_SET, NAV(set), NAV_COG_TRUE_PSET,
+				   {NAV(course_over_ground[compass_true])}},
+    [hist_heading_true]		= {NAVIGATION_SET, NAV(set), NAV_HDG_TRUE_PSET,
+				   {NAV(heading[compass_true])}},
+    [hist_heading_magnetic]	= {NAVIGATION_SET, NAV(set), NAV_HDG_MAGN_PSET,
+				   {NAV(heading[compass_magnetic])}},
+    [hist_depth]		= {NAVIGATION_SET, NAV(set), NAV_DPT_PSET,
+				   {NAV(depth)}},
+    [hist_wind_apparent_angle]	= {ENVIRONMENT_SET, ENV(set),
+				   ENV_WIND_APPARENT_ANGLE_PSET,
+				   {ENV(wind[wind_apparent].angle)}},
+    [hist_wind_apparent_speed]	= {ENVIRONMENT_SET, ENV(set),
+				   ENV_WIND_APPARENT_SPEED_PSET,
+				   {ENV(wind[wind_apparent].speed)}},
+    [hist_wind_true_speed]	= {ENVIRONMENT_SET, ENV(set),
+				   ENV_WIND_TRUE_TO_BOAT_SPEED_PSET,
+				   {ENV(wind[wind_true_to_boat].speed)}},
+    [hist_wind_true_direction]	= {ENVIRONMENT_SET, ENV(set),
+				   ENV_WIND_TRUE_NORTH_ANGLE_PSET,
+				   {ENV(wind[wind_true_north].angle)}},
+    [hist_water_temp]		= {ENVIRONMENT_SET, ENV(set),
+				   ENV_TEMP_WATER_PSET,
+				   {ENV(temp[temp_water])}},
+    [hist_engine_speed]		= {ENGINE_SET,
+				   offsetof(struct gps_data_t, engine.set),
+				   ENG_SPEED_PSET, {ENG(speed)}},
+    [hist_position]		= {LATLON_SET, 0, 0,
+				   {offsetof(struct gps_data_t, fix.longitude),
+				    offsetof(struct gps_data_t, fix.latitude)}},
+};
+/* *INDENT-ON* */
+
+#define HISTORY_GROUPS	(NAVIGATION_SET | ENVIRONMENT_SET | ENGINE_SET | LATLON_SET)
+
+static uint8_t *put_varint(uint8_t *p, int64_t v)
+/* zigzag, so that small negative numbers stay short */
+{
+    uint64_t u = ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+
+    while (u >= 0x80) {
+	*p++ = (uint8_t)(u | 0x80);
+	u >>= 7;
+    }
+    *p++ = (uint8_t)u;
+    return p;
+}
+
+static int64_t get_varint(const uint8_t **pp)
+{
+    const uint8_t *p = *pp;
+    uint64_t u = 0;
+    int shift = 0;
+
+    do {
+	u |= (uint64_t)(*p & 0x7f) << shift;
+	shift += 7;
+    } while (*p++ & 0x80);
+    *pp = p;
+    return (int64_t)(u >> 1) ^ -(int64_t)(u & 1);
+}
+
+#define history_block(store, n) \
+    (&(store)->blocks[((store)->head + (n)) % (store)->allocated])
+
+int history_lookup(const char *name)
+/* series recorded under a SignalK name, -1 if there is none */
+{
+    int i;
+
+    for (i = 0; i < HISTORY_SERIES; i++)
+	if (strcmp(history_paths[i].name, name) == 0)
+	    return i;
+    return -1;
+}
+
+/*@null@*/
+static struct history_block_t *history_new_block(struct history_series_store_t
+						 *store)
+/* append a block to the ring, growing it or giving up the oldest */
+{
+    if (store->nblocks == store->allocated) {
+	struct history_block_t *blocks = NULL;
+	uint16_t n = store->allocated ? store->allocated * 2 : 4;
+
+	if (n > HISTORY_MAX_BLOCKS)
+	    n = HISTORY_MAX_BLOCKS;
+	/* the ring only wraps once it has stopped growing */
+	if (n > store->allocated)
+	    blocks = realloc(store->blocks, n * sizeof(*blocks));
+	if (blocks != NULL) {
+	    store->blocks = blocks;
+	    store->allocated = n;
+	} else if (store->allocated == 0)
+	    return NULL;
+	else {
+	    store->head = (store->head + 1) % store->allocated;
+	    store->nblocks--;
+	}
+    }
+    store->nblocks++;
+    return history_block(store, store->nblocks - 1);
+}
+
+void history_record(struct gps_device_t *session, int series, uint32_t msec,
+		    const double *value)
+/* add a sample, at most one per HISTORY_INTERVAL */
+{
+    const struct history_path_t *path = &history_paths[series];
+    struct history_series_store_t *store;
+    struct history_block_t *block = NULL;
+    int32_t q[HISTORY_DIMS];
+    int d;
+
+    memset(q, 0, sizeof(q));
+    for (d = 0; d < path->dims; d++) {
+	double v = value[d] / path->resolution;
+	if (isnan(v) || fabs(v) >= 2147483647.0)
+	    return;
+	q[d] = (int32_t)lround(v);
+    }
+
+    if (session->history == NULL
+	&& (session->history = calloc(1, sizeof(struct history_t))) == NULL)
+	return;
+    store = &session->history->series[series];
+
+    if (store->nblocks > 0) {
+	if ((int32_t)(msec - store->msec) < HISTORY_INTERVAL)
+	    return;
+	block = history_block(store, store->nblocks - 1);
+	if (block->used + HISTORY_SAMPLE_MAX > HISTORY_BLOCK_BYTES)
+	    block = NULL;
+    }
+
+    if (block == NULL) {
+	if ((block = history_new_block(store)) == NULL)
+	    return;
+	block->first = msec;
+	(void)memcpy(block->value, q, sizeof(q));
+	block->count = 0;
+	block->used = 0;
+	store->delta = 0;
+    } else {
+	int32_t delta = (int32_t)(msec - store->msec);
+	uint8_t *p = block->data + block->used;
+
+	p = put_varint(p, (int64_t)delta - store->delta);
+	for (d = 0; d < path->dims; d++)
+	    p = put_varint(p, (int64_t)q[d] - store->value[d]);
+	block->used = (uint16_t)(p - block->data);
+	store->delta = delta;
+    }
+    block->count++;
+    block->last = msec;
+    store->msec = msec;
+    (void)memcpy(store->value, q, sizeof(q));
+}
+
+void history_update(struct gps_device_t *session)
+/* record the values the last packet carried */
+{
+    const char *gpsdata = (const char *)&session->gpsdata;
+    uint32_t msec;
+    int i, d;
+
+    if ((session->gpsdata.set & HISTORY_GROUPS) == 0)
+	return;
+    msec = tu_get_independend_time();
+    for (i = 0; i < HISTORY_SERIES; i++) {
+	double value[HISTORY_DIMS];
+
+	if ((session->gpsdata.set & history_sources[i].mask) == 0)
+	    continue;
+	if (history_sources[i].set != 0
+	    && (*(const gps_mask_t *)(gpsdata + history_sources[i].set)
+		& history_sources[i].pset) == 0)
+	    continue;
+	if (history_sources[i].mask == LATLON_SET
+	    && session->gpsdata.fix.mode <= MODE_NO_FIX)
+	    continue;
+	for (d = 0; d < history_paths[i].dims; d++)
+	    value[d] = *(const double *)(gpsdata + history_sources[i].value[d]);
+	history_record(session, i, msec, value);
+    }
+}
+
+void history_free(struct gps_device_t *session)
+{
+    int i;
+
+    if (session->history == NULL)
+	return;
+    for (i = 0; i < HISTORY_SERIES; i++)
+	free(session->history->series[i].blocks);
+    free(session->history);
+    session->history = NULL;
+}
+
+static bool history_step(struct history_cursor_t *cursor,
+			 /*@out@*/struct history_sample_t *sample)
+/* decode the next sample, whatever its time */
+{
+    const struct history_series_store_t *store = cursor->store;
+    const struct history_block_t *block;
+    int d;
+
+    for (;;) {
+	if (store == NULL || cursor->block >= store->nblocks)
+	    return false;
+	block = history_block(store, cursor->block);
+	if (cursor->index < block->count)
+	    break;
+	cursor->block++;
+	cursor->index = 0;
+	cursor->pos = 0;
+    }
+
+    if (cursor->index == 0) {
+	cursor->msec = block->first;
+	cursor->delta = 0;
+	(void)memcpy(cursor->value, block->value, sizeof(cursor->value));
+    } else {
+	const uint8_t *p = block->data + cursor->pos;
+
+	cursor->delta = (int32_t)(cursor->delta + get_varint(&p));
+	cursor->msec += (uint32_t)cursor->delta;
+	for (d = 0; d < cursor->dims; d++)
+	    cursor->value[d] = (int32_t)(cursor->value[d] + get_varint(&p));
+	cursor->pos = (uint16_t)(p - block->data);
+    }
+    cursor->index++;
+
+    sample->msec = cursor->msec;
+    for (d = 0; d < HISTORY_DIMS; d++)
+	sample->value[d] = cursor->value[d] * cursor->resolution;
+    return true;
+}
+
+void history_open(/*@out@*/struct history_cursor_t *cursor,
+		  const struct gps_device_t *session, int series,
+		  uint32_t after, uint32_t until)
+/* start a walk over the samples later than after and not later than until */
+{
+    const struct history_series_store_t *store;
+
+    memset(cursor, 0, sizeof(*cursor));
+    cursor->until = until;
+    if (series < 0 || series >= HISTORY_SERIES || session->history == NULL)
+	return;
+    store = &session->history->series[series];
+    cursor->store = store;
+    cursor->dims = history_paths[series].dims;
+    cursor->resolution = history_paths[series].resolution;
+    cursor->period = history_paths[series].period;
+
+    /* whole blocks are skipped on their header alone */
+    while (cursor->block < store->nblocks
+	   && history_block(store, cursor->block)->last <= after)
+	cursor->block++;
+    while (history_step(cursor, &cursor->next))
+	if (cursor->next.msec > after) {
+	    cursor->pending = true;
+	    break;
+	}
+}
+
+bool history_next(struct history_cursor_t *cursor,
+		  /*@out@*/struct history_sample_t *sample)
+{
+    if (cursor->pending) {
+	cursor->pending = false;
+	*sample = cursor->next;
+    } else if (!history_step(cursor, sample))
+	return false;
+    if (sample->msec > cursor->until) {
+	cursor->store = NULL;
+	return false;
+    }
+    return true;
+}
+
+static double history_wrap(double angle, double period, bool sign)
+/* an angle into [0, period), or [-period/2, period/2) if signed */
+{
+    angle = fmod(angle, period);
+    if (angle < 0)
+	angle += period;
+    /* what rounding left a hair short of a full turn is none */
+    if (period - angle < 1e-9)
+	angle = 0;
+    if (sign && angle >= period / 2)
+	angle -= period;
+    return angle;
+}
+
+bool history_next_bucket(struct history_cursor_t *cursor, uint32_t width,
+			 /*@out@*/struct history_bucket_t *bucket)
+/* min, max and average of the samples in the next non-empty bucket */
+{
+    struct history_sample_t sample;
+    double sum[HISTORY_DIMS];
+    double first, low = 0, high = 0, sines = 0, cosines = 0;
+    int d;
+
+    if (width == 0)
+	width = 1;
+    if (!history_next(cursor, &sample))
+	return false;
+    bucket->start = sample.msec - sample.msec % width;
+    bucket->count = 0;
+    bucket->min = bucket->max = first = sample.value[0];
+    memset(sum, 0, sizeof(sum));
+    do {
+	if (sample.msec - bucket->start >= width) {
+	    cursor->next = sample;
+	    cursor->pending = true;
+	    break;
+	}
+	if (cursor->period > 0) {
+	    /* angles as turns from the first, so 350 and 10 are 20 apart */
+	    double off = history_wrap(sample.value[0] - first,
+				      cursor->period, true);
+	    double rad = sample.value[0] * 2 * GPS_PI / cursor->period;
+	    if (off < low)
+		low = off;
+	    if (off > high)
+		high = off;
+	    sines += sin(rad);
+	    cosines += cos(rad);
+	} else {
+	    if (sample.value[0] < bucket->min)
+		bucket->min = sample.value[0];
+	    if (sample.value[0] > bucket->max)
+		bucket->max = sample.value[0];
+	}
+	for (d = 0; d < HISTORY_DIMS; d++)
+	    sum[d] += sample.value[d];
+	bucket->count++;
+    } while (history_next(cursor, &sample));
+    for (d = 0; d < HISTORY_DIMS; d++)
+	bucket->avg[d] = sum[d] / bucket->count;
+    if (cursor->period > 0) {
+	/* reported the way the series has them, signed or not */
+	bool sign = first < 0;
+	bucket->min = history_wrap(first + low, cursor->period, sign);
+	bucket->max = history_wrap(first + high, cursor->period, sign);
+	bucket->avg[0] = history_wrap(atan2(sines, cosines) * cursor->period
+				      / (2 * GPS_PI), cursor->period, sign);
+    }
+    return true;
+}
+
+/* history.c ends here */
@@ -0,0 +1,136 @@
+/* history.h -- per device time series of SignalK values
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _HISTORY_H_
+#define _HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * Every device keeps a short history of the values a chart wants to
+ * show, one series per SignalK path.  A series is a ring of fixed size
+ * blocks.  A block starts with one sample in the clear; every further
+ * sample is a zigzag varint of its time delta minus the previous one
+ * and one per value of the difference of the value quantized to the
+ * series' resolution.  A steady 1Hz instrument costs two to three
+ * bytes a sample, a day of it fits in under 256KB.
+ *
+ * Blocks are allocated when a series sees its first sample and the
+ * ring grows up to HISTORY_MAX_BLOCKS; after that the oldest block is
+ * reused.  Times are the milliseconds of tu_get_independend_time().
+ */
+#define HISTORY_INTERVAL	1000	/* msec, at most one sample a second */
+#define HISTORY_BLOCK_BYTES	1024
+#ifndef GPSD_SLIM
+#define HISTORY_MAX_BLOCKS	256	/* per series, a bit over a day at 1Hz */
+#else
+#define HISTORY_MAX_BLOCKS	64	/* per series, about seven hours at 1Hz */
+#endif /* GPSD_SLIM */
+#define HISTORY_DIMS		2	/* values per sample, position has two */
+
+enum history_series_t {
+    hist_speed_over_ground,
+    hist_speed_thru_water,
+    hist_course_over_ground,
+    hist_heading_true,
+    hist_heading_magnetic,
+    hist_depth,
+    hist_wind_apparent_angle,
+    hist_wind_apparent_speed,
+    hist_wind_true_speed,
+    hist_wind_true_direction,
+    hist_water_temp,
+    hist_engine_speed,
+    hist_position,
+    HISTORY_SERIES
+};
+
+/* what a series records and how it is named in SignalK */
+struct history_path_t {
+    const char *group;		/* dotted SignalK path above the name */
+    const char *name;		/* the field= of a track request */
+    int dims;
+    double resolution;		/* quantization step in stored units */
+    double factor;		/* stored units to reported units */
+    double period;		/* 360 for angles in degrees, else 0 */
+};
+
+struct history_block_t {
+    uint32_t first, last;	/* msec of the first and last sample */
+    int32_t value[HISTORY_DIMS];	/* first sample, quantized */
+    uint16_t count;		/* samples in the block */
+    uint16_t used;		/* bytes of data in use */
+    uint8_t data[HISTORY_BLOCK_BYTES];
+};
+
+struct history_series_store_t {
+    /*@null@*/struct history_block_t *blocks;
+    uint16_t allocated;		/* blocks in the ring */
+    uint16_t head;		/* oldest block */
+    uint16_t nblocks;		/* blocks in use */
+    /* encoder state, the last sample written */
+    uint32_t msec;
+    int32_t delta;
+    int32_t value[HISTORY_DIMS];
+};
+
+struct history_t {
+    struct history_series_store_t series[HISTORY_SERIES];
+};
+
+struct history_sample_t {
+    uint32_t msec;
+    double value[HISTORY_DIMS];
+};
+
+/*
+ * min and max are only kept for the first value.  Of an angle they
+ * are the ends of the arc the samples cover, going clockwise, so min
+ * is the larger where the arc crosses zero, and avg is the circular
+ * mean.
+ */
+struct history_bucket_t {
+    uint32_t start;		/* msec, a multiple of the bucket width */
+    uint32_t count;
+    double min, max;
+    double avg[HISTORY_DIMS];
+};
+
+/* walks one series in time order */
+struct history_cursor_t {
+    /*@null@*/const struct history_series_store_t *store;
+    int dims;
+    double resolution;
+    double period;
+    uint32_t until;
+    uint16_t block;		/* blocks of the ring already left behind */
+    uint16_t index;		/* samples of the block already returned */
+    uint16_t pos;		/* decoding position in the block */
+    uint32_t msec;
+    int32_t delta;
+    int32_t value[HISTORY_DIMS];
+    bool pending;		/* lookahead of the bucket walk */
+    struct history_sample_t next;
+};
+
+struct gps_device_t;
+
+extern const struct history_path_t history_paths[HISTORY_SERIES];
+
+extern int history_lookup(const char *);
+extern void history_record(struct gps_device_t *, int, uint32_t,
+			   const double *);
+extern void history_update(struct gps_device_t *);
+extern void history_free(struct gps_device_t *);
+extern void history_open(/*@out@*/struct history_cursor_t *,
+			 const struct gps_device_t *, int,
+			 uint32_t, uint32_t);
+extern bool history_next(struct history_cursor_t *,
+			 /*@out@*/struct history_sample_t *);
+extern bool history_next_bucket(struct history_cursor_t *, uint32_t,
+				/*@out@*/struct history_bucket_t *);
+
+#endif /* _HISTORY_H_ */
@@ -0,0 +1,103 @@
+/* jsonout.c -- cursor based writer for JSON reports
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <math.h>
+
+#include "jsonout.h"
+
+#define JSONOUT_MAX_DECIMALS	9
+
+static const double scale[JSONOUT_MAX_DECIMALS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+};
+
+void jsonout_init(/*@out@*/struct jsonout_t *out, /*@out@*/char *buf,
+		  size_t len)
+{
+    out->buf = out->p = buf;
+    out->end = buf + len - 1;
+    out->overflow = false;
+    buf[0] = '\0';
+}
+
+void jsonout_mem(struct jsonout_t *out, const char *s, size_t n)
+/* append n bytes, all or nothing */
+{
+    if (out->overflow || n > jsonout_room(out)) {
+	out->overflow = true;
+	return;
+    }
+    (void)memcpy(out->p, s, n);
+    out->p += n;
+    *out->p = '\0';
+}
+
+void jsonout_uint(struct jsonout_t *out, unsigned long u, int width)
+/* decimal, zero padded to width like %0*lu */
+{
+    char tmp[24], *q = tmp + sizeof(tmp);
+
+    if (width > (int)sizeof(tmp))
+	width = (int)sizeof(tmp);
+    do {
+	*--q = (char)('0' + u % 10);
+	u /= 10;
+    } while (u != 0);
+    while (tmp + sizeof(tmp) - q < width)
+	*--q = '0';
+    jsonout_mem(out, q, (size_t)(tmp + sizeof(tmp) - q));
+}
+
+void jsonout_fixed(struct jsonout_t *out, double value, int decimals)
+/* what %.*f makes of value */
+{
+    char tmp[48], *q = tmp + sizeof(tmp);
+    unsigned long long r, ip, fp;
+    double t, frac;
+    int i, n;
+
+    if (decimals < 0 || decimals > JSONOUT_MAX_DECIMALS || !isfinite(value))
+	goto slow;
+    t = fabs(value) * scale[decimals];
+    /* the integer part is exact and the product is off by a fraction of
+     * a thousandth at most, enough to find the nearest integer unless
+     * the exact value is close to a tie; leave those to printf */
+    if (t >= 1e12)
+	goto slow;
+    frac = t - floor(t);
+    if (fabs(frac - 0.5) < 1e-3)
+	goto slow;
+    r = (unsigned long long)t + (frac > 0.5 ? 1 : 0);
+
+    ip = r / (unsigned long long)scale[decimals];
+    fp = r % (unsigned long long)scale[decimals];
+    for (i = 0; i < decimals; i++) {
+	*--q = (char)('0' + fp % 10);
+	fp /= 10;
+    }
+    if (decimals > 0)
+	*--q = '.';
+    do {
+	*--q = (char)('0' + ip % 10);
+	ip /= 10;
+    } while (ip != 0);
+    if (signbit(value))
+	*--q = '-';
+    jsonout_mem(out, q, (size_t)(tmp + sizeof(tmp) - q));
+    return;
+
+  slow:
+    if (out->overflow)
+	return;
+    n = snprintf(out->p, jsonout_room(out) + 1, "%.*f", decimals, value);
+    if (n < 0 || (size_t)n > jsonout_room(out)) {
+	*out->p = '\0';
+	out->overflow = true;
+    } else
+	out->p += n;
+}
+
+/* jsonout.c ends here */
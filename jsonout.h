@@ -0,0 +1,62 @@
+/* jsonout.h -- cursor based writer for JSON reports
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _JSONOUT_H_
+#define _JSONOUT_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+ * A report is built front to back through a cursor that knows where
+ * the text ends and how much room is left, so appending never rescans
+ * what has been written the way strlcat() and snprintf(reply +
+ * strlen(reply), ...) do.  Numbers are formatted by hand; the output
+ * is byte for byte what the printf formats it replaces produce.
+ *
+ * The buffer is always NUL terminated.  Once something does not fit
+ * the writer stops appending for good and remembers it, the text
+ * written up to there is left intact.
+ */
+struct jsonout_t {
+    char *buf;
+    char *p;			/* the terminating NUL */
+    char *end;			/* last byte of the buffer */
+    bool overflow;
+};
+
+extern void jsonout_init(/*@out@*/struct jsonout_t *, /*@out@*/char *, size_t);
+extern void jsonout_mem(struct jsonout_t *, const char *, size_t);
+extern void jsonout_uint(struct jsonout_t *, unsigned long, int);
+extern void jsonout_fixed(struct jsonout_t *, double, int);
+
+/* append a C string */
+#define jsonout_str(out, s)	jsonout_mem((out), (s), strlen(s))
+/* append a string literal, its length is known at compile time */
+#define jsonout_lit(out, s)	jsonout_mem((out), (s), sizeof(s) - 1)
+
+static inline void jsonout_char(struct jsonout_t *out, char c)
+{
+    if (!out->overflow && out->p < out->end) {
+	*out->p++ = c;
+	*out->p = '\0';
+    } else
+	out->overflow = true;
+}
+
+/* bytes written so far, not counting the NUL */
+static inline size_t jsonout_len(const struct jsonout_t *out)
+{
+    return (size_t)(out->p - out->buf);
+}
+
+/* bytes that can still be appended */
+static inline size_t jsonout_room(const struct jsonout_t *out)
+{
+    return (size_t)(out->end - out->p);
+}
+
+#endif /* _JSONOUT_H_ */
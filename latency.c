@@ -0,0 +1,260 @@
+/* latency.c -- histograms of the time from device read to client send
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <string.h>
+
+#include "gpsd.h"
+#include "jsonout.h"
+#include "latency.h"
+
+struct latency_t latency;
+
+/* *INDENT-OFF* */
+static const char *type_names[LATENCY_TYPES] = {
+    [FRM_TYPE_CMD]	= "command",
+    [FRM_TYPE_NMEA0183]	= "nmea0183",
+    [FRM_TYPE_NMEA2000]	= "nmea2000",
+    [FRM_TYPE_ST]	= "seatalk",
+    [FRM_TYPE_AIS]	= "ais",
+};
+
+static const char *stage_names[LATENCY_STAGES] = {
+    [lat_accept]	= "accept",
+    [lat_decode]	= "decode",
+    [lat_dispatch]	= "dispatch",
+    [lat_send]		= "send",
+};
+
+/* the names getProtocolName() in gpsd.c uses */
+static const char *protocol_names[LATENCY_PROTOCOLS] = {
+    [tcp]		= "tcp",
+    [websocket]		= "ws",
+    [http]		= "http",
+};
+/* *INDENT-ON* */
+
+void latency_enable(bool on)
+{
+    if (on && !latency.enabled)
+	latency_reset();
+    latency.enabled = on;
+    latency.batch = 0;
+}
+
+void latency_reset(void)
+/* forget everything recorded so far */
+{
+    bool enabled = latency.enabled;
+
+    memset(&latency, 0, sizeof(latency));
+    latency.enabled = enabled;
+    latency.since = latency_now();
+}
+
+static unsigned msb(uint32_t v)
+/* position of the highest bit set, v must not be 0 */
+{
+#ifdef __GNUC__
+    return 31 - (unsigned)__builtin_clz(v);
+#else
+    unsigned n = 0;
+
+    while (v >>= 1)
+	n++;
+    return n;
+#endif /* __GNUC__ */
+}
+
+static unsigned bucket_of(uint32_t ns)
+{
+    unsigned shift;
+
+    if (ns < LATENCY_SUB)
+	return ns;
+    shift = msb(ns) - LATENCY_SUB_BITS;
+    return (shift + 1) * LATENCY_SUB + ((ns >> shift) & (LATENCY_SUB - 1));
+}
+
+static uint32_t bucket_low(unsigned i)
+/* the smallest value that lands in bucket i */
+{
+    if (i < LATENCY_SUB)
+	return i;
+    return (uint32_t)(LATENCY_SUB + i % LATENCY_SUB) << (i / LATENCY_SUB - 1);
+}
+
+static uint32_t bucket_width(unsigned i)
+{
+    return i < 2 * LATENCY_SUB ? 1 : (uint32_t)1 << (i / LATENCY_SUB - 1);
+}
+
+void latency_record(struct latency_hist_t *h, uint64_t ns)
+{
+    uint32_t v = ns > UINT32_MAX ? UINT32_MAX : (uint32_t)ns;
+
+    if (h->count == 0 || v < h->min)
+	h->min = v;
+    if (v > h->max)
+	h->max = v;
+    h->count++;
+    h->sum += v;
+    h->bucket[bucket_of(v)]++;
+}
+
+uint32_t latency_quantile(const struct latency_hist_t *h, double q)
+/* ns below which the fraction q of the values lie, middle of the bucket */
+{
+    uint64_t rank, seen = 0;
+    unsigned i;
+
+    if (h->count == 0)
+	return 0;
+    rank = (uint64_t)(q * h->count + 0.5);
+    if (rank < 1)
+	rank = 1;
+    for (i = 0; i < LATENCY_BUCKETS; i++) {
+	seen += h->bucket[i];
+	if (seen >= rank) {
+	    uint32_t v = bucket_low(i) + (bucket_width(i) - 1) / 2;
+
+	    if (v < h->min)
+		v = h->min;
+	    if (v > h->max)
+		v = h->max;
+	    return v;
+	}
+    }
+    return h->max;
+}
+
+void latency_dispatch(uint64_t stamp, unsigned types)
+/* the report of the read() at stamp is about to go out */
+{
+    uint64_t now;
+    unsigned type;
+
+    if (!latency.enabled || stamp == 0 || types == 0)
+	return;
+    now = latency_now();
+    for (type = 0; type < LATENCY_TYPES; type++)
+	if ((types & (1u << type)) != 0)
+	    latency_record(&latency.stage[type][lat_dispatch], now - stamp);
+    latency.batch = stamp;
+    latency.batch_types = types;
+}
+
+void latency_sent(int protocol)
+/* part of the current report went out on a socket of this protocol */
+{
+    uint64_t ns;
+    unsigned type;
+
+    if (!latency.enabled || latency.batch == 0)
+	return;
+    ns = latency_now() - latency.batch;
+    if (protocol >= 0 && protocol < LATENCY_PROTOCOLS)
+	latency_record(&latency.protocol[protocol], ns);
+    for (type = 0; type < LATENCY_TYPES; type++)
+	if ((latency.batch_types & (1u << type)) != 0)
+	    latency_record(&latency.stage[type][lat_send], ns);
+}
+
+static void dump_hist(struct jsonout_t *out, const char *name,
+		      const struct latency_hist_t *h)
+/* "name":{...} with count, mean and quantiles in usec */
+{
+    jsonout_char(out, '"');
+    jsonout_str(out, name);
+    jsonout_lit(out, "\":{\"count\":");
+    jsonout_uint(out, h->count, 0);
+    jsonout_lit(out, ",\"min\":");
+    jsonout_fixed(out, h->min / 1000.0, 1);
+    jsonout_lit(out, ",\"mean\":");
+    jsonout_fixed(out, (double)h->sum / h->count / 1000.0, 1);
+    jsonout_lit(out, ",\"p50\":");
+    jsonout_fixed(out, latency_quantile(h, 0.5) / 1000.0, 1);
+    jsonout_lit(out, ",\"p90\":");
+    jsonout_fixed(out, latency_quantile(h, 0.9) / 1000.0, 1);
+    jsonout_lit(out, ",\"p99\":");
+    jsonout_fixed(out, latency_quantile(h, 0.99) / 1000.0, 1);
+    jsonout_lit(out, ",\"p999\":");
+    jsonout_fixed(out, latency_quantile(h, 0.999) / 1000.0, 1);
+    jsonout_lit(out, ",\"max\":");
+    jsonout_fixed(out, h->max / 1000.0, 1);
+    jsonout_char(out, '}');
+}
+
+size_t latency_dump(/*@out@*/char *reply, size_t replylen)
+/* the STATS response, histograms nothing was recorded in are left out */
+{
+    struct jsonout_t out;
+    unsigned type, stage, protocol;
+    bool first;
+
+    jsonout_init(&out, reply, replylen);
+    jsonout_lit(&out, "{\"class\":\"STATS\",\"enabled\":");
+    if (!latency.enabled) {
+	jsonout_lit(&out, "false}\r\n");
+	return jsonout_len(&out);
+    }
+    jsonout_lit(&out, "true,\"elapsed\":");
+    jsonout_fixed(&out, (latency_now() - latency.since) / 1e9, 3);
+    jsonout_lit(&out, ",\"queued\":");
+    jsonout_uint(&out, latency.queued, 0);
+    jsonout_lit(&out, ",\"recompute\":{\"dop\":");
+    jsonout_uint(&out, latency.recompute.dop, 0);
+    jsonout_lit(&out, ",\"dop_skipped\":");
+    jsonout_uint(&out, latency.recompute.dop_skipped, 0);
+    jsonout_lit(&out, ",\"error_model\":");
+    jsonout_uint(&out, latency.recompute.error_model, 0);
+    jsonout_lit(&out, ",\"error_model_skipped\":");
+    jsonout_uint(&out, latency.recompute.error_model_skipped, 0);
+    jsonout_lit(&out, "},\"fanout\":{\"encoded\":");
+    jsonout_uint(&out, latency.fanout.encoded, 0);
+    jsonout_lit(&out, ",\"saved\":");
+    jsonout_uint(&out, latency.fanout.saved, 0);
+    jsonout_char(&out, '}');
+
+    jsonout_lit(&out, ",\"types\":{");
+    first = true;
+    for (type = 0; type < LATENCY_TYPES; type++) {
+	bool any = false;
+
+	for (stage = 0; stage < LATENCY_STAGES; stage++) {
+	    const struct latency_hist_t *h = &latency.stage[type][stage];
+
+	    if (h->count == 0)
+		continue;
+	    if (!any) {
+		if (!first)
+		    jsonout_char(&out, ',');
+		jsonout_char(&out, '"');
+		jsonout_str(&out, type_names[type]);
+		jsonout_lit(&out, "\":{");
+		first = false;
+	    } else
+		jsonout_char(&out, ',');
+	    dump_hist(&out, stage_names[stage], h);
+	    any = true;
+	}
+	if (any)
+	    jsonout_char(&out, '}');
+    }
+
+    jsonout_lit(&out, "},\"protocols\":{");
+    first = true;
+    for (protocol = 0; protocol < LATENCY_PROTOCOLS; protocol++) {
+	if (latency.protocol[protocol].count == 0)
+	    continue;
+	if (!first)
+	    jsonout_char(&out, ',');
+	dump_hist(&out, protocol_names[protocol], &latency.protocol[protocol]);
+	first = false;
+    }
+    jsonout_lit(&out, "}}\r\n");
+    return jsonout_len(&out);
+}
+
+/* latency.c ends here */
@@ -0,0 +1,109 @@
+/* latency.h -- histograms of the time from device read to client send
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _LATENCY_H_
+#define _LATENCY_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "frame.h"
+
+/*
+ * The lexer stamps every read() of a device with the monotonic clock.
+ * Each frame of that read is then timed against the stamp when the
+ * lexer accepts it, when its driver has decoded it, when the report it
+ * went into is dispatched and whenever that report hits a client
+ * socket.  Times go into one histogram per frame type and stage, the
+ * socket writes also into one per subscriber protocol.
+ *
+ * The histograms are HDR style: exact below 2^LATENCY_SUB_BITS ns,
+ * above that every power of two is split into 2^LATENCY_SUB_BITS
+ * linear buckets, so a value is off by at most 1/2^LATENCY_SUB_BITS
+ * of itself.  Recording is a handful of instructions and never
+ * allocates.  Values are capped at 2^32 ns, a bit over four seconds.
+ *
+ * The read() stamps are always taken, canboat records carry them.
+ * Nothing is recorded unless latency.enabled is set, all the hooks in
+ * the data path cost one well predicted branch then.
+ */
+#ifndef GPSD_SLIM
+#define LATENCY_SUB_BITS	4	/* 6% resolution, 1.8KB a histogram */
+#else
+#define LATENCY_SUB_BITS	3	/* 12% resolution, 960 bytes a histogram */
+#endif /* GPSD_SLIM */
+#define LATENCY_SUB		(1 << LATENCY_SUB_BITS)
+#define LATENCY_BUCKETS		((32 - LATENCY_SUB_BITS + 1) * LATENCY_SUB)
+
+#define LATENCY_TYPES		FRM_TYPE_MAX	/* indexed by FRM_TYPE_* */
+#define LATENCY_PROTOCOLS	3		/* indexed by enum protocol_t */
+
+enum latency_stage_t {
+    lat_accept,			/* read() to lexer accept */
+    lat_decode,			/* read() to driver decode done */
+    lat_dispatch,		/* read() to report dispatch */
+    lat_send,			/* read() to send() to a client */
+    LATENCY_STAGES
+};
+
+struct latency_hist_t {
+    uint32_t count;
+    uint32_t min, max;		/* ns */
+    uint64_t sum;		/* ns, for the mean */
+    uint32_t bucket[LATENCY_BUCKETS];
+};
+
+struct latency_t {
+    bool enabled;
+    uint64_t since;		/* ns, when recording was last reset */
+    uint64_t batch;		/* read() stamp of the report going out, 0 if none */
+    unsigned batch_types;	/* FRM_TYPE_* bits of the frames in that report */
+    uint32_t queued;		/* report writes that went to an output queue */
+    struct {
+	/* DOPs and error model worked out, or skipped as nothing changed */
+	uint32_t dop, dop_skipped;
+	uint32_t error_model, error_model_skipped;
+    } recompute;
+    struct {
+	/* JSON watcher reports encoded, or served from the report cache */
+	uint32_t encoded, saved;
+    } fanout;
+    struct latency_hist_t stage[LATENCY_TYPES][LATENCY_STAGES];
+    struct latency_hist_t protocol[LATENCY_PROTOCOLS];
+};
+
+extern struct latency_t latency;
+
+extern void latency_enable(bool);
+extern void latency_reset(void);
+extern void latency_record(struct latency_hist_t *, uint64_t);
+extern uint32_t latency_quantile(const struct latency_hist_t *, double);
+extern void latency_dispatch(uint64_t, unsigned);
+extern void latency_sent(int);
+extern size_t latency_dump(/*@out@*/char *, size_t);
+
+static inline uint64_t latency_now(void)
+/* monotonic ns, the time base of every stamp */
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static inline void latency_stage(unsigned type, enum latency_stage_t stage,
+				 uint64_t stamp)
+/* time a frame of the given type against the read() it came from */
+{
+    if (latency.enabled && stamp != 0 && type < LATENCY_TYPES)
+	latency_record(&latency.stage[type][stage], latency_now() - stamp);
+}
+
+/* the report of the current read() has been handed to all clients */
+#define latency_done()	(latency.batch = 0)
+
+#endif /* _LATENCY_H_ */
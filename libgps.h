@@ -24,6 +24,7 @@ extern int gps_shm_open(/*@out@*/struct gps_data_t *);
 extern void gps_shm_close(struct gps_data_t *);
 extern bool gps_shm_waiting(const struct gps_data_t *, int);
 extern int gps_shm_read(struct gps_data_t *);
+extern int gps_shm_stream(struct gps_data_t *, unsigned int, /*@null@*/void *);
 extern int gps_shm_mainloop(struct gps_data_t *, int,
 			      void (*)(struct gps_data_t *));
 
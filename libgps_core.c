@@ -178,6 +178,11 @@ int gps_stream(struct gps_data_t *gpsdata CONDITIONALLY_UNUSED,
 {
     int status = -1;
 
+#ifdef SHM_EXPORT_ENABLE
+    if ((intptr_t)(gpsdata->gps_fd) == SHM_PSEUDO_FD)
+	return gps_shm_stream(gpsdata, flags, d);
+#endif /* SHM_EXPORT_ENABLE */
+
 #ifdef SOCKET_EXPORT_ENABLE
     /* cppcheck-suppress redundantAssignment */
     status = gps_sock_stream(gpsdata, flags, d);
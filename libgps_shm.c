@@ -5,9 +5,10 @@ NAME
 
 DESCRIPTION
    This is a very lightweight alternative to JSON-over-sockets.  Clients
-won't be able to filter by device, and won't get device activation/deactivation
-notifications.  But both client and daemon will avoid all the marshalling and
-unmarshalling overhead.
+won't get device activation/deactivation notifications.  But both client
+and daemon will avoid all the marshalling and unmarshalling overhead.
+A read copies only the sections that changed since the last one, of
+one device, and only those gps_shm_select() asked for.
 
 PERMISSIONS
    This file is Copyright (c) 2010 by the GPSD project
@@ -33,7 +34,11 @@ PERMISSIONS
 struct privdata_t
 {
     void *shmseg;
-    int tick;
+    unsigned int tick;		/* segment tick at the last read */
+    char devpath[GPS_PATH_MAX];	/* device to read, empty for the latest */
+    gps_mask_t want;		/* sections the reader asked for */
+    int slot;			/* slot the sequences below belong to */
+    unsigned int seq[SHM_SECTIONS];	/* sequences already copied */
 };
 /*@+matchfields@*/
 
@@ -46,20 +51,29 @@ int gps_shm_open(/*@out@*/struct gps_data_t *gpsdata)
     libgps_debug_trace((DEBUG_CALLS, "gps_shm_open()\n"));
 
     gpsdata->privdata = NULL;
-    shmid = shmget((key_t)GPSD_KEY, sizeof(struct gps_data_t), 0);
+    shmid = shmget((key_t)GPSD_KEY, sizeof(struct shmexport_t), 0);
     if (shmid == -1) {
 	/* daemon isn't running or failed to create shared segment */
 	return -1;
     }
-    gpsdata->privdata = (void *)malloc(sizeof(struct privdata_t));
+    gpsdata->privdata = (void *)calloc(1, sizeof(struct privdata_t));
     if (gpsdata->privdata == NULL)
 	return -1;
 
     PRIVATE(gpsdata)->shmseg = shmat(shmid, 0, 0);
-    if ((int)(long)gpsdata->privdata == -1) {
+    if ((int)(long)PRIVATE(gpsdata)->shmseg == -1) {
 	/* attach failed for sume unknown reason */
 	return -2;
     }
+    if (((volatile struct shmexport_t *)PRIVATE(gpsdata)->shmseg)->version
+	!= SHM_EXPORT_VERSION) {
+	/* a daemon with a different layout */
+	(void)shmdt(PRIVATE(gpsdata)->shmseg);
+	PRIVATE(gpsdata)->shmseg = NULL;
+	return -2;
+    }
+    PRIVATE(gpsdata)->want = ~(gps_mask_t)0;
+    PRIVATE(gpsdata)->slot = -1;
 #ifndef USE_QT
     gpsdata->gps_fd = SHM_PSEUDO_FD;
 #else
@@ -68,6 +82,31 @@ int gps_shm_open(/*@out@*/struct gps_data_t *gpsdata)
     return 0;
 }
 
+int gps_shm_select(struct gps_data_t *gpsdata, gps_mask_t want)
+/* copy only the sections holding these report bits on gps_read(),
+   -1 if gpsdata isn't a shared memory session */
+{
+    if ((intptr_t)(gpsdata->gps_fd) != SHM_PSEUDO_FD
+	|| gpsdata->privdata == NULL)
+	return -1;
+    PRIVATE(gpsdata)->want = want;
+    return 0;
+}
+
+int gps_shm_stream(struct gps_data_t *gpsdata, unsigned int flags,
+		   /*@null@*/void *d)
+/* WATCH_DEVICE picks the device to read, otherwise the latest to report */
+{
+    if (gpsdata->privdata == NULL)
+	return -1;
+    if ((flags & WATCH_DEVICE) != 0 && d != NULL)
+	(void)strlcpy(PRIVATE(gpsdata)->devpath, (const char *)d,
+		      sizeof(PRIVATE(gpsdata)->devpath));
+    else if ((flags & WATCH_DISABLE) == 0)
+	PRIVATE(gpsdata)->devpath[0] = '\0';
+    return 0;
+}
+
 bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
 /* check to see if new data has been written */
 {
@@ -78,7 +117,7 @@ bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
     for (;;) {
 	bool newdata = false;
 	memory_barrier();
-	if (shared->bookend1 == shared->bookend2 && shared->bookend1 > PRIVATE(gpsdata)->tick)
+	if (shared->tick != PRIVATE(gpsdata)->tick)
 	    newdata = true;
 	memory_barrier();
 	if (newdata || (timestamp() - basetime >= (double)timeout))
@@ -88,55 +127,199 @@ bool gps_shm_waiting(const struct gps_data_t *gpsdata, int timeout)
     return true;
 }
 
+static int shm_find_slot(volatile struct shmexport_t *shared,
+			 const char *devpath)
+/* the slot of the device asked for, or the one updated last */
+{
+    int i, found = -1;
+
+    for (i = 0; i < SHM_EXPORT_SLOTS; i++) {
+	volatile struct shmexport_slot_t *slot = &shared->slot[i];
+	if (slot->path[0] == '\0')
+	    continue;
+	if (devpath[0] != '\0') {
+	    if (strcmp((const char *)slot->path, devpath) == 0)
+		return i;
+	} else if (found == -1
+		   || (int)(slot->tick - shared->slot[found].tick) > 0)
+	    found = i;
+    }
+    return found;
+}
+
+static size_t shm_section_read(volatile struct shmexport_slot_t *slot,
+			       int section, struct gps_data_t *gpsdata,
+			       unsigned int *seq, gps_mask_t *set)
+/* copy a section that changed since seq, return the bytes copied */
+{
+    /* a section is copied aside first, a torn copy must not reach
+     * the caller's data */
+    union {
+	struct shm_fix_t fix;
+	struct shm_sky_t sky;
+	struct navigation_t navigation;
+	struct environment_t environment;
+	struct engine_t engine;
+	struct ais_t ais;
+	struct attitude_t attitude;
+    } copy;
+    volatile void *src;
+    size_t size;
+    unsigned int before, after;
+    int tries;
+
+    switch (section) {
+    case shm_fix:
+	src = &slot->fix;
+	size = sizeof(copy.fix);
+	break;
+    case shm_sky:
+	src = &slot->sky;
+	size = sizeof(copy.sky);
+	break;
+    case shm_navigation:
+	src = &slot->navigation;
+	size = sizeof(copy.navigation);
+	break;
+    case shm_environment:
+	src = &slot->environment;
+	size = sizeof(copy.environment);
+	break;
+    case shm_engine:
+	src = &slot->engine;
+	size = sizeof(copy.engine);
+	break;
+    case shm_ais:
+	src = &slot->ais;
+	size = sizeof(copy.ais);
+	break;
+    case shm_attitude:
+	src = &slot->attitude;
+	size = sizeof(copy.attitude);
+	break;
+    default:
+	return 0;
+    }
+
+    /*
+     * Following block of instructions must not be reordered,
+     * otherwise havoc will ensue.  The writer keeps the sequence
+     * odd while it changes the section; the copy is good if the
+     * sequence was even and did not move while we took it.
+     */
+    for (tries = 0; tries < 3; tries++) {
+	before = slot->seq[section];
+	if (before == *seq)
+	    return 0;
+	if ((before & 1) != 0)
+	    continue;
+	memory_barrier();
+	(void)memcpy((void *)&copy, (const void *)src, size);
+	memory_barrier();
+	after = slot->seq[section];
+	if (before == after)
+	    break;
+    }
+    if (tries == 3)
+	return 0;
+    *seq = before;
+
+    switch (section) {
+    case shm_fix:
+	*set |= copy.fix.set;
+	gpsdata->online = copy.fix.online;
+	gpsdata->fix = copy.fix.fix;
+	gpsdata->separation = copy.fix.separation;
+	gpsdata->status = copy.fix.status;
+	gpsdata->dop = copy.fix.dop;
+	gpsdata->epe = copy.fix.epe;
+	break;
+    case shm_sky:
+	*set |= SATELLITE_SET;
+	gpsdata->satellites_used = copy.sky.satellites_used;
+	(void)memcpy(gpsdata->used, copy.sky.used, sizeof(gpsdata->used));
+	gpsdata->skyview_time = copy.sky.skyview_time;
+	gpsdata->satellites_visible = copy.sky.satellites_visible;
+	(void)memcpy(gpsdata->PRN, copy.sky.PRN, sizeof(gpsdata->PRN));
+	(void)memcpy(gpsdata->elevation, copy.sky.elevation,
+		     sizeof(gpsdata->elevation));
+	(void)memcpy(gpsdata->azimuth, copy.sky.azimuth,
+		     sizeof(gpsdata->azimuth));
+	(void)memcpy(gpsdata->ss, copy.sky.ss, sizeof(gpsdata->ss));
+	break;
+    case shm_navigation:
+	*set |= NAVIGATION_SET;
+	gpsdata->navigation = copy.navigation;
+	break;
+    case shm_environment:
+	*set |= ENVIRONMENT_SET;
+	gpsdata->environment = copy.environment;
+	break;
+    case shm_engine:
+	*set |= ENGINE_SET;
+	gpsdata->engine = copy.engine;
+	break;
+    case shm_ais:
+	*set |= AIS_SET;
+	gpsdata->ais = copy.ais;
+	break;
+    case shm_attitude:
+	*set |= ATTITUDE_SET;
+	gpsdata->attitude = copy.attitude;
+	break;
+    }
+    return size;
+}
+
 int gps_shm_read(struct gps_data_t *gpsdata)
-/* read an update from the shared-memory segment */
+/* read what changed in the sections asked for since the last read */
 {
     /*@ -compdestroy */
     if (gpsdata->privdata == NULL)
 	return -1;
     else
     {
-	int before, after;
-	void *private_save = gpsdata->privdata;
-	volatile struct shmexport_t *shared = (struct shmexport_t *)PRIVATE(gpsdata)->shmseg;
-	struct gps_data_t noclobber;
-
-	/*
-	 * Following block of instructions must not be reordered,
-	 * otherwise havoc will ensue.  The memory_barrier() call
-	 * should prevent reordering of the data accesses.
-	 *
-	 * This is a simple optimistic-concurrency technique.  We wrote
-	 * the second bookend first, then the data, then the first bookend.
-	 * Reader copies what it sees in normal order; that way, if we
-	 * start to write the segment during the read, the second bookend will
-	 * get clobbered first and the data can be detected as bad.
-	 */
-	before = shared->bookend1;
-	memory_barrier();
-	(void)memcpy((void *)&noclobber,
-		     (void *)&shared->gpsdata,
-		     sizeof(struct gps_data_t));
+	struct privdata_t *priv = PRIVATE(gpsdata);
+	volatile struct shmexport_t *shared = (struct shmexport_t *)priv->shmseg;
+	volatile struct shmexport_slot_t *slot;
+	gps_mask_t set = 0;
+	size_t bytes = 0;
+	int i, section;
+	unsigned int tick;
+
+	tick = shared->tick;
 	memory_barrier();
-	after = shared->bookend2;
+	i = shm_find_slot(shared, priv->devpath);
+	if (i == -1)
+	    return 0;
+	slot = &shared->slot[i];
+	if (i != priv->slot) {
+	    /* another device, everything is new to us */
+	    priv->slot = i;
+	    (void)memset(priv->seq, 0, sizeof(priv->seq));
+	}
 
-	if (before != after)
+	for (section = 0; section < SHM_SECTIONS; section++) {
+	    if ((priv->want & shm_section_mask(section)) == 0)
+		continue;
+	    bytes += shm_section_read(slot, section, gpsdata,
+				      &priv->seq[section], &set);
+	}
+	priv->tick = tick;
+	if (bytes == 0)
 	    return 0;
-	else {
-	    (void)memcpy((void *)gpsdata,
-			 (void *)&noclobber,
-			 sizeof(struct gps_data_t));
-	    /*@i1@*/gpsdata->privdata = private_save;
-	    PRIVATE(gpsdata)->tick = after;
-	    if ((gpsdata->set & REPORT_IS)!=0) {
-		if (gpsdata->fix.mode >= 2)
-		    gpsdata->status = STATUS_FIX;
-		else
-		    gpsdata->status = STATUS_NO_FIX;
-		gpsdata->set = STATUS_SET;
-	    }
-	    return (int)sizeof(struct gps_data_t);
+
+	(void)strlcpy(gpsdata->dev.path, (const char *)slot->path,
+		      sizeof(gpsdata->dev.path));
+	if ((set & REPORT_IS)!=0) {
+	    if (gpsdata->fix.mode >= 2)
+		gpsdata->status = STATUS_FIX;
+	    else
+		gpsdata->status = STATUS_NO_FIX;
+	    set = (set & ~REPORT_IS) | STATUS_SET;
 	}
+	gpsdata->set = set;
+	return (int)bytes;
     }
     /*@ +compdestroy */
 }
@@ -166,6 +349,15 @@ int gps_shm_mainloop(struct gps_data_t *gpsdata, int timeout UNUSED,
     //return 0;
 }
 
+#else
+
+#include "gps.h"
+
+int gps_shm_select(struct gps_data_t *gpsdata UNUSED, gps_mask_t want UNUSED)
+/* without shared memory export there are no sessions to select for */
+{
+    return -1;
+}
 #endif /* SHM_EXPORT_ENABLE */
 
 /* end */
@@ -501,7 +501,8 @@ int gps_sock_stream(struct gps_data_t *gpsdata, unsigned int flags,
 {
     char buf[GPS_JSON_COMMAND_MAX];
 
-    if ((flags & (WATCH_JSON | WATCH_OLDSTYLE | WATCH_NMEA | WATCH_RAW)) == 0) {
+    if ((flags & (WATCH_JSON | WATCH_OLDSTYLE | WATCH_NMEA | WATCH_RAW
+		  | WATCH_CANBOAT | WATCH_CANBOAT_BINARY)) == 0) {
 	flags |= WATCH_JSON;
     }
     if ((flags & WATCH_DISABLE) != 0) {
@@ -527,6 +528,8 @@ int gps_sock_stream(struct gps_data_t *gpsdata, unsigned int flags,
 		(void)strlcat(buf, "\"split24\":false,", sizeof(buf));
 	    if (flags & WATCH_PPS)
 		(void)strlcat(buf, "\"pps\":false,", sizeof(buf));
+	    if (flags & (WATCH_CANBOAT | WATCH_CANBOAT_BINARY))
+		(void)strlcat(buf, "\"canboat\":0,", sizeof(buf));
 	    if (buf[strlen(buf) - 1] == ',')
 		buf[strlen(buf) - 1] = '\0';
 	    (void)strlcat(buf, "};", sizeof(buf));
@@ -557,6 +560,10 @@ int gps_sock_stream(struct gps_data_t *gpsdata, unsigned int flags,
 		(void)strlcat(buf, "\"split24\":true,", sizeof(buf));
 	    if (flags & WATCH_PPS)
 		(void)strlcat(buf, "\"pps\":true,", sizeof(buf));
+	    if (flags & WATCH_CANBOAT_BINARY)
+		(void)strlcat(buf, "\"canboat\":2,", sizeof(buf));
+	    else if (flags & WATCH_CANBOAT)
+		(void)strlcat(buf, "\"canboat\":1,", sizeof(buf));
 	    /*@-nullpass@*//* shouldn't be needed, splint has a bug */
 	    if (flags & WATCH_DEVICE)
 		(void)snprintf(buf + strlen(buf), sizeof(buf) - strlen(buf),
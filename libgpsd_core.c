@@ -15,6 +15,7 @@
 #include <stdbool.h>
 #include <libgen.h>
 #include <math.h>
+#include <stddef.h>
 #include <string.h>
 #include <stdarg.h>
 #include <fcntl.h>
@@ -41,6 +42,11 @@
 #include "driver_seatalk.h"
 #endif /* defined(SEATALK_ENABLE) */
 #include "navigation.h"
+#include "history.h"
+#include "aistarget.h"
+#include "timeutil.h"
+#include "devreader.h"
+#include "latency.h"
 
 void gpsd_init_ports(struct gps_device_t *session);
 void gpsd_waypoint_clear(struct waypoint_navigation_t *);
@@ -81,12 +87,19 @@ static void visibilize(/*@out@*/char *buf2, size_t len, const char *buf)
 const char *gpsd_prettydump(struct gps_device_t *session)
 /* dump the current packet in a form optimised for eyeballs */
 {
+    if (session->packet.type == VYSPI_PACKET && session->packet.out_count > 0)
+	return gpsd_packetdump(session->msgbuf, sizeof(session->msgbuf),
+			       (char *)packet_record(&session->packet, 0),
+			       session->packet.out_len[0]);
     return gpsd_packetdump(session->msgbuf, sizeof(session->msgbuf),
 			   (char *)session->packet.outbuffer,
 			   session->packet.outbuflen);
 }
 
 
+/* raised by the daemon while log subscribers want more than it logs */
+int gpsd_log_sublevel = LOG_ERROR - 1;
+
 void gpsd_labeled_report(const int debuglevel, const int sublevel, const int errlevel,
 			 const char *label, const char *fmt, va_list ap)
 /* assemble command in printf(3) style, use stderr or syslog */
@@ -250,6 +263,7 @@ void gps_context_init(struct gps_context_t *context)
 	.gps_tow        = 0,
 	.century	= 0,
 	.rollovers      = 0,
+	.ais_targets    = NULL,
 #ifdef TIMEHINT_ENABLE
 	.leap_notify    = LEAP_NOWARNING,
 #endif /* TIMEHINT_ENABLE */
@@ -267,6 +281,7 @@ void gps_context_init(struct gps_context_t *context)
     /*@ +initallelements +nullassign +nullderef @*/
     /* *INDENT-ON* */
     (void)memcpy(context, &nullcontext, sizeof(struct gps_context_t));
+    timerwheel_init(&context->timers, timerwheel_now());
 
 #if !defined(S_SPLINT_S) && defined(PPS_ENABLE)
     /*@-nullpass@*/
@@ -276,6 +291,61 @@ void gps_context_init(struct gps_context_t *context)
 }
 /*@+compdestroy@*/
 
+void gpsd_timer_init(struct gpsd_timer_t *timer, gpsd_timer_fire_t fire,
+		     void *owner)
+/* set up a timer that is not armed, fire NULL keeps it from ever arming */
+{
+    timerwheel_timer_init(&timer->wheel, owner);
+    timer->fire = fire;
+}
+
+void gpsd_timer_arm(struct gps_context_t *context, struct gpsd_timer_t *timer,
+		    uint64_t due)
+/* (re)arm a timer to fire at due, ms of timerwheel_now() */
+{
+    if (timer->fire != NULL)
+	timerwheel_arm(&context->timers, &timer->wheel, due);
+}
+
+void gpsd_timer_after(struct gps_context_t *context,
+		      struct gpsd_timer_t *timer, unsigned int ms)
+/* (re)arm a timer to fire ms from now */
+{
+    gpsd_timer_arm(context, timer, timerwheel_now() + ms);
+}
+
+void gpsd_timer_cancel(struct gps_context_t *context,
+		       struct gpsd_timer_t *timer)
+/* disarm a timer, harmless if it is not armed */
+{
+    timerwheel_cancel(&context->timers, &timer->wheel);
+}
+
+int gpsd_timer_timeout(const struct gps_context_t *context, int max)
+/* ms a poll may sleep before a timer is due, max < 0 to sleep for good */
+{
+    return timerwheel_timeout(&context->timers, timerwheel_now(), max);
+}
+
+static void timer_fire(struct wheel_timer_t *wheel, void *arg)
+{
+    /* the wheel timer is the first member */
+    struct gpsd_timer_t *timer = (struct gpsd_timer_t *)wheel;
+
+    timer->fire(timer, *(const uint64_t *)arg);
+}
+
+unsigned int gpsd_timers_run(struct gps_context_t *context)
+/* fire the timers that are due, return how many did */
+{
+    uint64_t now;
+
+    if (context->timers.armed == 0)
+	return 0;
+    now = timerwheel_now();
+    return timerwheel_expire(&context->timers, now, timer_fire, &now);
+}
+
 void gpsd_waypoint_clear(struct waypoint_navigation_t * wpy) {
     wpy->set = 0;
     wpy->xte = NAN;
@@ -314,6 +384,54 @@ void gpsd_environment_clear(struct environment_t * env) {
 
 }
 
+/*
+ * Drivers set a PSET bit for every field they fill in, so everything
+ * not flagged is still clear and only the flagged fields need clearing
+ * before the next packet.
+ */
+static const struct {
+    gps_mask_t pset;
+    size_t offset;
+} environment_fields[] = {
+#define ENV_FIELD(pset, field)	{pset, offsetof(struct environment_t, field)}
+    ENV_FIELD(ENV_WIND_APPARENT_SPEED_PSET, wind[wind_apparent].speed),
+    ENV_FIELD(ENV_WIND_APPARENT_ANGLE_PSET, wind[wind_apparent].angle),
+    ENV_FIELD(ENV_WIND_TRUE_NORTH_SPEED_PSET, wind[wind_true_north].speed),
+    ENV_FIELD(ENV_WIND_TRUE_NORTH_ANGLE_PSET, wind[wind_true_north].angle),
+    ENV_FIELD(ENV_WIND_MAGN_SPEED_PSET, wind[wind_magnetic_north].speed),
+    ENV_FIELD(ENV_WIND_MAGN_ANGLE_PSET, wind[wind_magnetic_north].angle),
+    ENV_FIELD(ENV_WIND_TRUE_TO_BOAT_SPEED_PSET, wind[wind_true_to_boat].speed),
+    ENV_FIELD(ENV_WIND_TRUE_TO_BOAT_ANGLE_PSET, wind[wind_true_to_boat].angle),
+    ENV_FIELD(ENV_WIND_TRUE_TO_WATER_SPEED_PSET, wind[wind_true_to_water].speed),
+    ENV_FIELD(ENV_WIND_TRUE_TO_WATER_ANGLE_PSET, wind[wind_true_to_water].angle),
+    ENV_FIELD(ENV_TEMP_WATER_PSET, temp[temp_water]),
+    ENV_FIELD(ENV_TEMP_AIR_PSET, temp[temp_air]),
+    ENV_FIELD(ENV_VARIATION_PSET, variation),
+    ENV_FIELD(ENV_DEVIATION_PSET, deviation),
+#undef ENV_FIELD
+};
+
+static void environment_clear_set(struct environment_t *env)
+/* clear the fields of the environment the last packet set */
+{
+    size_t i;
+
+    if (env->set == 0)
+	return;
+    for (i = 0; i < sizeof(environment_fields) / sizeof(environment_fields[0]); i++)
+	if ((env->set & environment_fields[i].pset) != 0)
+	    *(double *)((char *)env + environment_fields[i].offset) = NAN;
+    env->set = 0;
+}
+
+static void waypoint_clear_set(struct waypoint_navigation_t *wpy)
+/* clear the waypoint if the last packet set any of it */
+{
+    /* RMB fills in the waypoint names without flagging them */
+    if (wpy->set != 0)
+	gpsd_waypoint_clear(wpy);
+}
+
 void gpsd_init_ports(struct gps_device_t *session) {
 
     uint8_t n = 0;
@@ -338,6 +456,12 @@ void gpsd_init_ports(struct gps_device_t *session) {
     }
 }
 
+static void reawake_wakeup(struct gpsd_timer_t *timer UNUSED,
+			   uint64_t now UNUSED)
+/* only ends the wait of gpsd_await_data(), gpsd_multipoll() reawakens */
+{
+}
+
 void gpsd_init(struct gps_device_t *session, struct gps_context_t *context,
 	       const char *device)
 /* initialize GPS polling */
@@ -366,6 +490,13 @@ void gpsd_init(struct gps_device_t *session, struct gps_context_t *context,
     gps_clear_fix(&session->gpsdata.fix);
     gps_clear_fix(&session->newdata);
     gps_clear_fix(&session->oldfix);
+    session->history = NULL;
+    gpsd_timer_init(&session->reawake_timer, reawake_wakeup, session);
+#ifdef CHEAPFLOATS_ENABLE
+    session->skydop.n = -1;
+    session->skydop.valid = false;
+#endif /* CHEAPFLOATS_ENABLE */
+    gpsd_timer_init(&session->driver_timer, NULL, session);
     session->gpsdata.set = 0;
     gps_clear_dop(&session->gpsdata.dop);
     session->gpsdata.epe = NAN;
@@ -416,6 +547,11 @@ void gpsd_init(struct gps_device_t *session, struct gps_context_t *context,
 void gpsd_deactivate(struct gps_device_t *session)
 /* temporarily release the GPS device */
 {
+    /* a reader thread must be gone before its fd is closed */
+    devreader_deactivate(session);
+    gpsd_timer_cancel(session->context, &session->reawake_timer);
+    gpsd_timer_cancel(session->context, &session->driver_timer);
+    session->reawake = 0;
 #ifdef RECONFIGURE_ENABLE
     if (!session->context->readonly
 	&& session->device_type != NULL
@@ -844,26 +980,25 @@ static bool invert(double mat[4][4], /*@out@*/ double inverse[4][4])
 
 /*@ +fixedformalarray +mustdefine @*/
 
-static gps_mask_t fill_dop(const struct gps_data_t * gpsdata, struct dop_t * dop, const int debug)
+static bool sky_dop(const struct gps_data_t * gpsdata, int n,
+		    /*@in@*/int sky[][2], /*@out@*/struct dop_t * dop,
+		    const int debug)
+/* DOPs from the azimuth and elevation of the n satellites used */
 {
     double prod[4][4];
     double inv[4][4];
     double satpos[MAXCHANNELS][4];
-    double xdop, ydop, hdop, vdop, pdop, tdop, gdop;
-    int i, j, k, n;
+    int i, j, k;
 
     memset(satpos, 0, sizeof(satpos));
 
-    for (n = k = 0; k < gpsdata->satellites_used; k++) {
-	if (gpsdata->used[k] == 0)
-	    continue;
-	satpos[n][0] = sin(gpsdata->azimuth[k] * DEG_2_RAD)
-	    * cos(gpsdata->elevation[k] * DEG_2_RAD);
-	satpos[n][1] = cos(gpsdata->azimuth[k] * DEG_2_RAD)
-	    * cos(gpsdata->elevation[k] * DEG_2_RAD);
-	satpos[n][2] = sin(gpsdata->elevation[k] * DEG_2_RAD);
-	satpos[n][3] = 1;
-	n++;
+    for (k = 0; k < n; k++) {
+	satpos[k][0] = sin(sky[k][0] * DEG_2_RAD)
+	    * cos(sky[k][1] * DEG_2_RAD);
+	satpos[k][1] = cos(sky[k][0] * DEG_2_RAD)
+	    * cos(sky[k][1] * DEG_2_RAD);
+	satpos[k][2] = sin(sky[k][1] * DEG_2_RAD);
+	satpos[k][3] = 1;
     }
 
     /* If we don't have 4 satellites then we don't have enough information to calculate DOPS */
@@ -873,7 +1008,7 @@ static gps_mask_t fill_dop(const struct gps_data_t * gpsdata, struct dop_t * dop
 		    "Not enough satellites available %d < 4:\n",
 		    n);
 #endif /* __UNUSED__ */
-	return 0;		/* Is this correct return code here? or should it be ERROR_SET */
+	return false;		/* Is this correct return code here? or should it be ERROR_SET */
     }
 
     memset(prod, 0, sizeof(prod));
@@ -923,45 +1058,82 @@ static gps_mask_t fill_dop(const struct gps_data_t * gpsdata, struct dop_t * dop
 		    "LOS matrix is singular, can't calculate DOPs - source '%s'\n",
 		    gpsdata->dev.path);
 #endif
-	return 0;
+	return false;
+    }
+
+    dop->xdop = sqrt(inv[0][0]);
+    dop->ydop = sqrt(inv[1][1]);
+    dop->hdop = sqrt(inv[0][0] + inv[1][1]);
+    dop->vdop = sqrt(inv[2][2]);
+    dop->pdop = sqrt(inv[0][0] + inv[1][1] + inv[2][2]);
+    dop->tdop = sqrt(inv[3][3]);
+    dop->gdop = sqrt(inv[0][0] + inv[1][1] + inv[2][2] + inv[3][3]);
+    return true;
+}
+
+static gps_mask_t fill_dop(struct gps_device_t *session)
+/* DOPs from the skyview where the packet did not report them */
+{
+    const struct gps_data_t *gpsdata = &session->gpsdata;
+    struct dop_t *dop = &session->gpsdata.dop;
+    const struct dop_t *sky = &session->skydop.dop;
+    int used[MAXCHANNELS][2];
+    int k, n;
+
+    for (n = k = 0; k < gpsdata->satellites_used; k++) {
+	if (gpsdata->used[k] == 0)
+	    continue;
+	used[n][0] = gpsdata->azimuth[k];
+	used[n][1] = gpsdata->elevation[k];
+	n++;
     }
 
-    xdop = sqrt(inv[0][0]);
-    ydop = sqrt(inv[1][1]);
-    hdop = sqrt(inv[0][0] + inv[1][1]);
-    vdop = sqrt(inv[2][2]);
-    pdop = sqrt(inv[0][0] + inv[1][1] + inv[2][2]);
-    tdop = sqrt(inv[3][3]);
-    gdop = sqrt(inv[0][0] + inv[1][1] + inv[2][2] + inv[3][3]);
+    /* 129540 and GSV repeat the same sky many times a minute */
+    if (n == session->skydop.n
+	&& memcmp(used, session->skydop.sky, n * sizeof(used[0])) == 0) {
+	if (latency.enabled)
+	    latency.recompute.dop_skipped++;
+    } else {
+	if (latency.enabled)
+	    latency.recompute.dop++;
+	session->skydop.n = n;
+	(void)memcpy(session->skydop.sky, used, n * sizeof(used[0]));
+	session->skydop.valid = n >= 4
+	    && sky_dop(gpsdata, n, used, &session->skydop.dop,
+		       session->context->debug);
+    }
+    if (!session->skydop.valid)
+	return 0;
 
 #ifndef USE_QT
-    gpsd_report(debug, LOG_DATA,
+    gpsd_report(session->context->debug, LOG_DATA,
 		"DOPS computed/reported: X=%f/%f, Y=%f/%f, H=%f/%f, V=%f/%f, P=%f/%f, T=%f/%f, G=%f/%f\n",
-		xdop, dop->xdop, ydop, dop->ydop, hdop, dop->hdop, vdop,
-		dop->vdop, pdop, dop->pdop, tdop, dop->tdop, gdop, dop->gdop);
+		sky->xdop, dop->xdop, sky->ydop, dop->ydop, sky->hdop, dop->hdop,
+		sky->vdop, dop->vdop, sky->pdop, dop->pdop, sky->tdop, dop->tdop,
+		sky->gdop, dop->gdop);
 #endif
 
     /*@ -usedef @*/
     if (isnan(dop->xdop) != 0) {
-	dop->xdop = xdop;
+	dop->xdop = sky->xdop;
     }
     if (isnan(dop->ydop) != 0) {
-	dop->ydop = ydop;
+	dop->ydop = sky->ydop;
     }
     if (isnan(dop->hdop) != 0) {
-	dop->hdop = hdop;
+	dop->hdop = sky->hdop;
     }
     if (isnan(dop->vdop) != 0) {
-	dop->vdop = vdop;
+	dop->vdop = sky->vdop;
     }
     if (isnan(dop->pdop) != 0) {
-	dop->pdop = pdop;
+	dop->pdop = sky->pdop;
     }
     if (isnan(dop->tdop) != 0) {
-	dop->tdop = tdop;
+	dop->tdop = sky->tdop;
     }
     if (isnan(dop->gdop) != 0) {
-	dop->gdop = gdop;
+	dop->gdop = sky->gdop;
     }
     /*@ +usedef @*/
 
@@ -1120,19 +1292,27 @@ static void gpsd_error_model(struct gps_device_t *session,
 	(void)memcpy(oldfix, fix, sizeof(struct gps_fix_t));
     /*@ +mayaliasunique @*/
 }
+
+/*
+ * What the error model works from, or what it fills in.  Packets with
+ * none of it, most of an N2K bus, leave the model as it was.
+ */
+#define ERROR_MODEL_SET	(TIME_SET | TIMERR_SET | LATLON_SET | ALTITUDE_SET \
+			 | CLIMB_SET | STATUS_SET | MODE_SET | DOP_SET \
+			 | HERR_SET | VERR_SET | CLIMBERR_SET | SATELLITE_SET \
+			 | CLEAR_IS)
 #endif /* CHEAPFLOATS_ENABLE */
 
 /*@ -mustdefine -compdef @*/
 int gpsd_await_data(/*@out@*/fd_set *rfds,
 		     const int maxfd,
 		     /*@in@*/fd_set *all_fds,
-		     const int debug)
-/* await data from any socket in the all_fds set */
+		     struct gps_context_t *context)
+/* await data from any socket in the all_fds set, or the next timer */
 {
-    int status;
-//#ifdef COMPAT_SELECT
-    struct timeval tv;
-//#endif /* COMPAT_SELECT */
+    int status, timeout;
+    const int debug = context->debug;
+    struct timespec ts;
 
 #ifdef EFDS
     FD_ZERO(efds);
@@ -1140,27 +1320,30 @@ int gpsd_await_data(/*@out@*/fd_set *rfds,
     (void)memcpy((char *)rfds, (char *)all_fds, sizeof(fd_set));
     gpsd_report(debug, LOG_RAW + 2, "select waits\n");
     /*
-     * Poll for user commands or GPS data.  The timeout doesn't
-     * actually matter here since select returns whenever one of
-     * the file descriptors in the set goes ready.  The point
-     * of tracking maxfd is to keep the set of descriptors that
-     * select(2) has to poll here as small as possible (for
-     * low-clock-rate SBCs and the like).
-     *
-     * pselect() is preferable, when we can have it, to eliminate
-     * the once-per-second wakeup when no sensors are attached.
-     * This cuts power consumption.
+     * Poll for user commands or GPS data.  select returns whenever one
+     * of the file descriptors in the set goes ready, so the only
+     * reason to wake up otherwise is a timer of the context; with none
+     * armed we sleep until there is input.  That is what keeps an
+     * idle box without sensors from waking at all.  The point of
+     * tracking maxfd is to keep the set of descriptors that select(2)
+     * has to poll here as small as possible (for low-clock-rate SBCs
+     * and the like).
      */
     /*@ -usedef -nullpass @*/
     errno = 0;
 
-//#ifdef COMPAT_SELECT
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    status = select(maxfd + 1, rfds, NULL, NULL, &tv);
-//#else
-//    status = pselect(maxfd + 1, rfds, NULL, NULL, NULL, NULL);
-//#endif
+    timeout = gpsd_timer_timeout(context, -1);
+    ts.tv_sec = timeout / 1000;
+    ts.tv_nsec = (long)(timeout % 1000) * 1000000;
+    status = pselect(maxfd + 1, rfds, NULL, NULL,
+		     timeout < 0 ? NULL : &ts, NULL);
+    if (context->timers.armed > 0) {
+	/* what is due goes off before the input is looked at */
+	int saved_errno = errno;
+
+	(void)gpsd_timers_run(context);
+	errno = saved_errno;
+    }
     if (status == -1) {
 	if (errno == EINTR)
 	    return AWAIT_NOT_READY;
@@ -1185,7 +1368,7 @@ int gpsd_await_data(/*@out@*/fd_set *rfds,
 	}
     }
     if(status == 0) {
-	gpsd_report(debug, LOG_INF, "TIMEOUT\n");
+	gpsd_report(debug, LOG_RAW + 2, "timers due\n");
 	return AWAIT_TIMEOUT;
     }
     /*@ +usedef +nullpass @*/
@@ -1259,8 +1442,9 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
     struct gps_type_t *prev_driver = NULL;
 
     gps_clear_fix(&session->newdata);
-    gpsd_environment_clear(&session->gpsdata.environment);
-    gpsd_waypoint_clear(&session->gpsdata.waypoint);
+    /* only what the last packet set, most touch neither */
+    environment_clear_set(&session->gpsdata.environment);
+    waypoint_clear_set(&session->gpsdata.waypoint);
 
 #ifdef TIMING_ENABLE
     /*
@@ -1545,7 +1729,7 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
          */
         if ((received & SATELLITE_SET) != 0
             && session->gpsdata.satellites_visible > 0) {
-            session->gpsdata.set |= fill_dop(&session->gpsdata, &session->gpsdata.dop, session->context->debug);
+            session->gpsdata.set |= fill_dop(session);
             session->gpsdata.epe = NAN;
         }
 #endif /* CHEAPFLOATS_ENABLE */
@@ -1562,9 +1746,31 @@ gps_mask_t gpsd_poll(struct gps_device_t *session)
         gps_merge_fix(&session->gpsdata.fix,
                       session->gpsdata.set, &session->newdata);
 #ifdef CHEAPFLOATS_ENABLE
-        gpsd_error_model(session, &session->gpsdata.fix, &session->oldfix);
+        if ((received & ERROR_MODEL_SET) != 0) {
+            if (latency.enabled)
+                latency.recompute.error_model++;
+            gpsd_error_model(session, &session->gpsdata.fix, &session->oldfix);
+        } else if (latency.enabled)
+            latency.recompute.error_model_skipped++;
 #endif /* CHEAPFLOATS_ENABLE */
 
+        /* keep what charts want to show */
+        history_update(session);
+
+        /* a vyspi batch has its AIS frames merged one by one already */
+        if ((session->gpsdata.set & AIS_SET) != 0
+            && session->packet.type != VYSPI_PACKET)
+            aistarget_report(session);
+        if (session->context->ais_targets != NULL
+            && (session->gpsdata.set & (LATLON_SET | NAVIGATION_SET)) != 0
+            && session->gpsdata.fix.mode > MODE_NO_FIX)
+            aistarget_own(session->context->ais_targets,
+                          session->gpsdata.fix.latitude,
+                          session->gpsdata.fix.longitude,
+                          session->gpsdata.navigation.course_over_ground[compass_true],
+                          session->gpsdata.navigation.speed_over_ground * KNOTS_TO_MPS,
+                          tu_get_independend_time());
+
         /*@+nullderef -nullpass@*/
 
         /*
@@ -1694,7 +1900,11 @@ int gpsd_multipoll(const bool data_ready,
                         gpsd_report(device->context->debug, LOG_DATA,
                                     "%s will be repolled in %f seconds\n",
                                     device->gpsdata.dev.path, reawake_time);
-                        device->reawake = timestamp() + reawake_time;
+                        device->reawake = timerwheel_now()
+                            + (uint64_t)(reawake_time * 1000);
+                        gpsd_timer_arm(device->context,
+                                       &device->reawake_timer,
+                                       device->reawake);
                         return DEVICE_UNREADY;
                     }
                 }
@@ -1712,7 +1922,10 @@ int gpsd_multipoll(const bool data_ready,
 
             /* we got actual data, head off the reawake special case */
             device->zerokill = false;
-            device->reawake = (timestamp_t)0;
+            if (device->reawake != 0) {
+                device->reawake = 0;
+                gpsd_timer_cancel(device->context, &device->reawake_timer);
+            }
 
             /* must have a full packet to continue */
             if ((changed & PACKET_SET) == 0) {
@@ -1756,12 +1969,13 @@ int gpsd_multipoll(const bool data_ready,
             //    break;
         }
     }
-    else if (device->reawake>0 && timestamp()>device->reawake) {
+    else if (device->reawake>0 && timerwheel_now()>=device->reawake) {
         /* device may have had a zero-length read */
         gpsd_report(device->context->debug, LOG_DATA,
                     "%s reawakened after zero-length read\n",
                     device->gpsdata.dev.path);
-        device->reawake = (timestamp_t)0;
+        device->reawake = 0;
+        gpsd_timer_cancel(device->context, &device->reawake_timer);
         device->zerokill = true;
         return DEVICE_READY;
     }
@@ -0,0 +1,40 @@
+/* n2kcodec.h -- NMEA2000 PGN codecs generated from n2kpgns.json
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _N2KCODEC_H_
+#define _N2KCODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * n2kgen.py writes a decoder and an encoder for every PGN described
+ * in n2kpgns.json into n2kcodec.c.  Adding a field or a PGN there is
+ * all it takes, the drivers and pseudon2k.c find the codec by PGN.
+ *
+ * decode() takes the payload of a whole (reassembled) PGN, stores what
+ * it carries in gpsdata and returns the report mask, 0 if the payload
+ * is short or names an instance gpsd has no room for.
+ *
+ * encode() writes instance idx (an engine instance, a heading or wind
+ * reference, 0 where the PGN has none) and returns the payload length,
+ * 0 if it does not fit into len.  Values gpsd does not have go out as
+ * N/A.
+ */
+struct n2k_codec_t {
+    uint32_t pgn;
+    uint16_t length;		/* payload bytes */
+    uint8_t instances;		/* valid idx for encode() */
+    const char *name;
+    gps_mask_t (*decode)(const unsigned char *bu, int len,
+			 struct gps_data_t *gpsdata);
+    int (*encode)(const struct gps_data_t *gpsdata, int idx,
+		  unsigned char *bu, size_t len);
+};
+
+extern const struct n2k_codec_t n2k_codecs[];	/* ends with pgn 0 */
+extern /*@null@*/const struct n2k_codec_t *n2k_codec_find(uint32_t pgn);
+
+#endif /* _N2KCODEC_H_ */
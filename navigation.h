@@ -3,8 +3,6 @@
 
 void
 nav_init(struct gps_device_t *device);
-void
-nav_print_speed_over_ground(struct gps_device_t *session);
 gps_mask_t
 nav_set_speed_over_ground_in_knots(double value, struct gps_device_t *session);
 gps_mask_t
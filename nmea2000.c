@@ -2,15 +2,25 @@
 */
 
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include <time.h>
 
 #include "nmea2000.h"
+#include "pgnindex.h"
 
 // TODO - must be better solution for getting printing into both: stm and linux
 // #include "printf.h"
 #include "gpsd.h"
 
-#define vy_printf printf
+#define vy_printf(...) \
+    do { \
+        if (nmea2000_verbose) \
+            (void)printf(__VA_ARGS__); \
+    } while (0)
+
+bool nmea2000_verbose = true;              // print every frame and transmission
+int nmea2000_debug = 0;                    // debug level errors are logged against
 
 
 uint32_t nmea2000_packet_count;            // count number of all packets completed (fast and single)
@@ -19,39 +29,49 @@ uint32_t nmea2000_frame_count;             // number of frames handled
 uint32_t nmea2000_packet_error_count;      // number of packets that had an error and were aborted
 uint32_t nmea2000_packet_cancel_count;     // number of fast transmissions thar were cancled or interrupted
 uint32_t nmea2000_packet_transfer_count;   // number of packets delivered
+uint32_t nmea2000_packet_timeout_count;    // number of fast transmissions dropped after NMEA2000_FAST_TIMEOUT_MS
+uint32_t nmea2000_packet_orphan_count;     // number of fast frames that belong to no transmission in flight
+uint32_t nmea2000_packet_inflight;         // number of fast transmissions in flight right now
+uint32_t nmea2000_packet_inflight_max;     // most fast transmissions in flight at once
 
 /* 32 index is reserved for single transmissions 
    0 - x1F/31 is for multiple fast transmissions from multiple devices 
 
-   Mailboxes for fast transmissions are organized in a ring of 
-   mailboxes 0 - 31/0x1F. 
-   A new fast transmission is just fetching the next mailbox from the ring. 
-   If there is a pending transmission then that pending transmission is 
-   canceled under the assumption that it never finished. 
-
-   This approach avoids a cumbersom cleaning process of never finished
-   fast transmissions.
+   A fast transmission is identified by its source address, its PGN and
+   the 3 bit sequence id in the upper bits of every frame index. A device
+   may send several fast transmissions at once (different PGNs, or the
+   same PGN with different sequence ids), each of them gets a mailbox of
+   its own for as long as it is in flight.
+
+   The mailboxes in flight are found through a small hash table of
+   chains running through fast_next[], so continuation frames cost one
+   hash and usually one compare. Nothing is allocated, a start frame
+   takes the next mailbox from the ring 0 - 31/0x1F that is not in
+   flight:
+
+      i) a start frame for a key already in flight restarts that
+         mailbox, the old transmission is canceled
+      ii) transmissions whose last frame is older than
+          NMEA2000_FAST_TIMEOUT_MS are dropped while looking for a
+          free mailbox (and when one of their frames shows up late)
+      iii) with all 32 mailboxes in flight the one that was quiet the
+           longest is canceled
 
    Assumptions: 
 
       i) 1 "mailbox" is enough for all single transmissions. 
-      ii) fast mailboxes can be identified by their the source device 
 
    to i) frames come from a serial line, we do have the queue as a buffer and
    frames are processed 1 by 1 from the queue. Even if multiple devices send 
    single transmissions quickly they cannot interrupt each other.
-
-   to ii) We need multiple "mailboxes" for fast transmissions which
-   will be disrupted from fast and single transmissions of other devices. 
-   But N2K requires source ids to be unique and fast transmissions shall not 
-   be disrupted by fast transmissions of the same device.
 */
-struct nmea2000_packet nmea2000_packets[32 + 1];
+struct nmea2000_packet nmea2000_packets[NMEA2000_FAST_MAILBOXES + 1];
+
+#define FAST_BUCKETS 64             // power of 2, twice the mailboxes
+#define FAST_NONE    -1
 
-/* This array identifies the source addresses fast transmission 
-   mailbox during a fast transmission. Obviously it could be 254 
-   indexes only as source address 255 is reserved for "to all". */
-uint8_t saddr_packet[255];
+static int8_t fast_bucket[FAST_BUCKETS];
+static int8_t fast_next[NMEA2000_FAST_MAILBOXES];
 
 uint8_t free_mailbox_counter;
 
@@ -83,10 +103,59 @@ uint32_t n2k_fixed_fast_list[] = {
 
 uint32_t n2k_dynamic_fast_list[255];
 
+/* both lists above, consulted for every frame */
+static struct pgnindex_t n2k_fast_index;
+
 void nmea2000_init_fast_list(void) {
     uint16_t i = 0;
+    bool ok;
+
     for(i= 0; i < 255; i++)
         n2k_dynamic_fast_list[i] = 0;
+
+    ok = pgnindex_init(&n2k_fast_index, NITEMS(n2k_fixed_fast_list)
+                       + NITEMS(n2k_dynamic_fast_list));
+    for(i = 0; ok && n2k_fixed_fast_list[i] > 0; i++)
+        ok = pgnindex_add(&n2k_fast_index, n2k_fixed_fast_list[i], 1);
+    if(!ok)
+        GPSD_LOG(nmea2000_debug, LOG_ERROR,
+                 "NMEA2000: can't index the fast packet PGNs, walking them\n");
+}
+
+static int walk_fast_lists(uint32_t pgn) {
+
+    uint16_t i;
+
+    for(i = 0; n2k_fixed_fast_list[i] > 0; i++)
+        if(n2k_fixed_fast_list[i] == pgn)
+            return 1;
+    for(i = 0; n2k_dynamic_fast_list[i] > 0; i++)
+        if(n2k_dynamic_fast_list[i] == pgn)
+            return 1;
+    return 0;
+}
+
+int nmea2000_add_fast(uint32_t pgn) {
+
+    uint16_t cnt = 0;
+
+    if(!n2k_fast_index.built)
+        nmea2000_init_fast_list();
+
+    if(nmea2000_isfast(pgn))
+        return 1;
+
+    while(n2k_dynamic_fast_list[cnt] > 0)
+        cnt++;
+    // keep the list zero terminated
+    if(cnt >= 254)
+        return 0;
+    n2k_dynamic_fast_list[cnt] = pgn;
+    // the index is sized for the whole list, this can't fail but still
+    if(n2k_fast_index.usable && !pgnindex_add(&n2k_fast_index, pgn, 1))
+        GPSD_LOG(nmea2000_debug, LOG_ERROR,
+                 "NMEA2000: fast packet index full, walking the lists\n");
+    return 1;
 }
 
 void nmea2000_init() {
@@ -99,45 +168,44 @@ void nmea2000_init() {
     nmea2000_packet_error_count    = 0;      
     nmea2000_packet_cancel_count   = 0;
     nmea2000_packet_transfer_count = 0;
+    nmea2000_packet_timeout_count  = 0;
+    nmea2000_packet_orphan_count   = 0;
+    nmea2000_packet_inflight       = 0;
+    nmea2000_packet_inflight_max   = 0;
     nmea2000_frame_count           = 0;      
 
     free_mailbox_counter = 0;
 
-    memset(saddr_packet, 0, 255);
-    for(i = 0; i < 33; i++) {
+    for(i = 0; i < FAST_BUCKETS; i++)
+        fast_bucket[i] = FAST_NONE;
+    for(i = 0; i < NMEA2000_FAST_MAILBOXES + 1; i++) {
         p = &nmea2000_packets[i];
         p->pgn   = 0;
         p->saddr = 0;
         p->daddr = 0;
+        p->seq   = 0;
+        p->stamp = 0;
         p->ptr   = 0;
         p->idx   = 0;
         p->outbuflen = 0;
         
         p->fast_packet_len = 0;
         p->state = unused;
+        if(i < NMEA2000_FAST_MAILBOXES)
+            fast_next[i] = FAST_NONE;
     }
 
     nmea2000_init_fast_list();
 }
 
 int nmea2000_isfast(uint32_t pgn) {
-    
-    uint16_t cnt = 0;
-    
-    while(n2k_fixed_fast_list[cnt] > 0) {
-        if(pgn == n2k_fixed_fast_list[cnt])
-            return 1;
-        cnt++;
-    }
-    
-    cnt = 0;
-    while(n2k_dynamic_fast_list[cnt] > 0) {
-        if(pgn == n2k_dynamic_fast_list[cnt])
-            return 1;
-        cnt++;
-    }
 
-    return 0;
+    if(!n2k_fast_index.built)
+        nmea2000_init_fast_list();
+
+    if(!n2k_fast_index.usable)
+        return walk_fast_lists(pgn);
+    return pgnindex_find(&n2k_fast_index, pgn) > 0;
 }
 
 uint32_t nmea2000_make_extid(uint32_t pgn, uint8_t prio, uint8_t saddr, uint8_t daddr) {
@@ -161,20 +229,135 @@ uint32_t nmea2000_make_extid(uint32_t pgn, uint8_t prio, uint8_t saddr, uint8_t
 }
 
 
-/* Return value is the number of the mailbox that is complete: 
+static uint32_t nmea2000_clock_ms(void) {
+
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)ts.tv_sec * 1000 + (uint32_t)(ts.tv_nsec / 1000000);
+}
+
+static uint8_t fast_hash(uint8_t saddr, uint32_t pgn, uint8_t seq) {
+
+    return (uint8_t)(((pgn * 2654435761u) >> 26) ^ saddr ^ (seq << 3)) & (FAST_BUCKETS - 1);
+}
+
+// mailbox of the fast transmission in flight for this key or FAST_NONE
+static int8_t fast_lookup(uint8_t saddr, uint32_t pgn, uint8_t seq) {
+
+    int8_t mb = fast_bucket[fast_hash(saddr, pgn, seq)];
+    struct nmea2000_packet * packet = NULL;
+
+    while(mb != FAST_NONE) {
+        packet = &nmea2000_packets[mb];
+        if(packet->saddr == saddr && packet->pgn == pgn && packet->seq == seq)
+            break;
+        mb = fast_next[mb];
+    }
+    return mb;
+}
+
+static void fast_link(int8_t mb) {
+
+    struct nmea2000_packet * packet = &nmea2000_packets[mb];
+    uint8_t h = fast_hash(packet->saddr, packet->pgn, packet->seq);
+
+    fast_next[mb] = fast_bucket[h];
+    fast_bucket[h] = mb;
+    nmea2000_packet_inflight++;
+    if(nmea2000_packet_inflight > nmea2000_packet_inflight_max)
+        nmea2000_packet_inflight_max = nmea2000_packet_inflight;
+}
+
+// takes a fast transmission out of flight, state tells how it ended
+static void fast_unlink(int8_t mb, uint32_t state) {
+
+    struct nmea2000_packet * packet = &nmea2000_packets[mb];
+    int8_t * pp = &fast_bucket[fast_hash(packet->saddr, packet->pgn, packet->seq)];
+
+    while(*pp != FAST_NONE && *pp != mb)
+        pp = &fast_next[*pp];
+    if(*pp == mb)
+        *pp = fast_next[mb];
+    fast_next[mb] = FAST_NONE;
 
-   -1 for none (during fast transmission or an error 
-    0 for single transmission 
-    n > 0 for completed fast transmissions
+    packet->state = state;
+    packet->idx = 0;
+    packet->fast_packet_len = 0;
+    nmea2000_packet_inflight--;
+}
+
+/* Mailbox for a new fast transmission, see the rules above the
+   mailboxes. Drops whatever timed out on the way. */
+static int8_t fast_mailbox(uint8_t saddr, uint32_t pgn, uint8_t seq, uint32_t now) {
+
+    int8_t mb = fast_lookup(saddr, pgn, seq);
+    int8_t oldest = FAST_NONE;
+    uint8_t i;
+    struct nmea2000_packet * packet = NULL;
+
+    if(mb != FAST_NONE) {
+        // the sender started over, whatever came so far is lost
+        fast_unlink(mb, error);
+        nmea2000_packet_cancel_count++;
+        return mb;
+    }
+
+    for(i = 0; i < NMEA2000_FAST_MAILBOXES; i++) {
+        int8_t n = (int8_t)((free_mailbox_counter + i) & 0x1F);
+
+        packet = &nmea2000_packets[n];
+        if(packet->state == incomplete 
+           && (uint32_t)(now - packet->stamp) > NMEA2000_FAST_TIMEOUT_MS) {
+            vy_printf("I: <= N2K %u,s:%02x,mb:%u - TIMEOUT\n", 
+                      packet->pgn, packet->saddr, (uint16_t)n);
+            fast_unlink(n, error);
+            nmea2000_packet_timeout_count++;
+        }
+        if(packet->state != incomplete) {
+            if(mb == FAST_NONE)
+                mb = n;
+        } else if(oldest == FAST_NONE 
+                  || (int32_t)(packet->stamp - nmea2000_packets[oldest].stamp) < 0) {
+            oldest = n;
+        }
+    }
+
+    if(mb == FAST_NONE) {
+        // all in flight and alive, sacrifice the one quiet the longest
+        mb = oldest;
+        vy_printf("I: <= N2K %u,s:%02x,mb:%u - CANCEL\n", 
+                  nmea2000_packets[mb].pgn, nmea2000_packets[mb].saddr, (uint16_t)mb);
+        fast_unlink(mb, error);
+        nmea2000_packet_cancel_count++;
+    }
+
+    free_mailbox_counter = (uint8_t)(mb + 1);
+    return mb;
+}
+
+/* Return value is the number of the mailbox the frame went to: 
+
+   -1 for none (an error or a frame of no transmission in flight)
+    0 - 31 for fast transmissions, check the state for complete
+    32 for single transmission 
 */
 int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
 
+    return nmea2000_parsemsg_at(frame, nmea2000_clock_ms());
+}
+
+/* Same with the time of the frame in ms given by the caller, which
+   only needs to be monotonic (wrapping is fine). */
+int nmea2000_parsemsg_at(struct nmea2000_raw_frame * frame, uint32_t now) {
+
     uint8_t  l2 = 0;
-    uint8_t mb  = 0;
+    int8_t   mb = 0;
     uint32_t pgn;
     uint8_t  prio;
     uint8_t  daddr;
     uint8_t  saddr;
+    uint8_t  seq;
     
     struct nmea2000_packet * packet = NULL;
 
@@ -203,6 +386,8 @@ int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
 
     // is this a fast transmission (list of pgn from gpsd)
     if(nmea2000_isfast(pgn)) {
+
+      seq = frame->data[0] >> 5;
         
       if((frame->data[0] & 0x1f) == 0) {
           // start of fast transmission, need to get a free mailbox
@@ -215,15 +400,8 @@ int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
               return -1;
           }
           
-          
-          mb = free_mailbox_counter & 0x1F;
-          free_mailbox_counter++;
-          
+          mb = fast_mailbox(saddr, pgn, seq, now);
           packet = &nmea2000_packets[mb];
-          saddr_packet[saddr] = mb;
-
-          if(packet->state == incomplete)
-              nmea2000_packet_cancel_count++;
 
           vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x,pl:%u\n", 
                     pgn, saddr, (uint16_t)mb, (uint8_t)frame->data[0], (uint8_t)frame->data[1]);
@@ -232,92 +410,87 @@ int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
           
           packet->fast_packet_len = frame->data[1];
           
-          packet->idx = frame->data[0] + 1;  // record next indexes position
-                                             // can be > 0! 
+          packet->idx = 1;                   // record next indexes position
           
           packet->ptr = 0;
-          packet->pgn = 0;                   // use this sign for whole fast trans being done
+          packet->pgn = pgn;
           packet->saddr = saddr;             // recording saddr to track packet owner
+          packet->seq = seq;
+          packet->stamp = now;
           
           for (l2=2;l2<8;l2++) {
               // no worries about the ptr becoming to large here
               packet->outbuffer[packet->ptr++]= frame->data[l2];
           }
 
-          return mb;
-          
+          fast_link(mb);
+
       } else {
           // continue pending fast transmission
 
-          if(saddr_packet[saddr] > 0x1F) {
-              vy_printf("I: <= N2K N2K %u,s:%02x,os:%02x - ERROR MB\n", 
-                        pgn, saddr, (uint8_t)saddr_packet[saddr]);
-              nmea2000_packet_error_count++;
+          mb = fast_lookup(saddr, pgn, seq);
+
+          if(mb == FAST_NONE) {
+              // never started, or canceled, timed out or broken before
+              vy_printf("I: <= N2K %u,s:%02x,fi:%02x - ORPHAN\n", 
+                        pgn, saddr, (uint8_t)frame->data[0]);
+              nmea2000_packet_orphan_count++;
               return -1;
           }
 
-          mb = saddr_packet[saddr];
-
           // fetch mailbox for this transmission
           packet = &nmea2000_packets[mb];
 
-          if(packet->saddr != saddr) {
-              // could be a stale canceled packet that was taken by a new saddr
-              vy_printf("I: <= N2K %u,s:%02x,mb:%u,os:%02x - STALE\n", 
-                        pgn, saddr, (uint8_t)mb, (uint16_t)packet->saddr);
+          if((uint32_t)(now - packet->stamp) > NMEA2000_FAST_TIMEOUT_MS) {
+              vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x - TIMEOUT\n", 
+                        pgn, saddr, (uint16_t)mb, (uint8_t)frame->data[0]);
+              fast_unlink(mb, error);
+              nmea2000_packet_timeout_count++;
               return -1;
           }
           
-          if(frame->data[0] == packet->idx) {
-
-              // still incomplete
-              packet->state = incomplete;
-          
-              for (l2=1; l2<8; l2++) {
-                  if (packet->fast_packet_len > packet->ptr) {
-                      packet->outbuffer[packet->ptr++] = frame->data[l2];
-                  }
-              }
-              if (packet->ptr >= packet->fast_packet_len) {
-              
-                  packet->outbuflen = packet->fast_packet_len;
-                  packet->prio  = prio;
-                  packet->daddr = daddr;
-                  packet->state = complete;
-                  packet->pgn   = pgn;
-              
-                  packet->fast_packet_len = 0;
-                  packet->idx = 0;
-                  packet->ptr = 0;
-                  nmea2000_packet_count++;
-              
-                  vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x,fl:%u\n", 
-                            pgn, saddr, (uint8_t)mb, (uint8_t)frame->data[0],(uint8_t)frame->len);
-              } else {
-              
-                  vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x\n", 
-                            pgn, saddr, (uint8_t)mb, (uint8_t)frame->data[0]);
-                  packet->idx += 1;
-
-              }
-              
-              return mb;
-          
-          } else {
+          if((frame->data[0] & 0x1f) != packet->idx) {
               
               // error - missing or wrong index
               vy_printf("I: <= N2K %u,s:%02x,mb:%u,pi:%02x,fi:%02x - ERROR\n", 
-                        pgn, saddr, (uint8_t)mb, packet->idx, (uint8_t)frame->data[0]);
+                        pgn, saddr, (uint16_t)mb, packet->idx, (uint8_t)frame->data[0]);
 
-              packet->idx = 0;
-              packet->fast_packet_len = 0;
-              packet->state = error;
+              fast_unlink(mb, error);
               nmea2000_packet_error_count++;
 
               // error
               return -1;
-          } // frame->Data[0] == packet->idx
+          }
+
+          packet->stamp = now;
+          
+          for (l2=1; l2<8; l2++) {
+              if (packet->fast_packet_len > packet->ptr) {
+                  packet->outbuffer[packet->ptr++] = frame->data[l2];
+              }
+          }
+          packet->idx += 1;
       } // start/continue fast transmission
+
+      if (packet->ptr >= packet->fast_packet_len) {
+              
+          packet->outbuflen = packet->fast_packet_len;
+          packet->prio  = prio;
+          packet->daddr = daddr;
+          fast_unlink(mb, complete);
+          packet->ptr = 0;
+          nmea2000_packet_count++;
+          nmea2000_packet_fast_count++;
+              
+          vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x,fl:%u\n", 
+                    pgn, saddr, (uint16_t)mb, (uint8_t)frame->data[0],(uint8_t)frame->len);
+      } else {
+              
+          vy_printf("I: <= N2K %u,s:%02x,mb:%u,fi:%02x\n", 
+                    pgn, saddr, (uint16_t)mb, (uint8_t)frame->data[0]);
+      }
+
+      return mb;
       
     } else {
         // single transmission
@@ -328,7 +501,7 @@ int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
         }
 
         vy_printf("I: <= N2K %u,s:%02x\n", pgn, saddr);
-        packet = &nmea2000_packets[32];
+        packet = &nmea2000_packets[NMEA2000_SINGLE_MAILBOX];
         
         packet->ptr = 0;
         for (l2=0; l2 < frame->len && l2 < 8; l2++) {
@@ -345,8 +518,7 @@ int nmea2000_parsemsg(struct nmea2000_raw_frame * frame) {
         
         nmea2000_packet_count++;
 
-        // this will always be '0' as its the number of the single transmission mailbox
-        return 32;
+        return NMEA2000_SINGLE_MAILBOX;
     }
 
     return -1;
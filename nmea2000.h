@@ -1,11 +1,19 @@
 #ifndef _NMEA2000_H_
 #define _NMEA2000_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
 // fast transmissions have max 223 bytes of data
 #define NMEA2000_MAX_PACKET_LENGTH 223
 
+// mailboxes 0 - 31 hold fast transmissions in flight, 32 the single frame
+#define NMEA2000_FAST_MAILBOXES 32
+#define NMEA2000_SINGLE_MAILBOX NMEA2000_FAST_MAILBOXES
+
+// a fast transmission with no frame for this long is dropped
+#define NMEA2000_FAST_TIMEOUT_MS 750
+
 struct nmea2000_raw_frame {
     uint32_t extid;
     uint8_t len;
@@ -29,19 +37,32 @@ struct nmea2000_packet {
     uint8_t prio;
     uint8_t daddr;
     uint8_t saddr;
+    uint8_t seq;         // sequence id of a fast transmission, upper 3 bits of its frame index
+    uint32_t stamp;      // ms of the last frame of a fast transmission
     uint32_t state;
 } ;
 
+extern struct nmea2000_packet nmea2000_packets[NMEA2000_FAST_MAILBOXES + 1];
+
 extern int nmea2000_parsemsg(struct nmea2000_raw_frame * frame);
+extern int nmea2000_parsemsg_at(struct nmea2000_raw_frame * frame, uint32_t now);
 extern void nmea2000_init(void);
+extern int nmea2000_isfast(uint32_t pgn);
+extern int nmea2000_add_fast(uint32_t pgn);
 extern uint32_t nmea2000_make_extid(uint32_t pgn, uint8_t prio, uint8_t saddr, uint8_t daddr);
 
+extern bool nmea2000_verbose;                     // print every frame and transmission
+extern int nmea2000_debug;                        // debug level errors are logged against
 extern uint32_t nmea2000_packet_count;            // count number of all packets completed (fast and single)
 extern uint32_t nmea2000_packet_fast_count;       // number of fast packets completed
 extern uint32_t nmea2000_packet_error_count;      // number of packets that had an error and were aborted
 extern uint32_t nmea2000_packet_cancel_count;     // number of fast transmissions thar were cancled or interrupted
 extern uint32_t nmea2000_frame_count;             // number of frames handled
 extern uint32_t nmea2000_packet_transfer_count;   // number of packets delivered
+extern uint32_t nmea2000_packet_timeout_count;    // number of fast transmissions dropped after NMEA2000_FAST_TIMEOUT_MS
+extern uint32_t nmea2000_packet_orphan_count;     // number of fast frames that belong to no transmission in flight
+extern uint32_t nmea2000_packet_inflight;         // number of fast transmissions in flight right now
+extern uint32_t nmea2000_packet_inflight_max;     // most fast transmissions in flight at once
 
 #endif // _NMEA2000_H_
 
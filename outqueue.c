@@ -0,0 +1,176 @@
+/* outqueue.c -- bounded output queues for slow subscribers
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+#include "outqueue.h"
+
+size_t outqueue_lowmark = OUTQUEUE_LOWMARK;
+size_t outqueue_highmark = OUTQUEUE_HIGHMARK;
+
+#define frame_at(q, n)	(&(q)->frames[((q)->head + (n)) % OUTQUEUE_FRAMES])
+
+void outqueue_init(/*@out@*/struct outqueue_t *q)
+{
+    memset(q, 0, sizeof(*q));
+}
+
+void outqueue_clear(struct outqueue_t *q)
+/* release all pending frames but keep the statistics */
+{
+    unsigned int n;
+
+    for (n = 0; n < q->count; n++)
+	free(frame_at(q, n)->data);
+    q->head = q->count = 0;
+    q->depth = 0;
+}
+
+static void outqueue_remove(struct outqueue_t *q, unsigned int n)
+/* drop the n-th pending frame, closing the gap behind it */
+{
+    struct outqueue_frame_t *fp = frame_at(q, n);
+
+    q->depth -= fp->len - fp->sent;
+    q->stats.dropped++;
+    q->stats.dropped_bytes += fp->len;
+    free(fp->data);
+    for (; n + 1 < q->count; n++)
+	*frame_at(q, n) = *frame_at(q, n + 1);
+    q->count--;
+}
+
+static bool outqueue_superseded(struct outqueue_t *q, unsigned int n,
+				/*@null@*/const struct outqueue_update_t *update)
+/* whether newer updates of its source carry every path of the n-th frame */
+{
+    struct outqueue_frame_t *fp = frame_at(q, n);
+    uint64_t left = fp->paths;
+
+    if (update != NULL && update->source == fp->source)
+	left &= ~update->paths;
+    for (n++; n < q->count && left != 0; n++) {
+	struct outqueue_frame_t *newer = frame_at(q, n);
+	if ((newer->flags & OQ_FRAME_UPDATE) != 0
+	    && newer->source == fp->source)
+	    left &= ~newer->paths;
+    }
+    return left == 0;
+}
+
+static void outqueue_coalesce(struct outqueue_t *q, size_t incoming,
+			      /*@null@*/const struct outqueue_update_t *update)
+/* drop superseded update frames, oldest first, down to the low watermark */
+{
+    unsigned int n = 0;
+
+    while (n < q->count
+	   && (q->depth + incoming > outqueue_lowmark
+	       || q->count == OUTQUEUE_FRAMES)) {
+	struct outqueue_frame_t *fp = frame_at(q, n);
+	if ((fp->flags & OQ_FRAME_UPDATE) != 0 && fp->sent == 0
+	    && outqueue_superseded(q, n, update))
+	    outqueue_remove(q, n);
+	else
+	    n++;
+    }
+}
+
+static bool outqueue_appends(const struct outqueue_t *q, int flags)
+/* plain output shares the tail frame, only updates need their own */
+{
+    return q->count > 0 && flags == OQ_FRAME_PLAIN
+	&& q->frames[(q->head + q->count - 1) % OUTQUEUE_FRAMES].flags
+	   == OQ_FRAME_PLAIN;
+}
+
+#define outqueue_full(q, len, flags) \
+    ((q)->depth + (len) > outqueue_highmark \
+     || ((q)->count == OUTQUEUE_FRAMES && !outqueue_appends(q, flags)))
+
+int outqueue_push(struct outqueue_t *q, const char *buf, size_t len,
+		  const struct outqueue_update_t *update)
+/* queue a frame, plain if update is NULL, returns -1 if the client
+   has fallen hopelessly behind */
+{
+    struct outqueue_frame_t *fp;
+    int flags = update != NULL ? OQ_FRAME_UPDATE : OQ_FRAME_PLAIN;
+
+    if (outqueue_full(q, len, flags))
+	outqueue_coalesce(q, len, update);
+    if (outqueue_full(q, len, flags))
+	return -1;
+
+    if (outqueue_appends(q, flags)) {
+	char *grown;
+	fp = frame_at(q, q->count - 1);
+	if ((grown = (char *)realloc(fp->data, fp->len + len)) == NULL)
+	    return -1;
+	fp->data = grown;
+	memcpy(fp->data + fp->len, buf, len);
+	fp->len += len;
+    } else {
+	fp = frame_at(q, q->count);
+	if ((fp->data = (char *)malloc(len)) == NULL)
+	    return -1;
+	memcpy(fp->data, buf, len);
+	fp->len = len;
+	fp->sent = 0;
+	fp->flags = flags;
+	fp->source = update != NULL ? update->source : NULL;
+	fp->paths = update != NULL ? update->paths : 0;
+	q->count++;
+    }
+    q->depth += len;
+    q->stats.queued++;
+    if (q->depth > q->stats.depth_max)
+	q->stats.depth_max = q->depth;
+    return 0;
+}
+
+ssize_t outqueue_drain(struct outqueue_t *q, int fd)
+/* write as much pending data as the socket takes with a single writev() */
+{
+    struct iovec iov[OUTQUEUE_FRAMES];
+    unsigned int n;
+    ssize_t status;
+    size_t left;
+
+    if (q->count == 0)
+	return 0;
+
+    for (n = 0; n < q->count; n++) {
+	struct outqueue_frame_t *fp = frame_at(q, n);
+	iov[n].iov_base = fp->data + fp->sent;
+	iov[n].iov_len = fp->len - fp->sent;
+    }
+    status = writev(fd, iov, (int)q->count);
+    if (status < 0)
+	return (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)
+	    ? 0 : -1;
+    q->stats.writevs++;
+
+    /* retire everything the kernel took */
+    left = (size_t)status;
+    q->depth -= left;
+    while (left > 0) {
+	struct outqueue_frame_t *fp = frame_at(q, 0);
+	size_t pending = fp->len - fp->sent;
+	if (left < pending) {
+	    fp->sent += left;
+	    break;
+	}
+	left -= pending;
+	free(fp->data);
+	q->head = (q->head + 1) % OUTQUEUE_FRAMES;
+	q->count--;
+    }
+    return status;
+}
+
+/* outqueue.c ends here */
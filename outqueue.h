@@ -0,0 +1,80 @@
+/* outqueue.h -- bounded output queues for slow subscribers
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _OUTQUEUE_H_
+#define _OUTQUEUE_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/*
+ * A subscriber normally gets its reports written straight to the
+ * socket.  Only when the socket would block is the unsent tail copied
+ * into the subscriber's queue, which the main loop drains with writev()
+ * as soon as epoll says the socket is writable again.
+ *
+ * An update frame (a SignalK delta) has values for some paths of one
+ * source, and only for those that changed.  Once more than the high
+ * watermark is pending, update frames that have not been started on
+ * the wire are dropped oldest first, until the queue is back under the
+ * low watermark, but only where newer update frames of the same
+ * source, queued or being queued, carry every path of the old one.
+ * What is lost was superseded.  A client still above the high
+ * watermark with nothing superseded to drop is not keeping up and gets
+ * disconnected.
+ */
+#define OUTQUEUE_FRAMES		64	/* max frames pending per client */
+#define OUTQUEUE_LOWMARK	(16 * 1024)
+#define OUTQUEUE_HIGHMARK	(64 * 1024)
+
+#define OQ_FRAME_PLAIN		0x00	/* must be delivered */
+#define OQ_FRAME_UPDATE		0x01	/* may be superseded by a newer one */
+
+struct outqueue_frame_t {
+    char *data;
+    size_t len;
+    size_t sent;		/* bytes of this frame already written */
+    int flags;
+    /*@dependent@*/const void *source;	/* of an update frame */
+    uint64_t paths;		/* bits of what an update frame has values for */
+};
+
+/* what an update frame being queued has values for */
+struct outqueue_update_t {
+    /*@dependent@*/const void *source;
+    uint64_t paths;
+};
+
+struct outqueue_stats_t {
+    size_t depth_max;		/* peak bytes pending */
+    unsigned long queued;	/* frames that had to be queued */
+    unsigned long dropped;	/* superseded update frames dropped */
+    unsigned long dropped_bytes;
+    unsigned long writevs;	/* drain calls that wrote data */
+};
+
+struct outqueue_t {
+    struct outqueue_frame_t frames[OUTQUEUE_FRAMES];
+    unsigned int head;		/* index of oldest pending frame */
+    unsigned int count;		/* frames pending */
+    size_t depth;		/* bytes pending */
+    struct outqueue_stats_t stats;
+};
+
+/* watermarks shared by all queues, settable with gpsd -Q */
+extern size_t outqueue_lowmark;
+extern size_t outqueue_highmark;
+
+extern void outqueue_init(/*@out@*/struct outqueue_t *);
+extern void outqueue_clear(struct outqueue_t *);
+extern int outqueue_push(struct outqueue_t *, const char *, size_t,
+			 /*@null@*/const struct outqueue_update_t *);
+extern ssize_t outqueue_drain(struct outqueue_t *, int);
+
+#define outqueue_empty(q)	((q)->count == 0)
+
+#endif /* _OUTQUEUE_H_ */
@@ -0,0 +1,85 @@
+/* pgnindex.c -- constant time lookup into NMEA2000 PGN tables
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgnindex.h"
+
+/* Fibonacci hashing, the PGNs in use differ mostly in their low bits */
+#define pgnindex_hash(idx, pgn) \
+    ((uint32_t)((pgn) * 2654435761u) >> (32 - (idx)->bits))
+
+bool pgnindex_init(struct pgnindex_t *idx, unsigned int entries)
+/* an empty index for that many PGNs, false if there is no memory for it;
+   idx is zeroed or was set up before */
+{
+    uint32_t slots = PGNINDEX_MIN_SLOTS;
+    unsigned bits = 4;
+
+    free(idx->pgn);
+    free(idx->entry);
+    memset(idx, 0, sizeof(*idx));
+    idx->built = true;
+    if (entries > UINT16_MAX)
+	return false;
+    while (slots < 2 * entries) {
+	slots <<= 1;
+	bits++;
+    }
+    idx->pgn = (uint32_t *)calloc(slots, sizeof(uint32_t));
+    idx->entry = (int16_t *)calloc(slots, sizeof(int16_t));
+    if (idx->pgn == NULL || idx->entry == NULL) {
+	free(idx->pgn);
+	free(idx->entry);
+	idx->pgn = NULL;
+	idx->entry = NULL;
+	return false;
+    }
+    idx->slots = slots;
+    idx->bits = bits;
+    idx->max = (uint16_t)entries;
+    idx->usable = true;
+    return true;
+}
+
+bool pgnindex_add(struct pgnindex_t *idx, uint32_t pgn, int entry)
+/* index a table entry, the first entry for a PGN wins like a table walk;
+   false if the index was not sized for it, it is not usable then */
+{
+    uint32_t slot;
+
+    if (!idx->usable)
+	return false;
+    if (pgn == 0)
+	return true;
+    for (slot = pgnindex_hash(idx, pgn); idx->pgn[slot] != 0;
+	 slot = (slot + 1) & (idx->slots - 1))
+	if (idx->pgn[slot] == pgn)
+	    return true;
+    if (idx->count >= idx->max) {
+	idx->usable = false;
+	return false;
+    }
+    idx->pgn[slot] = pgn;
+    idx->entry[slot] = (int16_t)entry;
+    idx->count++;
+    return true;
+}
+
+int pgnindex_find(const struct pgnindex_t *idx, uint32_t pgn)
+/* position of the entry for pgn, -1 if the table has none; only for
+   a usable index */
+{
+    uint32_t slot;
+
+    for (slot = pgnindex_hash(idx, pgn); idx->pgn[slot] != 0;
+	 slot = (slot + 1) & (idx->slots - 1))
+	if (idx->pgn[slot] == pgn)
+	    return (int)idx->entry[slot];
+    return -1;
+}
+
+/* pgnindex.c ends here */
@@ -0,0 +1,41 @@
+/* pgnindex.h -- constant time lookup into NMEA2000 PGN tables
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _PGNINDEX_H_
+#define _PGNINDEX_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/*
+ * The PGN tables (handler, fast-packet flag, transmit/receive
+ * capability) stay the single source of truth.  An index only maps a
+ * PGN to the position of its entry, so a lookup costs one multiply and
+ * usually a single probe instead of a walk over the whole table.
+ *
+ * PGNs are 17 bit and sparse, a flat array would cost 512KB per table.
+ * The open addressed table is sized when it is set up for the entries
+ * it is going to hold, the next power of two at least twice as many,
+ * which keeps the load under 50%.  An index that could not be set up,
+ * or was handed more PGNs than it was sized for, is not usable and its
+ * user walks the table instead.
+ */
+#define PGNINDEX_MIN_SLOTS	16
+
+struct pgnindex_t {
+    /*@null@*/uint32_t *pgn;	/* 0 marks an empty slot */
+    /*@null@*/int16_t *entry;	/* position in the indexed table */
+    uint32_t slots;		/* power of two, 0 if not set up */
+    unsigned bits;		/* log2(slots) */
+    uint16_t count, max;
+    bool built;			/* set up, usable or not */
+    bool usable;
+};
+
+extern bool pgnindex_init(struct pgnindex_t *, unsigned int);
+extern bool pgnindex_add(struct pgnindex_t *, uint32_t, int);
+extern int pgnindex_find(const struct pgnindex_t *, uint32_t);
+
+#endif /* _PGNINDEX_H_ */
@@ -9,6 +9,7 @@
 #include "gpsd.h"
 #include "utils.h"
 #include "frame.h"
+#include "n2kcodec.h"
 
 #include "pseudon2k.h"
 
@@ -53,6 +54,22 @@ void n2k_binary_126992_dump(struct gps_device_t *session, uint32_t *pgn,
     *pgn = 126992;
 }
 
+/*
+ *  Encoders generated from n2kpgns.json, see n2kcodec.h
+ */
+static void n2k_codec_dump(struct gps_device_t *session, uint32_t which, int idx,
+                           uint32_t *pgn, uint8_t bu[], size_t len, uint16_t * outlen)
+{
+    const struct n2k_codec_t *codec = n2k_codec_find(which);
+    int written = 0;
+
+    if (codec != NULL)
+        written = codec->encode(&session->gpsdata, idx, bu, len);
+
+    *outlen = (uint16_t)written;
+    *pgn = (written > 0) ? which : 0;
+}
+
 /**
  *   \TOPGN 127250: NAV Vessel Heading
  */
@@ -60,36 +77,8 @@ void n2k_binary_127250_dump(struct gps_device_t *session, uint32_t *pgn,
                          enum compass_t compass,
                          uint8_t bu[], size_t len, uint16_t * outlen)
 {
-
-    if(len < 8) return;
-
-    bu[0] = 0x14; // some sid
-
-    if (!isnan(session->gpsdata.navigation.heading[compass]))
-        set8les16(bu,
-                  session->gpsdata.navigation.heading[compass] / 0.0001 / RAD_2_DEG, 1);
-    else
-        set8les16(bu, 0xffff, 1);
-
-    if (!isnan(session->gpsdata.environment.deviation))
-        set8les16(bu,
-                  session->gpsdata.environment.deviation / 0.0001 / RAD_2_DEG, 3);
-    else
-        set8les16(bu, 0xffff, 3);
-
-    if (!isnan(session->gpsdata.environment.variation))
-        set8les16(bu,
-                  session->gpsdata.environment.variation / 0.0001 / RAD_2_DEG,
-                  5);
-
-    else
-        set8les16(bu, 0xffff, 5);
-
-    // 1: magnetic, 0: true
-    bu[7] = compass;
-
-  *outlen = 8;
-  *pgn = 127250;
+    // reference 1: magnetic, 0: true
+    n2k_codec_dump(session, 127250, (int)compass, pgn, bu, len, outlen);
 }
 
 void n2k_binary_hdg_magnetic_dump(struct gps_device_t *session, uint32_t *pgn,
@@ -109,26 +98,13 @@ void n2k_binary_hdg_true_dump(struct gps_device_t *session, uint32_t *pgn,
 }
 
 /**
- *  \todo PGN 127251: Rate of Turn
+ *   \TOPGN 127251: Rate of Turn
  *
  *  NAVIGATION_SET: NAV_ROT_PSET
  */
 void n2k_binary_127251_dump(struct gps_device_t *session, uint32_t *pgn,
                             uint8_t bu[], size_t len, uint16_t * outlen) {
-
-    if(len < 8) return;
-
-    bu[0] = 0x14; // some sid
-
-    if (!isnan(session->gpsdata.navigation.rate_of_turn)) {
-        // TODO : find explain for odd magic number 3/16 deg/min (or 3/16/60 in deg/sec)
-        set8les32(bu, session->gpsdata.navigation.rate_of_turn
-                  / (0.00001 * 3.0/16.0/60.0 * RAD_2_DEG), 1);
-                  // per sec, let compiler optimize
-    }
-
-    *outlen = 8;
-    *pgn = 127251;
+    n2k_codec_dump(session, 127251, 0, pgn, bu, len, outlen);
 }
 
 
@@ -138,36 +114,13 @@ void n2k_binary_127251_dump(struct gps_device_t *session, uint32_t *pgn,
 void n2k_binary_attitude_dump(struct gps_device_t *session,uint32_t *pgn,
                                 uint8_t bu[], size_t len, uint16_t * outlen)
 {
-    if(len < 8) return;
-
-    bu[0] = 0x14; // some sid
-
     if(!(session->gpsdata.set & ATTITUDE_SET)) {
+        *pgn = 0;
         *outlen = 0;
         return;
     }
 
-    if (!isnan(session->gpsdata.attitude.yaw))
-        set8les16(bu,
-                  session->gpsdata.attitude.yaw / 0.0001 / RAD_2_DEG, 1);
-    else
-        set8les16(bu, 0xffff, 1);
-
-    if (!isnan(session->gpsdata.attitude.pitch))
-        set8les16(bu,
-                  session->gpsdata.attitude.pitch / 0.0001 / RAD_2_DEG, 3);
-    else
-        set8les16(bu, 0xffff, 3);
-
-    if (!isnan(session->gpsdata.attitude.roll))
-        set8les16(bu,
-                  session->gpsdata.attitude.roll / 0.0001 / RAD_2_DEG, 5);
-    else
-        set8les16(bu, 0xffff, 5);
-
-    *outlen = 8;
-    *pgn = 127257;
-
+    n2k_codec_dump(session, 127257, 0, pgn, bu, len, outlen);
 }
 
 /**
@@ -189,58 +142,35 @@ void n2k_binary_127259_dump(struct gps_device_t *session UNUSED, uint32_t *pgn,
 }
 
 /*
- *   \todo PGN 127488: Engine Parameter Rapid Update
+ *  The engine instance the set bits are for, -1 if none.
+ */
+static int n2k_engine_instance(struct gps_device_t *session)
+{
+    if(session->gpsdata.engine.set & ENG_PORT_PSET)
+        return 0;
+    else if(session->gpsdata.engine.set & ENG_STARBOARD_PSET)
+        return 1;
+    return -1;
+}
+
+/*
+ *   \TOPGN 127488: Engine Parameter Rapid Update
  */
 void n2k_binary_127488_dump(struct gps_device_t *session, uint32_t *pgn,
                             uint8_t bu[], size_t len, uint16_t * outlen)
 {
-    uint8_t instance = 0;
-
-    if(len < 8) return;
-
-
-    // engine instance
-    if(session->gpsdata.engine.set & ENG_PORT_PSET) {
-        instance = 0;
-    } else if(session->gpsdata.engine.set & ENG_STARBOARD_PSET) {
-        instance = 1;
-    } else
-        return;
-
-    bu[0] = instance;
-
-    if(session->gpsdata.engine.set & ENG_SPEED_PSET)
-        set8leu16(bu, session->gpsdata.engine.instance[instance].speed/0.25, 1);
-    else
-        set8leu16(bu, 0xffff, 1);
-
-
-    if(session->gpsdata.engine.set & ENG_BOOST_PRESSURE_PSET)
-        set8leu16(bu, session->gpsdata.engine.instance[instance].boost_pressure/100.0, 3);
-    else
-        set8leu16(bu, 0xffff, 3);
-
-    if(session->gpsdata.engine.set & ENG_TILT_PSET)
-        set8leu8(bu, session->gpsdata.engine.instance[instance].tilt, 6);
-    else
-        set8leu8(bu, 0xff, 6);
-
-    *outlen = 8;
-    *pgn = 127488;
+    n2k_codec_dump(session, 127488, n2k_engine_instance(session),
+                   pgn, bu, len, outlen);
 }
 
 /*
- *   \todo PGN 127489: Engine Parameter Dynamic
+ *   \TOPGN 127489: Engine Parameter Dynamic
  */
-void n2k_binary_127489_dump(struct gps_device_t *session UNUSED, uint32_t *pgn,
-                            uint8_t bu[] UNUSED, size_t len, uint16_t * outlen)
+void n2k_binary_127489_dump(struct gps_device_t *session, uint32_t *pgn,
+                            uint8_t bu[], size_t len, uint16_t * outlen)
 {
-    if(len < 8) return;
-
-
-
-    *outlen = 8;
-    *pgn = 127489;
+    n2k_codec_dump(session, 127489, n2k_engine_instance(session),
+                   pgn, bu, len, outlen);
 }
 
 /**
@@ -249,22 +179,7 @@ void n2k_binary_127489_dump(struct gps_device_t *session UNUSED, uint32_t *pgn,
 void n2k_binary_128267_dump(struct gps_device_t *session, uint32_t *pgn,
                                 uint8_t bu[], size_t len, uint16_t * outlen)
 {
-    if(len < 8) return;
-
-    bu[0] = 0x14;
-
-    if (!isnan(session->gpsdata.navigation.depth))
-        set8leu32(bu, (uint32_t)(session->gpsdata.navigation.depth/.01), 1);
-    else
-        set8leu32(bu, (uint32_t)(0xffffffff), 1);
-
-    if (!isnan(session->gpsdata.navigation.depth_offset))
-        set8les16(bu, (int16_t)(session->gpsdata.navigation.depth_offset/.001), 5);
-    else
-        set8les16(bu, (int16_t)(0x7fff), 5);
-
-    *outlen = 8;
-    *pgn = 128267;
+    n2k_codec_dump(session, 128267, 0, pgn, bu, len, outlen);
 }
 
 /**
@@ -605,11 +520,8 @@ void n2k_binary_129540_dump(struct gps_device_t *session, uint32_t *pgn,
 void n2k_binary_130306_dump(struct gps_device_t *session, enum wind_reference_t wr, uint32_t *pgn,
                                 uint8_t bu[], size_t len, uint16_t * outlen)
 {
-    *pgn = 0;
-
-    if(len < 8) return;
-
     if(!(session->gpsdata.set & ENVIRONMENT_SET)) {
+        *pgn = 0;
         *outlen = 0;
         return;
     }
@@ -619,18 +531,7 @@ void n2k_binary_130306_dump(struct gps_device_t *session, enum wind_reference_t
         2=Apparent,
         3=True to boat,
         4=True to water */
-
-        double angle = session->gpsdata.environment.wind[wr].angle;
-        double speed = session->gpsdata.environment.wind[wr].speed;
-
-    bu[0] = 0x14;
-    set8leu16(bu, (uint16_t)(!isnan(speed)?speed/.01:0xffff), 1);
-    set8leu16(bu, (uint16_t)(!isnan(angle)?angle/RAD_2_DEG/0.0001:angle), 3);
-    bu[5] = wr; // setting the apparent wind flag
-    bu[6] = 0x00;
-
-    *outlen = 8;
-    *pgn = 130306;
+    n2k_codec_dump(session, 130306, (int)wr, pgn, bu, len, outlen);
 }
 
 /**
@@ -900,7 +801,7 @@ int n2k_binary_dump(gps_mask_t changed,
 
         static gps_mask_t speeds[] = {
             ENV_WIND_TRUE_NORTH_SPEED_PSET,
-            ENV_WIND_MAGN_ANGLE_PSET,
+            ENV_WIND_MAGN_SPEED_PSET,
             ENV_WIND_APPARENT_SPEED_PSET,
             ENV_WIND_TRUE_TO_BOAT_SPEED_PSET,
             ENV_WIND_TRUE_TO_WATER_SPEED_PSET
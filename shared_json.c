@@ -94,6 +94,8 @@ int json_watch_read(const char *buf,
 	                                  .nodefault = true},
 	{"nmea",	   t_boolean,  .addr.boolean = &ccp->nmea,
 	                                  .nodefault = true},
+	{"canboat",	   t_integer,  .addr.integer = &ccp->canboat,
+	                                  .nodefault = true},
 	{"scaled",         t_boolean,  .addr.boolean = &ccp->scaled},
 	{"timing",         t_boolean,  .addr.boolean = &ccp->timing},
 	{"split24",        t_boolean,  .addr.boolean = &ccp->split24},
@@ -5,9 +5,10 @@ NAME
 
 DESCRIPTION
    This is a very lightweight alternative to JSON-over-sockets.  Clients
-won't be able to filter by device, and won't get device activation/deactivation
-notifications.  But both client and daemon will avoid all the marshalling and
-unmarshalling overhead.
+won't get device activation/deactivation notifications.  But both client
+and daemon will avoid all the marshalling and unmarshalling overhead.
+Each device has its own slot in the segment, and an update only
+rewrites the sections of the slot it changed, see struct shmexport_t.
 
 PERMISSIONS
    This file is Copyright (c) 2010 by the GPSD project
@@ -33,14 +34,26 @@ PERMISSIONS
 bool shm_acquire(struct gps_context_t *context)
 /* initialize the shared-memory segment to be used for export */
 {
+    volatile struct shmexport_t *shared;
     int shmid;
 
-    shmid = shmget((key_t)GPSD_KEY, sizeof(struct gps_data_t), (int)(IPC_CREAT|0666));
+    shmid = shmget((key_t)GPSD_KEY, sizeof(struct shmexport_t), (int)(IPC_CREAT|0666));
+    if (shmid == -1 && errno == EINVAL) {
+	/* a segment of an older layout is in the way, replace it */
+	shmid = shmget((key_t)GPSD_KEY, 0, 0);
+	if (shmid != -1 && shmctl(shmid, IPC_RMID, NULL) == 0) {
+	    gpsd_report(context->debug, LOG_WARN,
+			"removed stale shared-memory segment %d\n", shmid);
+	    shmid = shmget((key_t)GPSD_KEY, sizeof(struct shmexport_t),
+			   (int)(IPC_CREAT|0666));
+	} else
+	    shmid = -1;
+    }
     if (shmid == -1) {
 	gpsd_report(context->debug, LOG_ERROR,
 		    "shmget(%ld, %zd, 0666) failed: %s\n",
 		    (long int)GPSD_KEY,
-		    sizeof(struct gps_data_t),
+		    sizeof(struct shmexport_t),
 		    strerror(errno));
 	return false;
     }
@@ -50,6 +63,11 @@ bool shm_acquire(struct gps_context_t *context)
 	context->shmexport = NULL;
 	return false;
     }
+    shared = (struct shmexport_t *)context->shmexport;
+    (void)memset((void *)shared, 0, sizeof(struct shmexport_t));
+    shared->slots = SHM_EXPORT_SLOTS;
+    memory_barrier();
+    shared->version = SHM_EXPORT_VERSION;
     gpsd_report(context->debug, LOG_PROG,
 		"shmat() succeeded, segment %d\n", shmid);
     return true;
@@ -62,38 +80,127 @@ void shm_release(struct gps_context_t *context)
 	(void)shmdt((const void *)context->shmexport);
 }
 
-void shm_update(struct gps_context_t *context, struct gps_data_t *gpsdata)
-/* export an update to all listeners */
+static volatile struct shmexport_slot_t *shm_slot(volatile struct shmexport_t *shared,
+						  const char *path)
+/* the slot of a device, a free or the least recently updated one if new */
 {
-    if (context->shmexport != NULL)
-    {
-	static int tick;
-	volatile struct shmexport_t *shared = (struct shmexport_t *)context->shmexport;
-
-	++tick;
-	/*
-	 * Following block of instructions must not be reordered, otherwise
-	 * havoc will ensue.
-	 *
-	 * This is a simple optimistic-concurrency technique.  We write
-	 * the second bookend first, then the data, then the first bookend.
-	 * Reader copies what it sees in normal order; that way, if we
-	 * start to write the segment during the read, the second bookend will
-	 * get clobbered first and the data can be detected as bad.
-	 */
-	shared->bookend2 = tick;
-	memory_barrier();
-	memcpy((void *)(context->shmexport + offsetof(struct shmexport_t, gpsdata)),
-	       (void *)gpsdata,
-	       sizeof(struct gps_data_t));
-	memory_barrier();
-#ifndef USE_QT
-	shared->gpsdata.gps_fd = SHM_PSEUDO_FD;
-#else
-	shared->gpsdata.gps_fd = (void *)(intptr_t)SHM_PSEUDO_FD;
-#endif /* USE_QT */
+    volatile struct shmexport_slot_t *slot, *victim = NULL;
+    int i;
+
+    for (i = 0; i < SHM_EXPORT_SLOTS; i++) {
+	slot = &shared->slot[i];
+	if (strcmp((const char *)slot->path, path) == 0)
+	    return slot;
+	if (victim == NULL)
+	    victim = slot;
+	else if (victim->path[0] != '\0'
+		 && (slot->path[0] == '\0'
+		     || (int)(slot->tick - victim->tick) < 0))
+	    victim = slot;
+    }
+
+    /* take it over with all sections locked so no reader mixes the
+     * data of the old device with the path of the new one */
+    for (i = 0; i < SHM_SECTIONS; i++)
+	victim->seq[i] |= 1;
+    memory_barrier();
+    (void)memset((void *)&victim->fix, 0,
+		 sizeof(*victim) - offsetof(struct shmexport_slot_t, fix));
+    (void)strlcpy((char *)victim->path, path, sizeof(victim->path));
+    memory_barrier();
+    for (i = 0; i < SHM_SECTIONS; i++)
+	victim->seq[i]++;
+    return victim;
+}
+
+static void shm_section_write(volatile struct shmexport_slot_t *slot,
+			      int section, const struct gps_data_t *gpsdata,
+			      gps_mask_t changed)
+/* copy one section of a report into the slot under its lock */
+{
+    volatile struct shm_fix_t *fix = &slot->fix;
+    volatile struct shm_sky_t *sky = &slot->sky;
+
+    /*
+     * Following block of instructions must not be reordered, otherwise
+     * havoc will ensue.  An odd sequence tells readers the section is
+     * being written, when it is even again it is consistent.
+     */
+    slot->seq[section]++;
+    memory_barrier();
+    switch (section) {
+    case shm_fix:
+	fix->set = changed & SHM_FIX_MASK;
+	fix->online = gpsdata->online;
+	(void)memcpy((void *)&fix->fix, &gpsdata->fix, sizeof(fix->fix));
+	fix->separation = gpsdata->separation;
+	fix->status = gpsdata->status;
+	(void)memcpy((void *)&fix->dop, &gpsdata->dop, sizeof(fix->dop));
+	fix->epe = gpsdata->epe;
+	break;
+    case shm_sky:
+	sky->satellites_used = gpsdata->satellites_used;
+	(void)memcpy((void *)sky->used, gpsdata->used, sizeof(sky->used));
+	sky->skyview_time = gpsdata->skyview_time;
+	sky->satellites_visible = gpsdata->satellites_visible;
+	(void)memcpy((void *)sky->PRN, gpsdata->PRN, sizeof(sky->PRN));
+	(void)memcpy((void *)sky->elevation, gpsdata->elevation,
+		     sizeof(sky->elevation));
+	(void)memcpy((void *)sky->azimuth, gpsdata->azimuth,
+		     sizeof(sky->azimuth));
+	(void)memcpy((void *)sky->ss, gpsdata->ss, sizeof(sky->ss));
+	break;
+    case shm_navigation:
+	(void)memcpy((void *)&slot->navigation, &gpsdata->navigation,
+		     sizeof(slot->navigation));
+	break;
+    case shm_environment:
+	(void)memcpy((void *)&slot->environment, &gpsdata->environment,
+		     sizeof(slot->environment));
+	break;
+    case shm_engine:
+	(void)memcpy((void *)&slot->engine, &gpsdata->engine,
+		     sizeof(slot->engine));
+	break;
+    case shm_ais:
+	(void)memcpy((void *)&slot->ais, &gpsdata->ais, sizeof(slot->ais));
+	break;
+    case shm_attitude:
+	(void)memcpy((void *)&slot->attitude, &gpsdata->attitude,
+		     sizeof(slot->attitude));
+	break;
+    }
+    memory_barrier();
+    slot->seq[section]++;
+}
+
+void shm_update(struct gps_context_t *context, struct gps_device_t *device,
+		gps_mask_t changed)
+/* export the sections of a device an update touched */
+{
+    volatile struct shmexport_t *shared;
+    volatile struct shmexport_slot_t *slot = NULL;
+    bool touched = false;
+    int section;
+
+    if (context->shmexport == NULL)
+	return;
+    shared = (struct shmexport_t *)context->shmexport;
+
+    for (section = 0; section < SHM_SECTIONS; section++) {
+	if ((changed & shm_section_mask(section)) == 0)
+	    continue;
+	if (!touched) {
+	    slot = shm_slot(shared, device->gpsdata.dev.path);
+	    touched = true;
+	}
+	shm_section_write(slot, section, &device->gpsdata, changed);
+    }
+
+    if (touched) {
+	/* readers waiting for anything new watch the segment tick */
 	memory_barrier();
-	shared->bookend1 = tick;
+	slot->tick = ++shared->tick;
     }
 }
 
@@ -7,27 +7,27 @@
 #include <string.h>
 #include <math.h>
 #include <time.h>
+#include <stddef.h>
+#include <fnmatch.h>
 
 #include "gpsd.h"
-#include "json.h"
+#include "gps_json.h"
 #include "timeutil.h"
-#include "ring_buffer.h"
 #include "signalk.h"
+#include "jsonout.h"
+#include "history.h"
+#include "aistarget.h"
 
 char *unix_to_signalk(timestamp_t fixtime, /*@ out @*/
                       char isotime[], size_t len);
 
-void signalk_add_timestamp(/*@out@*/ char *reply, size_t replylen);
-void signalk_add_unixtimestamp(timestamp_t ts,
-                               /*@out@*/ char *reply, size_t replylen);
-void signalk_add_fixtimestamp(const struct gps_device_t *device,
-                              /*@out@*/ char *reply, size_t replylen);
-
-void signalk_value_full_dump(const struct gps_device_t *device,
-                             int * pt, // first value on this level?
-                             double value,
-                             char * name,
-                             /*@out@*/ char *reply, size_t replylen);
+static void signalk_add_unixtimestamp(timestamp_t ts, struct jsonout_t *out);
+
+static void signalk_value_full_dump(const struct gps_device_t *device,
+                                    int * pt, // first value on this level?
+                                    double value,
+                                    const char * name,
+                                    struct jsonout_t *out);
 /*
 {
   "updates":[{
@@ -66,107 +66,126 @@ void signalk_value_full_dump(const struct gps_device_t *device,
 }
 /* *INDENT-ON* */
 
-struct signalk_path_t {
-    const char         path[256];
-    gps_mask_t         mask;     // environment, navigation
-    gps_mask_t         submask;
-    double             factor;   // some values require a multipler to correct units
-    const struct json_attr_t jattr;
-};
-
-void signalk_add_unixtimestamp(timestamp_t ts,
-		      /*@out@*/ char *reply, size_t replylen)
-{
-    (void)strlcat(reply, "\"timestamp\":\"", replylen);
-    unix_to_signalk(ts,
-                    reply + strlen(reply), replylen - strlen(reply));
-    (void)strlcat(reply, "\"", replylen);
-}
-
-void signalk_add_timestamp(/*@out@*/ char *reply, size_t replylen)
+static void signalk_add_unixtimestamp(timestamp_t ts, struct jsonout_t *out)
 {
-    timestamp_t ts = timestamp();
-    signalk_add_unixtimestamp(ts, reply, replylen);
-}
+    char isotime[64];
 
-void signalk_add_fixtimestamp(const struct gps_device_t *device,
-		      /*@out@*/ char *reply, size_t replylen)
-{
-    timestamp_t ts = device->gpsdata.fix.time;
-    signalk_add_unixtimestamp(ts, reply, replylen);
+    jsonout_lit(out, "\"timestamp\":\"");
+    jsonout_str(out, unix_to_signalk(ts, isotime, sizeof(isotime)));
+    jsonout_char(out, '"');
 }
 
-void signalk_value_full_dump(const struct gps_device_t *device UNUSED,
-                             int * pt, // first value on this level?
-                             double value,
-                             char * name,
-                             /*@out@*/ char *reply, size_t replylen)
+static void signalk_value_full_dump(const struct gps_device_t *device UNUSED,
+                                    int * pt, // first value on this level?
+                                    double value,
+                                    const char * name,
+                                    struct jsonout_t *out)
 {
     if (!isnan(value)) {
         if(*pt > 0)
-            (void)strlcat(reply, ",", replylen);
-        (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                       "\"%s\":{\"value\":%.2f}",
-                       name, value);
+            jsonout_char(out, ',');
+        jsonout_char(out, '"');
+        jsonout_str(out, name);
+        jsonout_lit(out, "\":{\"value\":");
+        jsonout_fixed(out, value, 2);
+        jsonout_char(out, '}');
         (*pt)++;
     }
 }
 
-gps_mask_t signalk_track_dump(const struct gps_device_t *device, uint32_t startAfter, char field[],
-                             /*@out@*/ char reply[], size_t replylen)
+/* room a track sample needs after its path, plus the closing "],...}" */
+#define SIGNALK_TRACK_SAMPLE_MAX        160
+
+gps_mask_t signalk_track_dump(const struct gps_device_t *device,
+                              uint32_t startAfter, uint32_t until,
+                              uint32_t bucket, const char field[],
+                              /*@out@*/ char reply[], size_t replylen)
 {
-    uint32_t i = 0;
-    uint8_t c = 0;
-    double val;
-    double scale = 1.0/KNOTS_TO_MPS;
-    uint32_t msec;
-
-    char buf[255]; // more than enough here for the moment
-    int buflen = 255;
-
-    buf[0] = '\0';
-    (void)strcpy(reply, "{\"data\":[");
-
-    rb_t * rb = NULL;
-    if(!strcmp(field, "speedOverGround"))
-        rb = &device->gpsdata.navigation.speed_over_grounds;
-    else if(!strcmp(field, "speedThroughWater"))
-        rb = &device->gpsdata.navigation.speed_thru_waters;
-    else
+    uint32_t n = 0;
+    int series = history_lookup(field);
+    const struct history_path_t *path;
+    struct history_cursor_t cursor;
+    char prefix[128], closing[8];
+    struct jsonout_t out, pre;
+    const char *group, *dot;
+    int levels = 3;
+
+    jsonout_init(&out, reply, replylen);
+    jsonout_lit(&out, "{\"data\":[");
+
+    if(series < 0)
         goto close; // yes, my first goto in 30 years outside a kernel driver
-
-    while(rb_peek_n(rb, i, &val, &msec)) {
-
-        if(msec > startAfter) {
-            if(c)
-                (void)strlcat(buf, ",", buflen);
-            c=1;
-            (void)strlcat(buf, "{\"navigation\":", buflen);
-            (void)snprintf(buf + strlen(buf), buflen - strlen(buf),
-                           "{\"%s\":{\"value\":%.4f,\"timestamp\":%u}}}",
-                           field, val*scale, msec);
-
-            if(strlen(buf) > replylen - strlen(reply) - 50) {
-                gpsd_report(device->context->debug, LOG_RAW,
-                            "%s, len buf %lu, len reply: %lu\n",
-                            buf, strlen(buf),  replylen - strlen(reply) - 2);
+    path = &history_paths[series];
+
+    /* {"environment":{"wind":{"angleApparent":{"value": is the same
+       for every sample, render it once */
+    jsonout_init(&pre, prefix, sizeof(prefix));
+    for(group = path->group; (dot = strchr(group, '.')) != NULL; group = dot + 1) {
+        jsonout_lit(&pre, "{\"");
+        jsonout_mem(&pre, group, (size_t)(dot - group));
+        jsonout_lit(&pre, "\":");
+        levels++;
+    }
+    jsonout_lit(&pre, "{\"");
+    jsonout_str(&pre, group);
+    jsonout_lit(&pre, "\":{\"");
+    jsonout_str(&pre, path->name);
+    jsonout_lit(&pre, "\":{\"value\":");
+    memset(closing, '}', (size_t)levels);
+
+    history_open(&cursor, device, series, startAfter, until);
+    for(;;) {
+        struct history_sample_t sample;
+        struct history_bucket_t b;
+        double *value = sample.value;
+
+        // stop early enough to close the reply
+        if(jsonout_room(&out) < jsonout_len(&pre) + SIGNALK_TRACK_SAMPLE_MAX) {
+            gpsd_report(device->context->debug, LOG_RAW,
+                        "track dump of %s full after %u samples, len reply: %lu\n",
+                        field, n, (unsigned long)jsonout_len(&out));
+            break;
+        }
+        if(bucket > 0) {
+            if(!history_next_bucket(&cursor, bucket, &b))
                 break;
+            value = b.avg;
+            sample.msec = b.start;
+        } else if(!history_next(&cursor, &sample))
+            break;
+
+        if(n++ > 0)
+            jsonout_char(&out, ',');
+        jsonout_mem(&out, prefix, jsonout_len(&pre));
+        if(path->dims == 2) {
+            jsonout_lit(&out, "{\"longitude\":");
+            jsonout_fixed(&out, value[0] * path->factor, 6);
+            jsonout_lit(&out, ",\"latitude\":");
+            jsonout_fixed(&out, value[1] * path->factor, 6);
+            jsonout_char(&out, '}');
+        } else {
+            jsonout_fixed(&out, value[0] * path->factor, 4);
+            if(bucket > 0) {
+                jsonout_lit(&out, ",\"min\":");
+                jsonout_fixed(&out, b.min * path->factor, 4);
+                jsonout_lit(&out, ",\"max\":");
+                jsonout_fixed(&out, b.max * path->factor, 4);
             }
-
-            (void)strlcat(reply, buf, replylen);
-            buf[0] = '\0';
         }
-        i++;
-
+        jsonout_lit(&out, ",\"timestamp\":");
+        jsonout_uint(&out, sample.msec, 0);
+        jsonout_mem(&out, closing, (size_t)levels);
     }
 
 close:
-    (void)strlcat(reply, "]", replylen);
-
-    (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                   ",\"now\":%u", tu_get_independend_time());
-
-    (void)strlcat(reply, "}", replylen);
+    jsonout_char(&out, ']');
+    if(bucket > 0) {
+        jsonout_lit(&out, ",\"bucket\":");
+        jsonout_uint(&out, bucket, 0);
+    }
+    jsonout_lit(&out, ",\"now\":");
+    jsonout_uint(&out, tu_get_independend_time(), 0);
+    jsonout_char(&out, '}');
 
     return NAVIGATION_SET;
 }
@@ -179,48 +198,55 @@ gps_mask_t signalk_full_dump(const struct gps_device_t *device,
     int pt[3];
     int i = 0;
 
-    (void)snprintf(reply, replylen,
-                   "{\"uuid\":\"urn:mrn:signalk:uuid:%s\"", vessel->uuid);
-    if(vessel->mmsi != 0)
-        (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                       ",\"mmsi\":\"%09u\"", vessel->mmsi);
+    struct jsonout_t out;
 
-    (void)strlcat(reply, ",\"navigation\":{", replylen);
+    jsonout_init(&out, reply, replylen);
+    jsonout_lit(&out, "{\"uuid\":\"urn:mrn:signalk:uuid:");
+    jsonout_str(&out, vessel->uuid);
+    jsonout_char(&out, '"');
+    if(vessel->mmsi != 0) {
+        jsonout_lit(&out, ",\"mmsi\":\"");
+        jsonout_uint(&out, vessel->mmsi, 9);
+        jsonout_char(&out, '"');
+    }
+
+    jsonout_lit(&out, ",\"navigation\":{");
 
     // add actual values
     // TODO see to either use timestamps of last seen or invalidate at times
     pt[0] = 0;
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.rate_of_turn,
-                            "rateOfTurn", reply, replylen);
+                            "rateOfTurn", &out);
     signalk_value_full_dump(device, &pt[0],
                             device->gpsdata.navigation.course_over_ground[compass_magnetic]*DEG_2_RAD,
-                            "courseOverGroundMagnetic", reply, replylen);
+                            "courseOverGroundMagnetic", &out);
     signalk_value_full_dump(device, &pt[0],
                             device->gpsdata.navigation.course_over_ground[compass_true]*DEG_2_RAD,
-                            "courseOverGroundTrue", reply, replylen);
+                            "courseOverGroundTrue", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.environment.variation,
-                            "magneticVariation", reply, replylen);
+                            "magneticVariation", &out);
     signalk_value_full_dump(device, &pt[0],
                             device->gpsdata.navigation.heading[compass_true]*DEG_2_RAD,
-                            "headingTrue", reply, replylen);
+                            "headingTrue", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.heading[compass_magnetic]*DEG_2_RAD,
-                            "headingMagnetic", reply, replylen);
+                            "headingMagnetic", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.speed_over_ground*KNOTS_TO_MPS,
-                            "speedOverGround", reply, replylen);
+                            "speedOverGround", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.speed_thru_water*KNOTS_TO_MPS,
-                            "speedThroughWater", reply, replylen);
+                            "speedThroughWater", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.distance_total,
-                            "log", reply, replylen);
+                            "log", &out);
     signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.distance_trip,
-                            "logTrip", reply, replylen);
+                            "logTrip", &out);
 
     if (device->gpsdata.fix.mode > MODE_NO_FIX) {
         if(pt[0] > 0)
-            (void)strlcat(reply, ",", replylen);
-        (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                       "\"position\":{\"value\":{\"longitude\":%f,\"latitude\":%f}}",
-                       device->gpsdata.fix.longitude,
-                       device->gpsdata.fix.latitude);
+            jsonout_lit(&out, ",");
+        jsonout_lit(&out, "\"position\":{\"value\":{\"longitude\":");
+        jsonout_fixed(&out, device->gpsdata.fix.longitude, 6);
+        jsonout_lit(&out, ",\"latitude\":");
+        jsonout_fixed(&out, device->gpsdata.fix.latitude, 6);
+        jsonout_lit(&out, "}}");
     }
 
     int go = 0;
@@ -232,20 +258,20 @@ gps_mask_t signalk_full_dump(const struct gps_device_t *device,
 
     if(go) {
         if(pt[0] > 0)
-            (void)strlcat(reply, ",", replylen);
+            jsonout_lit(&out, ",");
         pt[0]++;
         pt[1] = 0;
 
-        (void)strlcat(reply, "\"attitude\":{", replylen);
+        jsonout_lit(&out, "\"attitude\":{");
 
         signalk_value_full_dump(device, &pt[1], device->gpsdata.attitude.roll*DEG_2_RAD,
-                                "roll", reply, replylen);
+                                "roll", &out);
         signalk_value_full_dump(device, &pt[1], device->gpsdata.attitude.pitch*DEG_2_RAD,
-                                "pitch", reply, replylen);
+                                "pitch", &out);
         signalk_value_full_dump(device, &pt[1], device->gpsdata.attitude.yaw*DEG_2_RAD,
-                                "yaw", reply, replylen);
+                                "yaw", &out);
 
-        (void)strlcat(reply, "}", replylen); // closing attitude
+        jsonout_lit(&out, "}"); // closing attitude
     }
 
     go = 0;
@@ -260,121 +286,520 @@ gps_mask_t signalk_full_dump(const struct gps_device_t *device,
 
     if(go) {
 
-        (void)strlcat(reply, "},\"environment\":{", replylen);
+        jsonout_lit(&out, "},\"environment\":{");
         pt[0] = 0;
 
         signalk_value_full_dump(device, &pt[0], device->gpsdata.navigation.depth,
-                                "depthBelowTransducer", reply, replylen);
+                                "depthBelowTransducer", &out);
 
         if(pt[0] > 0)
-            (void)strlcat(reply, ",", replylen);
-        (void)strlcat(reply, "\"wind\":{", replylen);
+            jsonout_lit(&out, ",");
+        jsonout_lit(&out, "\"wind\":{");
         pt[0]++;
 
         pt[1] = 0;
 
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_apparent].angle*DEG_2_RAD,
-                                "angleApparent", reply, replylen);
+                                "angleApparent", &out);
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_apparent].speed,
-                                "speedApparent", reply, replylen);
+                                "speedApparent", &out);
 
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_true_to_boat].angle*DEG_2_RAD,
-                                "angleTrueWater", reply, replylen);
+                                "angleTrueWater", &out);
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_true_to_boat].speed,
-                                "speedTrue", reply, replylen);
+                                "speedTrue", &out);
 
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_true_north].angle*DEG_2_RAD,
-                                "directionTrue", reply, replylen);
+                                "directionTrue", &out);
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_true_north].speed,
-                                "speedOverGround", reply, replylen);
+                                "speedOverGround", &out);
 
         signalk_value_full_dump(device, &pt[1], device->gpsdata.environment.wind[wind_magnetic_north].angle*DEG_2_RAD,
-                                "directionMagnetic", reply, replylen);
+                                "directionMagnetic", &out);
 
 
-        (void)strlcat(reply, "}", replylen); // closing wind
+        jsonout_lit(&out, "}"); // closing wind
 
         signalk_value_full_dump(device, &pt[0], device->gpsdata.environment.temp[temp_water],
-                                "waterTemp", reply, replylen);
+                                "waterTemp", &out);
     }
 
-    (void)strlcat(reply, "}", replylen); // closing environment or previous group
+    jsonout_lit(&out, "}"); // closing environment or previous group
 
-    (void)strlcat(reply, "}", replylen); // closing all
+    jsonout_lit(&out, "}"); // closing all
 
     return reported;
 }
 
-void signalk_update_engine_struct(struct gps_device_t *device,
-                           struct signalk_path_t * path_updates,
-                           enum engine_reference_t einstance) {
-
-    const struct signalk_path_t pus[] = {
-        {"engineLoad", ENGINE_SET, ENG_LOAD_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].load,
-          .dflt.real = 0.0}},
-        {"revolutions", ENGINE_SET, ENG_SPEED_PSET, 60.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].speed,
-          .dflt.real = 0.0}},
-        {"temperatur", ENGINE_SET, ENG_TEMPERATURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].temperature,
-          .dflt.real = 0.0}},
-        {"oilTemperatur", ENGINE_SET, ENG_OIL_TEMPERATURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].oil_temperature,
-          .dflt.real = 0.0}},
-        {"oilPressure", ENGINE_SET, ENG_OIL_PRESSURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].oil_pressure,
-          .dflt.real = 0.0}},
-        {"alternatorVoltage", ENGINE_SET, ENG_ALTERNATOR_VOLTAGE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].alternator_voltage,
-          .dflt.real = 0.0}},
-        {"runTime", ENGINE_SET, ENG_TOTAL_HOURS_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].total_hours,
-          .dflt.real = 0.0}},
-        {"coolantTemperature", ENGINE_SET, ENG_COOLANT_TEMPERATURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].coolant_temperature,
-          .dflt.real = 0.0}},
-        {"coolantPressure", ENGINE_SET, ENG_COOLANT_PRESSURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].coolant_pressure,
-          .dflt.real = 0.0}},
-        {"engineTorque", ENGINE_SET, ENG_TORQUE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].torque,
-          .dflt.real = 0.0}},
-        {"fuel.rate", ENGINE_SET, ENG_FUEL_RATE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].fuel_rate,
-          .dflt.real = 0.0}},
-        {"fuel.pressure", ENGINE_SET, ENG_FUEL_PRESSURE_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].fuel_pressure,
-          .dflt.real = 0.0}},
-        {"drive.trimState", ENGINE_SET, ENG_TILT_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.engine.instance[einstance].tilt,
-          .dflt.real = 0.0}},
-    };
+/* room kept for closing the vessels once targets no longer fit */
+#define SIGNALK_VESSELS_TAIL    8
+
+static void signalk_target_dump(const struct aistarget_t *t, uint32_t now,
+                                struct jsonout_t *out)
+/* one AIS target as a SignalK vessel */
+{
+    char buf[JSON_VAL_MAX];
+    int pt = 0;
+
+    jsonout_lit(out, "\"urn:mrn:imo:mmsi:");
+    jsonout_uint(out, t->mmsi, 9);
+    jsonout_lit(out, "\":{\"mmsi\":\"");
+    jsonout_uint(out, t->mmsi, 9);
+    jsonout_char(out, '"');
+    if (t->name[0] != '\0') {
+        jsonout_lit(out, ",\"name\":\"");
+        jsonout_str(out, json_stringify(buf, sizeof(buf), t->name));
+        jsonout_char(out, '"');
+    }
+    if (t->callsign[0] != '\0') {
+        jsonout_lit(out, ",\"communication\":{\"callsignVhf\":\"");
+        jsonout_str(out, json_stringify(buf, sizeof(buf), t->callsign));
+        jsonout_lit(out, "\"}");
+    }
+
+    jsonout_lit(out, ",\"navigation\":{");
+    if (isfinite(t->lat)) {
+        jsonout_lit(out, "\"position\":{\"value\":{\"longitude\":");
+        jsonout_fixed(out, t->lon, 6);
+        jsonout_lit(out, ",\"latitude\":");
+        jsonout_fixed(out, t->lat, 6);
+        jsonout_lit(out, "}}");
+        pt++;
+    }
+    signalk_value_full_dump(NULL, &pt, t->cog * DEG_2_RAD,
+                            "courseOverGroundTrue", out);
+    signalk_value_full_dump(NULL, &pt, t->sog, "speedOverGround", out);
+    signalk_value_full_dump(NULL, &pt, t->heading * DEG_2_RAD,
+                            "headingTrue", out);
+    if (isfinite(t->cpa)) {
+        if (pt > 0)
+            jsonout_char(out, ',');
+        jsonout_lit(out, "\"closestApproach\":{\"value\":{\"distance\":");
+        jsonout_fixed(out, t->cpa, 0);
+        jsonout_lit(out, ",\"timeTo\":");
+        jsonout_fixed(out, aistarget_tcpa(t, now), 0);
+        jsonout_lit(out, "}}");
+    }
+    jsonout_char(out, '}');
+
+    if (isfinite(t->length) || isfinite(t->beam) || t->shiptype != 0) {
+        pt = 0;
+        jsonout_lit(out, ",\"design\":{");
+        if (isfinite(t->length)) {
+            jsonout_lit(out, "\"length\":{\"value\":{\"overall\":");
+            jsonout_fixed(out, t->length, 0);
+            jsonout_lit(out, "}}");
+            pt++;
+        }
+        signalk_value_full_dump(NULL, &pt, t->beam, "beam", out);
+        if (t->shiptype != 0) {
+            if (pt > 0)
+                jsonout_char(out, ',');
+            jsonout_lit(out, "\"aisShipType\":{\"value\":{\"id\":");
+            jsonout_uint(out, t->shiptype, 0);
+            jsonout_lit(out, "}}");
+        }
+        jsonout_char(out, '}');
+    }
+    jsonout_char(out, '}');
+}
+
+void signalk_vessels_dump(const struct gps_device_t *device,
+                          const struct vessel_t *vessel,
+                          /*@null@*/struct aistarget_table_t *table,
+                          const struct aistarget_query_t *query,
+                          uint32_t now,
+                          /*@out@*/ char reply[], size_t replylen)
+/* own vessel and the AIS targets a query selects, nearest first */
+{
+    struct jsonout_t out;
+    uint32_t n, i;
+
+    jsonout_init(&out, reply, replylen - SIGNALK_VESSELS_TAIL);
+    jsonout_lit(&out, "{\"urn:mrn:signalk:uuid:");
+    jsonout_str(&out, vessel->uuid);
+    jsonout_lit(&out, "\":");
+    if (!out.overflow) {
+        (void)signalk_full_dump(device, vessel, out.p, jsonout_room(&out) + 1);
+        out.p += strlen(out.p);
+    }
+
+    n = table != NULL ? aistarget_select(table, query, now) : 0;
+    for (i = 0; i < n; i++) {
+        char *mark = out.p;
+
+        jsonout_char(&out, ',');
+        signalk_target_dump(&table->target[table->hit[i].index], now, &out);
+        if (out.overflow) {
+            /* leave out the one that did not fit, and the rest */
+            out.p = mark;
+            *out.p = '\0';
+            out.overflow = false;
+            break;
+        }
+    }
+    out.end += SIGNALK_VESSELS_TAIL;
+    jsonout_char(&out, '}');
+}
+
+/*
+ * Every path a delta can carry, in the order they go out.  Path i is
+ * bit SIGNALK_PATH(i) of a path set.
+ */
+enum signalk_kind_t {
+    sk_value,			/* a double at offset, times factor */
+    sk_position,
+    sk_attitude,
+};
+
+struct signalk_path_t {
+    const char          *path;
+    enum signalk_kind_t kind;
+    gps_mask_t          mask;     // environment, navigation, engine
+    gps_mask_t          submask;  // in the set of that group
+    size_t              offset;   // of the value in struct gps_data_t
+    double              factor;   // some values require a multipler to correct units
+};
+
+#define NAV(field)	offsetof(struct gps_data_t, navigation.field)
+#define ENV(field)	offsetof(struct gps_data_t, environment.field)
+#define ENG(field)	offsetof(struct gps_data_t, \
+				 engine.instance[single_or_double_port].field)
+
+/* *INDENT-OFF* */
+static const struct signalk_path_t signalk_paths[SIGNALK_PATHS] = {
+    {"navigation.rateOfTurn", sk_value,
+     NAVIGATION_SET, NAV_ROT_PSET, NAV(rate_of_turn), 1.0},
+    {"navigation.courseOverGroundMagnetic", sk_value,
+     NAVIGATION_SET, NAV_COG_MAGN_PSET,
+     NAV(course_over_ground[compass_magnetic]), 1.0*DEG_2_RAD},
+    {"navigation.courseOverGroundTrue", sk_value,
+     NAVIGATION_SET, NAV_COG_TRUE_PSET,
+     NAV(course_over_ground[compass_true]), 1.0*DEG_2_RAD},
+    {"navigation.magneticVariation", sk_value,
+     ENVIRONMENT_SET, ENV_VARIATION_PSET, ENV(variation), 1.0*DEG_2_RAD},
+    {"navigation.headingMagnetic", sk_value,
+     NAVIGATION_SET, NAV_HDG_MAGN_PSET,
+     NAV(heading[compass_magnetic]), 1.0*DEG_2_RAD},
+    {"navigation.headingTrue", sk_value,
+     NAVIGATION_SET, NAV_HDG_TRUE_PSET,
+     NAV(heading[compass_true]), 1.0*DEG_2_RAD},
+    {"navigation.speedOverGround", sk_value,
+     NAVIGATION_SET, NAV_SOG_PSET, NAV(speed_over_ground), 1.0*KNOTS_TO_MPS},
+    {"navigation.speedThroughWater", sk_value,
+     NAVIGATION_SET, NAV_STW_PSET, NAV(speed_thru_water), 1.0*KNOTS_TO_MPS},
+    {"navigation.log", sk_value,
+     NAVIGATION_SET, NAV_DIST_TOT_PSET, NAV(distance_total), 1.0},
+    {"navigation.logTrip", sk_value,
+     NAVIGATION_SET, NAV_DIST_TRIP_PSET, NAV(distance_trip), 1.0},
+    {"environment.depth.belowTransducer", sk_value,
+     NAVIGATION_SET, NAV_DPT_PSET, NAV(depth), 1.0},
+    {"environment.depth.surfaceToTransducer", sk_value,
+     NAVIGATION_SET, NAV_DPT_PSET, NAV(depth_offset), 1.0},
+    {"environment.wind.angleApparent", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_APPARENT_ANGLE_PSET,
+     ENV(wind[wind_apparent].angle), 1.0*DEG_2_RAD},
+    {"environment.wind.speedApparent", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_APPARENT_SPEED_PSET,
+     ENV(wind[wind_apparent].speed), 1.0},
+    /* 'True' wind angle, -180 to +180 degrees from the bow. Negative numbers to port */
+    {"environment.wind.speedTrue", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_TRUE_TO_BOAT_SPEED_PSET,
+     ENV(wind[wind_true_to_boat].speed), 1.0},
+    {"environment.wind.angleTrueWater", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_TRUE_TO_BOAT_ANGLE_PSET,
+     ENV(wind[wind_true_to_boat].angle), 1.0*DEG_2_RAD},
+    {"environment.wind.speedOverGround", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_TRUE_NORTH_SPEED_PSET,
+     ENV(wind[wind_true_north].speed), 1.0},
+    /* The wind direction relative to true north, in compass degrees, 0 = North */
+    {"environment.wind.directionTrue", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_TRUE_NORTH_ANGLE_PSET,
+     ENV(wind[wind_true_north].angle), 1.0*DEG_2_RAD},
+    {"environment.wind.directionMagnetic", sk_value,
+     ENVIRONMENT_SET, ENV_WIND_MAGN_ANGLE_PSET,
+     ENV(wind[wind_magnetic_north].angle), 1.0*DEG_2_RAD},
+    {"environment.waterTemp", sk_value,
+     ENVIRONMENT_SET, ENV_TEMP_WATER_PSET, ENV(temp[temp_water]), 1.0},
+    {"navigation.position", sk_position, LATLON_SET, 0, 0, 1.0},
+    {"navigation.attitude", sk_attitude, ATTITUDE_SET, 0, 0, 1.0},
+    {"propulsion.port_engine.engineLoad", sk_value,
+     ENGINE_SET, ENG_LOAD_PSET, ENG(load), 1.0},
+    {"propulsion.port_engine.revolutions", sk_value,
+     ENGINE_SET, ENG_SPEED_PSET, ENG(speed), 60.0},
+    {"propulsion.port_engine.temperatur", sk_value,
+     ENGINE_SET, ENG_TEMPERATURE_PSET, ENG(temperature), 1.0},
+    {"propulsion.port_engine.oilTemperatur", sk_value,
+     ENGINE_SET, ENG_OIL_TEMPERATURE_PSET, ENG(oil_temperature), 1.0},
+    {"propulsion.port_engine.oilPressure", sk_value,
+     ENGINE_SET, ENG_OIL_PRESSURE_PSET, ENG(oil_pressure), 1.0},
+    {"propulsion.port_engine.alternatorVoltage", sk_value,
+     ENGINE_SET, ENG_ALTERNATOR_VOLTAGE_PSET, ENG(alternator_voltage), 1.0},
+    {"propulsion.port_engine.runTime", sk_value,
+     ENGINE_SET, ENG_TOTAL_HOURS_PSET, ENG(total_hours), 1.0},
+    {"propulsion.port_engine.coolantTemperature", sk_value,
+     ENGINE_SET, ENG_COOLANT_TEMPERATURE_PSET, ENG(coolant_temperature), 1.0},
+    {"propulsion.port_engine.coolantPressure", sk_value,
+     ENGINE_SET, ENG_COOLANT_PRESSURE_PSET, ENG(coolant_pressure), 1.0},
+    {"propulsion.port_engine.engineTorque", sk_value,
+     ENGINE_SET, ENG_TORQUE_PSET, ENG(torque), 1.0},
+    {"propulsion.port_engine.fuel.rate", sk_value,
+     ENGINE_SET, ENG_FUEL_RATE_PSET, ENG(fuel_rate), 1.0},
+    {"propulsion.port_engine.fuel.pressure", sk_value,
+     ENGINE_SET, ENG_FUEL_PRESSURE_PSET, ENG(fuel_pressure), 1.0},
+    {"propulsion.port_engine.drive.trimState", sk_value,
+     ENGINE_SET, ENG_TILT_PSET, ENG(tilt), 1.0},
+};
+/* *INDENT-ON* */
+
+#undef NAV
+#undef ENV
+#undef ENG
+
+#define PATH_POSITION	20	/* navigation.position above */
+
+static double path_value(const struct gps_device_t *device,
+                         const struct signalk_path_t *sp)
+{
+    return *(const double *)((const char *)&device->gpsdata + sp->offset);
+}
+
+static bool path_known(const struct gps_device_t *device,
+                       const struct signalk_path_t *sp)
+/* does the device have a value for the path */
+{
+    switch (sp->kind) {
+    case sk_position:
+        return device->gpsdata.fix.mode > MODE_NO_FIX;
+    case sk_attitude:
+        return !isnan(device->gpsdata.attitude.roll);
+    default:
+        return !isnan(path_value(device, sp));
+    }
+}
+
+static gps_mask_t path_group_set(const struct gps_device_t *device,
+                                 const struct signalk_path_t *sp)
+/* what of the path's group the last report set */
+{
+    switch (sp->mask) {
+    case NAVIGATION_SET:
+        return device->gpsdata.navigation.set;
+    case ENVIRONMENT_SET:
+        return device->gpsdata.environment.set;
+    case ENGINE_SET:
+        return device->gpsdata.engine.set;
+    default:
+        return 0;
+    }
+}
+
+uint64_t signalk_changed_paths(const struct gps_device_t *device)
+/* the paths the last report of a device brought values for */
+{
+    uint64_t paths = 0;
+    int i;
+
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        const struct signalk_path_t *sp = &signalk_paths[i];
+
+        if ((device->gpsdata.set & sp->mask) == 0
+            || !path_known(device, sp))
+            continue;
+        if (sp->kind == sk_value
+            && (path_group_set(device, sp) & sp->submask) == 0)
+            continue;
+        paths |= SIGNALK_PATH(i);
+    }
+    return paths;
+}
+
+uint64_t signalk_known_paths(const struct gps_device_t *device)
+/* the paths a device has values for, changed or not */
+{
+    uint64_t paths = 0;
+    int i;
+
+    for (i = 0; i < SIGNALK_PATHS; i++)
+        if (path_known(device, &signalk_paths[i]))
+            paths |= SIGNALK_PATH(i);
+    return paths;
+}
+
+/*
+ * Deltas are put together from text rendered once.  Every path has its
+ * head, from the ',' before it up to its value, the opening of a delta
+ * only changes with the second of its timestamp and its closing with the
+ * vessel.  What is left per delta is copying those and formatting the
+ * numbers in between.
+ */
+#define SIGNALK_HEAD_MAX	96	/* ,{"path":"...","value":{"longitude": */
+#define SIGNALK_OPEN_MAX	128
+#define SIGNALK_CLOSE_MAX	128
+
+struct signalk_head_t {
+    size_t len;
+    char text[SIGNALK_HEAD_MAX];
+};
+
+static struct signalk_head_t signalk_heads[SIGNALK_PATHS];
+static bool signalk_heads_ready = false;
+
+static void signalk_heads_init(void)
+/* the heads of all paths, once */
+{
+    int i;
+
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        const struct signalk_path_t *sp = &signalk_paths[i];
+        struct jsonout_t out;
+
+        jsonout_init(&out, signalk_heads[i].text, SIGNALK_HEAD_MAX);
+        jsonout_lit(&out, ",{\"path\":\"");
+        jsonout_str(&out, sp->path);
+        switch (sp->kind) {
+        case sk_position:
+            jsonout_lit(&out, "\",\"value\":{\"longitude\":");
+            break;
+        case sk_attitude:
+            jsonout_lit(&out, "\",\"value\":{\"roll\":");
+            break;
+        default:
+            jsonout_lit(&out, "\",\"value\":");
+            break;
+        }
+        signalk_heads[i].len = jsonout_len(&out);
+    }
+    signalk_heads_ready = true;
+}
 
-    memcpy(path_updates, pus, sizeof(pus));
+static void signalk_open_dump(timestamp_t when, struct jsonout_t *out)
+/* {"updates":[{"timestamp":"...","values":[ */
+{
+    /* fix time and system time take turns, so remember two seconds */
+    static struct {
+        time_t second;
+        size_t len;
+        char text[SIGNALK_OPEN_MAX];
+    } opening[2];	/* len 0 until rendered */
+    static int last = 0;
+    time_t second;
+    struct jsonout_t o;
+
+    if (!isfinite(when)) {
+        /* nothing to remember */
+        jsonout_lit(out, "{\"updates\":[{");
+        signalk_add_unixtimestamp(when, out);
+        jsonout_lit(out, ",\"values\":[");
+        return;
+    }
+    second = (time_t)when;
+    if (opening[last].len == 0 || opening[last].second != second) {
+        last ^= 1;
+        if (opening[last].len == 0 || opening[last].second != second) {
+            jsonout_init(&o, opening[last].text, SIGNALK_OPEN_MAX);
+            jsonout_lit(&o, "{\"updates\":[{");
+            signalk_add_unixtimestamp(when, &o);
+            jsonout_lit(&o, ",\"values\":[");
+            opening[last].len = jsonout_len(&o);
+            opening[last].second = second;
+        }
+    }
+    jsonout_mem(out, opening[last].text, opening[last].len);
+}
+
+static void signalk_close_dump(const struct vessel_t *vessel,
+                               struct jsonout_t *out)
+/* ]}],"context":"..."} */
+{
+    static struct {
+        bool ready;
+        uint32_t mmsi;
+        char uuid[MAX_UUID_STR_LEN];
+        size_t len;
+        char text[SIGNALK_CLOSE_MAX];
+    } closing;
+    struct jsonout_t o;
+
+    if (!closing.ready || closing.mmsi != vessel->mmsi
+        || strncmp(closing.uuid, vessel->uuid, sizeof(closing.uuid)) != 0) {
+        jsonout_init(&o, closing.text, SIGNALK_CLOSE_MAX);
+        jsonout_lit(&o, "]}"); // close values
+        jsonout_lit(&o, "],"); // close updates
+        if(vessel->mmsi != 0) {
+            jsonout_lit(&o, "\"context\":\"vessels.urn:mrn:imo:mmsi:");
+            jsonout_uint(&o, vessel->mmsi, 0);
+            jsonout_lit(&o, "9\"");
+        } else {
+            jsonout_lit(&o, "\"context\":\"vessels.urn:mrn:signalk:uuid:");
+            jsonout_str(&o, vessel->uuid);
+            jsonout_char(&o, '"');
+        }
+        jsonout_char(&o, '}');
+        closing.len = jsonout_len(&o);
+        closing.mmsi = vessel->mmsi;
+        (void)strncpy(closing.uuid, vessel->uuid, sizeof(closing.uuid));
+        closing.ready = true;
+    }
+    jsonout_mem(out, closing.text, closing.len);
 }
 
+static void signalk_delta_dump(const struct gps_device_t *device,
+                               const struct signalk_sub_t *sub,
+                               uint64_t paths, timestamp_t when,
+                               const struct vessel_t *vessel,
+                               /*@out@*/ char reply[], size_t replylen)
+/* a delta of the paths given, their values from device or sub's sources */
+{
+    struct jsonout_t out;
+    int i;
+    size_t skip = 1;	/* the first path goes without its ',' */
+
+    if (!signalk_heads_ready)
+        signalk_heads_init();
+
+    jsonout_init(&out, reply, replylen);
+    signalk_open_dump(when, &out);
+
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        const struct signalk_path_t *sp = &signalk_paths[i];
+        const struct gps_device_t *source;
+
+        if ((paths & SIGNALK_PATH(i)) == 0)
+            continue;
+        source = sub != NULL ? sub->path[i].source : device;
+        jsonout_mem(&out, signalk_heads[i].text + skip,
+                    signalk_heads[i].len - skip);
+        skip = 0;
+        switch (sp->kind) {
+        case sk_position:
+            jsonout_fixed(&out, source->gpsdata.fix.longitude, 6);
+            jsonout_lit(&out, ",\"latitude\":");
+            jsonout_fixed(&out, source->gpsdata.fix.latitude, 6);
+            jsonout_lit(&out, "}}");
+            break;
+        case sk_attitude:
+            jsonout_fixed(&out, source->gpsdata.attitude.roll, 6);
+            jsonout_lit(&out, "}}");
+            break;
+        default:
+            jsonout_fixed(&out, path_value(source, sp) * sp->factor, 2);
+            jsonout_char(&out, '}');
+            break;
+        }
+    }
+
+    signalk_close_dump(vessel, &out);
+}
 
 gps_mask_t signalk_update_dump(struct gps_device_t *device,
                                const struct vessel_t * vessel,
                                /*@out@*/ char reply[], size_t replylen)
 {
     gps_mask_t reported = 0;
-
-    (void)strlcpy(reply, "{\"updates\":[{", replylen);
+    uint64_t paths = signalk_changed_paths(device);
+    timestamp_t when;
+    int i;
 
     /* in case we deal with a fix we also take the
        fix timestamp
@@ -383,201 +808,279 @@ gps_mask_t signalk_update_dump(struct gps_device_t *device,
     */
     if(((device->gpsdata.navigation.set & LATLON_SET) != 0)
        && (device->gpsdata.fix.mode > MODE_NO_FIX)) {
-        signalk_add_fixtimestamp(device, reply, replylen);
+        when = device->gpsdata.fix.time;
     } else {
-        signalk_add_timestamp(reply, replylen);
+        when = timestamp();
     }
 
-    (void)strlcat(reply, ",\"values\":[", replylen);
+    signalk_delta_dump(device, NULL, paths, when, vessel, reply, replylen);
+    for (i = 0; i < SIGNALK_PATHS; i++)
+        if ((paths & SIGNALK_PATH(i)) != 0)
+            reported |= signalk_paths[i].mask;
 
-    // add actual values
-    uint16_t pu = 0, pt = 0;
-
-    const struct signalk_path_t path_updates[] = {
-        {"navigation.rateOfTurn", NAVIGATION_SET, NAV_ROT_PSET, 1.0,
-         {"status",        t_real,  .addr.real = &device->gpsdata.navigation.rate_of_turn,
-          .dflt.real = 0.0}},
-        /* we do this manually for now
-        {"navigation.position", LATLON_SET | ALTITUDE_SET, 0xffffffff,
-        {"status",        t_structobject}}, */
-        {"navigation.courseOverGroundMagnetic", NAVIGATION_SET, NAV_COG_MAGN_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.course_over_ground[compass_magnetic],
-          .dflt.real = 0.0}},
-        {"navigation.courseOverGroundTrue", NAVIGATION_SET, NAV_COG_TRUE_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.course_over_ground[compass_true],
-          .dflt.real = 0.0}},
-        {"navigation.magneticVariation", ENVIRONMENT_SET, ENV_VARIATION_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,  .addr.real = &device->gpsdata.environment.variation,
-          .dflt.real = 0.0}},
-        {"navigation.headingMagnetic", NAVIGATION_SET, NAV_HDG_MAGN_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.heading[compass_magnetic],
-          .dflt.real = 0.0}},
-        {"navigation.headingTrue", NAVIGATION_SET, NAV_HDG_TRUE_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.heading[compass_true],
-          .dflt.real = 0.0}},
-        {"navigation.speedOverGround", NAVIGATION_SET, NAV_SOG_PSET, 1.0*KNOTS_TO_MPS,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.speed_over_ground,
-          .dflt.real = 0.0}},
-        {"navigation.speedThroughWater", NAVIGATION_SET, NAV_STW_PSET, 1.0*KNOTS_TO_MPS,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.speed_thru_water,
-          .dflt.real = 0.0}},
-        {"navigation.log", NAVIGATION_SET, NAV_DIST_TOT_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.distance_total,
-          .dflt.real = 0.0}},
-        {"navigation.logTrip", NAVIGATION_SET, NAV_DIST_TRIP_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.navigation.distance_trip,
-          .dflt.real = 0.0}},
-        {"environment.depth.belowTransducer", NAVIGATION_SET, NAV_DPT_PSET, 1.0,
-          {"status",        t_real,  .addr.real = &device->gpsdata.navigation.depth,
-          .dflt.real = 0.0}},
-        {"environment.depth.surfaceToTransducer", NAVIGATION_SET, NAV_DPT_PSET, 1.0,
-          {"status",        t_real,  .addr.real = &device->gpsdata.navigation.depth_offset,
-          .dflt.real = 0.0}},
-        {"environment.wind.angleApparent",
-         ENVIRONMENT_SET, ENV_WIND_APPARENT_ANGLE_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.environment.wind[wind_apparent].angle,
-          .dflt.real = 0.0}},
-        {"environment.wind.speedApparent",
-           ENVIRONMENT_SET, ENV_WIND_APPARENT_SPEED_PSET, 1.0,
-           {"status",        t_real,
-            .addr.real = &device->gpsdata.environment.wind[wind_apparent].speed,
-            .dflt.real = 0.0}},
-        /* 'True' wind angle, -180 to +180 degrees from the bow. Negative numbers to port */
-        {"environment.wind.speedTrue",
-            ENVIRONMENT_SET, ENV_WIND_TRUE_TO_BOAT_SPEED_PSET, 1.0,
-            {"status",        t_real,
-            .addr.real = &device->gpsdata.environment.wind[wind_true_to_boat].speed,
-            .dflt.real = 0.0} },
-        {"environment.wind.angleTrueWater",
-             ENVIRONMENT_SET, ENV_WIND_TRUE_TO_BOAT_ANGLE_PSET, 1.0*DEG_2_RAD,
-             {"status",        t_real,
-              .addr.real = &device->gpsdata.environment.wind[wind_true_to_boat].angle,
-              .dflt.real = 0.0} },
-        {"environment.wind.speedOverGround",
-           ENVIRONMENT_SET,  ENV_WIND_TRUE_NORTH_SPEED_PSET, 1.0,
-           {"status",        t_real,
-            .addr.real = &device->gpsdata.environment.wind[wind_true_north].speed,
-            .dflt.real = 0.0}},
-        /* The wind direction relative to true north, in compass degrees, 0 = North */
-        {"environment.wind.directionTrue",
-         ENVIRONMENT_SET, ENV_WIND_TRUE_NORTH_ANGLE_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.environment.wind[wind_true_north].angle,
-          .dflt.real = 0.0} },
-        {"environment.wind.directionMagnetic",
-         ENVIRONMENT_SET, ENV_WIND_MAGN_ANGLE_PSET, 1.0*DEG_2_RAD,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.environment.wind[wind_magnetic_north].angle,
-          .dflt.real = 0.0}},
-        {"environment.waterTemp", ENVIRONMENT_SET, ENV_TEMP_WATER_PSET, 1.0,
-         {"status",        t_real,
-          .addr.real = &device->gpsdata.environment.temp[temp_water],
-          .dflt.real = 0.0}}
-    };
+    return reported;
+}
 
+/*
+ * Subscriptions.  A path a client subscribed to goes out by the policy
+ * it asked for:
+ *
+ *   instant  whenever it changes, but at least minPeriod apart
+ *   ideal    as instant, and every period it does not change in
+ *   fixed    every period, whatever it is then
+ *
+ * A path that changes several times before it is due is sent once,
+ * with the latest value.  That value stays in the device that reported
+ * it last, the subscription only remembers which one that was.
+ */
+#define SIGNALK_NEVER	UINT64_MAX
 
-    struct signalk_path_t path_updates_engine[2][13];
-    signalk_update_engine_struct(device, path_updates_engine[single_or_double_port], single_or_double_port);
-    signalk_update_engine_struct(device, path_updates_engine[starboard], starboard);
+void signalk_sub_init(/*@out@*/ struct signalk_sub_t *sub, bool everything)
+/* no paths, or every one of them as it changes like before subscriptions */
+{
+    int i;
+
+    memset(sub, 0, sizeof(*sub));
+    if (!everything)
+        return;
+    sub->paths = SIGNALK_ALL_PATHS;
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        sub->path[i].policy = signalk_instant;
+        sub->path[i].period = SIGNALK_PERIOD;
+    }
+}
 
+static uint64_t signalk_path_due(const struct signalk_sub_t *sub, int i)
+/* ms when a path goes out next, SIGNALK_NEVER if it does not */
+{
+    const struct signalk_subpath_t *sp = &sub->path[i];
+    bool pending = (sub->pending & SIGNALK_PATH(i)) != 0;
+
+    if ((sub->paths & SIGNALK_PATH(i)) == 0 || sp->source == NULL)
+        return SIGNALK_NEVER;
+    switch (sp->policy) {
+    case signalk_instant:
+        return pending ? sp->sent + sp->min_period : SIGNALK_NEVER;
+    case signalk_ideal:
+        return sp->sent + (pending ? sp->min_period : sp->period);
+    default:
+        return sp->sent + sp->period;
+    }
+}
 
-    for(pu = 0; pu < 19; pu++) {
-        if(!isnan(*(double *)path_updates[pu].jattr.addr.real)) {
-            if ((device->gpsdata.set & path_updates[pu].mask) != 0) {
-                if( (((device->gpsdata.navigation.set & path_updates[pu].submask) != 0) && (path_updates[pu].mask & NAVIGATION_SET))
-                   || (((device->gpsdata.environment.set & path_updates[pu].submask) != 0) && (path_updates[pu].mask & ENVIRONMENT_SET)) ) {
+uint64_t signalk_sub_update(struct signalk_sub_t *sub,
+                            const struct gps_device_t *device,
+                            uint64_t paths, uint64_t now)
+/* device has new values for paths, return those to go out right now */
+{
+    uint64_t ready = 0;
+    int i;
+
+    paths &= sub->paths;
+    for (i = 0; paths != 0; i++, paths >>= 1) {
+        if ((paths & 1) == 0)
+            continue;
+        sub->path[i].source = device;
+        /* fixed paths just go out with whatever is latest */
+        if (sub->path[i].policy == signalk_fixed)
+            continue;
+        sub->pending |= SIGNALK_PATH(i);
+        if (signalk_path_due(sub, i) <= now)
+            ready |= SIGNALK_PATH(i);
+    }
+    return ready;
+}
 
-                    if(pt > 0)
-                        (void)strlcat(reply, ",{", replylen);
-                    else
-                        (void)strlcat(reply, "{", replylen);
+void signalk_sub_forget(struct signalk_sub_t *sub,
+                        const struct gps_device_t *device)
+/* device is going away, paths it had the latest value of have none */
+{
+    int i;
 
-                    (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                               "\"path\":\"%s\",\"value\":%.2f}",
-                               path_updates[pu].path,
-                               *(double *)path_updates[pu].jattr.addr.real
-                               * path_updates[pu].factor);
-                    reported |= path_updates[pu].mask;
-                    pt++;
-                }
-            }
+    for (i = 0; i < SIGNALK_PATHS; i++)
+        if (sub->path[i].source == device) {
+            sub->path[i].source = NULL;
+            sub->pending &= ~SIGNALK_PATH(i);
         }
-    }
+}
 
-    /* position is different and will be handled here */
-    if((device->gpsdata.set & LATLON_SET) != 0) {
-        if (device->gpsdata.fix.mode > MODE_NO_FIX) {
-            if(pt > 0)
-                (void)strlcat(reply, ",{", replylen);
-            else
-                (void)strlcat(reply, "{", replylen);
-            pt++;
+uint64_t signalk_sub_due(const struct signalk_sub_t *sub, uint64_t now)
+/* the paths due by now */
+{
+    uint64_t due = 0;
+    int i;
 
-            (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                           "\"path\":\"navigation.position\",\"value\":{\"longitude\":%f,\"latitude\":%f}}",
-                           device->gpsdata.fix.longitude,
-                           device->gpsdata.fix.latitude);
-            reported |= LATLON_SET;
-        }
+    for (i = 0; i < SIGNALK_PATHS; i++)
+        if (signalk_path_due(sub, i) <= now)
+            due |= SIGNALK_PATH(i);
+    return due;
+}
+
+uint64_t signalk_sub_next(const struct signalk_sub_t *sub)
+/* ms when the next path is due, 0 if none will be */
+{
+    uint64_t next = SIGNALK_NEVER;
+    int i;
+
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        uint64_t due = signalk_path_due(sub, i);
+
+        if (due < next)
+            next = due;
     }
-    /* adding attitude */
-    if((device->gpsdata.set & ATTITUDE_SET)
-       && !isnan(device->gpsdata.attitude.roll)) {
-            if(pt > 0)
-                (void)strlcat(reply, ",{", replylen);
-            else
-                (void)strlcat(reply, "{", replylen);
-            pt++;
+    if (next == SIGNALK_NEVER)
+        return 0;
+    return next > 0 ? next : 1;
+}
 
-            (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                           "\"path\":\"navigation.attitude\",\"value\":{\"roll\":%f}}",
-                           device->gpsdata.attitude.roll);
-            reported |= ATTITUDE_SET;
-    }
-
-    for(pu = 0; pu < 13; pu++) {
-        int inst = single_or_double_port;
-        if(!isnan(*(double *)path_updates_engine[inst][pu].jattr.addr.real)) {
-            if ((device->gpsdata.set & ENGINE_SET) != 0) {
-                if((device->gpsdata.engine.set & path_updates_engine[inst][pu].submask) != 0) {
-
-                    if(pt > 0)
-                        (void)strlcat(reply, ",{", replylen);
-                    else
-                        (void)strlcat(reply, "{", replylen);
-
-                    (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                               "\"path\":\"propulsion.port_engine.%s\",\"value\":%.2f}",
-                               path_updates_engine[inst][pu].path,
-                               *(double *)path_updates_engine[inst][pu].jattr.addr.real
-                               * path_updates_engine[inst][pu].factor);
-                    reported |= ENGINE_SET;
-                    pt++;
-                }
-            }
-        }
+void signalk_sub_dump(struct signalk_sub_t *sub, uint64_t paths,
+                      uint64_t now, const struct vessel_t *vessel,
+                      /*@out@*/ char reply[], size_t replylen)
+/* the delta of paths, which count as sent at now from here on */
+{
+    timestamp_t when = timestamp();
+    int i;
+
+    if ((paths & SIGNALK_PATH(PATH_POSITION)) != 0)
+        when = sub->path[PATH_POSITION].source->gpsdata.fix.time;
+    signalk_delta_dump(NULL, sub, paths, when, vessel, reply, replylen);
+
+    for (i = 0; i < SIGNALK_PATHS; i++) {
+        struct signalk_subpath_t *sp = &sub->path[i];
+
+        if ((paths & SIGNALK_PATH(i)) == 0)
+            continue;
+        /* fixed keeps its beat unless it fell a period behind */
+        if (sp->policy == signalk_fixed && sp->sent != 0
+            && now - sp->sent < 2 * (uint64_t)sp->period)
+            sp->sent += sp->period;
+        else
+            sp->sent = now;
+        sub->pending &= ~SIGNALK_PATH(i);
     }
+}
 
+struct signalk_request_t {
+    char path[SIGNALK_PATTERN_MAX];
+    unsigned int period;	/* ms */
+    unsigned int min_period;	/* ms */
+    int policy;
+};
 
-    (void)strlcat(reply, "]}", replylen); // close values
-    (void)strlcat(reply, "],", replylen); // close updates
-    if(vessel->mmsi != 0)
-        (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                       "\"context\":\"vessels.urn:mrn:imo:mmsi:%u9\"", vessel->mmsi);
-    else
-        (void)snprintf(reply + strlen(reply), replylen - strlen(reply),
-                       "\"context\":\"vessels.urn:mrn:signalk:uuid:%s\"", vessel->uuid);
+static bool signalk_context_self(const char *context,
+                                 const struct vessel_t *vessel)
+/* does a subscription context name our own vessel */
+{
+    char self[GPS_PATH_MAX];
+
+    if (context[0] == '\0' || fnmatch(context, "vessels.self", 0) == 0)
+        return true;
+    (void)snprintf(self, sizeof(self), "vessels.urn:mrn:signalk:uuid:%s",
+                   vessel->uuid);
+    if (fnmatch(context, self, 0) == 0)
+        return true;
+    if (vessel->mmsi == 0)
+        return false;
+    (void)snprintf(self, sizeof(self), "vessels.urn:mrn:imo:mmsi:%u",
+                   vessel->mmsi);
+    return fnmatch(context, self, 0) == 0;
+}
 
-    (void)strlcat(reply, "}", replylen);
+static uint64_t signalk_matching_paths(const char *pattern)
+/* the paths a subscription path, wildcards and all, names */
+{
+    uint64_t paths = 0;
+    int i;
 
-    return reported;
+    for (i = 0; i < SIGNALK_PATHS; i++)
+        if (fnmatch(pattern, signalk_paths[i].path, 0) == 0)
+            paths |= SIGNALK_PATH(i);
+    return paths;
+}
+
+int signalk_subscribe(struct signalk_sub_t *sub, const char *buf,
+                      const struct vessel_t *vessel,
+                      /*@out@*/ uint64_t *subscribed)
+/* apply a subscribe or unsubscribe message, 0 or a JSON error */
+{
+    static struct signalk_request_t subscribe[SIGNALK_REQUESTS_MAX];
+    static struct signalk_request_t unsubscribe[SIGNALK_REQUESTS_MAX];
+    static char context[GPS_PATH_MAX];
+    int nsubscribe = 0, nunsubscribe = 0;
+    int status, i, j;
+
+    /*@ -fullinitblock @*/
+    const struct json_enum_t policy_map[] = {
+        {"instant",	signalk_instant},
+        {"ideal",	signalk_ideal},
+        {"fixed",	signalk_fixed},
+        {NULL,		0},
+    };
+    /* *INDENT-OFF* */
+    const struct json_attr_t json_attrs_request[] = {
+        {"path",      t_string,   STRUCTOBJECT(struct signalk_request_t, path),
+                                     .len = sizeof(subscribe[0].path)},
+        {"period",    t_uinteger, STRUCTOBJECT(struct signalk_request_t, period),
+                                     .dflt.uinteger = SIGNALK_PERIOD},
+        {"minPeriod", t_uinteger, STRUCTOBJECT(struct signalk_request_t, min_period),
+                                     .dflt.uinteger = 0},
+        {"policy",    t_integer,  STRUCTOBJECT(struct signalk_request_t, policy),
+                                     .dflt.integer = signalk_ideal,
+                                     .map = policy_map},
+        {"format",    t_ignore},
+        {NULL},
+    };
+    /* *INDENT-ON* */
+    /*@-type@*//* STRUCTARRAY confuses splint */
+    const struct json_attr_t json_attrs_message[] = {
+        {"context",     t_string, .addr.string = context,
+                                     .len = sizeof(context)},
+        {"subscribe",   t_array,  STRUCTARRAY(subscribe, json_attrs_request,
+                                              &nsubscribe)},
+        {"unsubscribe", t_array,  STRUCTARRAY(unsubscribe, json_attrs_request,
+                                              &nunsubscribe)},
+        {NULL},
+    };
+    /*@+type@*/
+    /*@ +fullinitblock @*/
+
+    *subscribed = 0;
+    context[0] = '\0';
+    status = json_read_object(buf, json_attrs_message, NULL);
+    if (status != 0)
+        return status;
+    if (!signalk_context_self(context, vessel))
+        return 0;
+
+    for (i = 0; i < nsubscribe; i++) {
+        uint64_t paths = signalk_matching_paths(subscribe[i].path);
+
+        for (j = 0; j < SIGNALK_PATHS; j++) {
+            struct signalk_subpath_t *sp = &sub->path[j];
+
+            if ((paths & SIGNALK_PATH(j)) == 0)
+                continue;
+            sp->policy = (enum signalk_policy_t)subscribe[i].policy;
+            sp->period = subscribe[i].period > 0
+                ? subscribe[i].period : SIGNALK_PERIOD;
+            sp->min_period = subscribe[i].min_period;
+            /* the current value goes out right away */
+            sp->sent = 0;
+        }
+        sub->paths |= paths;
+        *subscribed |= paths;
+    }
+
+    /* after subscribe, so one message can ask for all but some */
+    for (i = 0; i < nunsubscribe; i++) {
+        uint64_t paths = signalk_matching_paths(unsubscribe[i].path);
+
+        sub->paths &= ~paths;
+        sub->pending &= ~paths;
+        *subscribed &= ~paths;
+        for (j = 0; j < SIGNALK_PATHS; j++)
+            if ((paths & SIGNALK_PATH(j)) != 0)
+                sub->path[j].source = NULL;
+    }
+    return 0;
 }
@@ -1,11 +1,77 @@
 #ifndef _SIGNAL_K_
 #define _SIGNAL_K_
 
-gps_mask_t signalk_track_dump(const struct gps_device_t *device, uint32_t startAfter, char field[],
+/* largest GET reply body, well below the default output queue limit */
+#define SIGNALK_GET_MAX (48 * 1024)
+/* a delta with every path, fits a websocket frame of GPS_JSON_RESPONSE_MAX */
+#define SIGNALK_UPDATE_MAX      4000
+
+/*
+ * Paths are numbered by their place in the table in signalk.c, a set of
+ * them is a bit mask.
+ */
+#define SIGNALK_PATHS           35
+#define SIGNALK_PATH(i)         ((uint64_t)1 << (i))
+#define SIGNALK_ALL_PATHS       (SIGNALK_PATH(SIGNALK_PATHS) - 1)
+
+#define SIGNALK_PERIOD          1000    /* ms, when a subscription names none */
+#define SIGNALK_PATTERN_MAX     128     /* of a subscribed path */
+#define SIGNALK_REQUESTS_MAX    16      /* paths a message may (un)subscribe */
+
+enum signalk_policy_t {
+    signalk_instant,
+    signalk_ideal,
+    signalk_fixed,
+};
+
+/* what one websocket client is subscribed to */
+struct signalk_sub_t {
+    uint64_t paths;             /* subscribed to */
+    uint64_t pending;           /* changed since they were last sent */
+    struct signalk_subpath_t {
+        uint64_t sent;          /* ms, when last sent, 0 if never */
+        uint32_t period;        /* ms */
+        uint32_t min_period;    /* ms */
+        enum signalk_policy_t policy;
+        /*@null@*/const struct gps_device_t *source;    /* latest value */
+    } path[SIGNALK_PATHS];
+};
+
+struct aistarget_table_t;
+struct aistarget_query_t;
+
+uint64_t signalk_changed_paths(const struct gps_device_t *device);
+uint64_t signalk_known_paths(const struct gps_device_t *device);
+
+void signalk_sub_init(/*@out@*/ struct signalk_sub_t *sub, bool everything);
+int signalk_subscribe(struct signalk_sub_t *sub, const char *buf,
+                      const struct vessel_t *vessel,
+                      /*@out@*/ uint64_t *subscribed);
+uint64_t signalk_sub_update(struct signalk_sub_t *sub,
+                            const struct gps_device_t *device,
+                            uint64_t paths, uint64_t now);
+void signalk_sub_forget(struct signalk_sub_t *sub,
+                        const struct gps_device_t *device);
+uint64_t signalk_sub_due(const struct signalk_sub_t *sub, uint64_t now);
+uint64_t signalk_sub_next(const struct signalk_sub_t *sub);
+void signalk_sub_dump(struct signalk_sub_t *sub, uint64_t paths,
+                      uint64_t now, const struct vessel_t *vessel,
+                      /*@out@*/ char reply[], size_t replylen);
+
+gps_mask_t signalk_track_dump(const struct gps_device_t *device,
+                              uint32_t startAfter, uint32_t until,
+                              uint32_t bucket, const char field[],
                               /*@out@*/ char reply[], size_t replylen);
 
 gps_mask_t signalk_full_dump(const struct gps_device_t *device, 
                              const struct vessel_t * vessel,
                              /*@out@*/ char reply[], size_t replylen);
 
+void signalk_vessels_dump(const struct gps_device_t *device,
+                          const struct vessel_t *vessel,
+                          /*@null@*/struct aistarget_table_t *table,
+                          const struct aistarget_query_t *query,
+                          uint32_t now,
+                          /*@out@*/ char reply[], size_t replylen);
+
 #endif // _SIGNAL_K_
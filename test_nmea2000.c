@@ -0,0 +1,334 @@
+/* test harness for the NMEA2000 fast-packet reassembly in nmea2000.c
+ *
+ * Interleaves hundreds of fast transmissions frame by frame, several
+ * of them from the same device at once (different PGNs, or one PGN
+ * with different sequence ids), with single frames in between, and
+ * checks every payload that comes out.  Then walks through timeout,
+ * restart, cancel and broken transmissions and checks the counters.
+ *
+ * nmea2000.c reports every frame on stdout unless --quiet is given, the
+ * results go to stderr.
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nmea2000.h"
+
+#define TRANSFERS	600
+#define SOURCES		12
+
+struct transfer_t {
+    uint8_t saddr;
+    uint8_t seq;
+    uint32_t pgn;
+    uint8_t len;
+    uint8_t payload[NMEA2000_MAX_PACKET_LENGTH];
+    uint8_t frame;		/* next frame to send */
+    bool done;
+};
+
+static const uint32_t fast_pgns[] = {
+    126996, 129038, 129039, 129794, 129809, 129810, 130842,
+};
+#define NFAST	(sizeof(fast_pgns) / sizeof(fast_pgns[0]))
+
+static struct transfer_t transfers[TRANSFERS];
+static int failures;
+static bool quiet;
+
+static uint32_t rnd_state = 0x2545f491;
+
+/* nmea2000.c logs its errors through this */
+void gpsd_report(const int debuglevel, const int errlevel,
+		 const char *fmt, ...);
+
+void gpsd_report(const int debuglevel, const int errlevel,
+		 const char *fmt, ...)
+{
+    va_list ap;
+
+    va_start(ap, fmt);
+    (void)vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+static uint32_t rnd(void)
+/* xorshift, the same run every time */
+{
+    rnd_state ^= rnd_state << 13;
+    rnd_state ^= rnd_state >> 17;
+    rnd_state ^= rnd_state << 5;
+    return rnd_state;
+}
+
+static void check(bool ok, const char *what)
+{
+    if (!ok) {
+	(void)fprintf(stderr, "test_nmea2000: FAILED %s\n", what);
+	failures++;
+    }
+}
+
+static void make_frame(const struct transfer_t *t, uint8_t n,
+		       struct nmea2000_raw_frame *frame)
+/* frame n of a fast transmission, filled up with 0xff like on the bus */
+{
+    int i, from;
+
+    frame->extid = nmea2000_make_extid(t->pgn, 3, t->saddr, 0xff);
+    frame->len = 8;
+    memset(frame->data, 0xff, sizeof(frame->data));
+    frame->data[0] = (uint8_t)(t->seq << 5 | n);
+    if (n == 0) {
+	frame->data[1] = t->len;
+	for (i = 0; i < 6 && i < t->len; i++)
+	    frame->data[2 + i] = t->payload[i];
+    } else {
+	from = 6 + (n - 1) * 7;
+	for (i = 0; i < 7 && from + i < t->len; i++)
+	    frame->data[1 + i] = t->payload[from + i];
+    }
+}
+
+static uint8_t frames_of(const struct transfer_t *t)
+{
+    return (uint8_t)(t->len <= 6 ? 1 : 1 + (t->len - 6 + 6) / 7);
+}
+
+static int send(const struct transfer_t *t, uint8_t n, uint32_t now)
+{
+    struct nmea2000_raw_frame frame;
+
+    make_frame(t, n, &frame);
+    return nmea2000_parsemsg_at(&frame, now);
+}
+
+static bool delivered(int mb, const struct transfer_t *t)
+/* is t complete and intact in mailbox mb? */
+{
+    struct nmea2000_packet *packet;
+
+    if (mb < 0 || mb >= NMEA2000_SINGLE_MAILBOX)
+	return false;
+    packet = &nmea2000_packets[mb];
+    return packet->state == complete
+	&& packet->pgn == t->pgn
+	&& packet->saddr == t->saddr
+	&& packet->outbuflen == t->len
+	&& memcmp(packet->outbuffer, t->payload, t->len) == 0;
+}
+
+static bool in_flight(const struct transfer_t *a, int upto)
+/* does a transmission started before upto share a's key? */
+{
+    int i;
+
+    for (i = 0; i < upto; i++)
+	if (transfers[i].frame > 0 && !transfers[i].done
+	    && transfers[i].saddr == a->saddr && transfers[i].pgn == a->pgn
+	    && transfers[i].seq == a->seq)
+	    return true;
+    return false;
+}
+
+static void interleaved(void)
+/* up to NMEA2000_FAST_MAILBOXES transmissions in flight, frames in random order */
+{
+    int active[NMEA2000_FAST_MAILBOXES];
+    int nactive = 0, started = 0, completed = 0, singles = 0;
+    int per_source[256], most_per_source = 0;
+    uint32_t now = 0;
+    int i;
+
+    nmea2000_init();
+    memset(per_source, 0, sizeof(per_source));
+
+    while (completed < TRANSFERS) {
+	int pick, mb;
+	struct transfer_t *t;
+
+	now += 1 + rnd() % 3;
+
+	/* some traffic that is no fast transmission */
+	if (rnd() % 8 == 0) {
+	    struct nmea2000_raw_frame frame;
+	    uint8_t saddr = (uint8_t)(1 + rnd() % SOURCES);
+
+	    frame.extid = nmea2000_make_extid(127250, 2, saddr, 0xff);
+	    frame.len = 8;
+	    for (i = 0; i < 8; i++)
+		frame.data[i] = (uint8_t)rnd();
+	    mb = nmea2000_parsemsg_at(&frame, now);
+	    check(mb == NMEA2000_SINGLE_MAILBOX
+		  && nmea2000_packets[mb].pgn == 127250
+		  && memcmp(nmea2000_packets[mb].outbuffer, frame.data, 8) == 0,
+		  "single frame between fast frames");
+	    singles++;
+	    continue;
+	}
+
+	/* start a new one while there is room, keys unique in flight */
+	if (started < TRANSFERS && nactive < NMEA2000_FAST_MAILBOXES
+	    && (nactive == 0 || rnd() % 3 == 0)) {
+	    t = &transfers[started];
+	    do {
+		t->saddr = (uint8_t)(1 + rnd() % SOURCES);
+		t->pgn = fast_pgns[rnd() % NFAST];
+		t->seq = (uint8_t)(rnd() % 8);
+	    } while (in_flight(t, started));
+	    t->len = (uint8_t)(1 + rnd() % NMEA2000_MAX_PACKET_LENGTH);
+	    for (i = 0; i < t->len; i++)
+		t->payload[i] = (uint8_t)rnd();
+	    t->frame = 0;
+	    t->done = false;
+	    active[nactive++] = started++;
+	    if (++per_source[t->saddr] > most_per_source)
+		most_per_source = per_source[t->saddr];
+	}
+
+	pick = (int)(rnd() % (uint32_t)nactive);
+	t = &transfers[active[pick]];
+	mb = send(t, t->frame, now);
+	t->frame++;
+	if (t->frame == frames_of(t)) {
+	    check(delivered(mb, t), "interleaved transmission delivered");
+	    t->done = true;
+	    per_source[t->saddr]--;
+	    active[pick] = active[--nactive];
+	    completed++;
+	} else {
+	    check(mb >= 0 && mb < NMEA2000_SINGLE_MAILBOX
+		  && nmea2000_packets[mb].state == incomplete,
+		  "interleaved transmission in flight");
+	}
+    }
+
+    check(nmea2000_packet_fast_count == TRANSFERS, "all fast transmissions completed");
+    check(nmea2000_packet_count == (uint32_t)(TRANSFERS + singles), "packet count");
+    check(nmea2000_packet_cancel_count == 0, "no cancel");
+    check(nmea2000_packet_timeout_count == 0, "no timeout");
+    check(nmea2000_packet_error_count == 0, "no error");
+    check(nmea2000_packet_orphan_count == 0, "no orphan");
+    check(nmea2000_packet_inflight == 0, "nothing left in flight");
+    check(nmea2000_packet_inflight_max == NMEA2000_FAST_MAILBOXES, "all mailboxes used");
+    check(most_per_source > 1, "several transmissions per source");
+
+    if (!quiet)
+	(void)fprintf(stderr,
+		      "test_nmea2000: %d transmissions, %d singles, %u frames, "
+		      "up to %d per source in flight\n",
+		      TRANSFERS, singles, nmea2000_frame_count,
+		      most_per_source);
+}
+
+static void make_transfer(struct transfer_t *t, uint8_t saddr, uint32_t pgn,
+			  uint8_t seq, uint8_t len)
+{
+    int i;
+
+    t->saddr = saddr;
+    t->pgn = pgn;
+    t->seq = seq;
+    t->len = len;
+    for (i = 0; i < len; i++)
+	t->payload[i] = (uint8_t)(saddr + seq + i);
+}
+
+static void edge_cases(void)
+{
+    struct transfer_t a, b, c[NMEA2000_FAST_MAILBOXES + 1];
+    uint32_t now = 0xfffffe00;	/* the clock wraps while we are at it */
+    int i;
+
+    /* same source, same PGN, two sequence ids at once */
+    nmea2000_init();
+    make_transfer(&a, 7, 129038, 1, 27);
+    make_transfer(&b, 7, 129038, 2, 27);
+    for (i = 0; i < frames_of(&a) - 1; i++) {
+	(void)send(&a, (uint8_t)i, now++);
+	(void)send(&b, (uint8_t)i, now++);
+    }
+    check(delivered(send(&b, (uint8_t)i, now++), &b), "second sequence id");
+    check(delivered(send(&a, (uint8_t)i, now++), &a), "first sequence id");
+
+    /* a transmission that goes quiet times out */
+    nmea2000_init();
+    make_transfer(&a, 9, 129794, 0, 40);
+    (void)send(&a, 0, now);
+    (void)send(&a, 1, now + 10);
+    check(send(&a, 2, now + 10 + NMEA2000_FAST_TIMEOUT_MS + 1) == -1,
+	  "late frame refused");
+    check(nmea2000_packet_timeout_count == 1, "timeout counted");
+    check(send(&a, 3, now + 800) == -1 && nmea2000_packet_orphan_count == 1,
+	  "frame after timeout is an orphan");
+
+    /* ...also when nobody asks for it again */
+    nmea2000_init();
+    (void)send(&a, 0, now);
+    make_transfer(&b, 10, 129794, 0, 20);
+    (void)send(&b, 0, now + NMEA2000_FAST_TIMEOUT_MS + 1);
+    check(nmea2000_packet_timeout_count == 1 && nmea2000_packet_inflight == 1,
+	  "stale transmission swept");
+
+    /* a start frame for a key in flight starts over */
+    nmea2000_init();
+    make_transfer(&a, 11, 129809, 5, 25);
+    (void)send(&a, 0, now);
+    (void)send(&a, 1, now);
+    for (i = 0; i < frames_of(&a) - 1; i++)
+	(void)send(&a, (uint8_t)i, now);
+    check(delivered(send(&a, (uint8_t)i, now), &a), "restarted transmission");
+    check(nmea2000_packet_cancel_count == 1, "restart counted as cancel");
+
+    /* a lost frame breaks the transmission */
+    nmea2000_init();
+    make_transfer(&a, 12, 129810, 3, 30);
+    (void)send(&a, 0, now);
+    check(send(&a, 2, now) == -1 && nmea2000_packet_error_count == 1,
+	  "missing frame is an error");
+    check(send(&a, 3, now) == -1 && nmea2000_packet_orphan_count == 1,
+	  "frame after error is an orphan");
+
+    /* one more than there are mailboxes cancels the quietest */
+    nmea2000_init();
+    for (i = 0; i < NMEA2000_FAST_MAILBOXES + 1; i++) {
+	make_transfer(&c[i], (uint8_t)(20 + i), 130842, 0, 20);
+	(void)send(&c[i], 0, now + i);
+    }
+    check(nmea2000_packet_cancel_count == 1
+	  && nmea2000_packet_inflight == NMEA2000_FAST_MAILBOXES,
+	  "full table cancels one");
+    check(send(&c[0], 1, now + 40) == -1, "canceled transmission is gone");
+    for (i = 1; i < NMEA2000_FAST_MAILBOXES + 1; i++) {
+	(void)send(&c[i], 1, now + 40);
+	check(delivered(send(&c[i], 2, now + 40), &c[i]),
+	      "others survive a full table");
+    }
+
+    /* short payloads complete with the start frame */
+    nmea2000_init();
+    make_transfer(&a, 13, 126996, 0, 6);
+    check(delivered(send(&a, 0, now), &a), "single frame fast transmission");
+}
+
+int main(int argc, char *argv[])
+{
+    quiet = (argc > 1) && (strcmp(argv[1], "--quiet") == 0);
+    nmea2000_verbose = !quiet;
+    interleaved();
+    edge_cases();
+
+    if (failures > 0 || !quiet)
+	(void)fprintf(stderr, "test_nmea2000: %s\n",
+		      failures > 0 ? "FAILED" : "all tests passed");
+    exit(failures > 0 ? EXIT_FAILURE : EXIT_SUCCESS);
+}
+
+/* test_nmea2000.c ends here */
@@ -8,6 +8,7 @@
 #include <stdarg.h>
 #include <ctype.h>
 #include <sys/types.h>
+#include <sys/select.h>
 #include <fcntl.h>
 #ifndef S_SPLINT_S
 #include <unistd.h>
@@ -42,6 +43,21 @@ void gpsd_report(int debuglevel, int errlevel, const char *fmt, ...)
     }
 }
 
+void gpsd_external_report(int debuglevel, int errlevel, const char *fmt, ...)
+{
+    if (errlevel <= debuglevel) {
+	va_list ap;
+
+	va_start(ap, fmt);
+	(void)vfprintf(stderr, fmt, ap);
+	va_end(ap);
+    }
+}
+
+void gpsd_throttled_report(const int errlevel UNUSED, const char *buf UNUSED)
+{
+}
+
 struct map
 {
     char *legend;
@@ -324,6 +340,54 @@ static void runon_test(struct map *mp)
     /*@ +compdef +uniondef +usedef +formatcode @*/
 }
 
+static void reawake_handler(struct gps_device_t *session UNUSED,
+			    gps_mask_t changed UNUSED)
+{
+}
+
+static int reawake_test(void)
+/* a device with a zero-length read comes back on its timer, no gpsd */
+{
+    static struct gps_context_t context;
+    static struct gps_device_t session;
+    fd_set all_fds, rfds;
+    int fds[2], status, polls;
+
+    gps_context_init(&context);
+    context.debug = verbose;
+    gpsd_init(&session, &context, "reawake");
+    if (pipe(fds) != 0) {
+	(void)fputs("reawake test: no pipe\n", stderr);
+	return EXIT_FAILURE;
+    }
+    session.gpsdata.gps_fd = fds[0];
+    FD_ZERO(&all_fds);
+    FD_SET(fds[0], &all_fds);
+
+    /* a read that returns nothing takes the device out of the set */
+    (void)close(fds[1]);
+    status = gpsd_multipoll(true, &session, reawake_handler, 0.1);
+    if (status != DEVICE_UNREADY) {
+	(void)fprintf(stderr, "reawake test: zero-length read gave %d\n",
+		      status);
+	return EXIT_FAILURE;
+    }
+    FD_CLR(fds[0], &all_fds);
+
+    /* only the timer ends the wait now; without one it never would */
+    (void)alarm(5);
+    for (polls = 0; status != DEVICE_READY; polls++) {
+	if (gpsd_await_data(&rfds, fds[0], &all_fds, &context)
+	    == AWAIT_FAILED || polls > 100) {
+	    (void)fputs("reawake test: device not reawakened\n", stderr);
+	    return EXIT_FAILURE;
+	}
+	status = gpsd_multipoll(false, &session, reawake_handler, 0.1);
+    }
+    (void)alarm(0);
+    return EXIT_SUCCESS;
+}
+
 static int property_check(void)
 {
     const struct gps_type_t **dp;
@@ -401,10 +465,12 @@ int main(int argc, char *argv[])
     int option, singletest = 0;
 
     verbose = 0;
-    while ((option = getopt(argc, argv, "ce:t:v:")) != -1) {
+    while ((option = getopt(argc, argv, "ce:t:v:z")) != -1) {
 	switch (option) {
 	case 'c':
 	    exit(property_check());
+	case 'z':
+	    exit(reawake_test());
 	case 'e':
 	    mp = singletests + atoi(optarg) - 1;
 	    (void)fwrite(mp->test, mp->testlen, sizeof(char), stdout);
@@ -0,0 +1,164 @@
+/* timerwheel.c -- a hashed timing wheel of millisecond timers
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#include <limits.h>
+#include <stddef.h>
+
+#include "timerwheel.h"
+
+#define SLOT_MASK	(TIMERWHEEL_SLOTS - 1)
+#define FIRING		TIMERWHEEL_SLOTS	/* the list being fired */
+
+static void link_timer(struct timerwheel_t *wheel, struct wheel_timer_t *timer,
+		       int slot)
+{
+    timer->slot = slot;
+    timer->prev = NULL;
+    timer->next = wheel->slot[slot];
+    if (timer->next != NULL)
+	timer->next->prev = timer;
+    wheel->slot[slot] = timer;
+}
+
+static void unlink_timer(struct timerwheel_t *wheel,
+			 struct wheel_timer_t *timer)
+{
+    if (timer->prev != NULL)
+	timer->prev->next = timer->next;
+    else
+	wheel->slot[timer->slot] = timer->next;
+    if (timer->next != NULL)
+	timer->next->prev = timer->prev;
+    timer->next = timer->prev = NULL;
+    timer->slot = -1;
+}
+
+void timerwheel_init(struct timerwheel_t *wheel, uint64_t now)
+{
+    int i;
+
+    for (i = 0; i <= TIMERWHEEL_SLOTS; i++)
+	wheel->slot[i] = NULL;
+    wheel->armed = 0;
+    wheel->tick = now / TIMERWHEEL_TICK;
+}
+
+void timerwheel_timer_init(struct wheel_timer_t *timer, void *data)
+{
+    timer->next = timer->prev = NULL;
+    timer->due = 0;
+    timer->slot = -1;
+    timer->data = data;
+}
+
+void timerwheel_arm(struct timerwheel_t *wheel, struct wheel_timer_t *timer,
+		    uint64_t due)
+/* (re)arm a timer to fire at due */
+{
+    uint64_t tick = due / TIMERWHEEL_TICK;
+
+    if (timerwheel_armed(timer)) {
+	/* re-arming for the same tick is common and free */
+	if (timer->slot != FIRING && timer->due / TIMERWHEEL_TICK == tick) {
+	    timer->due = due;
+	    return;
+	}
+	unlink_timer(wheel, timer);
+    } else
+	wheel->armed++;
+    /* ticks already expired go to the next one */
+    if (tick < wheel->tick)
+	tick = wheel->tick;
+    timer->due = due;
+    link_timer(wheel, timer, (int)(tick & SLOT_MASK));
+}
+
+void timerwheel_cancel(struct timerwheel_t *wheel, struct wheel_timer_t *timer)
+/* disarm a timer, harmless if it is not armed */
+{
+    if (!timerwheel_armed(timer))
+	return;
+    unlink_timer(wheel, timer);
+    wheel->armed--;
+}
+
+unsigned timerwheel_expire(struct timerwheel_t *wheel, uint64_t now,
+			   timerwheel_fire_t fire, void *arg)
+/* fire every timer due by now, return how many did */
+{
+    uint64_t last;
+    unsigned turns, fired = 0;
+
+    /* only ticks that are over, so nothing fires early */
+    if (now / TIMERWHEEL_TICK <= wheel->tick)
+	return 0;
+    last = now / TIMERWHEEL_TICK - 1;
+    /* a turn looks at every slot, however many ticks went by */
+    turns = last - wheel->tick >= TIMERWHEEL_SLOTS
+	? TIMERWHEEL_SLOTS : (unsigned)(last - wheel->tick + 1);
+    for (; turns > 0 && wheel->armed > 0; turns--, wheel->tick++) {
+	struct wheel_timer_t *timer, *next;
+
+	for (timer = wheel->slot[wheel->tick & SLOT_MASK]; timer != NULL;
+	     timer = next) {
+	    next = timer->next;
+	    if (timer->due / TIMERWHEEL_TICK <= last) {
+		unlink_timer(wheel, timer);
+		link_timer(wheel, timer, FIRING);
+	    }
+	}
+    }
+    wheel->tick = last + 1;
+
+    /*
+     * Fire only now, so a handler can arm or cancel any timer.  What it
+     * re-arms lands at the next tick at the earliest.
+     */
+    while (wheel->slot[FIRING] != NULL) {
+	struct wheel_timer_t *timer = wheel->slot[FIRING];
+
+	unlink_timer(wheel, timer);
+	wheel->armed--;
+	fired++;
+	fire(timer, arg);
+    }
+    return fired;
+}
+
+int timerwheel_timeout(const struct timerwheel_t *wheel, uint64_t now,
+		       int max)
+/* ms until a tick with timers due in it is over, at most max if max >= 0 */
+{
+    uint64_t tick, at, due = UINT64_MAX;
+    unsigned i;
+
+    if (wheel->armed == 0)
+	return max;
+    /* no need to look further than max */
+    for (i = 0, tick = wheel->tick; i < TIMERWHEEL_SLOTS; i++, tick++) {
+	const struct wheel_timer_t *timer;
+
+	at = (tick + 1) * TIMERWHEEL_TICK;
+	if (max >= 0 && at >= now + (uint64_t)max)
+	    return max;
+	for (timer = wheel->slot[tick & SLOT_MASK]; timer != NULL;
+	     timer = timer->next) {
+	    if (timer->due / TIMERWHEEL_TICK <= tick)
+		return at <= now ? 0 : (int)(at - now);
+	    /* due a turn or more later */
+	    if (timer->due < due)
+		due = timer->due;
+	}
+    }
+    /* a whole turn went by empty, every timer was seen */
+    at = (due / TIMERWHEEL_TICK + 1) * TIMERWHEEL_TICK;
+    if (at <= now)
+	return 0;
+    if (max >= 0 && at - now > (uint64_t)max)
+	return max;
+    return at - now > INT_MAX ? INT_MAX : (int)(at - now);
+}
+
+/* timerwheel.c ends here */
@@ -0,0 +1,66 @@
+/* timerwheel.h -- a hashed timing wheel of millisecond timers
+ *
+ * This file is Copyright (c) 2010 by the GPSD project
+ * BSD terms apply: see the file COPYING in the distribution root for details.
+ */
+#ifndef _TIMERWHEEL_H_
+#define _TIMERWHEEL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+
+/*
+ * Timers hang in the slot of the tick they are due in, modulo the
+ * number of slots; a timer due more than a turn ahead waits in its slot
+ * until its turn comes.  Arming and cancelling are O(1), expiring walks
+ * the slots of the ticks that went by since the last call, a turn at
+ * most however long that was.  Timers are embedded in whatever they
+ * time, the wheel never allocates.
+ *
+ * Times are ms of the monotonic clock, see timerwheel_now().  A timer
+ * fires on the first timerwheel_expire() at or after its due time, with
+ * the resolution of a tick.  timerwheel_timeout() is how long a poll may
+ * sleep until then; a negative max means no limit, and comes back when
+ * no timer is armed.
+ */
+#define TIMERWHEEL_TICK		10	/* ms */
+#define TIMERWHEEL_SLOTS	256	/* a turn is 2.56s */
+
+struct wheel_timer_t {
+    struct wheel_timer_t *next, *prev;
+    uint64_t due;		/* ms */
+    int slot;			/* -1 while not armed */
+    void *data;			/* for the owner */
+};
+
+struct timerwheel_t {
+    uint64_t tick;		/* the next tick to expire */
+    unsigned armed;		/* timers on the wheel */
+    /* the last one holds what timerwheel_expire() is firing */
+    struct wheel_timer_t *slot[TIMERWHEEL_SLOTS + 1];
+};
+
+typedef void (*timerwheel_fire_t)(struct wheel_timer_t *, void *);
+
+extern void timerwheel_init(struct timerwheel_t *, uint64_t);
+extern void timerwheel_timer_init(struct wheel_timer_t *, void *);
+extern void timerwheel_arm(struct timerwheel_t *, struct wheel_timer_t *,
+			   uint64_t);
+extern void timerwheel_cancel(struct timerwheel_t *, struct wheel_timer_t *);
+extern unsigned timerwheel_expire(struct timerwheel_t *, uint64_t,
+				  timerwheel_fire_t, void *);
+extern int timerwheel_timeout(const struct timerwheel_t *, uint64_t, int);
+
+#define timerwheel_armed(timer)	((timer)->slot >= 0)
+
+static inline uint64_t timerwheel_now(void)
+/* monotonic ms, the time base of the wheel */
+{
+    struct timespec ts;
+
+    (void)clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+#endif /* _TIMERWHEEL_H_ */